@@ -0,0 +1,81 @@
+/** @file
+ * Implementations of functions counting the operations on a structure.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "counters.h"
+
+#define COUNTER_SLOTS 16 /**< Number of copies of the counters the threads are spread over. */
+#define CACHE_LINE_SIZE 64 /**< Size of the cache line, each copy of the counters takes a whole one. */
+#define NO_SLOT UINT_MAX /**< The thread hasn't been given a copy of the counters yet. */
+
+/**
+ * @struct CounterSlot
+ * @brief Copy of the counters used by some of the threads, padded to a whole cache line.
+ * @var CounterSlot::values
+ *      Values of the counters.
+ * @var CounterSlot::padding
+ *      Unused memory keeping other copies out of the cache line.
+ */
+struct CounterSlot {
+    atomic_uint_fast64_t values[NUMBER_OF_COUNTERS];
+    char padding[CACHE_LINE_SIZE - NUMBER_OF_COUNTERS * sizeof(atomic_uint_fast64_t)];
+};
+
+/**
+ * @struct OperationCounters
+ * @brief Copies of the counters, a thread uses the copy assigned to it.
+ * @var OperationCounters::slots
+ *      Array of the copies.
+ */
+struct OperationCounters {
+    struct CounterSlot slots[COUNTER_SLOTS];
+};
+
+static atomic_uint nextSlot; /**< The copy of the counters assigned to the next thread. */
+static _Thread_local unsigned threadSlot = NO_SLOT; /**< The copy of the counters assigned to the current thread. */
+
+OperationCounters *countersNew(void) {
+    OperationCounters *counters = aligned_alloc(CACHE_LINE_SIZE, sizeof(OperationCounters));
+    if (counters == NULL) {
+        return NULL;
+    }
+
+    for (size_t slot = 0; slot < COUNTER_SLOTS; slot++) {
+        for (int counter = 0; counter < NUMBER_OF_COUNTERS; counter++) {
+            atomic_init(&counters->slots[slot].values[counter], 0);
+        }
+    }
+    return counters;
+}
+
+void countersDelete(OperationCounters *counters) {
+    free(counters);
+}
+
+void countersAdd(OperationCounters *counters, int counter, uint64_t value) {
+    if (counters == NULL) {
+        return;
+    }
+
+    if (threadSlot == NO_SLOT) {
+        threadSlot = atomic_fetch_add_explicit(&nextSlot, 1, memory_order_relaxed) % COUNTER_SLOTS;
+    }
+    atomic_fetch_add_explicit(&counters->slots[threadSlot].values[counter], value, memory_order_relaxed);
+}
+
+uint64_t countersGet(OperationCounters const *counters, int counter) {
+    uint64_t sum = 0;
+    for (size_t slot = 0; slot < COUNTER_SLOTS; slot++) {
+        sum += atomic_load_explicit(&counters->slots[slot].values[counter], memory_order_relaxed);
+    }
+    return sum;
+}
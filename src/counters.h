@@ -0,0 +1,62 @@
+/** @file
+ * Interface of the class counting the operations on a structure.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <stdint.h>
+
+#define COUNTER_GET_CALLS 0 /**< Number of the numbers whose forwarding was determined. */
+#define COUNTER_REVERSE_CALLS 1 /**< Number of the calls of @ref phfwdReverse. */
+#define COUNTER_GET_REVERSE_CALLS 2 /**< Number of the calls of @ref phfwdGetReverse. */
+#define COUNTER_DIGITS_WALKED 3 /**< Number of the digits of the queried numbers followed down the trees. */
+#define COUNTER_NODE_ALLOCATIONS 4 /**< Number of the nodes taken from the pool. */
+#define COUNTER_NODE_FREES 5 /**< Number of the nodes returned to the pool. */
+#define COUNTER_CACHE_HITS 6 /**< Number of the lookups answered from the cache of the results. */
+#define NUMBER_OF_COUNTERS 7 /**< Number of the different counters. */
+
+/**
+ * This is a structure storing the counters of the operations.
+ * Each thread adds to its own copy of the counters, kept in a separate cache line, so counting doesn't make the
+ * threads wait for each other.
+ */
+struct OperationCounters;
+typedef struct OperationCounters OperationCounters; /**< Counters of the operations. */
+
+/**
+ * @brief Creates new counters, all equal to 0.
+ * @return Pointer to the new counters or NULL if there was an allocation error.
+ */
+OperationCounters *countersNew(void);
+
+/**
+ * @brief Deletes the counters.
+ * Does nothing if the pointer is NULL.
+ * @param [in] counters - pointer to the counters.
+ */
+void countersDelete(OperationCounters *counters);
+
+/**
+ * @brief Increases the counter.
+ * Does nothing if the pointer is NULL.
+ * @param [in, out] counters - pointer to the counters.
+ * @param [in] counter - the counter, one of the @p COUNTER_ constants.
+ * @param [in] value - the value added to the counter.
+ */
+void countersAdd(OperationCounters *counters, int counter, uint64_t value);
+
+/**
+ * @brief Obtains the value of the counter.
+ * Adds up the copies of all threads, the additions made at the same time may be missed.
+ * @param [in] counters - pointer to the counters.
+ * @param [in] counter - the counter, one of the @p COUNTER_ constants.
+ * @return The value of the counter.
+ */
+uint64_t countersGet(OperationCounters const *counters, int counter);
+
+#endif /* __COUNTERS_H__ */
@@ -0,0 +1,236 @@
+/** @file
+ * Implementations of functions reclaiming memory shared with concurrent readers.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "epoch.h"
+
+#define READER_SLOTS 16 /**< Number of counters the readers of a single epoch are spread over. */
+#define CACHE_LINE_SIZE 64 /**< Size of the cache line, each counter of readers takes a whole one. */
+#define NO_SLOT UINT_MAX /**< The thread hasn't been given a counter of readers yet. */
+#define MAX_SPARE_RECORDS 256 /**< Number of the records of reclaimed objects kept for the next retirements. */
+
+/**
+ * @struct ReaderCounter
+ * @brief Number of readers that started in an epoch, padded to a whole cache line.
+ * @var ReaderCounter::readers
+ *      Number of the readers.
+ * @var ReaderCounter::padding
+ *      Unused memory keeping other counters out of the cache line.
+ */
+struct ReaderCounter {
+    atomic_size_t readers;
+    char padding[CACHE_LINE_SIZE - sizeof(atomic_size_t)];
+};
+
+/**
+ * @struct Retired
+ * @brief Object waiting until no reader can see it.
+ * @var Retired::object
+ *      Pointer to the object.
+ * @var Retired::reclaim
+ *      The function freeing the object.
+ * @var Retired::context
+ *      Pointer passed to @p reclaim.
+ * @var Retired::next
+ *      Pointer to the object retired before this one.
+ */
+struct Retired {
+    void *object;
+    Reclaimer reclaim;
+    void *context;
+    struct Retired *next;
+};
+
+/**
+ * @struct EpochDomain
+ * @brief Counters of the readers and the objects retired by the writer.
+ * Only the parity of the epoch matters for the counters and the lists: the epoch moves forward only when there are
+ * no readers of the previous epoch left, which is the one with the same parity as the next epoch.
+ * @var EpochDomain::counters
+ *      Counters of the readers of the epochs of each parity, a reader uses the counter assigned to its thread.
+ * @var EpochDomain::epoch
+ *      The current epoch.
+ * @var EpochDomain::retired
+ *      Lists of the objects retired in the epochs of each parity.
+ * @var EpochDomain::spare
+ *      List of the unused records, linked with the @p next field.
+ * @var EpochDomain::spareCount
+ *      Number of the unused records.
+ * @var EpochDomain::reserved
+ *      Number of the unused records reserved for the retirements of the current write.
+ * @var EpochDomain::lost
+ *      Number of the objects that were retired without a reserved record when there was no memory for one, they are
+ *      never freed.
+ */
+struct EpochDomain {
+    struct ReaderCounter counters[2][READER_SLOTS];
+    atomic_uint_fast64_t epoch;
+    struct Retired *retired[2];
+    struct Retired *spare;
+    size_t spareCount;
+    size_t reserved;
+    size_t lost;
+};
+
+static atomic_uint nextSlot; /**< The counter of readers assigned to the next thread. */
+static _Thread_local unsigned threadSlot = NO_SLOT; /**< The counter of readers assigned to the current thread. */
+
+/**
+ * @brief Frees the objects from the list.
+ * Their records are kept for the next retirements, up to @ref MAX_SPARE_RECORDS of them.
+ * @param [in, out] domain - pointer to the domain.
+ * @param [in, out] retired - pointer to the first object of the list.
+ */
+static void reclaimAll(EpochDomain *domain, struct Retired *retired) {
+    while (retired != NULL) {
+        struct Retired *next = retired->next;
+        retired->reclaim(retired->context, retired->object);
+        if (domain->spareCount < MAX_SPARE_RECORDS) {
+            retired->next = domain->spare;
+            domain->spare = retired;
+            domain->spareCount++;
+        } else {
+            free(retired);
+        }
+        retired = next;
+    }
+}
+
+EpochDomain *epochNew(void) {
+    size_t size = (sizeof(EpochDomain) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    EpochDomain *domain = aligned_alloc(CACHE_LINE_SIZE, size);
+    if (domain == NULL) {
+        return NULL;
+    }
+
+    for (int parity = 0; parity < 2; parity++) {
+        for (size_t slot = 0; slot < READER_SLOTS; slot++) {
+            atomic_init(&domain->counters[parity][slot].readers, 0);
+        }
+        domain->retired[parity] = NULL;
+    }
+    atomic_init(&domain->epoch, 0);
+    domain->spare = NULL;
+    domain->spareCount = 0;
+    domain->reserved = 0;
+    domain->lost = 0;
+    return domain;
+}
+
+void epochDelete(EpochDomain *domain) {
+    if (domain == NULL) {
+        return;
+    }
+
+    reclaimAll(domain, domain->retired[0]);
+    reclaimAll(domain, domain->retired[1]);
+    while (domain->spare != NULL) {
+        struct Retired *next = domain->spare->next;
+        free(domain->spare);
+        domain->spare = next;
+    }
+    free(domain);
+}
+
+unsigned epochEnter(EpochDomain *domain) {
+    if (threadSlot == NO_SLOT) {
+        threadSlot = atomic_fetch_add(&nextSlot, 1) % READER_SLOTS;
+    }
+
+    while (true) {
+        uint_fast64_t epoch = atomic_load(&domain->epoch);
+        unsigned parity = (unsigned) (epoch & 1);
+        atomic_fetch_add(&domain->counters[parity][threadSlot].readers, 1);
+        if (atomic_load(&domain->epoch) == epoch) {
+            return 2 * threadSlot + parity;
+        }
+        atomic_fetch_sub(&domain->counters[parity][threadSlot].readers, 1);
+    }
+}
+
+void epochExit(EpochDomain *domain, unsigned token) {
+    atomic_fetch_sub(&domain->counters[token & 1][token / 2].readers, 1);
+}
+
+/**
+ * @brief Moves to the next epoch if all readers of the previous one are done.
+ * Frees the objects retired in the previous epoch, none of the readers that are left could have seen them.
+ * @param [in, out] domain - pointer to the domain.
+ * @return Value @p true if the epoch was moved.
+ *         Value @p false if some readers of the previous epoch are still reading.
+ */
+static bool advanceEpoch(EpochDomain *domain) {
+    uint_fast64_t epoch = atomic_load(&domain->epoch);
+    unsigned previous = (unsigned) ((epoch + 1) & 1);
+    for (size_t slot = 0; slot < READER_SLOTS; slot++) {
+        if (atomic_load(&domain->counters[previous][slot].readers) != 0) {
+            return false;
+        }
+    }
+
+    struct Retired *retired = domain->retired[previous];
+    domain->retired[previous] = NULL;
+    atomic_store(&domain->epoch, epoch + 1);
+    reclaimAll(domain, retired);
+    return true;
+}
+
+bool epochReserve(EpochDomain *domain, size_t count) {
+    domain->reserved += count;
+    while (domain->spareCount < domain->reserved) {
+        struct Retired *retired = malloc(sizeof(struct Retired));
+        if (retired == NULL) {
+            domain->reserved -= count;
+            return false;
+        }
+        retired->next = domain->spare;
+        domain->spare = retired;
+        domain->spareCount++;
+    }
+    return true;
+}
+
+void epochRetire(EpochDomain *domain, void *object, Reclaimer reclaim, void *context) {
+    struct Retired *retired = domain->spare;
+    if (retired != NULL) {
+        domain->spare = retired->next;
+        domain->spareCount--;
+        if (domain->reserved > 0) {
+            domain->reserved--;
+        }
+    } else {
+        retired = malloc(sizeof(struct Retired));
+    }
+    if (retired == NULL) {
+        domain->lost++;
+        return;
+    }
+
+    unsigned parity = (unsigned) (atomic_load(&domain->epoch) & 1);
+    retired->object = object;
+    retired->reclaim = reclaim;
+    retired->context = context;
+    retired->next = domain->retired[parity];
+    domain->retired[parity] = retired;
+}
+
+void epochReclaim(EpochDomain *domain) {
+    domain->reserved = 0;
+    while (domain->spareCount > MAX_SPARE_RECORDS) {
+        struct Retired *next = domain->spare->next;
+        free(domain->spare);
+        domain->spare = next;
+        domain->spareCount--;
+    }
+    advanceEpoch(domain);
+}
@@ -0,0 +1,94 @@
+/** @file
+ * Interface of the class reclaiming memory shared with concurrent readers.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * This is a structure deciding when the memory that readers could have seen can be freed.
+ * Readers announce the epoch they started in, the writer retires the memory it has made unreachable and frees it once
+ * no reader that could have seen it is left.
+ */
+struct EpochDomain;
+typedef struct EpochDomain EpochDomain; /**< Domain of epoch-based reclamation. */
+
+/**
+ * @brief Function freeing the retired object.
+ * @param [in, out] context - pointer given when the object was retired.
+ * @param [in, out] object - pointer to the object.
+ */
+typedef void (*Reclaimer)(void *context, void *object);
+
+/**
+ * @brief Creates a new domain.
+ * @return Pointer to the new domain or NULL if there was an allocation error.
+ */
+EpochDomain *epochNew(void);
+
+/**
+ * @brief Deletes the domain.
+ * Frees all the retired objects, there mustn't be any readers left. Does nothing if the pointer is NULL.
+ * @param [in] domain - pointer to the domain.
+ */
+void epochDelete(EpochDomain *domain);
+
+/**
+ * @brief Starts reading the shared memory.
+ * Doesn't take any locks, it may only retry if the epoch changes at the same time.
+ * @param [in, out] domain - pointer to the domain.
+ * @return The token to pass to @ref epochExit.
+ */
+unsigned epochEnter(EpochDomain *domain);
+
+/**
+ * @brief Stops reading the shared memory.
+ * @param [in, out] domain - pointer to the domain.
+ * @param [in] token - the token returned by @ref epochEnter.
+ */
+void epochExit(EpochDomain *domain, unsigned token);
+
+/**
+ * @brief Makes sure the retirements of the current write don't allocate memory.
+ * The objects retired before the write is published can still be reached by new readers, so they can't be freed
+ * right away when there is no memory to remember them. Reserving the memory beforehand guarantees that the next
+ * @p count of them are remembered. The reservations last until @ref epochReclaim. It may only be called by one
+ * writer at a time.
+ * @param [in, out] domain - pointer to the domain.
+ * @param [in] count - number of the retirements.
+ * @return Value @p true if the memory was reserved.
+ *         Value @p false if there was an allocation error.
+ */
+bool epochReserve(EpochDomain *domain, size_t count);
+
+/**
+ * @brief Retires the object that was made unreachable for new readers.
+ * The object is freed with @p reclaim once all readers that could have seen it are done. The object is never freed
+ * right away: until the write is published new readers can still reach it. Every retirement has to be covered by
+ * @ref epochReserve before the write changes anything, so that a write without memory fails before it starts. If an
+ * object is retired without a reservation and there is no memory to remember it, it is never freed, which is safe.
+ * It may only be called by one writer at a time.
+ * @param [in, out] domain - pointer to the domain.
+ * @param [in, out] object - pointer to the object.
+ * @param [in] reclaim - the function freeing the object.
+ * @param [in, out] context - pointer passed to @p reclaim.
+ */
+void epochRetire(EpochDomain *domain, void *object, Reclaimer reclaim, void *context);
+
+/**
+ * @brief Frees the objects that no reader can see anymore.
+ * Moves to the next epoch if all readers of the previous one are done, freeing the objects retired two epochs ago.
+ * Ends the reservations made by @ref epochReserve. Never waits for the readers. It may only be called by one writer
+ * at a time, once its write is published.
+ * @param [in, out] domain - pointer to the domain.
+ */
+void epochReclaim(EpochDomain *domain);
+
+#endif /* __EPOCH_H__ */
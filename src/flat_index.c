@@ -0,0 +1,1067 @@
+/** @file
+ * Implementations of functions regarding the flat index of phone forwarding.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _POSIX_C_SOURCE 200809L /**< Makes the POSIX functions for mapping files available. */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "packed_number.h"
+#include "phone_numbers.h"
+#include "string_utils.h"
+#include "node_utils.h"
+#include "flat_index.h"
+
+#define FLAT_MAGIC "PHFWDIDX" /**< Characters the image starts with. */
+#define FLAT_MAGIC_SIZE 8 /**< Number of the characters the image starts with. */
+#define FLAT_VERSION 3 /**< Version of the format of the image. */
+#define FLAT_NO_VALUE UINT32_MAX /**< Value of the node that doesn't store any numbers. */
+#define FLAT_ALIGNMENT 8 /**< Alignment of the parts of the image. */
+#define FIRST_FLAT_CAPACITY 64 /**< Initial number of elements of the arrays used while building the image. */
+#define LABEL_CAPACITY 16 /**< Maximal number of digits of the label stored in a node. */
+#define BATCH_LANES 8 /**< Number of numbers whose routes are followed in lock-step by @ref flatFindPrefixBatch. */
+#define NUMBER_BUFFER_SIZE 64 /**< Size of the buffer for the digits of a number unpacked without allocating. */
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address) /**< Hints the processor to load the memory into cache. */
+#else
+#define PREFETCH(address) ((void) (address)) /**< Hints the processor to load the memory into cache. */
+#endif
+
+/**
+ * @struct FlatHeader
+ * @brief Header at the beginning of the image.
+ * All offsets are counted in bytes from the beginning of the image.
+ * @var FlatHeader::magic
+ *      The characters @ref FLAT_MAGIC.
+ * @var FlatHeader::version
+ *      Version of the format, @ref FLAT_VERSION.
+ * @var FlatHeader::forwardCount
+ *      Number of the nodes of the forward tree.
+ * @var FlatHeader::reverseCount
+ *      Number of the nodes of the reverse tree.
+ * @var FlatHeader::listsLength
+ *      Number of the elements of the lists of numbers of the reverse tree.
+ * @var FlatHeader::blobSize
+ *      Number of the bytes of all the packed numbers.
+ * @var FlatHeader::forwardOffset
+ *      Offset of the array of the nodes of the forward tree.
+ * @var FlatHeader::reverseOffset
+ *      Offset of the array of the nodes of the reverse tree.
+ * @var FlatHeader::listsOffset
+ *      Offset of the lists of numbers of the reverse tree.
+ * @var FlatHeader::blobOffset
+ *      Offset of the packed numbers.
+ */
+struct FlatHeader {
+    char magic[FLAT_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t forwardCount;
+    uint32_t reverseCount;
+    uint32_t listsLength;
+    uint64_t blobSize;
+    uint64_t forwardOffset;
+    uint64_t reverseOffset;
+    uint64_t listsOffset;
+    uint64_t blobOffset;
+};
+
+/**
+ * @struct FlatNode
+ * @brief Node of a tree stored in the image.
+ * The nodes of a tree are stored in breadth-first order, starting with the root.
+ * @var FlatNode::label
+ *      Digits of the edge leading to the node, packed like in @ref nodeGetLabel.
+ * @var FlatNode::children
+ *      Index of the first child of the node, the children are stored next to each other in the order of their digits.
+ * @var FlatNode::value
+ *      For the forward tree it is the offset of the packed number the route to the node is forwarded to, for the
+ *      reverse tree it is the index of the list of numbers forwarded to the route, or @ref FLAT_NO_VALUE. Each list
+ *      starts with the number of its elements, which are the offsets of the packed numbers in their sorted order.
+ * @var FlatNode::mask
+ *      Bitmap of the digits the node has children for.
+ * @var FlatNode::labelLength
+ *      Number of digits in the label.
+ * @var FlatNode::padding
+ *      Unused bytes, set to 0.
+ */
+struct FlatNode {
+    uint64_t label;
+    uint32_t children;
+    uint32_t value;
+    uint16_t mask;
+    uint8_t labelLength;
+    uint8_t padding[5];
+};
+
+/**
+ * @struct FlatIndex
+ * @brief Image of the trees and the pointers to its parts.
+ * @var FlatIndex::data
+ *      Pointer to the image.
+ * @var FlatIndex::size
+ *      Size of the image in bytes.
+ * @var FlatIndex::mapped
+ *      Whether the image is a mapped file or allocated memory.
+ * @var FlatIndex::forward
+ *      Array of the nodes of the forward tree.
+ * @var FlatIndex::reverse
+ *      Array of the nodes of the reverse tree.
+ * @var FlatIndex::lists
+ *      Lists of numbers of the reverse tree.
+ * @var FlatIndex::blob
+ *      All the packed numbers.
+ */
+struct FlatIndex {
+    void *data;
+    size_t size;
+    bool mapped;
+    struct FlatNode const *forward;
+    struct FlatNode const *reverse;
+    uint32_t const *lists;
+    PackedNumber const *blob;
+};
+
+/**
+ * @struct FlatBuilder
+ * @brief Parts of the image while it is being built.
+ * @var FlatBuilder::nodes
+ *      Array of the nodes of the tree that is being flattened.
+ * @var FlatBuilder::trees
+ *      Array of the nodes of the original tree corresponding to @p nodes.
+ * @var FlatBuilder::nodeCount
+ *      Number of the nodes in @p nodes.
+ * @var FlatBuilder::nodeCapacity
+ *      Number of the nodes @p nodes and @p trees have memory for.
+ * @var FlatBuilder::lists
+ *      Lists of numbers of the reverse tree.
+ * @var FlatBuilder::listsLength
+ *      Number of the elements of @p lists.
+ * @var FlatBuilder::listsCapacity
+ *      Number of the elements @p lists has memory for.
+ * @var FlatBuilder::blob
+ *      All the packed numbers.
+ * @var FlatBuilder::blobSize
+ *      Number of the bytes in @p blob.
+ * @var FlatBuilder::blobCapacity
+ *      Number of the bytes @p blob has memory for.
+ */
+struct FlatBuilder {
+    struct FlatNode *nodes;
+    DNode **trees;
+    size_t nodeCount;
+    size_t nodeCapacity;
+    uint32_t *lists;
+    size_t listsLength;
+    size_t listsCapacity;
+    PackedNumber *blob;
+    size_t blobSize;
+    size_t blobCapacity;
+};
+
+/**
+ * @brief Makes sure the array has memory for the given number of elements.
+ * @param [in] array - pointer to the array.
+ * @param [in] capacity - number of the elements the array has memory for.
+ * @param [in] needed - number of the elements the array needs memory for.
+ * @param [in] elementSize - size of an element in bytes.
+ * @param [in, out] newCapacity - pointer to the new number of elements.
+ * @return Pointer to the array or NULL if there was an allocation error, the array isn't freed then.
+ */
+static void *growArray(void *array, size_t capacity, size_t needed, size_t elementSize, size_t *newCapacity) {
+    *newCapacity = capacity;
+    if (needed <= capacity) {
+        return array;
+    }
+
+    size_t grown = capacity == 0 ? FIRST_FLAT_CAPACITY : capacity;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    void *result = realloc(array, grown * elementSize);
+    if (result != NULL) {
+        *newCapacity = grown;
+    }
+    return result;
+}
+
+/**
+ * @brief Obtains the memory for a packed number at the end of the numbers of the image.
+ * @param [in, out] builder - pointer to the builder.
+ * @param [in] bytes - size of the packed number.
+ * @param [in, out] offset - pointer to the offset of the added number.
+ * @return Pointer to the memory for the packed number or NULL if there was an allocation error or the numbers don't
+ *         fit in the format.
+ */
+static PackedNumber *reserveNumber(struct FlatBuilder *builder, size_t bytes, uint32_t *offset) {
+    if (builder->blobSize + bytes > UINT32_MAX) {
+        return NULL;
+    }
+
+    PackedNumber *blob = growArray(builder->blob, builder->blobCapacity, builder->blobSize + bytes,
+                                   sizeof(PackedNumber), &builder->blobCapacity);
+    if (blob == NULL) {
+        return NULL;
+    }
+    builder->blob = blob;
+
+    *offset = (uint32_t) builder->blobSize;
+    builder->blobSize += bytes;
+    return blob + *offset;
+}
+
+/**
+ * @brief Packs the number and adds it to the numbers of the image.
+ * @param [in, out] builder - pointer to the builder.
+ * @param [in] number - the number.
+ * @param [in, out] offset - pointer to the offset of the added number.
+ * @return Value @p true if the number was added successfully.
+ *         Value @p false if there was an allocation error or the numbers don't fit in the format.
+ */
+static bool addNumber(struct FlatBuilder *builder, char const *number, uint32_t *offset) {
+    size_t len = length(number);
+    PackedNumber *packed = reserveNumber(builder, packedSize(len), offset);
+    if (packed == NULL) {
+        return false;
+    }
+    packNumber(number, len, packed);
+    return true;
+}
+
+/**
+ * @brief Adds the element to the lists of numbers of the image.
+ * @param [in, out] builder - pointer to the builder.
+ * @param [in] element - the element.
+ * @return Value @p true if the element was added successfully.
+ *         Value @p false if there was an allocation error or the lists don't fit in the format.
+ */
+static bool addListElement(struct FlatBuilder *builder, uint32_t element) {
+    if (builder->listsLength >= UINT32_MAX) {
+        return false;
+    }
+
+    uint32_t *lists = growArray(builder->lists, builder->listsCapacity, builder->listsLength + 1, sizeof(uint32_t),
+                                &builder->listsCapacity);
+    if (lists == NULL) {
+        return false;
+    }
+    builder->lists = lists;
+    builder->lists[builder->listsLength++] = element;
+    return true;
+}
+
+/**
+ * @brief Adds the number forwarded to the node of the reverse tree to the image.
+ * @param [in] number - the forwarded number.
+ * @param [in, out] context - pointer to the builder.
+ * @return Value @p true if the number was added successfully.
+ *         Value @p false if there was an allocation error or the image doesn't fit in the format.
+ */
+static bool addSourceNumber(char const *number, void *context) {
+    struct FlatBuilder *builder = context;
+    uint32_t offset;
+    return addNumber(builder, number, &offset) && addListElement(builder, offset);
+}
+
+/**
+ * @brief Adds the node of the tree to the end of the array of the nodes of the image.
+ * @param [in, out] builder - pointer to the builder.
+ * @param [in] node - pointer to the node of the tree.
+ * @return Value @p true if the node was added successfully.
+ *         Value @p false if there was an allocation error or the tree doesn't fit in the format.
+ */
+static bool addNode(struct FlatBuilder *builder, DNode *node) {
+    if (builder->nodeCount >= UINT32_MAX) {
+        return false;
+    }
+
+    if (builder->nodeCount == builder->nodeCapacity) {
+        size_t capacity;
+        struct FlatNode *nodes = growArray(builder->nodes, builder->nodeCapacity, builder->nodeCount + 1,
+                                           sizeof(struct FlatNode), &capacity);
+        if (nodes == NULL) {
+            return false;
+        }
+        builder->nodes = nodes;
+
+        DNode **trees = growArray(builder->trees, builder->nodeCapacity, builder->nodeCount + 1, sizeof(DNode *),
+                                  &capacity);
+        if (trees == NULL) {
+            return false;
+        }
+        builder->trees = trees;
+        builder->nodeCapacity = capacity;
+    }
+
+    builder->trees[builder->nodeCount++] = node;
+    return true;
+}
+
+/**
+ * @brief Flattens the tree.
+ * The array of the nodes of the builder is used as the queue of the breadth-first walk of the tree: the children of
+ * each node are appended to it when the node is flattened.
+ * @param [in, out] builder - pointer to the builder, its array of nodes has to be empty.
+ * @param [in] root - pointer to the root of the tree.
+ * @param [in] reverse - whether the tree is the reverse tree.
+ * @return Value @p true if the tree was flattened successfully.
+ *         Value @p false if there was an allocation error or the tree doesn't fit in the format.
+ */
+static bool flattenTree(struct FlatBuilder *builder, DNode *root, bool reverse) {
+    if (!addNode(builder, root)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < builder->nodeCount; i++) {
+        DNode *node = builder->trees[i];
+        struct FlatNode flat = {0};
+        size_t labelLength;
+        flat.label = nodeGetLabel(node, &labelLength);
+        flat.labelLength = (uint8_t) labelLength;
+        flat.children = (uint32_t) builder->nodeCount;
+        flat.value = FLAT_NO_VALUE;
+
+        for (int digit = 0; digit < NUMBER_OF_DIGITS; digit++) {
+            DNode *next = nodeGetNext(node, digit);
+            if (next != NULL) {
+                if (!addNode(builder, next)) {
+                    return false;
+                }
+                flat.mask |= (uint16_t) (1u << digit);
+            }
+        }
+
+        PackedNumber const *target = nodeGetNumber(node);
+        if (!reverse && target != NULL) {
+            PackedNumber *packed = reserveNumber(builder, packedBytes(target), &flat.value);
+            if (packed == NULL) {
+                return false;
+            }
+            memcpy(packed, target, packedBytes(target));
+        } else if (reverse) {
+            size_t list = builder->listsLength;
+            if (!addListElement(builder, 0) || !nodeVisitNumbers(node, addSourceNumber, builder)) {
+                return false;
+            }
+            if (builder->listsLength == list + 1) {
+                builder->listsLength = list;
+            } else {
+                builder->lists[list] = (uint32_t) (builder->listsLength - list - 1);
+                flat.value = (uint32_t) list;
+            }
+        }
+
+        builder->nodes[i] = flat;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Rounds the offset up to @ref FLAT_ALIGNMENT.
+ * @param [in] offset - the offset.
+ * @return The smallest multiple of @ref FLAT_ALIGNMENT not smaller than the offset.
+ */
+static size_t alignOffset(size_t offset) {
+    return (offset + FLAT_ALIGNMENT - 1) / FLAT_ALIGNMENT * FLAT_ALIGNMENT;
+}
+
+/**
+ * @brief Checks the nodes of the tree stored in the image.
+ * The children of the nodes have to follow each other in breadth-first order inside the array, so that every node
+ * but the root has exactly one parent, the labels have to consist of valid digits and the values have to point to
+ * valid packed numbers inside the image, so that no walk of the index can read outside of it, loop forever or visit
+ * a node twice. The lists of numbers of the reverse tree have to be sorted, so that they can be merged without
+ * sorting them again.
+ * @param [in] index - pointer to the index with the set parts.
+ * @param [in] header - pointer to the header of the image.
+ * @param [in] nodes - array of the nodes.
+ * @param [in] count - number of the nodes.
+ * @param [in] reverse - whether the tree is the reverse tree.
+ * @return Value @p true if the nodes are valid.
+ *         Value @p false otherwise.
+ */
+static bool checkNodes(FlatIndex const *index, struct FlatHeader const *header, struct FlatNode const *nodes,
+                       uint64_t count, bool reverse) {
+    uint64_t nextChild = 1;
+    for (uint64_t i = 0; i < count; i++) {
+        struct FlatNode const *node = &nodes[i];
+        if (node->labelLength > LABEL_CAPACITY || (node->mask >> NUMBER_OF_DIGITS) != 0) {
+            return false;
+        }
+        for (size_t j = 0; j < node->labelLength; j++) {
+            if (((node->label >> (4 * j)) & 0xFu) >= NUMBER_OF_DIGITS) {
+                return false;
+            }
+        }
+        if (node->mask != 0 && (node->children != nextChild || nextChild + countBits(node->mask) > count)) {
+            return false;
+        }
+        nextChild += (uint64_t) countBits(node->mask);
+        if (node->value == FLAT_NO_VALUE) {
+            continue;
+        }
+
+        if (!reverse) {
+            if (node->value >= header->blobSize ||
+                packedCheck(index->blob + node->value, header->blobSize - node->value) == 0) {
+                return false;
+            }
+            continue;
+        }
+
+        if (node->value >= header->listsLength ||
+            index->lists[node->value] > header->listsLength - node->value - 1) {
+            return false;
+        }
+        for (uint32_t j = 1; j <= index->lists[node->value]; j++) {
+            uint32_t offset = index->lists[node->value + j];
+            if (offset >= header->blobSize || packedCheck(index->blob + offset, header->blobSize - offset) == 0) {
+                return false;
+            }
+            if (j > 1 && comparePackedParts(index->blob + index->lists[node->value + j - 1], NULL,
+                                            index->blob + offset, NULL) >= 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Checks the range of the part of the image.
+ * @param [in] offset - offset of the part.
+ * @param [in] count - number of the elements of the part.
+ * @param [in] elementSize - size of an element.
+ * @param [in] alignment - required alignment of the offset.
+ * @param [in] size - size of the image.
+ * @return Value @p true if the part fits in the image and is aligned.
+ *         Value @p false otherwise.
+ */
+static bool checkRange(uint64_t offset, uint64_t count, size_t elementSize, size_t alignment, size_t size) {
+    return offset >= sizeof(struct FlatHeader) && offset % alignment == 0 && offset <= size &&
+           count <= (size - offset) / elementSize;
+}
+
+/**
+ * @brief Sets the pointers of the index to the parts of the image.
+ * Checks the header and the nodes of the image first.
+ * @param [in, out] index - pointer to the index.
+ * @param [in] data - pointer to the image, aligned to @ref FLAT_ALIGNMENT.
+ * @param [in] size - size of the image.
+ * @return Value @p true if the image is valid.
+ *         Value @p false otherwise.
+ */
+static bool attachImage(FlatIndex *index, void *data, size_t size) {
+    struct FlatHeader header;
+    if (size < sizeof(struct FlatHeader)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(struct FlatHeader));
+
+    if (memcmp(header.magic, FLAT_MAGIC, FLAT_MAGIC_SIZE) != 0 || header.version != FLAT_VERSION ||
+        header.forwardCount == 0 || header.reverseCount == 0 || header.blobSize == 0 ||
+        !checkRange(header.forwardOffset, header.forwardCount, sizeof(struct FlatNode), FLAT_ALIGNMENT, size) ||
+        !checkRange(header.reverseOffset, header.reverseCount, sizeof(struct FlatNode), FLAT_ALIGNMENT, size) ||
+        !checkRange(header.listsOffset, header.listsLength, sizeof(uint32_t), sizeof(uint32_t), size) ||
+        !checkRange(header.blobOffset, header.blobSize, sizeof(PackedNumber), sizeof(PackedNumber), size)) {
+        return false;
+    }
+
+    char const *bytes = data;
+    index->data = data;
+    index->size = size;
+    index->forward = (struct FlatNode const *) (bytes + header.forwardOffset);
+    index->reverse = (struct FlatNode const *) (bytes + header.reverseOffset);
+    index->lists = (uint32_t const *) (bytes + header.listsOffset);
+    index->blob = (PackedNumber const *) (bytes + header.blobOffset);
+
+    return checkNodes(index, &header, index->forward, header.forwardCount, false) &&
+           checkNodes(index, &header, index->reverse, header.reverseCount, true);
+}
+
+FlatIndex *flatIndexBuild(DNode *root, DNode *reverseRoot) {
+    struct FlatBuilder builder = {0};
+    struct FlatNode *forward = NULL;
+    size_t forwardCount = 0;
+    uint32_t empty;
+    FlatIndex *index = NULL;
+    void *data = NULL;
+
+    bool result = addNumber(&builder, "", &empty) && flattenTree(&builder, root, false);
+    if (result) {
+        forward = builder.nodes;
+        forwardCount = builder.nodeCount;
+        builder.nodes = NULL;
+        builder.nodeCount = 0;
+        builder.nodeCapacity = 0;
+        free(builder.trees);
+        builder.trees = NULL;
+        result = flattenTree(&builder, reverseRoot, true);
+    }
+
+    size_t forwardOffset = alignOffset(sizeof(struct FlatHeader));
+    size_t reverseOffset = forwardOffset + forwardCount * sizeof(struct FlatNode);
+    size_t listsOffset = reverseOffset + builder.nodeCount * sizeof(struct FlatNode);
+    size_t blobOffset = alignOffset(listsOffset + builder.listsLength * sizeof(uint32_t));
+    size_t size = blobOffset + builder.blobSize;
+
+    if (result) {
+        index = malloc(sizeof(FlatIndex));
+        data = malloc(size);
+        result = index != NULL && data != NULL;
+    }
+
+    if (result) {
+        struct FlatHeader header;
+        memset(&header, 0, sizeof(struct FlatHeader));
+        memcpy(header.magic, FLAT_MAGIC, FLAT_MAGIC_SIZE);
+        header.version = FLAT_VERSION;
+        header.forwardCount = (uint32_t) forwardCount;
+        header.reverseCount = (uint32_t) builder.nodeCount;
+        header.listsLength = (uint32_t) builder.listsLength;
+        header.blobSize = builder.blobSize;
+        header.forwardOffset = forwardOffset;
+        header.reverseOffset = reverseOffset;
+        header.listsOffset = listsOffset;
+        header.blobOffset = blobOffset;
+
+        char *bytes = data;
+        memset(bytes, 0, blobOffset);
+        memcpy(bytes, &header, sizeof(struct FlatHeader));
+        memcpy(bytes + forwardOffset, forward, forwardCount * sizeof(struct FlatNode));
+        memcpy(bytes + reverseOffset, builder.nodes, builder.nodeCount * sizeof(struct FlatNode));
+        if (builder.listsLength > 0) {
+            memcpy(bytes + listsOffset, builder.lists, builder.listsLength * sizeof(uint32_t));
+        }
+        memcpy(bytes + blobOffset, builder.blob, builder.blobSize);
+
+        index->mapped = false;
+        result = attachImage(index, data, size);
+    }
+
+    free(forward);
+    free(builder.nodes);
+    free(builder.trees);
+    free(builder.lists);
+    free(builder.blob);
+    if (!result) {
+        free(data);
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+FlatIndex *flatIndexMap(char const *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t) fileStat.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    FlatIndex *index = malloc(sizeof(FlatIndex));
+    if (index == NULL || !attachImage(index, data, size)) {
+        munmap(data, size);
+        free(index);
+        return NULL;
+    }
+
+    index->mapped = true;
+    return index;
+}
+
+bool flatIndexSave(FlatIndex const *index, char const *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    bool result = fwrite(index->data, 1, index->size, file) == index->size;
+    if (fclose(file) != 0) {
+        result = false;
+    }
+    return result;
+}
+
+void flatIndexDelete(FlatIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+
+    if (index->mapped) {
+        munmap(index->data, index->size);
+    } else {
+        free(index->data);
+    }
+    free(index);
+}
+
+/**
+ * @brief Adds the nodes of the tree stored in the index to the statistics.
+ * The nodes are stored in breadth-first order, so the nodes of each depth follow each other and the number of the
+ * nodes of the next depth is the number of their children.
+ * @param [in] nodes - array of the nodes.
+ * @param [in] count - number of the nodes.
+ * @param [in, out] tree - pointer to the shape of the tree.
+ */
+static void flatTreeStats(struct FlatNode const *nodes, size_t count, PhoneForwardTreeStats *tree) {
+    size_t begin = 0;
+    size_t end = 1;
+    size_t depth = 0;
+
+    while (begin < end) {
+        size_t children = 0;
+        for (size_t i = begin; i < end; i++) {
+            int fanOut = countBits(nodes[i].mask);
+            tree->fanOuts[fanOut]++;
+            children += (size_t) fanOut;
+        }
+        tree->depths[depth < PHFWD_STATS_DEPTHS ? depth : PHFWD_STATS_DEPTHS - 1] += end - begin;
+
+        begin = end;
+        end = end + children < count ? end + children : count;
+        depth++;
+    }
+    tree->nodes += count;
+}
+
+void flatIndexStats(FlatIndex const *index, PhoneForwardStats *stats) {
+    struct FlatHeader header;
+    memcpy(&header, index->data, sizeof(struct FlatHeader));
+
+    flatTreeStats(index->forward, header.forwardCount, &stats->forward);
+    flatTreeStats(index->reverse, header.reverseCount, &stats->reverse);
+    stats->nodeBytes += ((size_t) header.forwardCount + header.reverseCount) * sizeof(struct FlatNode);
+    stats->numbersBytes += (size_t) header.listsLength * sizeof(uint32_t);
+    stats->stringBytes += (size_t) header.blobSize;
+
+    for (uint32_t i = 0; i < header.reverseCount; i++) {
+        uint32_t value = index->reverse[i].value;
+        if (value != FLAT_NO_VALUE && index->lists[value] > stats->largestReverseBucket) {
+            stats->largestReverseBucket = index->lists[value];
+        }
+    }
+}
+
+/**
+ * @struct VisitEntry
+ * @brief Node of the forward tree waiting to be visited by @ref flatVisitForwardings.
+ * @var VisitEntry::node
+ *      Index of the node.
+ * @var VisitEntry::depth
+ *      Number of the digits of the route to the parent of the node.
+ * @var VisitEntry::digit
+ *      The digit of the edge from the parent to the node.
+ */
+struct VisitEntry {
+    uint32_t node;
+    size_t depth;
+    int digit;
+};
+
+/**
+ * @brief Makes sure the buffer has memory for the given number of characters.
+ * @param [in, out] buffer - pointer to the buffer.
+ * @param [in, out] capacity - pointer to the number of the characters the buffer has memory for.
+ * @param [in] needed - the needed number of the characters.
+ * @return Value @p true if the buffer is big enough.
+ *         Value @p false if there was an allocation error.
+ */
+static bool reserveChars(char **buffer, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    size_t newCapacity;
+    char *bigger = growArray(*buffer, *capacity, needed, sizeof(char), &newCapacity);
+    if (bigger == NULL) {
+        return false;
+    }
+    *buffer = bigger;
+    *capacity = newCapacity;
+    return true;
+}
+
+/**
+ * @brief Pushes the children of the node of the forward tree on the stack, the first digit on the top.
+ * @param [in] node - pointer to the node.
+ * @param [in] depth - number of the digits of the route to the node.
+ * @param [in, out] stack - pointer to the stack.
+ * @param [in, out] size - pointer to the number of the entries of the stack.
+ * @param [in, out] capacity - pointer to the number of the entries the stack has memory for.
+ * @return Value @p true if the children were pushed.
+ *         Value @p false if there was an allocation error.
+ */
+static bool pushChildren(struct FlatNode const *node, size_t depth, struct VisitEntry **stack, size_t *size,
+                         size_t *capacity) {
+    int children = countBits(node->mask);
+    if (*size + (size_t) children > *capacity) {
+        size_t newCapacity;
+        struct VisitEntry *bigger = growArray(*stack, *capacity, *size + (size_t) children,
+                                              sizeof(struct VisitEntry), &newCapacity);
+        if (bigger == NULL) {
+            return false;
+        }
+        *stack = bigger;
+        *capacity = newCapacity;
+    }
+
+    uint32_t child = node->children + (uint32_t) children;
+    for (int digit = NUMBER_OF_DIGITS - 1; digit >= 0; digit--) {
+        if ((node->mask >> digit) & 1u) {
+            (*stack)[(*size)++] = (struct VisitEntry) {--child, depth, digit};
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Visits the phone forwarding stored in the node of the forward tree, if there is one.
+ * @param [in] index - pointer to the index.
+ * @param [in] node - pointer to the node.
+ * @param [in] num1 - the number represented by the node.
+ * @param [in, out] num2 - pointer to the buffer the number @p num1 is forwarded to is unpacked to.
+ * @param [in, out] capacity2 - pointer to the number of the characters @p num2 has memory for.
+ * @param [in] visit - the function called for the forwarding.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if the node has no forwarding or the visiting should continue.
+ *         Value @p false if there was an allocation error or @p visit stopped the visiting.
+ */
+static bool visitForwarding(FlatIndex const *index, struct FlatNode const *node, char const *num1, char **num2,
+                            size_t *capacity2, ForwardingVisitor visit, void *context) {
+    if (node->value == FLAT_NO_VALUE) {
+        return true;
+    }
+
+    PackedNumber const *target = index->blob + node->value;
+    if (!reserveChars(num2, capacity2, packedLength(target) + 1)) {
+        return false;
+    }
+    unpackNumber(target, *num2);
+    return visit(num1, *num2, context);
+}
+
+bool flatVisitForwardings(FlatIndex const *index, char const *prefix, ForwardingVisitor visit, void *context) {
+    struct FlatNode const *node = &index->forward[0];
+    size_t depth = 0;
+    size_t matched = 0;
+    while (isValidDigit(prefix[depth])) {
+        uint16_t bit = (uint16_t) (1u << toDecimalRepresentation(prefix[depth]));
+        if ((node->mask & bit) == 0) {
+            return true;
+        }
+        node = &index->forward[node->children + countBits(node->mask & (bit - 1))];
+        matched = 0;
+        while (matched < node->labelLength &&
+               toDecimalRepresentation(prefix[depth + 1 + matched]) == (int) ((node->label >> (4 * matched)) & 0xFu)) {
+            matched++;
+        }
+        if (matched < node->labelLength && isValidDigit(prefix[depth + 1 + matched])) {
+            return true;
+        }
+        depth += 1 + matched;
+    }
+
+    char *num1 = NULL;
+    char *num2 = NULL;
+    size_t capacity1 = 0;
+    size_t capacity2 = 0;
+    size_t length = depth + (node == &index->forward[0] ? 0 : node->labelLength - matched);
+    if (!reserveChars(&num1, &capacity1, length + 1)) {
+        return false;
+    }
+    memcpy(num1, prefix, depth);
+    for (size_t i = depth; i < length; i++) {
+        num1[i] = DIGIT_CHARS[(node->label >> (4 * (matched + i - depth))) & 0xFu];
+    }
+    num1[length] = '\0';
+
+    struct VisitEntry *stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    bool result = visitForwarding(index, node, num1, &num2, &capacity2, visit, context) &&
+                  pushChildren(node, length, &stack, &size, &capacity);
+    while (result && size > 0) {
+        struct VisitEntry entry = stack[--size];
+        node = &index->forward[entry.node];
+        length = entry.depth + 1 + node->labelLength;
+        if (!reserveChars(&num1, &capacity1, length + 1)) {
+            result = false;
+            break;
+        }
+        num1[entry.depth] = DIGIT_CHARS[entry.digit];
+        for (size_t i = 0; i < node->labelLength; i++) {
+            num1[entry.depth + 1 + i] = DIGIT_CHARS[(node->label >> (4 * i)) & 0xFu];
+        }
+        num1[length] = '\0';
+
+        result = visitForwarding(index, node, num1, &num2, &capacity2, visit, context) &&
+                 pushChildren(node, length, &stack, &size, &capacity);
+    }
+
+    free(stack);
+    free(num1);
+    free(num2);
+    return result;
+}
+
+/**
+ * @brief Follows the edge represented by the beginning of the number.
+ * @param [in] nodes - array of the nodes of the tree.
+ * @param [in] node - pointer to the node the edge starts in.
+ * @param [in] num - the number.
+ * @param [in, out] index - index of the first digit of the edge in the number, it will be moved after the edge.
+ * @return Pointer to the node the edge leads to or NULL if there is no such edge or the number doesn't contain its
+ *         whole label.
+ */
+static struct FlatNode const *flatFollowEdge(struct FlatNode const *nodes, struct FlatNode const *node,
+                                             char const *num, size_t *index) {
+    uint16_t bit = (uint16_t) (1u << toDecimalRepresentation(num[*index]));
+    if ((node->mask & bit) == 0) {
+        return NULL;
+    }
+
+    struct FlatNode const *next = &nodes[node->children + countBits(node->mask & (bit - 1))];
+    size_t i = *index + 1;
+    for (size_t matched = 0; matched < next->labelLength; matched++, i++) {
+        if (toDecimalRepresentation(num[i]) != (int) ((next->label >> (4 * matched)) & 0xFu)) {
+            return NULL;
+        }
+    }
+
+    *index = i;
+    return next;
+}
+
+size_t flatFindPrefix(FlatIndex const *index, char const *num, PackedNumber const **maxForwardedPrefix,
+                      size_t *lenOfMaxOriginalPrefix) {
+    struct FlatNode const *node = index->forward;
+    size_t i = 0;
+
+    while (isValidDigit(num[i])) {
+        node = flatFollowEdge(index->forward, node, num, &i);
+        if (node == NULL) {
+            break;
+        }
+
+        if (node->value != FLAT_NO_VALUE) {
+            (*maxForwardedPrefix) = index->blob + node->value;
+            (*lenOfMaxOriginalPrefix) = i;
+        }
+    }
+    return i;
+}
+
+size_t flatFindPrefixBatch(FlatIndex const *index, char const *const *nums, size_t count,
+                           PackedNumber const **maxForwardedPrefix, size_t *lenOfMaxOriginalPrefix) {
+    size_t walked = 0;
+    for (size_t first = 0; first < count; first += BATCH_LANES) {
+        size_t lanes = count - first < BATCH_LANES ? count - first : BATCH_LANES;
+        struct FlatNode const *nodes[BATCH_LANES];
+        size_t positions[BATCH_LANES];
+        size_t active = 0;
+
+        for (size_t lane = 0; lane < lanes; lane++) {
+            maxForwardedPrefix[first + lane] = NULL;
+            lenOfMaxOriginalPrefix[first + lane] = 0;
+            positions[lane] = 0;
+            nodes[lane] = nums[first + lane] == NULL ? NULL : index->forward;
+            if (nodes[lane] != NULL) {
+                active++;
+            }
+        }
+
+        while (active > 0) {
+            for (size_t lane = 0; lane < lanes; lane++) {
+                if (nodes[lane] == NULL) {
+                    continue;
+                }
+
+                char const *num = nums[first + lane];
+                struct FlatNode const *next = NULL;
+                if (isValidDigit(num[positions[lane]])) {
+                    next = flatFollowEdge(index->forward, nodes[lane], num, &positions[lane]);
+                }
+
+                if (next == NULL) {
+                    active--;
+                } else {
+                    if (next->value != FLAT_NO_VALUE) {
+                        maxForwardedPrefix[first + lane] = index->blob + next->value;
+                        lenOfMaxOriginalPrefix[first + lane] = positions[lane];
+                    }
+                    if (next->mask != 0) {
+                        PREFETCH(&index->forward[next->children]);
+                    }
+                }
+                nodes[lane] = next;
+            }
+        }
+
+        for (size_t lane = 0; lane < lanes; lane++) {
+            walked += positions[lane];
+        }
+    }
+    return walked;
+}
+
+/**
+ * @brief Checks if the number built from the source and the suffix is forwarded to the given number.
+ * Works like the check done by @ref addAllInverseFromReverseTree for the forward tree stored in the index.
+ * @param [in] index - pointer to the index.
+ * @param [in] source - the first part of the number.
+ * @param [in] suffix - the second part of the number.
+ * @param [in] num - the number to compare the result of the forwarding with.
+ * @return Value @p true if the number is forwarded to @p num.
+ *         Value @p false otherwise.
+ */
+static bool flatIsForwardedTo(FlatIndex const *index, char const *source, char const *suffix, char const *num) {
+    PackedNumber const *maxForwardedPrefix = NULL;
+    size_t lenOfMaxOriginalPrefix = 0;
+    struct FlatNode const *node = index->forward;
+    size_t i = 0;
+
+    while (node != NULL && isValidDigit(source[i])) {
+        node = flatFollowEdge(index->forward, node, source, &i);
+        if (node != NULL && node->value != FLAT_NO_VALUE) {
+            maxForwardedPrefix = index->blob + node->value;
+            lenOfMaxOriginalPrefix = i;
+        }
+    }
+
+    size_t sourceLength = i;
+    size_t j = 0;
+    while (node != NULL && isValidDigit(suffix[j])) {
+        node = flatFollowEdge(index->forward, node, suffix, &j);
+        if (node != NULL && node->value != FLAT_NO_VALUE) {
+            maxForwardedPrefix = index->blob + node->value;
+            lenOfMaxOriginalPrefix = sourceLength + j;
+        }
+    }
+
+    return arePackedPartsEqual(source, suffix, maxForwardedPrefix, lenOfMaxOriginalPrefix, num);
+}
+
+/**
+ * @brief Adds the number built from the source and the rest of the searched number.
+ * @param [in] index - pointer to the index.
+ * @param [in] packed - pointer to the packed number forwarded to the prefix of the searched number.
+ * @param [in] num - the searched number.
+ * @param [in] prefixLength - length of the prefix of @p num the source is forwarded to.
+ * @param [in] inverse - whether the number is added only if it is really forwarded to @p num.
+ * @param [in, out] pnum - the vector to add the number to.
+ * @return Value @p true if the number was added successfully or skipped.
+ *         Value @p false if there was an allocation error.
+ */
+static bool addSource(FlatIndex const *index, PackedNumber const *packed, char const *num, size_t prefixLength,
+                      bool inverse, PhoneNumbers *pnum) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    size_t len = packedLength(packed);
+    char *source = len < NUMBER_BUFFER_SIZE ? buffer : malloc(len + 1);
+    if (source == NULL) {
+        return false;
+    }
+    unpackNumber(packed, source);
+
+    bool result = true;
+    if (!inverse || flatIsForwardedTo(index, source, num + prefixLength, num)) {
+        char *number = NULL;
+        result = copyParts(num, source, prefixLength, &number);
+        if (result && !phnumAdd(pnum, &number)) {
+            free(number);
+            result = false;
+        }
+    }
+
+    if (source != buffer) {
+        free(source);
+    }
+    return result;
+}
+
+bool flatNextReverse(FlatIndex const *index, uint32_t *node, char const *num, size_t *prefixLength, uint32_t *list) {
+    struct FlatNode const *current = index->reverse + *node;
+    size_t i = *prefixLength;
+    while (isValidDigit(num[i])) {
+        current = flatFollowEdge(index->reverse, current, num, &i);
+        if (current == NULL) {
+            return false;
+        }
+        if (current->value != FLAT_NO_VALUE) {
+            *node = (uint32_t) (current - index->reverse);
+            *prefixLength = i;
+            *list = current->value;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t flatListSize(FlatIndex const *index, uint32_t list) {
+    return index->lists[list];
+}
+
+PackedNumber const *flatListNumber(FlatIndex const *index, uint32_t list, uint32_t position) {
+    return index->blob + index->lists[list + 1 + position];
+}
+
+bool flatAddAllReverse(FlatIndex const *index, char const *num, bool inverse, PhoneNumbers *pnum) {
+    struct FlatNode const *node = index->reverse;
+    size_t i = 0;
+
+    while (isValidDigit(num[i])) {
+        node = flatFollowEdge(index->reverse, node, num, &i);
+        if (node == NULL) {
+            break;
+        }
+        if (node->value == FLAT_NO_VALUE) {
+            continue;
+        }
+
+        uint32_t const *list = index->lists + node->value;
+        for (uint32_t j = 1; j <= list[0]; j++) {
+            if (!addSource(index, index->blob + list[j], num, i, inverse, pnum)) {
+                return false;
+            }
+        }
+    }
+
+    if (!inverse || flatIsForwardedTo(index, "", num, num)) {
+        char *numCopy = NULL;
+        if (!copyNumber(num, &numCopy)) {
+            return false;
+        }
+        if (!phnumAdd(pnum, &numCopy)) {
+            free(numCopy);
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,156 @@
+/** @file
+ * Interface of the class storing the flat index of phone forwarding.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __FLAT_INDEX_H__
+#define __FLAT_INDEX_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "phone_numbers.h"
+#include "node_utils.h"
+
+/**
+ * This is a structure storing a read-only image of the forward and reverse trees in a single block of memory.
+ * The image doesn't contain any pointers, so it can be written to a file and used directly from the mapped pages.
+ */
+struct FlatIndex;
+typedef struct FlatIndex FlatIndex; /**< Flat index of phone forwarding. */
+
+/**
+ * @brief Builds the flat index from the trees.
+ * The nodes of each tree are stored in an array in breadth-first order, so that the children of every node are
+ * stored next to each other, and all the numbers are packed in a single block of bytes.
+ * @param [in] root - pointer to the root of the forward tree.
+ * @param [in] reverseRoot - pointer to the root of the reverse tree.
+ * @return Pointer to the new index or NULL if there was an allocation error or the trees don't fit in the format.
+ */
+FlatIndex *flatIndexBuild(DNode *root, DNode *reverseRoot);
+
+/**
+ * @brief Maps the flat index saved in the file.
+ * The file is mapped read-only and shared, so the pages are shared by all processes using it. The structure of the
+ * image is checked, but its contents aren't copied.
+ * @param [in] path - path of the file.
+ * @return Pointer to the index or NULL if the file couldn't be mapped or doesn't contain a valid image.
+ */
+FlatIndex *flatIndexMap(char const *path);
+
+/**
+ * @brief Saves the image of the flat index to the file.
+ * @param [in] index - pointer to the index.
+ * @param [in] path - path of the file.
+ * @return Value @p true if the image was saved successfully.
+ *         Value @p false if there was an error while writing the file.
+ */
+bool flatIndexSave(FlatIndex const *index, char const *path);
+
+/**
+ * @brief Deletes the flat index.
+ * Does nothing if the pointer is NULL.
+ * @param [in] index - pointer to the index.
+ */
+void flatIndexDelete(FlatIndex *index);
+
+/**
+ * @brief Describes the trees stored in the index.
+ * Works like @ref nodeTreeStats for both trees, the nodes, the lists of numbers and the numbers are counted with the
+ * sizes they have in the image.
+ * @param [in] index - pointer to the index.
+ * @param [in, out] stats - pointer to the statistics.
+ */
+void flatIndexStats(FlatIndex const *index, PhoneForwardStats *stats);
+
+/**
+ * @brief Visits the phone forwardings of the numbers starting with the prefix stored in the index.
+ * Works like @ref nodeVisitForwardings for the forward tree of the index.
+ * @param [in] index - pointer to the index.
+ * @param [in] prefix - the prefix of the visited forwarded numbers, it has to be valid or empty.
+ * @param [in] visit - the function called for every forwarding.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if all the forwardings were visited.
+ *         Value @p false if there was an allocation error or @p visit stopped the visiting.
+ */
+bool flatVisitForwardings(FlatIndex const *index, char const *prefix, ForwardingVisitor visit, void *context);
+
+/**
+ * @brief Finds the longest prefix of the number that is forwarded to another number.
+ * Works like @ref findPrefix for the forward tree stored in the index.
+ * @param [in] index - pointer to the index.
+ * @param [in] num - the number.
+ * @param [in, out] maxForwardedPrefix - pointer to the packed number the longest prefix is forwarded to, it is left
+ *                                       unchanged if no prefix is forwarded.
+ * @param [in, out] lenOfMaxOriginalPrefix - pointer to the length of the longest forwarded prefix.
+ * @return Number of the digits of @p num followed down the tree.
+ */
+size_t flatFindPrefix(FlatIndex const *index, char const *num, PackedNumber const **maxForwardedPrefix,
+                      size_t *lenOfMaxOriginalPrefix);
+
+/**
+ * @brief Finds the longest forwarded prefixes of many numbers at once.
+ * Works like @ref findPrefixBatch for the forward tree stored in the index: the routes of several numbers are
+ * followed in lock-step and the children of the next node of each route are prefetched, so that the cache misses of
+ * different numbers overlap.
+ * @param [in] index - pointer to the index.
+ * @param [in] nums - array of the numbers, a NULL number is skipped.
+ * @param [in] count - number of the numbers.
+ * @param [out] maxForwardedPrefix - array of the packed numbers the longest prefixes are forwarded to, NULL if no
+ *                                   prefix of the number is forwarded.
+ * @param [out] lenOfMaxOriginalPrefix - array of the lengths of the longest forwarded prefixes.
+ * @return Number of the digits of all the numbers followed down the tree.
+ */
+size_t flatFindPrefixBatch(FlatIndex const *index, char const *const *nums, size_t count,
+                           PackedNumber const **maxForwardedPrefix, size_t *lenOfMaxOriginalPrefix);
+
+/**
+ * @brief Adds all numbers after the operation of reversing.
+ * Works like @ref addAllFromReverseTree or, if @p inverse is @p true, like @ref addAllInverseFromReverseTree for the
+ * trees stored in the index.
+ * @param [in] index - pointer to the index.
+ * @param [in] num - the number we are finding reverse forwards of.
+ * @param [in] inverse - whether only the numbers that are really forwarded to @p num should be added.
+ * @param [in, out] pnum - the vector to add the numbers to.
+ * @return Value @p true if the numbers were added successfully.
+ *         Value @p false if there was an allocation error.
+ */
+bool flatAddAllReverse(FlatIndex const *index, char const *num, bool inverse, PhoneNumbers *pnum);
+
+/**
+ * @brief Finds the next node of the reverse tree storing the numbers forwarded to a prefix of the number.
+ * Works like @ref nodeNextReverse for the reverse tree stored in the index.
+ * @param [in] index - pointer to the index.
+ * @param [in, out] node - pointer to the index of the node to start from, 0 for the root, it will be set to the
+ *                         index of the found node.
+ * @param [in] num - the number to follow the route of.
+ * @param [in, out] prefixLength - pointer to the number of the digits of @p num on the route to @p node, it will be
+ *                                 set to the number of the digits on the route to the found node.
+ * @param [in, out] list - pointer to the list of numbers of the found node.
+ * @return Value @p true if the node was found.
+ *         Value @p false if there is no such node further on the route.
+ */
+bool flatNextReverse(FlatIndex const *index, uint32_t *node, char const *num, size_t *prefixLength, uint32_t *list);
+
+/**
+ * @brief Obtains the number of the numbers of the list.
+ * @param [in] index - pointer to the index.
+ * @param [in] list - the list found by @ref flatNextReverse.
+ * @return Number of the numbers of the list.
+ */
+uint32_t flatListSize(FlatIndex const *index, uint32_t list);
+
+/**
+ * @brief Obtains the number of the list.
+ * The numbers of every list are sorted like in @ref comparePackedParts.
+ * @param [in] index - pointer to the index.
+ * @param [in] list - the list found by @ref flatNextReverse.
+ * @param [in] position - index of the number in the list, smaller than @ref flatListSize.
+ * @return Pointer to the packed number.
+ */
+PackedNumber const *flatListNumber(FlatIndex const *index, uint32_t list, uint32_t position);
+
+#endif /* __FLAT_INDEX_H__ */
@@ -0,0 +1,504 @@
+/** @file
+ * Implementations of functions appending the changes of phone forwarding to a log file.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _POSIX_C_SOURCE 200809L /**< Makes the POSIX functions for files available. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "packed_number.h"
+#include "string_utils.h"
+#include "forward_log.h"
+
+#define LOG_MAGIC "PHFWDLOG" /**< Characters the log file starts with. */
+#define LOG_MAGIC_SIZE 8 /**< Number of the characters the log file starts with. */
+#define LOG_VERSION 1 /**< Version of the format of the log file. */
+#define LOG_BUFFER_SIZE (1 << 16) /**< Number of the buffered bytes of the records that makes them written. */
+#define CHECKSUM_SIZE 4 /**< Number of the bytes of the checksum ending each record. */
+#define FNV_OFFSET_BASIS UINT32_C(2166136261) /**< Initial value of the FNV-1a checksum. */
+#define FNV_PRIME UINT32_C(16777619) /**< Multiplier of the FNV-1a checksum. */
+#define FILE_MODE 0644 /**< Permissions of the created files. */
+
+/**
+ * @struct LogHeader
+ * @brief Header at the beginning of the log file.
+ * It is followed by the records, each of them is the type of the record in one byte, the packed numbers of the
+ * record and the checksum of all these bytes in the native byte order.
+ * @var LogHeader::magic
+ *      The characters @ref LOG_MAGIC.
+ * @var LogHeader::version
+ *      Version of the format, @ref LOG_VERSION.
+ * @var LogHeader::padding
+ *      Unused bytes, set to 0.
+ */
+struct LogHeader {
+    char magic[LOG_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t padding;
+};
+
+/**
+ * @struct ForwardLog forward_log.h
+ * @brief Open log file and the buffer of its records.
+ * @var ForwardLog::fd
+ *      Descriptor of the file.
+ * @var ForwardLog::path
+ *      Copy of the path of the file.
+ * @var ForwardLog::buffer
+ *      The committed records that weren't written yet, followed by the prepared one.
+ * @var ForwardLog::size
+ *      Number of the bytes of the committed records in @p buffer.
+ * @var ForwardLog::capacity
+ *      Number of the bytes @p buffer has memory for.
+ * @var ForwardLog::prepared
+ *      Number of the bytes of the prepared record, 0 if there is none.
+ * @var ForwardLog::written
+ *      Number of the bytes of the file.
+ * @var ForwardLog::unsynced
+ *      Number of the committed records that may not be on the disk yet.
+ * @var ForwardLog::syncEvery
+ *      Number of the committed records flushed to the disk together, 0 if only @ref forwardLogSync flushes them.
+ * @var ForwardLog::failed
+ *      Whether writing the file failed.
+ */
+struct ForwardLog {
+    int fd;
+    char *path;
+    unsigned char *buffer;
+    size_t size;
+    size_t capacity;
+    size_t prepared;
+    uint64_t written;
+    size_t unsynced;
+    size_t syncEvery;
+    bool failed;
+};
+
+/**
+ * @brief Computes the FNV-1a checksum of the bytes.
+ * @param [in] bytes - pointer to the bytes.
+ * @param [in] count - number of the bytes.
+ * @return The checksum.
+ */
+static uint32_t checksum(unsigned char const *bytes, size_t count) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Writes all the bytes to the file.
+ * @param [in] fd - descriptor of the file.
+ * @param [in] bytes - pointer to the bytes.
+ * @param [in] count - number of the bytes.
+ * @return Value @p true if the bytes were written.
+ *         Value @p false if there was an error while writing.
+ */
+static bool writeAll(int fd, void const *bytes, size_t count) {
+    unsigned char const *next = bytes;
+    while (count > 0) {
+        ssize_t written = write(fd, next, count);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written <= 0) {
+            return false;
+        }
+        next += written;
+        count -= (size_t) written;
+    }
+    return true;
+}
+
+/**
+ * @brief Flushes the directory containing the file, so that a file created or renamed in it stays there.
+ * @param [in] path - path of the file.
+ * @return Value @p true if the directory was flushed.
+ *         Value @p false if there was an allocation error or the directory couldn't be flushed.
+ */
+static bool syncDirectory(char const *path) {
+    char const *slash = strrchr(path, '/');
+    size_t len = slash == NULL ? 1 : (slash == path ? 1 : (size_t) (slash - path));
+    char *directory = malloc(len + 1);
+    if (directory == NULL) {
+        return false;
+    }
+    memcpy(directory, slash == NULL ? "." : path, len);
+    directory[len] = '\0';
+
+    int fd = open(directory, O_RDONLY);
+    free(directory);
+    if (fd < 0) {
+        return false;
+    }
+    bool result = fsync(fd) == 0;
+    close(fd);
+    return result;
+}
+
+/**
+ * @brief Writes the header of a new log file.
+ * @param [in] fd - descriptor of the empty file.
+ * @return Value @p true if the header was written.
+ *         Value @p false otherwise.
+ */
+static bool writeHeader(int fd) {
+    struct LogHeader header;
+    memset(&header, 0, sizeof(struct LogHeader));
+    memcpy(header.magic, LOG_MAGIC, LOG_MAGIC_SIZE);
+    header.version = LOG_VERSION;
+    return writeAll(fd, &header, sizeof(struct LogHeader));
+}
+
+/**
+ * @brief Checks the header of the log file.
+ * @param [in] data - pointer to the contents of the file.
+ * @param [in] size - number of the bytes of the contents.
+ * @return Value @p true if the file starts with a valid header.
+ *         Value @p false otherwise.
+ */
+static bool checkHeader(unsigned char const *data, size_t size) {
+    struct LogHeader header;
+    if (size < sizeof(struct LogHeader)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(struct LogHeader));
+    return memcmp(header.magic, LOG_MAGIC, LOG_MAGIC_SIZE) == 0 && header.version == LOG_VERSION;
+}
+
+/**
+ * @brief Unpacks the number of a record to the buffer, enlarging it if necessary.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in, out] buffer - pointer to the buffer.
+ * @param [in, out] capacity - pointer to the number of the characters the buffer has memory for.
+ * @return Value @p true if the number was unpacked.
+ *         Value @p false if there was an allocation error.
+ */
+static bool unpackRecordNumber(unsigned char const *packed, char **buffer, size_t *capacity) {
+    size_t len = packedLength(packed);
+    if (len + 1 > *capacity) {
+        char *bigger = realloc(*buffer, len + 1);
+        if (bigger == NULL) {
+            return false;
+        }
+        *buffer = bigger;
+        *capacity = len + 1;
+    }
+    unpackNumber(packed, *buffer);
+    return true;
+}
+
+/**
+ * @brief Reads the record at the beginning of the bytes.
+ * @param [in] bytes - pointer to the bytes.
+ * @param [in] available - number of the bytes that can be read.
+ * @param [out] type - pointer to the type of the record.
+ * @param [out] second - pointer to the offset of the second number of the record or 0 if it has only one number.
+ * @return Number of the bytes of the record or 0 if the bytes don't start with a complete valid record.
+ */
+static size_t readRecord(unsigned char const *bytes, size_t available, int *type, size_t *second) {
+    if (available < 1 + CHECKSUM_SIZE || (bytes[0] != FORWARD_LOG_ADD && bytes[0] != FORWARD_LOG_REMOVE &&
+                                            bytes[0] != FORWARD_LOG_CLEAR)) {
+        return 0;
+    }
+    *type = bytes[0];
+    *second = 0;
+
+    size_t size = 1;
+    for (int i = 0; i < (*type == FORWARD_LOG_ADD ? 2 : 1); i++) {
+        size_t bytesOfNumber = packedCheck(bytes + size, available - size);
+        if (bytesOfNumber == 0 || packedLength(bytes + size) == 0) {
+            return 0;
+        }
+        *second = i == 1 ? size : 0;
+        size += bytesOfNumber;
+    }
+
+    uint32_t stored;
+    if (available - size < CHECKSUM_SIZE) {
+        return 0;
+    }
+    memcpy(&stored, bytes + size, CHECKSUM_SIZE);
+    return stored == checksum(bytes, size) ? size + CHECKSUM_SIZE : 0;
+}
+
+/**
+ * @brief Replays the records of the file contents.
+ * @param [in] data - pointer to the records.
+ * @param [in] size - number of the bytes of the records.
+ * @param [in] visit - the function called for every record.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @param [out] valid - pointer to the number of the bytes of the complete records.
+ * @return Value @p true if the records were replayed.
+ *         Value @p false if there was an allocation error or @p visit failed.
+ */
+static bool replayRecords(unsigned char const *data, size_t size, LogRecordVisitor visit, void *context,
+                          size_t *valid) {
+    char *num1 = NULL;
+    char *num2 = NULL;
+    size_t capacity1 = 0;
+    size_t capacity2 = 0;
+    bool result = true;
+
+    size_t position = 0;
+    while (result) {
+        int type;
+        size_t second;
+        size_t recordSize = readRecord(data + position, size - position, &type, &second);
+        if (recordSize == 0) {
+            break;
+        }
+
+        result = unpackRecordNumber(data + position + 1, &num1, &capacity1) &&
+                 (second == 0 || unpackRecordNumber(data + position + second, &num2, &capacity2)) &&
+                 visit(type, num1, second == 0 ? NULL : num2, context);
+        position += recordSize;
+    }
+
+    free(num1);
+    free(num2);
+    *valid = position;
+    return result;
+}
+
+/**
+ * @brief Reads the log file, replays its records and cuts off the incomplete ones.
+ * @param [in, out] log - pointer to the log with the open file.
+ * @param [in] visit - the function called for every record.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if the file was replayed and is ready for appending.
+ *         Value @p false otherwise.
+ */
+static bool replayFile(ForwardLog *log, LogRecordVisitor visit, void *context) {
+    struct stat fileStat;
+    if (fstat(log->fd, &fileStat) != 0) {
+        return false;
+    }
+
+    size_t size = (size_t) fileStat.st_size;
+    if (size < sizeof(struct LogHeader)) {
+        log->written = sizeof(struct LogHeader);
+        return ftruncate(log->fd, 0) == 0 && writeHeader(log->fd) && fsync(log->fd) == 0 &&
+               syncDirectory(log->path);
+    }
+
+    unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, log->fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    size_t valid = 0;
+    bool result = checkHeader(data, size) &&
+                  replayRecords(data + sizeof(struct LogHeader), size - sizeof(struct LogHeader), visit, context,
+                                &valid);
+    munmap(data, size);
+
+    log->written = sizeof(struct LogHeader) + valid;
+    return result && (log->written == size || (ftruncate(log->fd, (off_t) log->written) == 0 &&
+                                                fsync(log->fd) == 0)) &&
+           lseek(log->fd, (off_t) log->written, SEEK_SET) >= 0;
+}
+
+ForwardLog *forwardLogOpen(char const *path, size_t syncEvery, LogRecordVisitor visit, void *context) {
+    ForwardLog *log = malloc(sizeof(ForwardLog));
+    if (log == NULL) {
+        return NULL;
+    }
+
+    log->path = malloc(strlen(path) + 1);
+    log->buffer = malloc(LOG_BUFFER_SIZE);
+    log->fd = open(path, O_RDWR | O_CREAT, FILE_MODE);
+    log->size = 0;
+    log->capacity = LOG_BUFFER_SIZE;
+    log->prepared = 0;
+    log->unsynced = 0;
+    log->syncEvery = syncEvery;
+    log->failed = false;
+    if (log->path != NULL) {
+        strcpy(log->path, path);
+    }
+    if (log->path == NULL || log->buffer == NULL || log->fd < 0 || !replayFile(log, visit, context)) {
+        if (log->fd >= 0) {
+            close(log->fd);
+        }
+        free(log->path);
+        free(log->buffer);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+/**
+ * @brief Writes the buffered records to the file.
+ * @param [in, out] log - pointer to the log.
+ * @return Value @p true if the records were written.
+ *         Value @p false if writing the file failed.
+ */
+static bool writeBuffer(ForwardLog *log) {
+    if (log->failed || !writeAll(log->fd, log->buffer, log->size)) {
+        log->failed = true;
+        return false;
+    }
+    log->written += log->size;
+    log->size = 0;
+    return true;
+}
+
+void forwardLogClose(ForwardLog *log) {
+    if (log == NULL) {
+        return;
+    }
+
+    forwardLogSync(log);
+    close(log->fd);
+    free(log->path);
+    free(log->buffer);
+    free(log);
+}
+
+bool forwardLogPrepare(ForwardLog *log, int type, char const *num1, char const *num2) {
+    if (log->failed) {
+        return false;
+    }
+
+    size_t len1 = length(num1);
+    size_t len2 = type == FORWARD_LOG_ADD ? length(num2) : 0;
+    size_t recordSize = 1 + packedSize(len1) + (type == FORWARD_LOG_ADD ? packedSize(len2) : 0) + CHECKSUM_SIZE;
+    if (log->capacity - log->size < recordSize) {
+        size_t capacity = 2 * log->capacity;
+        while (capacity - log->size < recordSize) {
+            capacity *= 2;
+        }
+        unsigned char *buffer = realloc(log->buffer, capacity);
+        if (buffer == NULL) {
+            return false;
+        }
+        log->buffer = buffer;
+        log->capacity = capacity;
+    }
+
+    unsigned char *record = log->buffer + log->size;
+    record[0] = (unsigned char) type;
+    packNumber(num1, len1, record + 1);
+    if (type == FORWARD_LOG_ADD) {
+        packNumber(num2, len2, record + 1 + packedSize(len1));
+    }
+    uint32_t sum = checksum(record, recordSize - CHECKSUM_SIZE);
+    memcpy(record + recordSize - CHECKSUM_SIZE, &sum, CHECKSUM_SIZE);
+    log->prepared = recordSize;
+    return true;
+}
+
+void forwardLogCommit(ForwardLog *log) {
+    log->size += log->prepared;
+    log->prepared = 0;
+    log->unsynced++;
+    if (log->syncEvery > 0 && log->unsynced >= log->syncEvery) {
+        forwardLogSync(log);
+    } else if (log->size >= LOG_BUFFER_SIZE) {
+        writeBuffer(log);
+    }
+}
+
+bool forwardLogSync(ForwardLog *log) {
+    if (!writeBuffer(log)) {
+        return false;
+    }
+    if (log->unsynced > 0 && fsync(log->fd) != 0) {
+        log->failed = true;
+        return false;
+    }
+    log->unsynced = 0;
+    return true;
+}
+
+uint64_t forwardLogEnd(ForwardLog const *log) {
+    return log->written + log->size;
+}
+
+/**
+ * @brief Copies the part of the file to another file.
+ * @param [in] from - descriptor of the file to read.
+ * @param [in] offset - position of the first copied byte.
+ * @param [in] count - number of the copied bytes.
+ * @param [in] to - descriptor of the file to write.
+ * @return Value @p true if the bytes were copied.
+ *         Value @p false if there was an allocation error or the files couldn't be read or written.
+ */
+static bool copyRange(int from, uint64_t offset, uint64_t count, int to) {
+    unsigned char *chunk = malloc(LOG_BUFFER_SIZE);
+    if (chunk == NULL) {
+        return false;
+    }
+
+    bool result = true;
+    while (result && count > 0) {
+        size_t wanted = count < LOG_BUFFER_SIZE ? (size_t) count : LOG_BUFFER_SIZE;
+        ssize_t copied = pread(from, chunk, wanted, (off_t) offset);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        result = copied > 0 && writeAll(to, chunk, (size_t) copied);
+        offset += (uint64_t) (copied > 0 ? copied : 0);
+        count -= (uint64_t) (copied > 0 ? copied : 0);
+    }
+    free(chunk);
+    return result;
+}
+
+bool forwardLogDropBefore(ForwardLog *log, uint64_t position) {
+    if (!writeBuffer(log)) {
+        return false;
+    }
+
+    char *temporary = malloc(strlen(log->path) + sizeof(".tmp"));
+    if (temporary == NULL) {
+        return false;
+    }
+    sprintf(temporary, "%s.tmp", log->path);
+
+    int fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, FILE_MODE);
+    uint64_t start = position > sizeof(struct LogHeader) ? position : sizeof(struct LogHeader);
+    bool result = fd >= 0 && writeHeader(fd) && copyRange(log->fd, start, log->written - start, fd) &&
+                  fsync(fd) == 0 && rename(temporary, log->path) == 0;
+    if (!result) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(temporary);
+        }
+        free(temporary);
+        return false;
+    }
+    free(temporary);
+
+    syncDirectory(log->path);
+    close(log->fd);
+    log->fd = fd;
+    log->written = sizeof(struct LogHeader) + (log->written - start);
+    log->unsynced = 0;
+    return true;
+}
+
+bool forwardLogReplaceFile(char const *temporary, char const *path) {
+    int fd = open(temporary, O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool result = fsync(fd) == 0;
+    close(fd);
+    return result && rename(temporary, path) == 0 && syncDirectory(path);
+}
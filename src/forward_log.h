@@ -0,0 +1,118 @@
+/** @file
+ * Interface of the class appending the changes of phone forwarding to a log file.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __FORWARD_LOG_H__
+#define __FORWARD_LOG_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FORWARD_LOG_ADD 1 /**< The record adds a phone forwarding. */
+#define FORWARD_LOG_REMOVE 2 /**< The record removes the phone forwardings of a prefix. */
+#define FORWARD_LOG_CLEAR 3 /**< The record removes the phone forwarding of a single number. */
+
+/**
+ * This is a structure storing the open log file and the records that weren't written to it yet.
+ * The records are packed and checked with a checksum, so a record torn by a crash is recognized and dropped together
+ * with everything after it. Each record only sets or clears the forwardings it names, whatever the structure holds,
+ * so replaying the records a snapshot already contains doesn't change the result.
+ */
+struct ForwardLog;
+typedef struct ForwardLog ForwardLog; /**< The log of the changes. */
+
+/**
+ * @brief Function replaying a single record.
+ * @param [in] type - the type of the record, @ref FORWARD_LOG_ADD, @ref FORWARD_LOG_REMOVE or @ref FORWARD_LOG_CLEAR.
+ * @param [in] num1 - the forwarded number or the removed prefix or number.
+ * @param [in] num2 - the number @p num1 is forwarded to or NULL for the other types.
+ * @param [in, out] context - pointer passed to @ref forwardLogOpen.
+ * @return Value @p true if the record was replayed successfully.
+ *         Value @p false otherwise, which stops the replaying.
+ */
+typedef bool (*LogRecordVisitor)(int type, char const *num1, char const *num2, void *context);
+
+/**
+ * @brief Opens the log file, replaying its records, and prepares it for appending.
+ * The file is created if it doesn't exist. The records following the last complete one are cut off.
+ * @param [in] path - path of the file.
+ * @param [in] syncEvery - number of the committed records written and flushed to the disk together, 0 means that
+ *                         they are flushed only by @ref forwardLogSync.
+ * @param [in] visit - the function called for every record of the file, in their order.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Pointer to the log or NULL if there was an allocation error, the file couldn't be read or written, it isn't
+ *         a log or @p visit failed.
+ */
+ForwardLog *forwardLogOpen(char const *path, size_t syncEvery, LogRecordVisitor visit, void *context);
+
+/**
+ * @brief Writes and flushes the remaining records and closes the log.
+ * Does nothing if the pointer is NULL.
+ * @param [in] log - pointer to the log.
+ */
+void forwardLogClose(ForwardLog *log);
+
+/**
+ * @brief Prepares the record of a change, before the change is made.
+ * The record is only appended by @ref forwardLogCommit, another prepared record replaces it.
+ * @param [in, out] log - pointer to the log.
+ * @param [in] type - the type of the record, @ref FORWARD_LOG_ADD, @ref FORWARD_LOG_REMOVE or @ref FORWARD_LOG_CLEAR.
+ * @param [in] num1 - the forwarded number or the removed prefix or number, it has to be valid.
+ * @param [in] num2 - the valid number @p num1 is forwarded to, ignored for the other types.
+ * @return Value @p true if the record was prepared.
+ *         Value @p false if there was an allocation error or writing the log failed before, the change mustn't be
+ *         made then.
+ */
+bool forwardLogPrepare(ForwardLog *log, int type, char const *num1, char const *num2);
+
+/**
+ * @brief Appends the prepared record, once the change was made.
+ * The records are written to the file when enough of them is buffered and flushed to the disk once @p syncEvery of
+ * them was committed. If that fails, the following changes are refused by @ref forwardLogPrepare.
+ * @param [in, out] log - pointer to the log.
+ */
+void forwardLogCommit(ForwardLog *log);
+
+/**
+ * @brief Writes the committed records to the file and flushes it to the disk.
+ * @param [in, out] log - pointer to the log.
+ * @return Value @p true if all the committed records are on the disk.
+ *         Value @p false if writing the log failed.
+ */
+bool forwardLogSync(ForwardLog *log);
+
+/**
+ * @brief Obtains the position after the last committed record.
+ * @param [in] log - pointer to the log.
+ * @return The position, to be passed to @ref forwardLogDropBefore.
+ */
+uint64_t forwardLogEnd(ForwardLog const *log);
+
+/**
+ * @brief Removes the records before the given position from the file.
+ * The remaining records are copied to a new file, which then replaces the log, so the file always holds either all
+ * the records or the remaining ones.
+ * @param [in, out] log - pointer to the log.
+ * @param [in] position - position obtained by @ref forwardLogEnd.
+ * @return Value @p true if the records were removed.
+ *         Value @p false if there was an allocation error or the new file couldn't be written, the log is left
+ *         unchanged then.
+ */
+bool forwardLogDropBefore(ForwardLog *log, uint64_t position);
+
+/**
+ * @brief Flushes the file to the disk and puts it in place of another one.
+ * The file at @p path is then either the old or the new one, even after a crash.
+ * @param [in] temporary - path of the new file.
+ * @param [in] path - path of the replaced file.
+ * @return Value @p true if the file was replaced.
+ *         Value @p false if the file couldn't be flushed or renamed.
+ */
+bool forwardLogReplaceFile(char const *temporary, char const *path);
+
+#endif /* __FORWARD_LOG_H__ */
@@ -6,398 +6,2727 @@
  * @date 2022
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include "counters.h"
+#include "epoch.h"
+#include "number_table.h"
+#include "packed_number.h"
 #include "phone_forward.h"
 #include "phone_numbers.h"
 #include "string_utils.h"
 #include "node_utils.h"
 
-#define NUMBER_OF_DIGITS 12 /**< Number of different digits. */
+#define FIRST_CHUNK_CAPACITY 32 /**< Number of nodes in the first chunk of the pool. */
+#define MAX_CHUNK_CAPACITY 4096 /**< Maximal number of nodes in a single chunk of the pool. */
+#define LABEL_CAPACITY 16 /**< Maximal number of digits of the label stored in a node. */
+#define INLINE_NUMBER_SIZE 16 /**< Size of the buffer for the packed number stored in the node itself. */
+#define NUMBER_BUFFER_SIZE 64 /**< Size of the buffer for the digits of a number unpacked without allocating. */
+#define SOURCE_TREE_THRESHOLD 32 /**< Number of numbers in a sequence of the reverse tree that makes it a tree. */
+#define VISIT_STACK_SIZE 64 /**< Number of nodes that fit on the stack of @ref visitNumbers without allocating. */
+#define FIRST_BUILD_STACK_CAPACITY 16 /**< Initial number of entries of the stack of @ref buildSorted. */
+#define FIRST_UNPUBLISHED_CAPACITY 16 /**< Initial number of nodes the list of unpublished nodes has memory for. */
+#define CLEANUP_BATCH_SIZE 128 /**< Number of nodes of the reverse tree cleaned together by @ref removeSubtreeReverse. */
+#define ROUTE_RETIREMENTS 4 /**< Number of the objects a change of a prepared route retires, at most. */
+
+#define NO_VALUE 0 /**< The node doesn't store any value. */
+#define NUMBERS_VALUE 1 /**< The node of the reverse tree stores a sequence of packed numbers. */
+#define INLINE_NUMBER_VALUE 2 /**< The node stores the packed number in its own buffer. */
+#define HEAP_NUMBER_VALUE 3 /**< The node stores a pointer to the packed number shared through the pool. */
+#define SOURCE_TREE_VALUE 4 /**< The node of the reverse tree stores the root of a tree of numbers. */
+
+#define UNPUBLISHED_NODE 1 /**< The node was created by the current write of a shared pool. */
+#define UNPUBLISHED_VALUE 2 /**< The value of the node was created by the current write of a shared pool. */
+#define PENDING_CLEANUP 4 /**< The node of the reverse tree is waiting in the batch of @ref removeSubtreeReverse. */
+#define MAX_REFERENCES UINT16_MAX /**< Number of the references of a node that is kept until the pool is deleted. */
+
+#define BATCH_LANES 8 /**< Number of numbers whose routes are followed in lock-step by @ref findPrefixBatch. */
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address) /**< Hints the processor to load the memory into cache. */
+#else
+#define PREFETCH(address) ((void) (address)) /**< Hints the processor to load the memory into cache. */
+#endif
 
 /**
  * @struct Node
  * @brief Node of the tree of phone forwarding.
- * @var Node::numbers
- *      Vector of numbers, for the forwarding tree it will hold only one number (the one to which the route from
- *      root to the current node is forwarded), for the reverse tree it will hold all numbers which are
- *      forwarded to that number.
+ * The tree is path-compressed: a run of digits without any branches or numbers is stored in the label of a single
+ * node.
+ * @var Node::value
+ *      Value stored in the node. For the reverse tree it is the set of all numbers which are forwarded to the
+ *      number represented by the node, kept in the sequence @p numbers or, once it grows to
+ *      @ref SOURCE_TREE_THRESHOLD numbers, in the tree of numbers rooted in @p sources. For the forwarding tree it is
+ *      the number to which the route from root to the current node is forwarded and for the tree of numbers it is
+ *      the number represented by the route itself, packed in @p inlineNumber if it fits in
+ *      @ref INLINE_NUMBER_SIZE bytes or otherwise in @p number, the copy shared by all the nodes of the pool storing
+ *      that number.
  * @var Node::parent
- *      Pointer to the parent node.
+ *      Pointer to the parent node, set while the tree is being deleted. For a node on the free list of the pool it
+ *      points to the next free node.
  * @var Node::next
- *      Array of pointers to the 12 children nodes in the tree.
+ *      Children of the node. If @p capacity is 0 the node has at most one child stored directly in @p child,
+ *      otherwise @p children is an array of @p capacity pointers, in which the children are packed in the order of
+ *      their digits.
+ * @var Node::label
+ *      Digits of the edge leading to the node, following the digit the node is indexed with in its parent. Each digit
+ *      takes 4 bits, the first one is stored in the least significant bits.
+ * @var Node::mask
+ *      Bitmap of the digits the node has children for, the child for a digit is at the index equal to the number of
+ *      set bits below the bit of that digit.
+ * @var Node::capacity
+ *      Number of elements of the allocated array of children or 0 if the child is stored inline.
+ * @var Node::labelLength
+ *      Number of digits in the label.
+ * @var Node::valueType
+ *      Type of the value stored in the node, one of @ref NO_VALUE, @ref NUMBERS_VALUE, @ref INLINE_NUMBER_VALUE,
+ *      @ref HEAP_NUMBER_VALUE and @ref SOURCE_TREE_VALUE.
+ * @var Node::flags
+ *      Set of @ref UNPUBLISHED_NODE and @ref UNPUBLISHED_VALUE, telling which parts of the node of a shared pool can't
+ *      be seen by the readers yet and can be changed in place, and of @ref PENDING_CLEANUP. Readers never look at it,
+ *      like at @p parent.
+ * @var Node::references
+ *      Number of the nodes and structures pointing to the node, more than one once the trees of cloned structures
+ *      share it. The node is freed when the last of them lets it go and never before the pool is deleted once the
+ *      number reaches @ref MAX_REFERENCES. Readers never look at it either.
  */
 struct Node {
-    PhoneNumbers *numbers;
+    union {
+        PackedNumbers *numbers;
+        DNode *sources;
+        PackedNumber *number;
+        PackedNumber inlineNumber[INLINE_NUMBER_SIZE];
+    } value;
     DNode *parent;
-    DNode *next[NUMBER_OF_DIGITS];
+    union {
+        DNode *child;
+        DNode **children;
+    } next;
+    uint64_t label;
+    uint16_t mask;
+    uint8_t capacity;
+    uint8_t labelLength;
+    uint8_t valueType;
+    uint8_t flags;
+    uint16_t references;
+};
+
+/**
+ * @struct NodeChunk
+ * @brief Contiguous block of memory holding the nodes of the pool.
+ * @var NodeChunk::previous
+ *      Pointer to the chunk allocated before this one.
+ * @var NodeChunk::used
+ *      Number of nodes that were already handed out from this chunk.
+ * @var NodeChunk::capacity
+ *      Number of nodes that fit in this chunk.
+ * @var NodeChunk::nodes
+ *      Array of the nodes.
+ */
+struct NodeChunk {
+    struct NodeChunk *previous;
+    size_t used;
+    size_t capacity;
+    DNode nodes[];
 };
 
-DNode *nodeNew(void) {
-    DNode *node = malloc(sizeof(DNode));
-    if (node == NULL) {
+/**
+ * @struct NodePool
+ * @brief Slab allocator of the nodes.
+ * @var NodePool::chunks
+ *      Pointer to the most recently allocated chunk.
+ * @var NodePool::freeList
+ *      Pointer to the first node on the list of freed nodes, linked with the @p parent field.
+ * @var NodePool::epoch
+ *      Pointer to the domain the shared memory is retired to or NULL if the trees aren't shared with concurrent
+ *      readers.
+ * @var NodePool::unpublished
+ *      Array of the nodes created or copied by the current write, whose flags are cleared once it is published.
+ * @var NodePool::unpublishedCount
+ *      Number of the nodes in @p unpublished.
+ * @var NodePool::unpublishedCapacity
+ *      Number of the nodes @p unpublished has memory for.
+ * @var NodePool::counters
+ *      Pointer to the counters of the allocated and freed nodes or NULL if they aren't counted.
+ * @var NodePool::numbers
+ *      Pointer to the table of the numbers too long to be stored in the nodes themselves.
+ * @var NodePool::writer
+ *      Mutex serializing the writes of all the structures using the pool.
+ * @var NodePool::users
+ *      Number of the structures using the pool.
+ */
+struct NodePool {
+    struct NodeChunk *chunks;
+    DNode *freeList;
+    EpochDomain *epoch;
+    DNode **unpublished;
+    size_t unpublishedCount;
+    size_t unpublishedCapacity;
+    OperationCounters *counters;
+    NumberTable *numbers;
+    pthread_mutex_t writer;
+    size_t users;
+};
+
+/**
+ * @brief Deletes the value stored in the node.
+ * @param [in, out] pool - pointer to the pool the tree of numbers stored in the node is allocated from.
+ * @param [in, out] node - pointer to the node.
+ */
+static void clearValue(NodePool *pool, DNode *node) {
+    if (node->valueType == NUMBERS_VALUE) {
+        packedNumbersDelete(node->value.numbers);
+    } else if (node->valueType == HEAP_NUMBER_VALUE) {
+        numberTableRelease(pool->numbers, node->value.number);
+    } else if (node->valueType == SOURCE_TREE_VALUE) {
+        deleteIterative(pool, node->value.sources);
+    }
+    node->valueType = NO_VALUE;
+}
+
+PackedNumber const *nodeGetNumber(DNode const *node) {
+    if (node->valueType == INLINE_NUMBER_VALUE) {
+        return node->value.inlineNumber;
+    } else if (node->valueType == HEAP_NUMBER_VALUE) {
+        return node->value.number;
+    }
+    return NULL;
+}
+
+NodePool *nodePoolNew(bool shared) {
+    NodePool *pool = malloc(sizeof(NodePool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->chunks = NULL;
+    pool->freeList = NULL;
+    pool->epoch = NULL;
+    pool->unpublished = NULL;
+    pool->unpublishedCount = 0;
+    pool->unpublishedCapacity = 0;
+    pool->counters = NULL;
+    pool->users = 1;
+    pool->numbers = numberTableNew();
+    if (pool->numbers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    if (pthread_mutex_init(&pool->writer, NULL) != 0) {
+        numberTableDelete(pool->numbers);
+        free(pool);
+        return NULL;
+    }
+    if (shared) {
+        pool->epoch = epochNew();
+        if (pool->epoch == NULL) {
+            pthread_mutex_destroy(&pool->writer);
+            numberTableDelete(pool->numbers);
+            free(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+void nodePoolDelete(NodePool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    epochDelete(pool->epoch);
+    struct NodeChunk *chunk = pool->chunks;
+    while (chunk != NULL) {
+        struct NodeChunk *previous = chunk->previous;
+        for (size_t i = 0; i < chunk->used; i++) {
+            if (chunk->nodes[i].valueType != SOURCE_TREE_VALUE) {
+                clearValue(pool, &chunk->nodes[i]);
+            }
+            if (chunk->nodes[i].capacity > 0) {
+                free(chunk->nodes[i].next.children);
+            }
+        }
+        free(chunk);
+        chunk = previous;
+    }
+
+    numberTableDelete(pool->numbers);
+    pthread_mutex_destroy(&pool->writer);
+    free(pool->unpublished);
+    free(pool);
+}
+
+/**
+ * @brief Obtains memory for a node from the pool.
+ * Takes the first node from the free list or, if there is none, the next unused node of the current chunk. If the
+ * current chunk is full, allocates a new one, twice as big as the previous one (but not bigger than
+ * @ref MAX_CHUNK_CAPACITY).
+ * @param [in, out] pool - pointer to the pool.
+ * @return Pointer to the uninitialized node or NULL if there was an allocation error.
+ */
+static DNode *nodeAllocate(NodePool *pool) {
+    if (pool->freeList != NULL) {
+        DNode *node = pool->freeList;
+        pool->freeList = node->parent;
+        countersAdd(pool->counters, COUNTER_NODE_ALLOCATIONS, 1);
+        return node;
+    }
+
+    struct NodeChunk *chunk = pool->chunks;
+    if (chunk == NULL || chunk->used == chunk->capacity) {
+        size_t capacity = FIRST_CHUNK_CAPACITY;
+        if (chunk != NULL && chunk->capacity < MAX_CHUNK_CAPACITY) {
+            capacity = chunk->capacity * 2;
+        } else if (chunk != NULL) {
+            capacity = MAX_CHUNK_CAPACITY;
+        }
+
+        struct NodeChunk *newChunk = malloc(sizeof(struct NodeChunk) + capacity * sizeof(DNode));
+        if (newChunk == NULL) {
+            return NULL;
+        }
+        newChunk->previous = chunk;
+        newChunk->used = 0;
+        newChunk->capacity = capacity;
+        pool->chunks = newChunk;
+        chunk = newChunk;
+    }
+
+    countersAdd(pool->counters, COUNTER_NODE_ALLOCATIONS, 1);
+    return &chunk->nodes[chunk->used++];
+}
+
+/**
+ * @brief Returns the node to the pool.
+ * Deletes the value stored in the node and puts the node on the free list of the pool.
+ * @param [in, out] pool - pointer to the pool.
+ * @param [in] node - pointer to the node to be freed.
+ */
+static void nodeFree(NodePool *pool, DNode *node) {
+    clearValue(pool, node);
+    if (node->capacity > 0) {
+        free(node->next.children);
+        node->capacity = 0;
+    }
+    node->parent = pool->freeList;
+    pool->freeList = node;
+    countersAdd(pool->counters, COUNTER_NODE_FREES, 1);
+}
+
+/**
+ * @brief Remembers the node created or copied by the current write of a shared pool.
+ * The node is marked as unpublished until @ref nodePoolPublish is called. Does nothing if the pool isn't shared.
+ * @param [in, out] pool - pointer to the pool.
+ * @param [in, out] node - pointer to the node.
+ * @return Value @p true if the node was remembered successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool markUnpublished(NodePool *pool, DNode *node) {
+    if (pool->epoch == NULL) {
+        return true;
+    }
+
+    if (pool->unpublishedCount == pool->unpublishedCapacity) {
+        size_t capacity = pool->unpublishedCapacity == 0 ? FIRST_UNPUBLISHED_CAPACITY : 2 * pool->unpublishedCapacity;
+        DNode **unpublished = realloc(pool->unpublished, capacity * sizeof(DNode *));
+        if (unpublished == NULL) {
+            return false;
+        }
+        pool->unpublished = unpublished;
+        pool->unpublishedCapacity = capacity;
+    }
+
+    pool->unpublished[pool->unpublishedCount++] = node;
+    node->flags = UNPUBLISHED_NODE;
+    return true;
+}
+
+/**
+ * @brief Marks the value of the node as created by the current write of a shared pool.
+ * Such a value is deleted right away instead of being retired. Does nothing if the pool isn't shared.
+ * @param [in] pool - pointer to the pool.
+ * @param [in, out] node - pointer to the unpublished node.
+ */
+static void markValueUnpublished(NodePool const *pool, DNode *node) {
+    if (pool->epoch != NULL) {
+        node->flags |= UNPUBLISHED_VALUE;
+    }
+}
+
+DNode *nodeNew(NodePool *pool) {
+    DNode *node = nodeAllocate(pool);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    node->valueType = NO_VALUE;
+    node->parent = NULL;
+    node->next.child = NULL;
+    node->label = 0;
+    node->mask = 0;
+    node->capacity = 0;
+    node->labelLength = 0;
+    node->flags = 0;
+    node->references = 1;
+
+    if (!markUnpublished(pool, node)) {
+        nodeFree(pool, node);
+        return NULL;
+    }
+    return node;
+}
+
+void nodeRetain(DNode *node) {
+    if (node->references < MAX_REFERENCES) {
+        node->references++;
+    }
+}
+
+/**
+ * @brief Gives up one of the references to the node.
+ * @param [in, out] node - pointer to the node.
+ * @return Value @p true if that was the last reference and the node can be freed.
+ *         Value @p false if the node is still in use or is kept until the pool is deleted.
+ */
+static bool dropReference(DNode *node) {
+    if (node->references == MAX_REFERENCES) {
+        return false;
+    }
+    return --node->references == 0;
+}
+
+/**
+ * @brief Frees the node that was replaced by its copy.
+ * The value of the node belongs to the copy, only the array of children is freed with the node.
+ * @param [in, out] context - pointer to the pool.
+ * @param [in, out] object - pointer to the node.
+ */
+static void reclaimNode(void *context, void *object) {
+    DNode *node = object;
+    node->valueType = NO_VALUE;
+    nodeFree(context, node);
+}
+
+/**
+ * @brief Deletes the tree that was cut off.
+ * @param [in, out] context - pointer to the pool.
+ * @param [in, out] object - pointer to the root of the tree.
+ */
+static void reclaimTree(void *context, void *object) {
+    deleteIterative(context, object);
+}
+
+/**
+ * @brief Gives up the shared number that was overwritten.
+ * @param [in, out] context - pointer to the pool.
+ * @param [in, out] object - pointer to the number.
+ */
+static void reclaimNumber(void *context, void *object) {
+    NodePool *pool = context;
+    numberTableRelease(pool->numbers, object);
+}
+
+/**
+ * @brief Deletes the sequence of numbers that was replaced.
+ * @param [in, out] context - unused.
+ * @param [in, out] object - pointer to the sequence.
+ */
+static void reclaimNumbers(void *context, void *object) {
+    (void) context;
+    packedNumbersDelete(object);
+}
+
+/**
+ * @brief Deletes the value stored in the node once no reader can see it.
+ * Works like @ref clearValue, but in a shared pool a value that could have been seen by the readers is retired
+ * instead of being deleted right away.
+ * @param [in, out] pool - pointer to the pool the node is allocated from.
+ * @param [in, out] node - pointer to the node.
+ */
+static void releaseValue(NodePool *pool, DNode *node) {
+    if (pool->epoch == NULL || (node->flags & UNPUBLISHED_VALUE)) {
+        clearValue(pool, node);
+    } else if (node->valueType == NUMBERS_VALUE) {
+        epochRetire(pool->epoch, node->value.numbers, reclaimNumbers, NULL);
+    } else if (node->valueType == HEAP_NUMBER_VALUE) {
+        epochRetire(pool->epoch, node->value.number, reclaimNumber, pool);
+    } else if (node->valueType == SOURCE_TREE_VALUE) {
+        epochRetire(pool->epoch, node->value.sources, reclaimTree, pool);
+    }
+    node->valueType = NO_VALUE;
+    node->flags &= (uint8_t) ~UNPUBLISHED_VALUE;
+}
+
+/**
+ * @brief Deletes the tree once no reader can see it.
+ * In a shared pool the tree is retired as a whole, otherwise it is deleted right away.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the root of the tree that was cut off.
+ */
+static void releaseTree(NodePool *pool, DNode *node) {
+    if (pool->epoch == NULL) {
+        deleteIterative(pool, node);
+    } else {
+        epochRetire(pool->epoch, node, reclaimTree, pool);
+    }
+}
+
+/**
+ * @brief Makes the copy of a node shared with other trees own what it points to.
+ * The copy gets its own sequence of numbers and one more reference is taken to the shared number, the tree of
+ * numbers and every child, which are kept by the node as well.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] copy - pointer to the unpublished copy of the node.
+ * @return Value @p true if the copy owns its contents.
+ *         Value @p false if there was an allocation error, no reference is taken then.
+ */
+static bool shareContents(NodePool *pool, DNode *copy) {
+    if (copy->valueType == NUMBERS_VALUE) {
+        PackedNumbers *numbers = packedNumbersCopy(copy->value.numbers);
+        if (numbers == NULL) {
+            return false;
+        }
+        copy->value.numbers = numbers;
+        markValueUnpublished(pool, copy);
+    } else if (copy->valueType == HEAP_NUMBER_VALUE) {
+        numberTableRetain(pool->numbers, copy->value.number);
+    } else if (copy->valueType == SOURCE_TREE_VALUE) {
+        nodeRetain(copy->value.sources);
+    }
+
+    if (copy->capacity == 0) {
+        if (copy->mask != 0) {
+            nodeRetain(copy->next.child);
+        }
+    } else {
+        for (int i = 0; i < numberOfChildren(copy); i++) {
+            nodeRetain(copy->next.children[i]);
+        }
+    }
+    return true;
+}
+
+DNode *nodeWritable(NodePool *pool, DNode *node) {
+    if (pool->epoch == NULL || (node->flags & UNPUBLISHED_NODE)) {
+        return node;
+    }
+    bool shared = node->references > 1;
+    if (!shared && !epochReserve(pool->epoch, 1)) {
+        return NULL;
+    }
+
+    DNode *copy = nodeAllocate(pool);
+    if (copy == NULL) {
+        return NULL;
+    }
+    *copy = *node;
+    copy->flags = 0;
+    copy->references = 1;
+
+    if (node->capacity > 0) {
+        copy->next.children = malloc(node->capacity * sizeof(DNode *));
+        if (copy->next.children == NULL) {
+            copy->capacity = 0;
+        } else {
+            for (int i = 0; i < numberOfChildren(node); i++) {
+                copy->next.children[i] = node->next.children[i];
+            }
+        }
+    }
+    if ((node->capacity > 0 && copy->capacity == 0) || !markUnpublished(pool, copy) ||
+        (shared && !shareContents(pool, copy))) {
+        copy->valueType = NO_VALUE;
+        nodeFree(pool, copy);
+        return NULL;
+    }
+
+    if (shared) {
+        dropReference(node);
+    } else {
+        epochRetire(pool->epoch, node, reclaimNode, pool);
+    }
+    return copy;
+}
+
+void nodePoolSetCounters(NodePool *pool, OperationCounters *counters) {
+    pool->counters = counters;
+}
+
+EpochDomain *nodePoolGetEpoch(NodePool const *pool) {
+    return pool->epoch;
+}
+
+void nodePoolLock(NodePool *pool) {
+    pthread_mutex_lock(&pool->writer);
+}
+
+void nodePoolUnlock(NodePool *pool) {
+    pthread_mutex_unlock(&pool->writer);
+}
+
+bool nodePoolShare(NodePool *pool) {
+    if (pool->epoch == NULL) {
+        pool->epoch = epochNew();
+        if (pool->epoch == NULL) {
+            return false;
+        }
+    }
+    pool->users++;
+    return true;
+}
+
+void nodePoolLeave(NodePool *pool, DNode *root, DNode *reverseRoot) {
+    pthread_mutex_lock(&pool->writer);
+    if (pool->users == 1) {
+        pthread_mutex_unlock(&pool->writer);
+        nodePoolDelete(pool);
+        return;
+    }
+
+    pool->users--;
+    pool->counters = NULL;
+    releaseTree(pool, root);
+    if (reverseRoot != NULL) {
+        releaseTree(pool, reverseRoot);
+    }
+    nodePoolPublish(pool);
+    pthread_mutex_unlock(&pool->writer);
+}
+
+void nodePoolPublish(NodePool *pool) {
+    if (pool->epoch == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < pool->unpublishedCount; i++) {
+        pool->unpublished[i]->flags = 0;
+    }
+    pool->unpublishedCount = 0;
+    epochReclaim(pool->epoch);
+}
+
+int countBits(uint16_t mask) {
+    unsigned int bits = mask;
+    bits = bits - ((bits >> 1) & 0x5555u);
+    bits = (bits & 0x3333u) + ((bits >> 2) & 0x3333u);
+    bits = (bits + (bits >> 4)) & 0x0F0Fu;
+    return (int) ((bits + (bits >> 8)) & 0x1Fu);
+}
+
+DNode *nodeGetNext(DNode *node, int digit) {
+    uint16_t bit = (uint16_t) (1u << digit);
+    if ((node->mask & bit) == 0) {
+        return NULL;
+    }
+    if (node->capacity == 0) {
+        return node->next.child;
+    }
+    return node->next.children[countBits(node->mask & (bit - 1))];
+}
+
+uint64_t nodeGetLabel(DNode const *node, size_t *labelLength) {
+    *labelLength = node->labelLength;
+    return node->label;
+}
+
+/**
+ * @brief Obtains the child at the given position.
+ * @param [in] node - pointer to the node.
+ * @param [in] index - position of the child among the children of the node, in the order of their digits.
+ * @return Pointer to the child.
+ */
+static DNode *nodeGetChild(DNode *node, int index) {
+    return node->capacity == 0 ? node->next.child : node->next.children[index];
+}
+
+/**
+ * @brief Removes the child at the given digit.
+ * If there is at most one child left afterwards, the array of children is freed and the child is stored inline.
+ * @param [in, out] node - pointer to the node to remove the child from.
+ * @param [in] digit - the digit of the child.
+ */
+static void nodeRemoveNext(DNode *node, int digit) {
+    uint16_t bit = (uint16_t) (1u << digit);
+    if ((node->mask & bit) == 0) {
+        return;
+    }
+    node->mask &= (uint16_t) ~bit;
+
+    if (node->capacity == 0) {
+        node->next.child = NULL;
+        return;
+    }
+
+    DNode **children = node->next.children;
+    int index = countBits(node->mask & (bit - 1));
+    int count = countBits(node->mask);
+    for (int i = index; i < count; i++) {
+        children[i] = children[i + 1];
+    }
+
+    if (count <= 1) {
+        node->next.child = count == 1 ? children[0] : NULL;
+        node->capacity = 0;
+        free(children);
+    }
+}
+
+bool nodeSetNext(DNode *node, int digit, DNode *next) {
+    if (next == NULL) {
+        nodeRemoveNext(node, digit);
+        return true;
+    }
+
+    uint16_t bit = (uint16_t) (1u << digit);
+    int index = countBits(node->mask & (bit - 1));
+    int count = countBits(node->mask);
+
+    if (node->mask & bit) {
+        if (node->capacity == 0) {
+            node->next.child = next;
+        } else {
+            node->next.children[index] = next;
+        }
+        return true;
+    }
+
+    if (count == 0 && node->capacity == 0) {
+        node->next.child = next;
+        node->mask |= bit;
+        return true;
+    }
+
+    if (node->capacity == 0) {
+        DNode **children = malloc(2 * sizeof(DNode *));
+        if (children == NULL) {
+            return false;
+        }
+        children[0] = node->next.child;
+        node->next.children = children;
+        node->capacity = 2;
+    } else if (count == node->capacity) {
+        int capacity = node->capacity * 2 > NUMBER_OF_DIGITS ? NUMBER_OF_DIGITS : node->capacity * 2;
+        DNode **children = realloc(node->next.children, capacity * sizeof(DNode *));
+        if (children == NULL) {
+            return false;
+        }
+        node->next.children = children;
+        node->capacity = (uint8_t) capacity;
+    }
+
+    DNode **children = node->next.children;
+    for (int i = count; i > index; i--) {
+        children[i] = children[i - 1];
+    }
+    children[index] = next;
+    node->mask |= bit;
+    return true;
+}
+
+/**
+ * @brief Detaches the child with the greatest digit.
+ * @param [in, out] node - pointer to the node to detach the child from.
+ * @return Pointer to the detached child or NULL if the node has no children.
+ */
+static DNode *nodeDetachLastChild(DNode *node) {
+    if (node->mask == 0) {
+        return NULL;
+    }
+
+    int digit = NUMBER_OF_DIGITS - 1;
+    while ((node->mask & (1u << digit)) == 0) {
+        digit--;
+    }
+
+    DNode *child = nodeGetNext(node, digit);
+    nodeRemoveNext(node, digit);
+    return child;
+}
+
+void deleteIterative(NodePool *pool, DNode *node) {
+    DNode *current = node;
+    if (current == NULL || !dropReference(current)) {
+        return;
+    }
+    current->parent = NULL;
+
+    while (current != NULL) {
+        DNode *child = nodeDetachLastChild(current);
+
+        if (child != NULL) {
+            if (dropReference(child)) {
+                child->parent = current;
+                current = child;
+            }
+        } else {
+            DNode *parent = current->parent;
+            nodeFree(pool, current);
+            current = parent;
+        }
+    }
+}
+
+/**
+ * @brief Obtains a digit of the label.
+ * @param [in] node - pointer to the node.
+ * @param [in] index - index of the digit in the label.
+ * @return Decimal representation of the digit.
+ */
+static int labelDigit(DNode const *node, size_t index) {
+    return (int) ((node->label >> (4 * index)) & 0xFu);
+}
+
+/**
+ * @brief Counts the digits of the label that match the number.
+ * @param [in] node - pointer to the node.
+ * @param [in] num - the digits of the number that follow the digit the node is indexed with.
+ * @return The length of the longest common prefix of the label and the number.
+ */
+static size_t matchLabel(DNode const *node, char const *num) {
+    size_t matched = 0;
+    while (matched < node->labelLength && toDecimalRepresentation(num[matched]) == labelDigit(node, matched)) {
+        matched++;
+    }
+    return matched;
+}
+
+/**
+ * @brief Follows the edge represented by the beginning of the number.
+ * @param [in] node - pointer to the node the edge starts in.
+ * @param [in] num - the number.
+ * @param [in, out] index - index of the first digit of the edge in the number, it will be moved after the edge.
+ * @return Pointer to the node the edge leads to or NULL if there is no such edge or the number doesn't contain its
+ *         whole label.
+ */
+static DNode *followEdge(DNode *node, char const *num, size_t *index) {
+    DNode *next = nodeGetNext(node, toDecimalRepresentation(num[*index]));
+    if (next == NULL) {
+        return NULL;
+    }
+
+    size_t matched = matchLabel(next, num + *index + 1);
+    if (matched < next->labelLength) {
+        return NULL;
+    }
+
+    *index += 1 + matched;
+    return next;
+}
+
+/**
+ * @brief Copies the route of the number in a shared pool, so that it can be changed in place.
+ * Every node of the route that could have been seen by the readers is replaced by its unpublished copy, including the
+ * last node the number enters, even if it doesn't contain its whole label.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] start - pointer to the unpublished node the route starts in.
+ * @param [in] num - the number that represents the route.
+ * @param [out] endPtr - pointer to the node at the end of the route or NULL if there is no such node.
+ * @return Value @p true if the route was copied successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool copyRoute(NodePool *pool, DNode *start, char const *num, DNode **endPtr) {
+    DNode *node = start;
+    size_t i = 0;
+    *endPtr = NULL;
+
+    while (isValidDigit(num[i])) {
+        int digit = toDecimalRepresentation(num[i]);
+        DNode *next = nodeGetNext(node, digit);
+        if (next == NULL) {
+            return true;
+        }
+
+        DNode *copy = nodeWritable(pool, next);
+        if (copy == NULL) {
+            return false;
+        }
+        if (copy != next) {
+            nodeSetNext(node, digit, copy);
+        }
+
+        size_t matched = matchLabel(copy, num + i + 1);
+        if (matched < copy->labelLength) {
+            return true;
+        }
+        node = copy;
+        i += 1 + matched;
+    }
+
+    *endPtr = node;
+    return true;
+}
+
+/**
+ * @brief Prepares the numbers stored in the node of the reverse tree of a shared pool to be changed in place.
+ * A sequence that could have been seen by the readers is replaced by its copy, for a tree of numbers its root and the
+ * route of the number are copied.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the unpublished node.
+ * @param [in] num - the number or the prefix of the numbers that will be added or removed.
+ * @return Value @p true if the numbers were prepared successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool prepareBucket(NodePool *pool, DNode *node, char const *num) {
+    if (node->valueType == NUMBERS_VALUE && (node->flags & UNPUBLISHED_VALUE) == 0) {
+        PackedNumbers *numbers = packedNumbersCopy(node->value.numbers);
+        if (numbers == NULL) {
+            return false;
+        }
+        releaseValue(pool, node);
+        node->value.numbers = numbers;
+        node->valueType = NUMBERS_VALUE;
+        markValueUnpublished(pool, node);
+    } else if (node->valueType == SOURCE_TREE_VALUE) {
+        DNode *root = nodeWritable(pool, node->value.sources);
+        if (root == NULL) {
+            return false;
+        }
+        node->value.sources = root;
+
+        DNode *end = NULL;
+        return copyRoute(pool, root, num, &end);
+    }
+    return true;
+}
+
+/**
+ * @brief Prepares the route to be changed in place by a write of a shared pool.
+ * Copies the route with @ref copyRoute and, if a number is given, prepares the numbers stored at its end with
+ * @ref prepareBucket, and reserves the memory for the objects the change will retire. Afterwards the functions
+ * changing the route and the numbers at its end can only fail when creating new nodes or numbers. Does nothing if the
+ * pool isn't shared.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] start - pointer to the unpublished node the route starts in.
+ * @param [in] route - the number that represents the route.
+ * @param [in] num - the number that will be added to or removed from the node at the end of the route or NULL.
+ * @return Value @p true if the route was prepared successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool prepareRoute(NodePool *pool, DNode *start, char const *route, char const *num) {
+    if (pool->epoch == NULL) {
+        return true;
+    }
+    if (!epochReserve(pool->epoch, ROUTE_RETIREMENTS)) {
+        return false;
+    }
+
+    DNode *end = NULL;
+    if (!copyRoute(pool, start, route, &end)) {
+        return false;
+    }
+    return end == NULL || num == NULL || prepareBucket(pool, end, num);
+}
+
+/**
+ * @brief Merges the node with its only child.
+ * If the node doesn't store any numbers, has exactly one child and the joined labels fit in one node, the child is
+ * moved into the node, so that the route is represented by a single node. Otherwise nothing happens. In a shared pool
+ * a child that could have been seen by the readers is left intact and retired, the node gets a copy of its array of
+ * children, and if that can't be allocated nothing happens either. A child shared with other trees is replaced by its
+ * copy first.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node, it mustn't be the root of the tree.
+ */
+static void mergeWithChild(NodePool *pool, DNode *node) {
+    if (node->valueType != NO_VALUE || numberOfChildren(node) != 1) {
+        return;
+    }
+
+    int digit = 0;
+    while ((node->mask & (1u << digit)) == 0) {
+        digit++;
+    }
+    DNode *child = nodeGetNext(node, digit);
+    if (node->labelLength + 1 + child->labelLength > LABEL_CAPACITY) {
+        return;
+    }
+    if (pool->epoch != NULL && (child->flags & UNPUBLISHED_NODE) == 0 && child->references > 1) {
+        child = nodeWritable(pool, child);
+        if (child == NULL) {
+            return;
+        }
+        nodeSetNext(node, digit, child);
+    }
+
+    bool shared = pool->epoch != NULL && (child->flags & UNPUBLISHED_NODE) == 0;
+    DNode **children = NULL;
+    if (shared && child->capacity > 0) {
+        children = malloc(child->capacity * sizeof(DNode *));
+        if (children == NULL) {
+            return;
+        }
+        for (int i = 0; i < numberOfChildren(child); i++) {
+            children[i] = child->next.children[i];
+        }
+    }
+
+    node->label |= (uint64_t) digit << (4 * node->labelLength);
+    if (child->labelLength > 0) {
+        node->label |= child->label << (4 * (node->labelLength + 1));
+    }
+    node->labelLength = (uint8_t) (node->labelLength + 1 + child->labelLength);
+    node->value = child->value;
+    node->valueType = child->valueType;
+    node->flags = (uint8_t) ((node->flags & ~UNPUBLISHED_VALUE) | (child->flags & UNPUBLISHED_VALUE));
+    node->next = child->next;
+    node->mask = child->mask;
+    node->capacity = child->capacity;
+
+    if (shared) {
+        if (children != NULL) {
+            node->next.children = children;
+        }
+        epochRetire(pool->epoch, child, reclaimNode, pool);
+        return;
+    }
+
+    child->valueType = NO_VALUE;
+    child->mask = 0;
+    child->capacity = 0;
+    nodeFree(pool, child);
+}
+
+/**
+ * @brief Splits the edge leading to the child.
+ * Inserts a new node between the parent and the child, after the given number of digits of the child's label.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] parent - pointer to the parent node.
+ * @param [in] digit - the digit the child is indexed with in the parent.
+ * @param [in, out] child - pointer to the child node.
+ * @param [in] length - number of digits of the label that stay above the new node, smaller than the label length.
+ * @return Pointer to the new node or NULL if there was an allocation error.
+ */
+static DNode *splitEdge(NodePool *pool, DNode *parent, int digit, DNode *child, size_t length) {
+    DNode *middle = nodeNew(pool);
+    if (middle == NULL) {
+        return NULL;
+    }
+
+    int childDigit = labelDigit(child, length);
+    middle->labelLength = (uint8_t) length;
+    middle->label = child->label & ((UINT64_C(1) << (4 * length)) - 1);
+    child->label = length + 1 < LABEL_CAPACITY ? child->label >> (4 * (length + 1)) : 0;
+    child->labelLength = (uint8_t) (child->labelLength - length - 1);
+
+    nodeSetNext(middle, childDigit, child);
+    nodeSetNext(parent, digit, middle);
+    return middle;
+}
+
+/**
+ * @brief Creates a new route.
+ * Creates the nodes representing the given digits, filling the labels up to @ref LABEL_CAPACITY.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in] num - the digits following the digit the route will be indexed with.
+ * @param [in, out] leafPtr - pointer to the last node of the route.
+ * @return Pointer to the first node of the route or NULL if there was an allocation error.
+ */
+static DNode *newRoute(NodePool *pool, char const *num, DNode **leafPtr) {
+    DNode *first = nodeNew(pool);
+    if (first == NULL) {
+        return NULL;
+    }
+    DNode *node = first;
+    size_t i = 0;
+
+    while (true) {
+        while (node->labelLength < LABEL_CAPACITY && isValidDigit(num[i])) {
+            node->label |= (uint64_t) toDecimalRepresentation(num[i]) << (4 * node->labelLength);
+            node->labelLength++;
+            i++;
+        }
+        if (!isValidDigit(num[i])) {
+            break;
+        }
+
+        DNode *next = nodeNew(pool);
+        if (next == NULL) {
+            deleteIterative(pool, first);
+            return NULL;
+        }
+        nodeSetNext(node, toDecimalRepresentation(num[i]), next);
+        node = next;
+        i++;
+    }
+
+    *leafPtr = node;
+    return first;
+}
+
+/**
+ * @brief Finds the end of the route.
+ * Goes down the tree along the route represented by the number, remembering the last point the route can be cut off
+ * at without removing any other numbers.
+ * @param [in] start - pointer to the start of the route.
+ * @param [in] num - the number that represents the route.
+ * @param [in] wholeEdges - if @p false, the number may end inside the label of the last node.
+ * @param [in, out] beforePointToRemove - pointer to the node the cut off route starts in.
+ * @param [in, out] pointToRemoveDigit - pointer to the digit of the cut off route.
+ * @param [in, out] lastPointToRemove - pointer to the first node of the cut off route.
+ * @return Pointer to the node at the end of the route or NULL if there is no such route.
+ */
+static DNode *findRouteEnd(DNode *start, char const *num, bool wholeEdges, DNode **beforePointToRemove,
+                           int *pointToRemoveDigit, DNode **lastPointToRemove) {
+    DNode *node = start;
+    size_t i = 0;
+    *beforePointToRemove = start;
+    *pointToRemoveDigit = 0;
+    *lastPointToRemove = NULL;
+
+    while (isValidDigit(num[i])) {
+        int digit = toDecimalRepresentation(num[i]);
+        DNode *next = nodeGetNext(node, digit);
+        if (next == NULL) {
+            return NULL;
+        }
+
+        size_t matched = matchLabel(next, num + i + 1);
+        if (matched < next->labelLength && (wholeEdges || isValidDigit(num[i + 1 + matched]))) {
+            return NULL;
+        }
+
+        if (node->valueType != NO_VALUE || numberOfChildren(node) > 1 || *lastPointToRemove == NULL) {
+            *beforePointToRemove = node;
+            *pointToRemoveDigit = digit;
+            *lastPointToRemove = next;
+        }
+        node = next;
+        i += 1 + matched;
+    }
+
+    return node;
+}
+
+/**
+ * @brief Cuts off the route.
+ * Deletes the nodes starting from the given point and merges the node the route started in with its only child,
+ * if it was left with one.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in] start - pointer to the root of the tree.
+ * @param [in, out] beforePointToRemove - pointer to the node the cut off route starts in.
+ * @param [in] pointToRemoveDigit - the digit of the cut off route.
+ * @param [in, out] lastPointToRemove - pointer to the first node of the cut off route.
+ */
+static void cutRoute(NodePool *pool, DNode *start, DNode *beforePointToRemove, int pointToRemoveDigit,
+                     DNode *lastPointToRemove) {
+    nodeSetNext(beforePointToRemove, pointToRemoveDigit, NULL);
+    releaseTree(pool, lastPointToRemove);
+    if (beforePointToRemove != start) {
+        mergeWithChild(pool, beforePointToRemove);
+    }
+}
+
+/**
+ * @brief Removes the node at the end of the route if it is no longer needed.
+ * If the node doesn't store any numbers, it is deleted together with the part of the route that leads only to it, or
+ * merged with its child if it has only one.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in] start - pointer to the root of the tree.
+ * @param [in, out] node - pointer to the node at the end of the route.
+ * @param [in, out] beforePointToRemove - pointer to the node the route can be cut off in.
+ * @param [in] pointToRemoveDigit - the digit of the route that can be cut off.
+ * @param [in, out] lastPointToRemove - pointer to the first node of the route that can be cut off.
+ */
+static void pruneRoute(NodePool *pool, DNode *start, DNode *node, DNode *beforePointToRemove, int pointToRemoveDigit,
+                       DNode *lastPointToRemove) {
+    if (node->valueType != NO_VALUE) {
+        return;
+    }
+
+    if (numberOfChildren(node) == 0) {
+        cutRoute(pool, start, beforePointToRemove, pointToRemoveDigit, lastPointToRemove);
+    } else {
+        mergeWithChild(pool, node);
+    }
+}
+
+/**
+ * @brief Stores the packed number in the node.
+ * Numbers that fit in @ref INLINE_NUMBER_SIZE bytes once packed are stored in the node itself, longer ones are shared
+ * through the table of the pool, so a number many keys are forwarded to is stored only once. The node mustn't store
+ * any value.
+ * @param [in, out] pool - pointer to the pool the node is allocated from.
+ * @param [in, out] node - pointer to the node.
+ * @param [in] num - the number to store.
+ * @return Value @p true if the number was stored successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool nodeSetNumber(NodePool *pool, DNode *node, char const *num) {
+    size_t len = length(num);
+    if (packedSize(len) > INLINE_NUMBER_SIZE) {
+        PackedNumber *number = numberTableAcquire(pool->numbers, num);
+        if (number == NULL) {
+            return false;
+        }
+        node->value.number = number;
+        node->valueType = HEAP_NUMBER_VALUE;
+        return true;
+    }
+
+    packNumber(num, len, node->value.inlineNumber);
+    node->valueType = INLINE_NUMBER_VALUE;
+    return true;
+}
+
+/**
+ * @brief Obtains the digits of the packed number.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in, out] buffer - buffer of @ref NUMBER_BUFFER_SIZE characters used if the number fits in it.
+ * @return Pointer to the terminated number, it has to be freed if it isn't @p buffer, or NULL if there was an
+ *         allocation error.
+ */
+static char *unpackToBuffer(PackedNumber const *packed, char *buffer) {
+    size_t len = packedLength(packed);
+    char *number = len < NUMBER_BUFFER_SIZE ? buffer : malloc(len + 1);
+    if (number != NULL) {
+        unpackNumber(packed, number);
+    }
+    return number;
+}
+
+/**
+ * @brief Frees the number returned by @ref unpackToBuffer.
+ * @param [in] number - pointer to the number or NULL.
+ * @param [in] buffer - the buffer passed to @ref unpackToBuffer.
+ */
+static void releaseNumber(char *number, char const *buffer) {
+    if (number != buffer) {
+        free(number);
+    }
+}
+
+/**
+ * @brief Adds the number to the tree of numbers.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] root - pointer to the root of the tree of numbers.
+ * @param [in] num - the number to add, it mustn't be in the tree yet.
+ * @return Value @p true if the number was added successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool sourceTreeAdd(NodePool *pool, DNode *root, char const *num) {
+    DNode *node = getEndNode(pool, root, num);
+    if (node == NULL) {
+        return false;
+    }
+    if (!nodeSetNumber(pool, node, num)) {
+        removeEmptyRoute(pool, root, num);
+        return false;
+    }
+    markValueUnpublished(pool, node);
+    return true;
+}
+
+/**
+ * @brief Moves the numbers from the sequence of the node of the reverse tree to a new tree of numbers.
+ * If there was an allocation error, the node is left unchanged.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node storing the sequence.
+ * @return Value @p true if the numbers were moved successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool bucketToTree(NodePool *pool, DNode *node) {
+    DNode *root = nodeNew(pool);
+    if (root == NULL) {
+        return false;
+    }
+
+    PackedNumbers *numbers = node->value.numbers;
+    char buffer[NUMBER_BUFFER_SIZE];
+    for (PackedNumber const *packed = packedNumbersNext(numbers, NULL); packed != NULL;
+         packed = packedNumbersNext(numbers, packed)) {
+        char *source = unpackToBuffer(packed, buffer);
+        bool added = source != NULL && sourceTreeAdd(pool, root, source);
+        releaseNumber(source, buffer);
+        if (!added) {
+            deleteIterative(pool, root);
+            return false;
+        }
+    }
+
+    releaseValue(pool, node);
+    node->value.sources = root;
+    node->valueType = SOURCE_TREE_VALUE;
+    markValueUnpublished(pool, node);
+    return true;
+}
+
+/**
+ * @brief Deletes the tree of numbers of the node of the reverse tree if there are no numbers left in it.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node storing the tree.
+ */
+static void releaseEmptySourceTree(NodePool *pool, DNode *node) {
+    if (numberOfChildren(node->value.sources) == 0) {
+        releaseValue(pool, node);
+    }
+}
+
+/**
+ * @brief Removes the number from the numbers stored in the node of the reverse tree.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node.
+ * @param [in] num - the number to remove.
+ */
+static void bucketRemove(NodePool *pool, DNode *node, char const *num) {
+    if (node->valueType == NUMBERS_VALUE) {
+        packedNumbersRemove(&node->value.numbers, num);
+        if (node->value.numbers == NULL) {
+            node->valueType = NO_VALUE;
+        }
+    } else if (node->valueType == SOURCE_TREE_VALUE) {
+        DNode *beforePointToRemove;
+        DNode *lastPointToRemove;
+        int pointToRemoveDigit;
+        DNode *root = node->value.sources;
+        DNode *end = findRouteEnd(root, num, true, &beforePointToRemove, &pointToRemoveDigit, &lastPointToRemove);
+        if (end != NULL) {
+            releaseValue(pool, end);
+            pruneRoute(pool, root, end, beforePointToRemove, pointToRemoveDigit, lastPointToRemove);
+            releaseEmptySourceTree(pool, node);
+        }
+    }
+}
+
+/**
+ * @brief Removes the numbers with certain prefix from the numbers stored in the node of the reverse tree.
+ * In the tree of numbers all such numbers are in the subtree at the end of the route of the prefix, so the subtree
+ * is cut off as a whole.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node.
+ * @param [in] prefix - the prefix of numbers we want to remove.
+ */
+static void bucketRemoveWithPrefix(NodePool *pool, DNode *node, char const *prefix) {
+    if (node->valueType == NUMBERS_VALUE) {
+        packedNumbersRemoveWithPrefix(&node->value.numbers, prefix);
+        if (node->value.numbers == NULL) {
+            node->valueType = NO_VALUE;
+        }
+    } else if (node->valueType == SOURCE_TREE_VALUE) {
+        DNode *beforePointToRemove;
+        DNode *lastPointToRemove;
+        int pointToRemoveDigit;
+        DNode *root = node->value.sources;
+        if (findRouteEnd(root, prefix, false, &beforePointToRemove, &pointToRemoveDigit, &lastPointToRemove) != NULL) {
+            cutRoute(pool, root, beforePointToRemove, pointToRemoveDigit, lastPointToRemove);
+            releaseEmptySourceTree(pool, node);
+        }
+    }
+}
+
+/**
+ * @brief Visits the packed number.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in] visit - the function called for the digits of the number.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if @p visit returned @p true.
+ *         Value @p false if @p visit stopped the visiting or there was an allocation error.
+ */
+static bool visitPacked(PackedNumber const *packed, NumberVisitor visit, void *context) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *number = unpackToBuffer(packed, buffer);
+    bool result = number != NULL && visit(number, context);
+    releaseNumber(number, buffer);
+    return result;
+}
+
+/**
+ * @brief Visits all numbers stored in the tree.
+ * The tree is walked in depth-first order with an explicit stack of nodes, which is kept on the call stack unless it
+ * grows beyond @ref VISIT_STACK_SIZE nodes. The numbers are visited in the lexicographic order of their digits.
+ * @param [in] root - pointer to the root of the tree.
+ * @param [in] visit - the function called for every number.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if all numbers were visited.
+ *         Value @p false if @p visit stopped the visiting or there was an allocation error.
+ */
+static bool visitNumbers(DNode *root, NumberVisitor visit, void *context) {
+    DNode *inlineStack[VISIT_STACK_SIZE];
+    DNode **stack = inlineStack;
+    size_t capacity = VISIT_STACK_SIZE;
+    size_t size = 0;
+    bool result = true;
+    stack[size++] = root;
+
+    while (size > 0) {
+        DNode *node = stack[--size];
+        PackedNumber const *number = nodeGetNumber(node);
+        if (number != NULL && !visitPacked(number, visit, context)) {
+            result = false;
+            break;
+        }
+
+        int count = numberOfChildren(node);
+        if (size + count > capacity) {
+            DNode **newStack = stack == inlineStack ? malloc(2 * capacity * sizeof(DNode *))
+                                                    : realloc(stack, 2 * capacity * sizeof(DNode *));
+            if (newStack == NULL) {
+                result = false;
+                break;
+            }
+            if (stack == inlineStack) {
+                for (size_t i = 0; i < size; i++) {
+                    newStack[i] = inlineStack[i];
+                }
+            }
+            stack = newStack;
+            capacity *= 2;
+        }
+
+        for (int i = count - 1; i >= 0; i--) {
+            stack[size++] = nodeGetChild(node, i);
+        }
+    }
+
+    if (stack != inlineStack) {
+        free(stack);
+    }
+    return result;
+}
+
+bool nodeVisitNumbers(DNode *node, NumberVisitor visit, void *context) {
+    if (node->valueType == SOURCE_TREE_VALUE) {
+        return visitNumbers(node->value.sources, visit, context);
+    }
+    if (node->valueType == NUMBERS_VALUE) {
+        PackedNumbers *numbers = node->value.numbers;
+        for (PackedNumber const *packed = packedNumbersNext(numbers, NULL); packed != NULL;
+             packed = packedNumbersNext(numbers, packed)) {
+            if (!visitPacked(packed, visit, context)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @struct ForwardingEntry
+ * @brief Node of the forward tree waiting to be visited by @ref nodeVisitForwardings.
+ * @var ForwardingEntry::node
+ *      Pointer to the node.
+ * @var ForwardingEntry::depth
+ *      Number of the digits of the route to the parent of the node.
+ * @var ForwardingEntry::digit
+ *      The digit of the edge from the parent to the node.
+ */
+struct ForwardingEntry {
+    DNode *node;
+    size_t depth;
+    int digit;
+};
+
+/**
+ * @brief Pushes the children of the node of the forward tree on the stack, the first digit on the top.
+ * @param [in] node - pointer to the node.
+ * @param [in] depth - number of the digits of the route to the node.
+ * @param [in, out] stack - pointer to the stack.
+ * @param [in, out] size - pointer to the number of the entries of the stack.
+ * @param [in, out] capacity - pointer to the number of the entries the stack has memory for.
+ * @return Value @p true if the children were pushed.
+ *         Value @p false if there was an allocation error.
+ */
+static bool pushForwardings(DNode *node, size_t depth, struct ForwardingEntry **stack, size_t *size,
+                            size_t *capacity) {
+    size_t children = (size_t) numberOfChildren(node);
+    if (*size + children > *capacity) {
+        size_t newCapacity = *capacity == 0 ? VISIT_STACK_SIZE : 2 * *capacity;
+        while (newCapacity < *size + children) {
+            newCapacity *= 2;
+        }
+        struct ForwardingEntry *bigger = realloc(*stack, newCapacity * sizeof(struct ForwardingEntry));
+        if (bigger == NULL) {
+            return false;
+        }
+        *stack = bigger;
+        *capacity = newCapacity;
+    }
+
+    for (int digit = NUMBER_OF_DIGITS - 1; digit >= 0; digit--) {
+        DNode *child = nodeGetNext(node, digit);
+        if (child != NULL) {
+            (*stack)[(*size)++] = (struct ForwardingEntry) {child, depth, digit};
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Makes sure the buffer has memory for the given number of characters.
+ * @param [in, out] buffer - pointer to the buffer.
+ * @param [in, out] capacity - pointer to the number of the characters the buffer has memory for.
+ * @param [in] needed - the needed number of the characters.
+ * @return Value @p true if the buffer is big enough.
+ *         Value @p false if there was an allocation error.
+ */
+static bool reserveChars(char **buffer, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    size_t newCapacity = *capacity == 0 ? NUMBER_BUFFER_SIZE : 2 * *capacity;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    char *bigger = realloc(*buffer, newCapacity);
+    if (bigger == NULL) {
+        return false;
+    }
+    *buffer = bigger;
+    *capacity = newCapacity;
+    return true;
+}
+
+/**
+ * @brief Visits the phone forwarding stored in the node, if there is one.
+ * @param [in] node - pointer to the node.
+ * @param [in] num1 - the number represented by the node.
+ * @param [in] visit - the function called for the forwarding.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if the node has no forwarding or the visiting should continue.
+ *         Value @p false if there was an allocation error or @p visit stopped the visiting.
+ */
+static bool visitForwarding(DNode *node, char const *num1, ForwardingVisitor visit, void *context) {
+    PackedNumber const *target = nodeGetNumber(node);
+    if (target == NULL) {
+        return true;
+    }
+
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *num2 = unpackToBuffer(target, buffer);
+    bool result = num2 != NULL && visit(num1, num2, context);
+    releaseNumber(num2, buffer);
+    return result;
+}
+
+bool nodeVisitForwardings(DNode *root, char const *prefix, ForwardingVisitor visit, void *context) {
+    DNode *node = root;
+    size_t depth = 0;
+    size_t matched = 0;
+    while (isValidDigit(prefix[depth])) {
+        node = nodeGetNext(node, toDecimalRepresentation(prefix[depth]));
+        if (node == NULL) {
+            return true;
+        }
+        matched = matchLabel(node, prefix + depth + 1);
+        if (matched < node->labelLength && isValidDigit(prefix[depth + 1 + matched])) {
+            return true;
+        }
+        depth += 1 + matched;
+    }
+
+    char *num1 = NULL;
+    size_t capacity1 = 0;
+    size_t length = depth + (node == root ? 0 : node->labelLength - matched);
+    if (!reserveChars(&num1, &capacity1, length + 1)) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        num1[i] = i < depth ? prefix[i] : DIGIT_CHARS[labelDigit(node, matched + i - depth)];
+    }
+    num1[length] = '\0';
+
+    struct ForwardingEntry *stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    bool result = visitForwarding(node, num1, visit, context) &&
+                  pushForwardings(node, length, &stack, &size, &capacity);
+    while (result && size > 0) {
+        struct ForwardingEntry entry = stack[--size];
+        node = entry.node;
+        length = entry.depth + 1 + node->labelLength;
+        if (!reserveChars(&num1, &capacity1, length + 1)) {
+            result = false;
+            break;
+        }
+        num1[entry.depth] = DIGIT_CHARS[entry.digit];
+        for (size_t i = 0; i < node->labelLength; i++) {
+            num1[entry.depth + 1 + i] = DIGIT_CHARS[labelDigit(node, i)];
+        }
+        num1[length] = '\0';
+
+        result = visitForwarding(node, num1, visit, context) &&
+                 pushForwardings(node, length, &stack, &size, &capacity);
+    }
+
+    free(stack);
+    free(num1);
+    return result;
+}
+
+/**
+ * @struct DiffEntry
+ * @brief Pair of the points of two forward trees waiting to be compared by @ref nodeDiffForwardings.
+ * A point is a node and the number of the digits of its label already followed, it is at the node itself once the
+ * whole label is followed.
+ * @var DiffEntry::nodes
+ *      Pointers to the nodes of the points of both trees, NULL if the route doesn't exist in the tree.
+ * @var DiffEntry::offsets
+ *      Numbers of the digits of the labels of the nodes already followed.
+ * @var DiffEntry::depth
+ *      Number of the digits of the route to the points.
+ * @var DiffEntry::digit
+ *      The last digit of the route.
+ */
+struct DiffEntry {
+    DNode *nodes[2];
+    uint8_t offsets[2];
+    size_t depth;
+    int digit;
+};
+
+/**
+ * @brief Follows a digit from the point of the forward tree.
+ * @param [in] node - pointer to the node of the point or NULL if there is no point.
+ * @param [in] offset - number of the digits of the label of the node already followed.
+ * @param [in] digit - the followed digit.
+ * @param [out] nextOffset - pointer to the number of the digits of the label followed at the next point.
+ * @return Pointer to the node of the next point or NULL if the route doesn't continue with the digit.
+ */
+static DNode *diffStep(DNode *node, uint8_t offset, int digit, uint8_t *nextOffset) {
+    if (node == NULL) {
+        return NULL;
+    }
+    if (offset < node->labelLength) {
+        *nextOffset = (uint8_t) (offset + 1);
+        return labelDigit(node, offset) == digit ? node : NULL;
+    }
+    *nextOffset = 0;
+    return nodeGetNext(node, digit);
+}
+
+/**
+ * @brief Pushes the pairs of the points following both points of the entry, the first digit on the top.
+ * @param [in] entry - pointer to the entry.
+ * @param [in, out] stack - pointer to the stack.
+ * @param [in, out] size - pointer to the number of the entries of the stack.
+ * @param [in, out] capacity - pointer to the number of the entries the stack has memory for.
+ * @return Value @p true if the pairs were pushed.
+ *         Value @p false if there was an allocation error.
+ */
+static bool pushDiffs(struct DiffEntry const *entry, struct DiffEntry **stack, size_t *size, size_t *capacity) {
+    if (*size + NUMBER_OF_DIGITS > *capacity) {
+        size_t newCapacity = *capacity == 0 ? VISIT_STACK_SIZE : 2 * *capacity;
+        struct DiffEntry *bigger = realloc(*stack, newCapacity * sizeof(struct DiffEntry));
+        if (bigger == NULL) {
+            return false;
+        }
+        *stack = bigger;
+        *capacity = newCapacity;
+    }
+
+    for (int digit = NUMBER_OF_DIGITS - 1; digit >= 0; digit--) {
+        struct DiffEntry next = {{NULL, NULL}, {0, 0}, entry->depth + 1, digit};
+        for (int i = 0; i < 2; i++) {
+            next.nodes[i] = diffStep(entry->nodes[i], entry->offsets[i], digit, &next.offsets[i]);
+        }
+        if (next.nodes[0] != NULL || next.nodes[1] != NULL) {
+            (*stack)[(*size)++] = next;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Visits the difference between the forwardings stored at the points of the entry, if there is one.
+ * @param [in] entry - pointer to the entry.
+ * @param [in] num1 - the number represented by the points.
+ * @param [in] visit - the function called for the difference.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if the forwardings are the same or the visiting should continue.
+ *         Value @p false if there was an allocation error or @p visit stopped the visiting.
+ */
+static bool visitDiff(struct DiffEntry const *entry, char const *num1, ForwardingDiffVisitor visit, void *context) {
+    PackedNumber const *targets[2];
+    for (int i = 0; i < 2; i++) {
+        DNode *node = entry->nodes[i];
+        targets[i] = node != NULL && entry->offsets[i] == node->labelLength ? nodeGetNumber(node) : NULL;
+    }
+    if (targets[0] == targets[1]) {
+        return true;
+    }
+
+    char buffers[2][NUMBER_BUFFER_SIZE];
+    char *nums[2] = {NULL, NULL};
+    bool result = true;
+    for (int i = 0; i < 2 && result; i++) {
+        if (targets[i] != NULL) {
+            nums[i] = unpackToBuffer(targets[i], buffers[i]);
+            result = nums[i] != NULL;
+        }
+    }
+    if (result && (nums[0] == NULL || nums[1] == NULL || !areEqual(nums[0], nums[1]))) {
+        result = visit(num1, nums[0], nums[1], context);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (nums[i] != NULL) {
+            releaseNumber(nums[i], buffers[i]);
+        }
+    }
+    return result;
+}
+
+bool nodeDiffForwardings(DNode *root1, DNode *root2, ForwardingDiffVisitor visit, void *context) {
+    char *num1 = NULL;
+    size_t capacity1 = 0;
+    if (!reserveChars(&num1, &capacity1, 1)) {
+        return false;
+    }
+    num1[0] = '\0';
+
+    struct DiffEntry *stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    struct DiffEntry entry = {{root1, root2}, {root1->labelLength, root2->labelLength}, 0, -1};
+    bool result = true;
+    while (result) {
+        if (entry.nodes[0] != entry.nodes[1] || entry.offsets[0] != entry.offsets[1]) {
+            result = visitDiff(&entry, num1, visit, context) && pushDiffs(&entry, &stack, &size, &capacity);
+        }
+        if (!result || size == 0) {
+            break;
+        }
+
+        entry = stack[--size];
+        if (!reserveChars(&num1, &capacity1, entry.depth + 1)) {
+            result = false;
+            break;
+        }
+        num1[entry.depth - 1] = DIGIT_CHARS[entry.digit];
+        num1[entry.depth] = '\0';
+    }
+
+    free(stack);
+    free(num1);
+    return result;
+}
+
+/**
+ * @struct StatsEntry
+ * @brief Node on the stack of @ref collectStats.
+ * @var StatsEntry::node
+ *      Pointer to the node.
+ * @var StatsEntry::depth
+ *      Number of the nodes on the route from the root to the node, not counting the node.
+ */
+struct StatsEntry {
+    DNode *node;
+    size_t depth;
+};
+
+static bool collectStats(DNode *root, PhoneForwardTreeStats *tree, PhoneForwardStats *stats, size_t *numbers);
+
+/**
+ * @brief Adds the memory taken by the value of the node to the statistics.
+ * @param [in] node - pointer to the node.
+ * @param [in, out] stats - pointer to the statistics.
+ * @param [in, out] numbers - pointer to the number of the numbers stored in the nodes of the tree.
+ * @return Value @p true if the value was described successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool collectValueStats(DNode *node, PhoneForwardStats *stats, size_t *numbers) {
+    size_t bucket = 0;
+    if (node->valueType == INLINE_NUMBER_VALUE) {
+        (*numbers)++;
+    } else if (node->valueType == HEAP_NUMBER_VALUE) {
+        (*numbers)++;
+    } else if (node->valueType == NUMBERS_VALUE) {
+        stats->numbersBytes += packedNumbersGetMemory(node->value.numbers);
+        bucket = packedNumbersGetSize(node->value.numbers);
+    } else if (node->valueType == SOURCE_TREE_VALUE &&
+               !collectStats(node->value.sources, NULL, stats, &bucket)) {
+        return false;
+    }
+
+    if (bucket > stats->largestReverseBucket) {
+        stats->largestReverseBucket = bucket;
+    }
+    return true;
+}
+
+/**
+ * @brief Adds the nodes of the tree to the statistics.
+ * The tree is walked in depth-first order with an explicit stack of nodes.
+ * @param [in] root - pointer to the root of the tree.
+ * @param [in, out] tree - pointer to the shape of the tree or NULL if the tree stores a set of numbers of the
+ *                         reverse tree.
+ * @param [in, out] stats - pointer to the statistics.
+ * @param [in, out] numbers - pointer to the number of the numbers stored in the nodes of the tree.
+ * @return Value @p true if the tree was described successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool collectStats(DNode *root, PhoneForwardTreeStats *tree, PhoneForwardStats *stats, size_t *numbers) {
+    size_t capacity = VISIT_STACK_SIZE;
+    struct StatsEntry *stack = malloc(capacity * sizeof(struct StatsEntry));
+    if (stack == NULL) {
+        return false;
+    }
+    size_t size = 0;
+    stack[size++] = (struct StatsEntry) {root, 0};
+
+    bool result = true;
+    while (size > 0) {
+        struct StatsEntry entry = stack[--size];
+        DNode *node = entry.node;
+        int count = numberOfChildren(node);
+
+        stats->nodeBytes += sizeof(DNode) + node->capacity * sizeof(DNode *);
+        if (tree == NULL) {
+            stats->sourceTreeNodes++;
+        } else {
+            tree->nodes++;
+            tree->depths[entry.depth < PHFWD_STATS_DEPTHS ? entry.depth : PHFWD_STATS_DEPTHS - 1]++;
+            tree->fanOuts[count]++;
+        }
+        if (!collectValueStats(node, stats, numbers)) {
+            result = false;
+            break;
+        }
+
+        if (size + count > capacity) {
+            struct StatsEntry *newStack = realloc(stack, 2 * capacity * sizeof(struct StatsEntry));
+            if (newStack == NULL) {
+                result = false;
+                break;
+            }
+            stack = newStack;
+            capacity *= 2;
+        }
+        for (int i = count - 1; i >= 0; i--) {
+            stack[size++] = (struct StatsEntry) {nodeGetChild(node, i), entry.depth + 1};
+        }
+    }
+
+    free(stack);
+    return result;
+}
+
+bool nodeTreeStats(DNode *root, PhoneForwardTreeStats *tree, PhoneForwardStats *stats) {
+    size_t numbers = 0;
+    return collectStats(root, tree, stats, &numbers);
+}
+
+void nodePoolStats(NodePool const *pool, PhoneForwardStats *stats) {
+    stats->stringBytes += numberTableGetMemory(pool->numbers);
+}
+
+/**
+ * @brief Obtains the node following the given one in the subtree in depth-first order.
+ * The way back up is found with the @p parent fields set on the way down, so the nodes are neither changed otherwise
+ * nor is any memory allocated, which lets the subtree be walked while the readers still use it.
+ * @param [in] root - pointer to the root of the subtree.
+ * @param [in] node - pointer to the current node of the subtree.
+ * @return Pointer to the next node or NULL if the whole subtree was walked.
+ */
+static DNode *nextInSubtree(DNode *root, DNode *node) {
+    if (node->mask != 0) {
+        DNode *child = nodeGetChild(node, 0);
+        child->parent = node;
+        return child;
+    }
+
+    while (node != root) {
+        DNode *parent = node->parent;
+        int index = 0;
+        while (nodeGetChild(parent, index) != node) {
+            index++;
+        }
+        if (index + 1 < numberOfChildren(parent)) {
+            DNode *sibling = nodeGetChild(parent, index + 1);
+            sibling->parent = parent;
+            return sibling;
+        }
+        node = parent;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Prepares the routes of the reverse tree leading to the numbers the subtree of a shared pool forwards to.
+ * Uses @ref prepareRoute for every number stored in the subtree, so that they can all be removed without allocating.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] reverseStart - pointer to the unpublished root of the reverse tree.
+ * @param [in] root - pointer to the root of the subtree of the forward tree.
+ * @param [in] prefix - the prefix of numbers that will be removed.
+ * @return Value @p true if the routes were prepared successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool prepareSubtreeReverse(NodePool *pool, DNode *reverseStart, DNode *root, char const *prefix) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    for (DNode *node = root; node != NULL; node = nextInSubtree(root, node)) {
+        PackedNumber const *packed = nodeGetNumber(node);
+        if (packed == NULL) {
+            continue;
+        }
+
+        char *target = unpackToBuffer(packed, buffer);
+        bool prepared = target != NULL && prepareRoute(pool, reverseStart, target, prefix);
+        releaseNumber(target, buffer);
+        if (!prepared) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the end of the route represented by the packed number.
+ * Works like @ref findRouteEnd for a number that has to contain the whole labels, but reads the digits of the number
+ * from its packed form, so that the numbers stored in the forward tree can be followed without unpacking them.
+ * @param [in] start - pointer to the start of the route.
+ * @param [in] num - pointer to the packed number that represents the route.
+ * @param [in, out] beforePointToRemove - pointer to the node the cut off route starts in.
+ * @param [in, out] pointToRemoveDigit - pointer to the digit of the cut off route.
+ * @param [in, out] lastPointToRemove - pointer to the first node of the cut off route.
+ * @return Pointer to the node at the end of the route or NULL if there is no such route.
+ */
+static DNode *findPackedRouteEnd(DNode *start, PackedNumber const *num, DNode **beforePointToRemove,
+                                 int *pointToRemoveDigit, DNode **lastPointToRemove) {
+    size_t len;
+    PackedNumber const *digits = packedDigits(num, &len);
+    DNode *node = start;
+    size_t i = 0;
+    *beforePointToRemove = start;
+    *pointToRemoveDigit = 0;
+    *lastPointToRemove = NULL;
+
+    while (i < len) {
+        int digit = packedDigit(digits, i);
+        DNode *next = nodeGetNext(node, digit);
+        if (next == NULL || next->labelLength > len - i - 1) {
+            return NULL;
+        }
+        for (size_t matched = 0; matched < next->labelLength; matched++) {
+            if (packedDigit(digits, i + 1 + matched) != labelDigit(next, matched)) {
+                return NULL;
+            }
+        }
+
+        if (node->valueType != NO_VALUE || numberOfChildren(node) > 1 || *lastPointToRemove == NULL) {
+            *beforePointToRemove = node;
+            *pointToRemoveDigit = digit;
+            *lastPointToRemove = next;
+        }
+        node = next;
+        i += 1 + next->labelLength;
+    }
+
+    return node;
+}
+
+/**
+ * @struct PendingBucket
+ * @brief Node of the reverse tree waiting for the numbers with the removed prefix to be removed from it.
+ * @var PendingBucket::node
+ *      Pointer to the node.
+ * @var PendingBucket::target
+ *      The packed number represented by the node, stored in the removed part of the forward tree.
+ */
+struct PendingBucket {
+    DNode *node;
+    PackedNumber const *target;
+};
+
+/**
+ * @struct ReverseCleanup
+ * @brief Nodes of the reverse tree that are cleaned together by @ref flushReverseCleanup.
+ * @var ReverseCleanup::buckets
+ *      Array of the nodes, each one is there at most once.
+ * @var ReverseCleanup::count
+ *      Number of the nodes in the array.
+ */
+struct ReverseCleanup {
+    struct PendingBucket buckets[CLEANUP_BATCH_SIZE];
+    size_t count;
+};
+
+/**
+ * @brief Removes the numbers with the prefix from all the nodes waiting in the batch.
+ * First the numbers are removed from every node, which doesn't change the reverse tree itself, and only then the
+ * routes of the nodes that were left without any numbers are pruned, each found again from the root, because pruning
+ * one route may merge or free the nodes of another.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] reverseStart - pointer to the root of the reverse tree.
+ * @param [in, out] cleanup - pointer to the batch, it is left empty.
+ * @param [in] prefix - the prefix of numbers we want to remove.
+ */
+static void flushReverseCleanup(NodePool *pool, DNode *reverseStart, struct ReverseCleanup *cleanup,
+                                char const *prefix) {
+    size_t emptied = 0;
+    for (size_t i = 0; i < cleanup->count; i++) {
+        DNode *node = cleanup->buckets[i].node;
+        node->flags &= (uint8_t) ~PENDING_CLEANUP;
+        bucketRemoveWithPrefix(pool, node, prefix);
+        if (node->valueType == NO_VALUE) {
+            cleanup->buckets[emptied++].target = cleanup->buckets[i].target;
+        }
+    }
+
+    for (size_t i = 0; i < emptied; i++) {
+        DNode *beforePointToRemove;
+        DNode *lastPointToRemove;
+        int pointToRemoveDigit;
+        DNode *node = findPackedRouteEnd(reverseStart, cleanup->buckets[i].target, &beforePointToRemove,
+                                         &pointToRemoveDigit, &lastPointToRemove);
+        if (node != NULL) {
+            pruneRoute(pool, reverseStart, node, beforePointToRemove, pointToRemoveDigit, lastPointToRemove);
+        }
+    }
+    cleanup->count = 0;
+}
+
+/**
+ * @brief Removes the numbers with the prefix from the reverse tree for all forwardings of the subtree.
+ * The node of the reverse tree of the number every forwarding of the subtree leads to is looked up from the root and
+ * marked with @ref PENDING_CLEANUP, so however many removed numbers of a batch are forwarded to it, its numbers are
+ * filtered only once per batch. The nodes are cleaned in batches of @ref CLEANUP_BATCH_SIZE, which don't need any
+ * memory to be allocated, and the mark is cleared with each batch, so a node can be filtered again by a later batch,
+ * which finds no numbers with the prefix left in it. The subtree has to be cut off from the forward tree already and
+ * is left intact, in a shared pool the routes have to be prepared with @ref prepareSubtreeReverse.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] reverseStart - pointer to the root of the reverse tree.
+ * @param [in] root - pointer to the root of the subtree of the forward tree.
+ * @param [in] prefix - the prefix of numbers we want to remove.
+ */
+static void removeSubtreeReverse(NodePool *pool, DNode *reverseStart, DNode *root, char const *prefix) {
+    struct ReverseCleanup cleanup;
+    cleanup.count = 0;
+
+    for (DNode *node = root; node != NULL; node = nextInSubtree(root, node)) {
+        PackedNumber const *target = nodeGetNumber(node);
+        if (target == NULL) {
+            continue;
+        }
+
+        DNode *beforePointToRemove;
+        DNode *lastPointToRemove;
+        int pointToRemoveDigit;
+        DNode *bucket = findPackedRouteEnd(reverseStart, target, &beforePointToRemove, &pointToRemoveDigit,
+                                           &lastPointToRemove);
+        if (bucket == NULL || (bucket->flags & PENDING_CLEANUP)) {
+            continue;
+        }
+
+        if (cleanup.count == CLEANUP_BATCH_SIZE) {
+            flushReverseCleanup(pool, reverseStart, &cleanup, prefix);
+            bucket = findPackedRouteEnd(reverseStart, target, &beforePointToRemove, &pointToRemoveDigit,
+                                        &lastPointToRemove);
+            if (bucket == NULL) {
+                continue;
+            }
+        }
+        bucket->flags |= PENDING_CLEANUP;
+        cleanup.buckets[cleanup.count++] = (struct PendingBucket) {bucket, target};
+    }
+
+    flushReverseCleanup(pool, reverseStart, &cleanup, prefix);
+}
+
+bool removeForwardWithPrefix(NodePool *pool, DNode *start, DNode *reverseStart, char const *prefix) {
+    if (!prepareRoute(pool, start, prefix, NULL)) {
+        return false;
+    }
+
+    DNode *beforePointToRemove;
+    DNode *lastPointToRemove;
+    int pointToRemoveDigit;
+    if (findRouteEnd(start, prefix, false, &beforePointToRemove, &pointToRemoveDigit, &lastPointToRemove) == NULL) {
+        return true;
+    }
+    if (pool->epoch != NULL && reverseStart != NULL &&
+        !prepareSubtreeReverse(pool, reverseStart, lastPointToRemove, prefix)) {
+        return false;
+    }
+
+    nodeSetNext(beforePointToRemove, pointToRemoveDigit, NULL);
+    if (reverseStart != NULL) {
+        removeSubtreeReverse(pool, reverseStart, lastPointToRemove, prefix);
+    }
+    releaseTree(pool, lastPointToRemove);
+    if (beforePointToRemove != start) {
+        mergeWithChild(pool, beforePointToRemove);
+    }
+    return true;
+}
+
+DNode *getEndNode(NodePool *pool, DNode *start, char const *num) {
+    if (!prepareRoute(pool, start, num, NULL)) {
         return NULL;
     }
 
-    node->numbers = NULL;
-    node->parent = NULL;
-    for (int i = 0; i < NUMBER_OF_DIGITS; ++i) {
-        node->next[i] = NULL;
+    DNode *node = start;
+    size_t i = 0;
+
+    while (isValidDigit(num[i])) {
+        int digit = toDecimalRepresentation(num[i]);
+        DNode *next = nodeGetNext(node, digit);
+
+        if (next == NULL) {
+            DNode *leaf = NULL;
+            DNode *route = newRoute(pool, num + i + 1, &leaf);
+            if (route == NULL || !nodeSetNext(node, digit, route)) {
+                deleteIterative(pool, route);
+                if (node != start) {
+                    mergeWithChild(pool, node);
+                }
+                return NULL;
+            }
+            return leaf;
+        }
+
+        size_t matched = matchLabel(next, num + i + 1);
+        if (matched < next->labelLength) {
+            next = splitEdge(pool, node, digit, next, matched);
+            if (next == NULL) {
+                return NULL;
+            }
+        }
+        node = next;
+        i += 1 + matched;
     }
 
     return node;
 }
 
-PhoneNumbers *nodeGetNumbers(DNode *node) {
-    return node->numbers;
+void removeEmptyRoute(NodePool *pool, DNode *start, char const *num) {
+    DNode *beforePointToRemove;
+    DNode *lastPointToRemove;
+    int pointToRemoveDigit;
+    DNode *node = findRouteEnd(start, num, true, &beforePointToRemove, &pointToRemoveDigit, &lastPointToRemove);
+    if (node != NULL) {
+        pruneRoute(pool, start, node, beforePointToRemove, pointToRemoveDigit, lastPointToRemove);
+    }
 }
 
-DNode *nodeGetNext(DNode *node, int digit) {
-    return node->next[digit];
+int numberOfChildren(DNode const *node) {
+    return countBits(node->mask);
 }
 
-void nodeSetNext(DNode *node, int digit, DNode *next) {
-    node->next[digit] = next;
-}
+bool overWriteForwarding(NodePool *pool, DNode *reverseStart, DNode *node, char const *num1, char const *num2) {
+    DNode forwarding;
+    forwarding.valueType = NO_VALUE;
+    if (!nodeSetNumber(pool, &forwarding, num2)) {
+        return false;
+    }
 
-void deleteIterative(DNode *node) {
-    DNode *current = node;
-    if (current == NULL) {
-        return;
+    PackedNumber const *overWritten = nodeGetNumber(node);
+    if (overWritten != NULL && reverseStart != NULL) {
+        char buffer[NUMBER_BUFFER_SIZE];
+        char *target = unpackToBuffer(overWritten, buffer);
+        if (target == NULL || !prepareRoute(pool, reverseStart, target, num1)) {
+            releaseNumber(target, buffer);
+            clearValue(pool, &forwarding);
+            return false;
+        }
+        removeReverse(pool, reverseStart, target, num1);
+        releaseNumber(target, buffer);
     }
-    current->parent = NULL;
+    releaseValue(pool, node);
 
-    while (current != NULL) {
-        bool hasChild = false;
+    node->value = forwarding.value;
+    node->valueType = forwarding.valueType;
+    markValueUnpublished(pool, node);
+    return true;
+}
 
-        for (int i = 0; i < NUMBER_OF_DIGITS; i++) {
-            if (current->next[i]) {
-                current = current->next[i];
-                hasChild = true;
-                break;
-            }
+bool removeForwarding(NodePool *pool, DNode *start, DNode *reverseStart, char const *num) {
+    if (getForwarding(start, num) == NULL) {
+        return true;
+    }
+    DNode *node = getEndNode(pool, start, num);
+    if (node == NULL) {
+        return false;
+    }
+
+    if (reverseStart != NULL) {
+        char buffer[NUMBER_BUFFER_SIZE];
+        char *target = unpackToBuffer(nodeGetNumber(node), buffer);
+        if (target == NULL || !prepareRoute(pool, reverseStart, target, num)) {
+            releaseNumber(target, buffer);
+            return false;
         }
+        removeReverse(pool, reverseStart, target, num);
+        releaseNumber(target, buffer);
+    }
+    releaseValue(pool, node);
+    removeEmptyRoute(pool, start, num);
+    return true;
+}
 
-        if (!hasChild) {
-            DNode *parent = current->parent;
-            if (parent == NULL) {
-                phnumDelete(current->numbers);
-                free(current);
-                break;
-            }
+PackedNumber const *getForwarding(DNode *start, char const *num) {
+    DNode *beforePointToRemove;
+    DNode *lastPointToRemove;
+    int pointToRemoveDigit;
+    DNode *node = findRouteEnd(start, num, true, &beforePointToRemove, &pointToRemoveDigit, &lastPointToRemove);
+    return node == NULL ? NULL : nodeGetNumber(node);
+}
 
-            for (int i = 0; i < NUMBER_OF_DIGITS; i++) {
-                if (parent->next[i] == current) {
-                    parent->next[i] = NULL;
-                    break;
-                }
-            }
+bool addReverse(NodePool *pool, DNode *node, char const *num) {
+    if (pool->epoch != NULL && (!epochReserve(pool->epoch, ROUTE_RETIREMENTS) || !prepareBucket(pool, node, num))) {
+        return false;
+    }
+    if (node->valueType == NUMBERS_VALUE && packedNumbersGetSize(node->value.numbers) >= SOURCE_TREE_THRESHOLD &&
+        !bucketToTree(pool, node)) {
+        return false;
+    }
+    if (node->valueType == SOURCE_TREE_VALUE) {
+        return sourceTreeAdd(pool, node->value.sources, num);
+    }
 
-            phnumDelete(current->numbers);
-            free(current);
-            current = parent;
-        }
+    if (node->valueType == NO_VALUE) {
+        node->value.numbers = NULL;
+    }
+    if (!packedNumbersAdd(&node->value.numbers, num)) {
+        return false;
     }
+    if (node->valueType == NO_VALUE) {
+        node->valueType = NUMBERS_VALUE;
+        markValueUnpublished(pool, node);
+    }
+    return true;
 }
 
-/**
- * @brief Removes numbers with certain prefix from the reverse trees.
- * This function will find the end of the route in the reverse tree, represented by the given number. Then it will
- * remove all the numbers that contain the given prefix from the vector. If there are no numbers left in the vector,
- * this function will delete all nodes down to the end of the route (starting from the point that can be safely
- * deleted).
- * @param [in] start - pointer to the start of the route.
- * @param [in] num - the number that represents the route.
- * @param [in] prefix - the prefix of numbers we want to remove.
- */
-static void removeReverseWithPrefix(DNode *start, char const *num, char const *prefix) {
+void removeReverse(NodePool *pool, DNode *start, char const *num1, char const *num2) {
+    DNode *beforePointToRemove;
+    DNode *lastPointToRemove;
+    int pointToRemoveDigit;
+    DNode *node = findRouteEnd(start, num1, true, &beforePointToRemove, &pointToRemoveDigit, &lastPointToRemove);
+    if (node == NULL) {
+        return;
+    }
+
+    bucketRemove(pool, node, num2);
+    pruneRoute(pool, start, node, beforePointToRemove, pointToRemoveDigit, lastPointToRemove);
+}
+
+size_t findPrefix(DNode *start, char const *num, PackedNumber const **maxForwardedPrefix,
+                  size_t *lenOfMaxOriginalPrefix) {
     DNode *node = start;
-    DNode *beforePointToRemove = start;
-    DNode *lastPointToRemove = NULL;
-    int pointToRemoveDigit = 0;
     size_t i = 0;
 
     while (isValidDigit(num[i])) {
-        int digit = toDecimalRepresentation(num[i]);
-        if (node->next[digit] == NULL) {
-            return;
-        }
-        if (node->numbers != NULL || numberOfChildren(node) > 1 || lastPointToRemove == NULL) {
-            beforePointToRemove = node;
-            pointToRemoveDigit = digit;
-            lastPointToRemove = node->next[digit];
+        node = followEdge(node, num, &i);
+        if (node == NULL) {
+            break;
         }
-        node = node->next[digit];
-        i++;
-    }
-
-    phnumRemoveWithPrefix(&node->numbers, prefix);
 
-    if (node->numbers == NULL && numberOfChildren(node) == 0) {
-        if (beforePointToRemove != NULL) {
-            beforePointToRemove->next[pointToRemoveDigit] = NULL;
+        PackedNumber const *target = nodeGetNumber(node);
+        if (target != NULL) {
+            (*maxForwardedPrefix) = target;
+            (*lenOfMaxOriginalPrefix) = i;
         }
-        deleteIterative(lastPointToRemove);
     }
+    return i;
 }
 
-void deleteIterativeWithReverse(DNode *deleteReverseStart, DNode *deleteForwardStart, char const *prefix) {
-    DNode *current = deleteForwardStart;
-    if (current == NULL) {
-        return;
-    }
-    current->parent = NULL;
-
-    while (current != NULL) {
-        bool hasChild = false;
+size_t findPrefixBatch(DNode *start, char const *const *nums, size_t count, PackedNumber const **maxForwardedPrefix,
+                       size_t *lenOfMaxOriginalPrefix) {
+    size_t walked = 0;
+    for (size_t first = 0; first < count; first += BATCH_LANES) {
+        size_t lanes = count - first < BATCH_LANES ? count - first : BATCH_LANES;
+        DNode *nodes[BATCH_LANES];
+        size_t positions[BATCH_LANES];
+        size_t active = 0;
 
-        for (int i = 0; i < NUMBER_OF_DIGITS; i++) {
-            if (current->next[i]) {
-                current = current->next[i];
-                hasChild = true;
-                break;
+        for (size_t lane = 0; lane < lanes; lane++) {
+            char const *num = nums[first + lane];
+            maxForwardedPrefix[first + lane] = NULL;
+            lenOfMaxOriginalPrefix[first + lane] = 0;
+            positions[lane] = 0;
+            nodes[lane] = num == NULL ? NULL : nodeGetNext(start, toDecimalRepresentation(num[0]));
+            if (nodes[lane] != NULL) {
+                PREFETCH(nodes[lane]);
+                active++;
             }
         }
 
-        if (!hasChild) {
-            DNode *parent = current->parent;
-            if (parent == NULL) {
-                if (current->numbers != NULL && phnumGetSize(current->numbers) > 0) {
-                    removeReverseWithPrefix(deleteReverseStart, phnumGet(current->numbers, 0), prefix);
+        while (active > 0) {
+            for (size_t lane = 0; lane < lanes; lane++) {
+                DNode *node = nodes[lane];
+                if (node == NULL) {
+                    continue;
                 }
-                phnumDelete(current->numbers);
-                free(current);
-                break;
-            }
 
-            for (int i = 0; i < NUMBER_OF_DIGITS; i++) {
-                if (parent->next[i] == current) {
-                    parent->next[i] = NULL;
-                    break;
+                char const *num = nums[first + lane];
+                size_t i = positions[lane];
+                DNode *next = NULL;
+                if (matchLabel(node, num + i + 1) == node->labelLength) {
+                    i += 1 + node->labelLength;
+
+                    PackedNumber const *target = nodeGetNumber(node);
+                    if (target != NULL) {
+                        maxForwardedPrefix[first + lane] = target;
+                        lenOfMaxOriginalPrefix[first + lane] = i;
+                    }
+
+                    if (isValidDigit(num[i])) {
+                        next = nodeGetNext(node, toDecimalRepresentation(num[i]));
+                    }
                 }
-            }
 
-            if (current->numbers != NULL && phnumGetSize(current->numbers) > 0) {
-                removeReverseWithPrefix(deleteReverseStart, phnumGet(current->numbers, 0), prefix);
+                if (next == NULL) {
+                    active--;
+                } else {
+                    PREFETCH(next);
+                }
+                nodes[lane] = next;
+                positions[lane] = i;
             }
-            phnumDelete(current->numbers);
-            free(current);
-            current = parent;
+        }
+
+        for (size_t lane = 0; lane < lanes; lane++) {
+            walked += positions[lane];
         }
     }
+    return walked;
+}
+
+bool addAllFromReverseTree(DNode *start, char const *num, PhoneNumbers *pnum) {
+    return addAllInverseFromReverseTree(start, NULL, num, pnum);
 }
 
-DNode *getEndNode(DNode *start, DNode **beforeFirstAddedPtr, DNode **firstAddedPtr, int *firstAddedDigit,
-                  char const *num) {
-    DNode *result = start;
-    DNode *beforeFirstAdded = *beforeFirstAddedPtr;
-    DNode *firstAdded = *firstAddedPtr;
+/**
+ * @brief Checks if the number built from the source and the suffix is forwarded to the given number.
+ * Follows the route of the concatenation of @p source and @p suffix in the forward tree, looking for its longest
+ * forwarded prefix, and compares the result of the forwarding with @p num without building any of the numbers.
+ * The route of @p source has to end in a node of the tree, which is true for every number forwarded in the tree and
+ * for the empty string.
+ * @param [in] start - pointer to the root of the forward tree.
+ * @param [in] source - the first part of the number.
+ * @param [in] suffix - the second part of the number.
+ * @param [in] num - the number to compare the result of the forwarding with.
+ * @return Value @p true if the number is forwarded to @p num.
+ *         Value @p false otherwise.
+ */
+static bool isForwardedTo(DNode *start, char const *source, char const *suffix, char const *num) {
+    PackedNumber const *maxForwardedPrefix = NULL;
+    size_t lenOfMaxOriginalPrefix = 0;
+    DNode *node = start;
     size_t i = 0;
 
-    while (isValidDigit(num[i])) {
-        int digit = toDecimalRepresentation(num[i]);
-        if (result->next[digit] == NULL) {
-            result->next[digit] = nodeNew();
-            if (result->next[digit] == NULL) {
-                if (beforeFirstAdded != NULL) {
-                    beforeFirstAdded->next[*firstAddedDigit] = NULL;
-                }
-                deleteIterative(firstAdded);
-                return NULL;
-            }
+    while (node != NULL && isValidDigit(source[i])) {
+        node = followEdge(node, source, &i);
+        if (node != NULL && nodeGetNumber(node) != NULL) {
+            maxForwardedPrefix = nodeGetNumber(node);
+            lenOfMaxOriginalPrefix = i;
+        }
+    }
 
-            result->next[digit]->parent = result;
-            if (firstAdded == NULL) {
-                beforeFirstAdded = result;
-                (*firstAddedDigit) = digit;
-                firstAdded = result->next[digit];
-            }
+    size_t sourceLength = i;
+    size_t j = 0;
+    while (node != NULL && isValidDigit(suffix[j])) {
+        node = followEdge(node, suffix, &j);
+        if (node != NULL && nodeGetNumber(node) != NULL) {
+            maxForwardedPrefix = nodeGetNumber(node);
+            lenOfMaxOriginalPrefix = sourceLength + j;
         }
-        result = result->next[digit];
-        i++;
     }
 
-    *beforeFirstAddedPtr = beforeFirstAdded;
-    *firstAddedPtr = firstAdded;
-    return result;
+    return arePackedPartsEqual(source, suffix, maxForwardedPrefix, lenOfMaxOriginalPrefix, num);
 }
 
-int numberOfChildren(DNode const *node) {
-    int sum = 0;
-    for (int i = 0; i < NUMBER_OF_DIGITS; i++) {
-        if (node->next[i] != NULL) {
-            sum++;
-        }
+/**
+ * @struct ReverseQuery
+ * @brief Context of the visiting of the numbers of the reverse tree by @ref addSource.
+ * @var ReverseQuery::forwardStart
+ *      Pointer to the root of the forward tree or NULL if the numbers aren't checked.
+ * @var ReverseQuery::num
+ *      The number the reverse forwarding is searched for.
+ * @var ReverseQuery::prefixLength
+ *      Length of the prefix of @p num represented by the node of the reverse tree.
+ * @var ReverseQuery::pnum
+ *      The vector to add the numbers to.
+ */
+struct ReverseQuery {
+    DNode *forwardStart;
+    char const *num;
+    size_t prefixLength;
+    PhoneNumbers *pnum;
+};
+
+/**
+ * @brief Adds the number built from the source and the rest of the searched number.
+ * If the root of the forward tree is given, the number is added only if it is really forwarded to the searched number.
+ * @param [in] source - the number forwarded to the prefix of the searched number.
+ * @param [in, out] context - pointer to the @ref ReverseQuery.
+ * @return Value @p true if the number was added successfully or skipped.
+ *         Value @p false if there was an allocation error.
+ */
+static bool addSource(char const *source, void *context) {
+    struct ReverseQuery *query = context;
+    char const *suffix = query->num + query->prefixLength;
+    if (query->forwardStart != NULL && !isForwardedTo(query->forwardStart, source, suffix, query->num)) {
+        return true;
     }
-    return sum;
-}
 
-bool overWriteForwarding(DNode *node, DNode *beforeFirstAdded, DNode *firstAdded, int firstAddedDigit, char const *num,
-                         char **overWritten) {
     char *result = NULL;
-    result = malloc(sizeof(char) * (length(num) + 1));
-    if (result == NULL) {
-        if (beforeFirstAdded != NULL) {
-            beforeFirstAdded->next[firstAddedDigit] = NULL;
-        }
-        deleteIterative(firstAdded);
+    if (!copyParts(query->num, source, query->prefixLength, &result)) {
+        return false;
+    }
+    if (!phnumAdd(query->pnum, &result)) {
+        free(result);
         return false;
     }
+    return true;
+}
+
+bool addAllInverseFromReverseTree(DNode *start, DNode *forwardStart, char const *num, PhoneNumbers *pnum) {
+    struct ReverseQuery query = {forwardStart, num, 0, pnum};
+    DNode *node = start;
     size_t i = 0;
 
     while (isValidDigit(num[i])) {
-        result[i] = num[i];
-        i++;
-    }
-    result[i] = '\0';
+        node = followEdge(node, num, &i);
+        if (node == NULL) {
+            break;
+        }
 
-    if (node->numbers != NULL && phnumGetSize(node->numbers) > 0 &&
-        !copyNumber(phnumGet(node->numbers, 0), overWritten)) {
-        if (beforeFirstAdded != NULL) {
-            beforeFirstAdded->next[firstAddedDigit] = NULL;
+        query.prefixLength = i;
+        if (!nodeVisitNumbers(node, addSource, &query)) {
+            return false;
         }
-        deleteIterative(firstAdded);
-        free(result);
-        return false;
     }
 
-    phnumDelete(node->numbers);
-
-    node->numbers = phnumNew();
-    if (node->numbers == NULL || !phnumAdd(node->numbers, &result)) {
-        if (beforeFirstAdded != NULL) {
-            beforeFirstAdded->next[firstAddedDigit] = NULL;
+    if (forwardStart == NULL || isForwardedTo(forwardStart, "", num, num)) {
+        char *numCopy = NULL;
+        if (!copyNumber(num, &numCopy)) {
+            return false;
+        }
+        if (!phnumAdd(pnum, &numCopy)) {
+            free(numCopy);
+            return false;
         }
-        deleteIterative(firstAdded);
-        free(*overWritten);
-        *overWritten = NULL;
-        free(result);
-        return false;
     }
+
     return true;
 }
 
-bool addReverse(DNode *node, DNode *beforeFirstAdded, DNode *firstAdded, int firstAddedDigit, char const *num) {
-    char *result = NULL;
-    result = malloc(sizeof(char) * (length(num) + 1));
-    if (result == NULL) {
-        if (beforeFirstAdded != NULL) {
-            beforeFirstAdded->next[firstAddedDigit] = NULL;
+DNode *nodeNextReverse(DNode *node, char const *num, size_t *index) {
+    while (node != NULL && isValidDigit(num[*index])) {
+        node = followEdge(node, num, index);
+        if (node != NULL && (node->valueType == NUMBERS_VALUE || node->valueType == SOURCE_TREE_VALUE)) {
+            return node;
         }
-        deleteIterative(firstAdded);
-        return false;
     }
-    size_t i = 0;
+    return NULL;
+}
 
-    while (isValidDigit(num[i])) {
-        result[i] = num[i];
-        i++;
+/**
+ * @brief Finds the first number stored in the subtree of the tree of numbers.
+ * Every leaf of a tree of numbers stores a number, so the first one is found by following the first children.
+ * @param [in] node - pointer to the root of the subtree.
+ * @return Pointer to the number or NULL if the subtree doesn't store any.
+ */
+static PackedNumber const *firstTreeSource(DNode *node) {
+    while (nodeGetNumber(node) == NULL && numberOfChildren(node) > 0) {
+        node = nodeGetChild(node, 0);
     }
-    result[i] = '\0';
+    return nodeGetNumber(node);
+}
 
-    if (node->numbers == NULL) {
-        node->numbers = phnumNew();
-        if (node->numbers == NULL) {
-            if (beforeFirstAdded != NULL) {
-                beforeFirstAdded->next[firstAddedDigit] = NULL;
-            }
-            deleteIterative(firstAdded);
-            free(result);
-            return false;
+/**
+ * @brief Obtains the number following the given one in the tree of numbers.
+ * Follows the route of the current number, remembering the deepest subtree on its right side. The next number is the
+ * first one among the children of the current number or, if it has no children, in that subtree.
+ * @param [in] root - pointer to the root of the tree of numbers.
+ * @param [in] current - pointer to the current number, it has to be stored in the tree.
+ * @return Pointer to the next number or NULL if there is none.
+ */
+static PackedNumber const *nextTreeSource(DNode *root, PackedNumber const *current) {
+    size_t len;
+    PackedNumber const *digits = packedDigits(current, &len);
+    DNode *node = root;
+    DNode *following = NULL;
+    size_t i = 0;
+
+    while (i < len) {
+        int digit = packedDigit(digits, i);
+        uint16_t notAbove = (uint16_t) ((2u << digit) - 1);
+        if ((node->mask & ~notAbove) != 0) {
+            following = nodeGetChild(node, countBits(node->mask & notAbove));
+        }
+        node = nodeGetNext(node, digit);
+        if (node == NULL) {
+            return NULL;
         }
+        i += 1 + node->labelLength;
     }
 
-    if (!phnumAdd(node->numbers, &result)) {
-        if (beforeFirstAdded != NULL) {
-            beforeFirstAdded->next[firstAddedDigit] = NULL;
+    if (numberOfChildren(node) > 0) {
+        following = nodeGetChild(node, 0);
+    }
+    return following == NULL ? NULL : firstTreeSource(following);
+}
+
+PackedNumber const *nodeNextSource(DNode *node, PackedNumber const *current) {
+    if (node->valueType == NUMBERS_VALUE) {
+        return packedNumbersNext(node->value.numbers, current);
+    }
+    if (node->valueType == SOURCE_TREE_VALUE) {
+        return current == NULL ? firstTreeSource(node->value.sources) : nextTreeSource(node->value.sources, current);
+    }
+    return NULL;
+}
+
+bool nodeHasSource(DNode *node, PackedNumber const *number, size_t len) {
+    if (node->valueType == NUMBERS_VALUE) {
+        PackedNumbers *numbers = node->value.numbers;
+        for (PackedNumber const *packed = packedNumbersNext(numbers, NULL); packed != NULL;
+             packed = packedNumbersNext(numbers, packed)) {
+            int comparison = comparePackedPrefix(packed, number, len);
+            if (comparison >= 0) {
+                return comparison == 0;
+            }
         }
-        deleteIterative(firstAdded);
-        free(result);
         return false;
     }
-    return true;
-}
+    if (node->valueType != SOURCE_TREE_VALUE) {
+        return false;
+    }
 
-void removeReverse(DNode *start, char const *num1, char const *num2) {
-    DNode *node = start;
-    DNode *beforePointToRemove = start;
-    DNode *lastPointToRemove = NULL;
-    int pointToRemoveDigit = 0;
+    size_t numberLength;
+    PackedNumber const *digits = packedDigits(number, &numberLength);
+    DNode *current = node->value.sources;
     size_t i = 0;
-
-    while (isValidDigit(num1[i])) {
-        int digit = toDecimalRepresentation(num1[i]);
-        if (node->next[digit] == NULL) {
-            return;
+    while (i < len) {
+        current = nodeGetNext(current, packedDigit(digits, i++));
+        if (current == NULL) {
+            return false;
         }
-        if (node->numbers != NULL || numberOfChildren(node) > 1 || lastPointToRemove == NULL) {
-            beforePointToRemove = node;
-            pointToRemoveDigit = digit;
-            lastPointToRemove = node->next[digit];
+        for (size_t matched = 0; matched < current->labelLength; matched++, i++) {
+            if (i == len || packedDigit(digits, i) != labelDigit(current, matched)) {
+                return false;
+            }
         }
-        node = node->next[digit];
-        i++;
     }
+    return nodeGetNumber(current) != NULL;
+}
+
+/**
+ * @brief Function storing the value of the node created by @ref buildSorted.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node representing the key.
+ * @param [in] first - index of the first entry with the key.
+ * @param [in] count - number of consecutive entries with the key.
+ * @param [in, out] context - pointer passed to @ref buildSorted.
+ * @return Value @p true if the value was stored successfully.
+ *         Value @p false if there was an allocation error.
+ */
+typedef bool (*ValueBuilder)(NodePool *pool, DNode *node, size_t first, size_t count, void *context);
 
-    phnumRemove(&node->numbers, num2);
+/**
+ * @struct BuildEntry
+ * @brief Node on the rightmost route of the tree being built by @ref buildSorted.
+ * @var BuildEntry::node
+ *      Pointer to the node.
+ * @var BuildEntry::depth
+ *      Number of digits on the route from the root to the node, including its label.
+ */
+struct BuildEntry {
+    DNode *node;
+    size_t depth;
+};
 
-    if (node->numbers == NULL) {
-        if (beforePointToRemove != NULL) {
-            beforePointToRemove->next[pointToRemoveDigit] = NULL;
+/**
+ * @brief Pushes the node on the stack of @ref buildSorted.
+ * @param [in, out] stackPtr - pointer to the stack.
+ * @param [in, out] size - pointer to the number of entries on the stack.
+ * @param [in, out] capacity - pointer to the number of entries the stack has memory for.
+ * @param [in] node - pointer to the node.
+ * @param [in] depth - number of digits on the route from the root to the node.
+ * @return Value @p true if the node was pushed successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool pushBuildEntry(struct BuildEntry **stackPtr, size_t *size, size_t *capacity, DNode *node, size_t depth) {
+    if (*size == *capacity) {
+        struct BuildEntry *stack = realloc(*stackPtr, 2 * *capacity * sizeof(struct BuildEntry));
+        if (stack == NULL) {
+            return false;
         }
-        deleteIterative(lastPointToRemove);
+        *stackPtr = stack;
+        *capacity *= 2;
     }
+
+    (*stackPtr)[(*size)++] = (struct BuildEntry) {node, depth};
+    return true;
 }
 
-void findPrefix(DNode *start, char const *num, char const **maxForwardedPrefix, size_t *lenOfMaxOriginalPrefix) {
-    DNode *node = start;
+/**
+ * @brief Counts the common first digits of two numbers.
+ * @param [in] num1 - first number.
+ * @param [in] num2 - second number.
+ * @return The length of the longest common prefix of the numbers.
+ */
+static size_t commonPrefixLength(char const *num1, char const *num2) {
     size_t i = 0;
+    while (isValidDigit(num1[i]) && num1[i] == num2[i]) {
+        i++;
+    }
+    return i;
+}
 
-    while (isValidDigit(num[i])) {
-        int digit = toDecimalRepresentation(num[i]);
+/**
+ * @brief Builds the tree from sorted keys.
+ * The keys are added in order, each one below the rightmost route of the tree, which is kept on a stack. The route
+ * of a key only has to be cut back to its longest common prefix with the previous key, splitting an edge if that
+ * prefix ends inside of it, before the rest of the key is appended, so the nodes are never searched for from the
+ * root. Consecutive equal keys are represented by a single node.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] root - pointer to the root of the empty tree.
+ * @param [in] keys - array of the non-empty keys, sorted according to @ref compareNumbers.
+ * @param [in] count - number of the keys.
+ * @param [in] build - the function storing the value of the node of every key.
+ * @param [in, out] context - pointer passed to @p build.
+ * @return Value @p true if the tree was built successfully.
+ *         Value @p false if there was an allocation error or the keys aren't sorted.
+ */
+static bool buildSorted(NodePool *pool, DNode *root, char const *const *keys, size_t count, ValueBuilder build,
+                        void *context) {
+    size_t capacity = FIRST_BUILD_STACK_CAPACITY;
+    struct BuildEntry *stack = malloc(capacity * sizeof(struct BuildEntry));
+    if (stack == NULL) {
+        return false;
+    }
+    size_t size = 0;
+    stack[size++] = (struct BuildEntry) {root, 0};
+
+    bool result = true;
+    size_t first = 0;
+    while (result && first < count) {
+        char const *key = keys[first];
+        size_t end = first + 1;
+        while (end < count && areEqual(keys[end], key)) {
+            end++;
+        }
+
+        size_t common = first == 0 ? 0 : commonPrefixLength(keys[first - 1], key);
+        DNode *popped = NULL;
+        while (stack[size - 1].depth > common) {
+            popped = stack[--size].node;
+        }
 
-        if (node->next[digit] == NULL) {
+        DNode *parent = stack[size - 1].node;
+        size_t depth = stack[size - 1].depth;
+        if (depth < common) {
+            int digit = toDecimalRepresentation(keys[first - 1][depth]);
+            parent = splitEdge(pool, parent, digit, popped, common - depth - 1);
+            if (parent == NULL || !pushBuildEntry(&stack, &size, &capacity, parent, common)) {
+                result = false;
+                break;
+            }
+        }
+        if (!isValidDigit(key[common])) {
+            result = false;
             break;
         }
 
-        node = node->next[digit];
-        i++;
+        DNode *leaf = NULL;
+        DNode *route = newRoute(pool, key + common + 1, &leaf);
+        if (route == NULL || !nodeSetNext(parent, toDecimalRepresentation(key[common]), route)) {
+            deleteIterative(pool, route);
+            result = false;
+            break;
+        }
 
-        if (node->numbers != NULL && phnumGetSize(node->numbers) > 0) {
-            (*maxForwardedPrefix) = phnumGet(node->numbers, 0);
-            (*lenOfMaxOriginalPrefix) = i;
+        DNode *node = route;
+        depth = common + 1 + node->labelLength;
+        while (result) {
+            result = pushBuildEntry(&stack, &size, &capacity, node, depth);
+            if (node == leaf) {
+                break;
+            }
+            node = node->next.child;
+            depth += 1 + node->labelLength;
         }
+
+        result = result && build(pool, leaf, first, end - first, context);
+        first = end;
     }
+
+    free(stack);
+    return result;
 }
 
-bool addAllFromReverseTree(DNode *start, char const *num, PhoneNumbers *pnum) {
-    DNode *node = start;
-    size_t i = 0;
+/**
+ * @brief Stores the key itself in the node of the tree of numbers.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node representing the key.
+ * @param [in] first - index of the key.
+ * @param [in] count - number of consecutive entries with the key.
+ * @param [in, out] context - the array of the keys.
+ * @return Value @p true if the number was stored successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool buildSourceNumber(NodePool *pool, DNode *node, size_t first, size_t count, void *context) {
+    (void) count;
+    char const *const *sources = context;
+    return nodeSetNumber(pool, node, sources[first]);
+}
 
-    while (isValidDigit(num[i])) {
-        int digit = toDecimalRepresentation(num[i]);
+/**
+ * @brief Stores the forwarded number in the node of the forward tree.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node representing the forwarded number.
+ * @param [in] first - index of the forwarding.
+ * @param [in] count - number of consecutive forwardings of the number, the last one is stored.
+ * @param [in, out] context - the array of the numbers the keys are forwarded to.
+ * @return Value @p true if the number was stored successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool buildForwarding(NodePool *pool, DNode *node, size_t first, size_t count, void *context) {
+    char const *const *targets = context;
+    return nodeSetNumber(pool, node, targets[first + count - 1]);
+}
 
-        if (node->next[digit] == NULL) {
-            break;
-        } else if (node->next[digit]->numbers != NULL) {
-            if (!phnumAddAllCopiedParts(node->next[digit]->numbers, pnum, num, i + 1)) {
-                return false;
-            }
+/**
+ * @brief Stores the numbers forwarded to the key in the node of the reverse tree.
+ * Short groups are stored in a sequence allocated once for the whole group, longer ones are stored in a tree of numbers
+ * built with @ref buildSorted.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node representing the key.
+ * @param [in] first - index of the first number forwarded to the key.
+ * @param [in] count - number of the numbers forwarded to the key.
+ * @param [in, out] context - the array of the numbers forwarded to the keys, sorted for each key.
+ * @return Value @p true if the numbers were stored successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool buildReverseBucket(NodePool *pool, DNode *node, size_t first, size_t count, void *context) {
+    char const *const *sources = context;
+    if (count >= SOURCE_TREE_THRESHOLD) {
+        DNode *root = nodeNew(pool);
+        if (root == NULL) {
+            return false;
         }
-
-        node = node->next[digit];
-        i++;
+        node->value.sources = root;
+        node->valueType = SOURCE_TREE_VALUE;
+        return buildSorted(pool, root, sources + first, count, buildSourceNumber, (void *) (sources + first));
     }
 
-    char *numCopy = NULL;
-    if (!copyNumber(num, &numCopy)) {
-        return false;
+    size_t bytes = 0;
+    for (size_t i = first; i < first + count; i++) {
+        bytes += packedSize(length(sources[i]));
     }
-    if (!phnumAdd(pnum, &numCopy)) {
-        free(numCopy);
+    node->value.numbers = NULL;
+    if (!packedNumbersReserve(&node->value.numbers, bytes)) {
         return false;
     }
+    node->valueType = NUMBERS_VALUE;
 
+    for (size_t i = first; i < first + count; i++) {
+        if (!packedNumbersAdd(&node->value.numbers, sources[i])) {
+            return false;
+        }
+    }
     return true;
-}
\ No newline at end of file
+}
+
+bool buildForwardTree(NodePool *pool, DNode *root, char const *const *nums1, char const *const *nums2, size_t count) {
+    return buildSorted(pool, root, nums1, count, buildForwarding, (void *) nums2);
+}
+
+bool buildReverseTree(NodePool *pool, DNode *root, char const *const *targets, char const *const *sources,
+                      size_t count) {
+    return buildSorted(pool, root, targets, count, buildReverseBucket, (void *) sources);
+}
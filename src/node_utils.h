@@ -11,6 +11,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "counters.h"
+#include "epoch.h"
+#include "packed_number.h"
+#include "phone_forward.h"
 #include "phone_numbers.h"
 
 /**
@@ -19,19 +24,233 @@
 struct Node;
 typedef struct Node DNode; /**< Node of the forwarding tree. */
 
+/**
+ * This is a structure storing the memory the nodes are allocated from.
+ */
+struct NodePool;
+typedef struct NodePool NodePool; /**< Pool of the nodes. */
+
+/**
+ * @brief Creates a new pool of nodes.
+ * Creates an empty pool, the memory for the nodes is allocated in chunks when they are needed.
+ *
+ * The trees of a shared pool can be read by concurrent readers while one writer changes them. The writer doesn't
+ * change the nodes the readers could have seen: every node on the changed routes is copied first, the changes are
+ * made to the unpublished copies and the replaced nodes, values and cut off subtrees are retired to the epoch domain
+ * of the pool, to be freed once the readers are done with them. A write starts with copying the roots with
+ * @ref nodeWritable and ends with @ref nodePoolPublish, after the new roots were made visible to the readers.
+ * @param [in] shared - whether the trees of the pool will be shared with concurrent readers.
+ * @return Pointer to the new pool or NULL if there was an allocation error.
+ */
+NodePool *nodePoolNew(bool shared);
+
+/**
+ * @brief Deletes the pool of nodes.
+ * Releases all the chunks of the pool at once, together with the numbers stored in the nodes that are still
+ * in use, so that the trees do not have to be traversed. Does nothing when the pointer is NULL.
+ * @param [in] pool - pointer to the pool to be deleted.
+ */
+void nodePoolDelete(NodePool *pool);
+
 /**
  * @brief Creates a new Node.
- * Allocates memory for the node and initializes it.
+ * Obtains memory for the node from the given pool and initializes it.
+ * @param [in, out] pool - pointer to the pool the node is allocated from.
  * @return Pointer to the new node or NULL if there was an allocation error.
  */
-DNode *nodeNew(void);
+DNode *nodeNew(NodePool *pool);
+
+/**
+ * @brief Obtains the version of the node that can be changed in place.
+ * If the pool is shared and the node could have been seen by the readers, it is replaced by an unpublished copy
+ * and retired. The copy takes over the value and the children of the node, but the caller has to make the parent of
+ * the node (or the structure holding the root) point to it. A node that is also a part of other trees is left to them
+ * instead, the copy shares its children and numbers with it.
+ * @param [in, out] pool - pointer to the pool the node is allocated from.
+ * @param [in, out] node - pointer to the node.
+ * @return Pointer to the node or to its copy or NULL if there was an allocation error.
+ */
+DNode *nodeWritable(NodePool *pool, DNode *node);
+
+/**
+ * @brief Takes one more reference to the node.
+ * The trees of the structures cloned from each other share their nodes, each node is freed by @ref deleteIterative
+ * once all the trees and the structures holding it let it go.
+ * @param [in, out] node - pointer to the node.
+ */
+void nodeRetain(DNode *node);
+
+/**
+ * @brief Locks the mutex serializing the writes of all the structures using the pool.
+ * @param [in, out] pool - pointer to the pool.
+ */
+void nodePoolLock(NodePool *pool);
+
+/**
+ * @brief Unlocks the mutex locked by @ref nodePoolLock.
+ * @param [in, out] pool - pointer to the pool.
+ */
+void nodePoolUnlock(NodePool *pool);
+
+/**
+ * @brief Lets one more structure use the pool.
+ * The pool becomes shared if it wasn't, so that the writes of each structure copy the nodes instead of changing the
+ * ones the other structures hold. Has to be called with the mutex of the pool locked.
+ * @param [in, out] pool - pointer to the pool.
+ * @return Value @p true if the pool can be used by one more structure.
+ *         Value @p false if there was an allocation error.
+ */
+bool nodePoolShare(NodePool *pool);
+
+/**
+ * @brief Stops one of the structures using the pool.
+ * The trees of the structure are retired or, if it was the last one, the whole pool is deleted.
+ * @param [in, out] pool - pointer to the pool.
+ * @param [in, out] root - pointer to the root of the forward tree of the structure.
+ * @param [in, out] reverseRoot - pointer to the root of its reverse tree or NULL if it isn't kept.
+ */
+void nodePoolLeave(NodePool *pool, DNode *root, DNode *reverseRoot);
+
+/**
+ * @brief Makes the pool count the nodes it allocates and frees.
+ * @param [in, out] pool - pointer to the pool.
+ * @param [in] counters - pointer to the counters or NULL if the nodes shouldn't be counted.
+ */
+void nodePoolSetCounters(NodePool *pool, OperationCounters *counters);
+
+/**
+ * @brief Obtains the epoch domain of the shared pool.
+ * Readers have to enter the domain before reading the trees and the memory of the writer that has to outlive them
+ * can be retired to it.
+ * @param [in] pool - pointer to the pool.
+ * @return Pointer to the domain or NULL if the pool isn't shared.
+ */
+EpochDomain *nodePoolGetEpoch(NodePool const *pool);
+
+/**
+ * @brief Ends the write of the shared pool.
+ * Marks the nodes created by the write as seen by the readers and frees the retired memory no reader can see
+ * anymore. It has to be called after the new roots were made visible. Does nothing if the pool isn't shared.
+ * @param [in, out] pool - pointer to the pool.
+ */
+void nodePoolPublish(NodePool *pool);
 
 /**
- * @brief Obtains the vector of phone numbers from the node.
+ * @brief Obtains the number stored in the node.
+ * For the forward tree it is the number the route to the node is forwarded to.
  * @param [in] node - pointer to the node.
- * @return The vector of phone numbers stored in the node.
+ * @return Pointer to the packed number or NULL if the node doesn't store it.
+ */
+PackedNumber const *nodeGetNumber(DNode const *node);
+
+/**
+ * @brief Function called for every visited number.
+ * @param [in] number - the visited number.
+ * @param [in, out] context - pointer passed to the function visiting the numbers.
+ * @return Value @p true if the visiting should continue.
+ *         Value @p false if it should stop.
+ */
+typedef bool (*NumberVisitor)(char const *number, void *context);
+
+/**
+ * @brief Visits all numbers stored in the node of the reverse tree.
+ * @param [in] node - pointer to the node.
+ * @param [in] visit - the function called for every number.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if all numbers were visited.
+ *         Value @p false if @p visit stopped the visiting or there was an allocation error.
+ */
+bool nodeVisitNumbers(DNode *node, NumberVisitor visit, void *context);
+
+/**
+ * @brief Function called for every visited phone forwarding.
+ * @param [in] num1 - the forwarded number.
+ * @param [in] num2 - the number @p num1 is forwarded to.
+ * @param [in, out] context - pointer passed to the function visiting the forwardings.
+ * @return Value @p true if the visiting should continue.
+ *         Value @p false if it should stop.
+ */
+typedef bool (*ForwardingVisitor)(char const *num1, char const *num2, void *context);
+
+/**
+ * @brief Visits the phone forwardings of the numbers starting with the prefix stored in the forward tree.
+ * The tree is walked in depth-first order from the node of the prefix with an explicit stack, the forwarded numbers
+ * are built from the labels on the way and visited in the order of @ref compareNumbers. Both numbers are valid only
+ * during the call. The nodes aren't changed, so the tree can be walked while it is being read.
+ * @param [in] root - pointer to the root of the forward tree.
+ * @param [in] prefix - the prefix of the visited forwarded numbers, it has to be valid or empty.
+ * @param [in] visit - the function called for every forwarding.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if all the forwardings were visited.
+ *         Value @p false if there was an allocation error or @p visit stopped the visiting.
+ */
+bool nodeVisitForwardings(DNode *root, char const *prefix, ForwardingVisitor visit, void *context);
+
+/**
+ * @brief Function called for every difference between two forward trees.
+ * @param [in] num1 - the forwarded number.
+ * @param [in] before - the number @p num1 is forwarded to in the first tree or NULL if it isn't forwarded there.
+ * @param [in] after - the number @p num1 is forwarded to in the second tree or NULL if it isn't forwarded there.
+ * @param [in, out] context - pointer passed to the function comparing the trees.
+ * @return Value @p true if the comparing should continue.
+ *         Value @p false if it should stop.
  */
-PhoneNumbers *nodeGetNumbers(DNode *node);
+typedef bool (*ForwardingDiffVisitor)(char const *num1, char const *before, char const *after, void *context);
+
+/**
+ * @brief Visits the phone forwardings that differ between two forward trees.
+ * Both trees are walked in lock-step with an explicit stack, following the same digits in both of them, and the
+ * numbers are visited in the order of @ref compareNumbers. A node that both trees share, like the trees of the
+ * structures cloned from each other do, is skipped with its whole subtree, so comparing a tree with its slightly
+ * changed copy only walks the routes that were changed. The nodes aren't changed, so the trees can be compared while
+ * they are being read.
+ * @param [in] root1 - pointer to the root of the first forward tree.
+ * @param [in] root2 - pointer to the root of the second forward tree.
+ * @param [in] visit - the function called for every difference.
+ * @param [in, out] context - pointer passed to @p visit.
+ * @return Value @p true if all the differences were visited.
+ *         Value @p false if there was an allocation error or @p visit stopped the visiting.
+ */
+bool nodeDiffForwardings(DNode *root1, DNode *root2, ForwardingDiffVisitor visit, void *context);
+
+/**
+ * @brief Describes the tree.
+ * Adds the nodes of the tree to @p tree and the memory they take, including their values, to @p stats. The trees
+ * storing the sets of numbers of the reverse tree are walked too and the largest set is remembered. The nodes aren't
+ * changed, so the tree can be described while it is being read.
+ * @param [in] root - pointer to the root of the tree.
+ * @param [in, out] tree - pointer to the shape of the tree.
+ * @param [in, out] stats - pointer to the statistics.
+ * @return Value @p true if the tree was described successfully.
+ *         Value @p false if there was an allocation error.
+ */
+bool nodeTreeStats(DNode *root, PhoneForwardTreeStats *tree, PhoneForwardStats *stats);
+
+/**
+ * @brief Describes the numbers shared through the pool.
+ * Adds the memory taken by the numbers too long to be stored in the nodes to @p stats, counting each of them once.
+ * The pool isn't changed, so it can be described while the trees are being read.
+ * @param [in] pool - pointer to the pool.
+ * @param [in, out] stats - pointer to the statistics.
+ */
+void nodePoolStats(NodePool const *pool, PhoneForwardStats *stats);
+
+/**
+ * @brief Counts the set bits.
+ * @param [in] mask - the bitmap of digits.
+ * @return The number of set bits in the bitmap.
+ */
+int countBits(uint16_t mask);
+
+/**
+ * @brief Obtains the label of the node.
+ * The label holds the digits of the edge leading to the node that follow the digit the node is indexed with in its
+ * parent. Each digit takes 4 bits, the first one is stored in the least significant bits.
+ * @param [in] node - pointer to the node.
+ * @param [out] labelLength - pointer to the number of digits of the label.
+ * @return The digits of the label.
+ */
+uint64_t nodeGetLabel(DNode const *node, size_t *labelLength);
 
 /**
  * @brief Obtains the next node in the tree.
@@ -44,46 +263,64 @@ DNode *nodeGetNext(DNode *node, int digit);
 
 /**
  * @brief Sets the next node in the tree.
- * Sets the pointer to the next node at the given index.
+ * Sets the pointer to the next node at the given index. The array of children is grown if needed, setting the next
+ * node to NULL removes the child and never fails.
  * @param [in] node - pointer to the node we want to set the next node for.
  * @param [in] digit - the index of the next node.
  * @param [in] next - pointer to node we want to set as the next node.
+ * @return Value @p true if the next node was set successfully.
+ *         Value @p false if there was an allocation error.
  */
-void nodeSetNext(DNode *node, int digit, DNode *next);
+bool nodeSetNext(DNode *node, int digit, DNode *next);
 
 /**
  * @brief Deletes the nodes in phone forwarding tree.
  * Starting from the given Node and going down the tree, deletes all the nodes in the tree under the given node and the
- * node itself.
+ * node itself. The nodes are returned to the given pool. A node still held by other trees only loses one reference
+ * and its subtree is left intact.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
  * @param [in, out] node - pointer to the node we want to start deleting from.
  */
-void deleteIterative(DNode *node);
+void deleteIterative(NodePool *pool, DNode *node);
 
 /**
- * @brief Removes nodes from the forward tree and numbers with certain prefix from the reverse tree.
- * This function will delete all the nodes under the given node and if any node contain a number, the function will
- * start looking in the reverse tree for numbers that contain the given prefix using function
- * @ref removeReverseWithPrefix.
- * @param [in] deleteReverseStart - pointer to the node we want to start deleting from in the reverse tree.
- * @param [in, out] deleteForwardStart - pointer to the node that we want to start deleting from in the forward tree.
+ * @brief Removes the forwardings with certain prefix.
+ * This function will find the nodes of the forward tree representing numbers that contain the given prefix and delete
+ * them. If any of these nodes contain a number, the function will also remove the numbers that contain the given
+ * prefix from the corresponding node of the reverse tree, each such node is cleaned only once, however many of the
+ * removed numbers are forwarded to it. In a shared pool all the routes that will be changed are copied before
+ * anything is removed.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] start - pointer to the root of the forward tree.
+ * @param [in, out] reverseStart - pointer to the root of the reverse tree or NULL if the reverse tree isn't kept.
  * @param [in] prefix - the prefix of numbers we want to remove.
+ * @return Value @p true if the forwardings were removed.
+ *         Value @p false if the routes of a shared pool couldn't be copied, nothing is removed then.
  */
-void deleteIterativeWithReverse(DNode *deleteReverseStart, DNode *deleteForwardStart, char const *prefix);
+bool removeForwardWithPrefix(NodePool *pool, DNode *start, DNode *reverseStart, char const *prefix);
 
 /**
  * @brief Obtains the node at the end of the route.
- * Obtains the node which represents the last digit of the given number. If there was any allocation error,
- * the function will delete all the nodes it has already added on the route to the current node and return NULL.
- * This function will also update values pointed by the given pointers.
+ * Obtains the node which represents the last digit of the given number, creating the missing nodes and splitting the
+ * edges the number ends or branches off in. If there was any allocation error, the function will restore the tree to
+ * the previous state and return NULL.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
  * @param [in] start - pointer to the node we want to start looking from.
- * @param [in, out] beforeFirstAddedPtr - pointer to the node before the first node added by this function.
- * @param [in, out] firstAddedPtr - pointer to the first node added by this function.
- * @param [in, out] firstAddedDigit - pointer to the digit of the first node added by this function.
  * @param [in] num - number to get the last digit of.
  * @return pointer to the node at the end of the route or NULL if there was an allocation error.
  */
-DNode *getEndNode(DNode *start, DNode **beforeFirstAddedPtr, DNode **firstAddedPtr, int *firstAddedDigit,
-                  char const *num);
+DNode *getEndNode(NodePool *pool, DNode *start, char const *num);
+
+/**
+ * @brief Removes the route if it isn't needed.
+ * If the node at the end of the route represented by the number doesn't store any numbers, this function will delete
+ * the route to the node (starting from the point that can be safely deleted) or merge the node with its only child.
+ * It is used to undo @ref getEndNode when storing the number in the node failed.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in] start - pointer to the node at the beginning of the route.
+ * @param [in] num - the number representing the route to the node.
+ */
+void removeEmptyRoute(NodePool *pool, DNode *start, char const *num);
 
 /**
 * @brief Finds the number od children for given node.
@@ -95,57 +332,97 @@ int numberOfChildren(DNode const *node);
 
 /**
  * @brief Overwrites the forwarding in the node.
- * This function will overwrite the forwarding in the given node (or create it if it doesn't exist). If there was an
- * allocation error, the function will also delete all the nodes that were created down to this node.
+ * This function will overwrite the forwarding in the given node of the forward tree (or create it if it doesn't
+ * exist). Short numbers are stored in the node itself, longer ones are allocated. The number that was overwritten is
+ * removed from the reverse tree. If there was an allocation error, the node is left unchanged.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] reverseStart - pointer to the root of the reverse tree or NULL if the reverse tree isn't kept.
  * @param [in] node - pointer to the node to overwrite the forwarding in.
- * @param [in, out] beforeFirstAdded - pointer to the node before the first added node.
- * @param [in, out] firstAdded - pointer to the first added node.
- * @param [in] firstAddedDigit - digit of the first added node.
- * @param [in] num - the number to overwrite current number in the node with.
- * @param [in, out] overWritten - pointer to the string representing a number that was overwritten.
+ * @param [in] num1 - the number represented by the node.
+ * @param [in] num2 - the number to overwrite current number in the node with.
  * @return Value @p true if the number was overwritten successfully.
  *         Value @p false if there was an allocation error.
  */
-bool overWriteForwarding(DNode *node, DNode *beforeFirstAdded, DNode *firstAdded, int firstAddedDigit, char const *num,
-                         char **overWritten);
+bool overWriteForwarding(NodePool *pool, DNode *reverseStart, DNode *node, char const *num1, char const *num2);
+
+/**
+ * @brief Removes the forwarding of the number.
+ * Unlike @ref removeForwardWithPrefix, only the forwarding of the whole number is removed, the forwardings of the
+ * longer numbers starting with it are left intact. The number is removed from the reverse tree too and the routes
+ * that are no longer needed are deleted. Does nothing if the number isn't forwarded.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] start - pointer to the root of the forward tree.
+ * @param [in, out] reverseStart - pointer to the root of the reverse tree or NULL if the reverse tree isn't kept.
+ * @param [in] num - the number whose forwarding is removed.
+ * @return Value @p true if the forwarding was removed or there was none.
+ *         Value @p false if the routes of a shared pool couldn't be copied, nothing is removed then.
+ */
+bool removeForwarding(NodePool *pool, DNode *start, DNode *reverseStart, char const *num);
+
+/**
+ * @brief Obtains the number the given number is forwarded to.
+ * Unlike @ref findPrefix, only the forwarding of the whole number is taken into account.
+ * @param [in] start - pointer to the root of the forward tree.
+ * @param [in] num - the forwarded number.
+ * @return The packed number @p num is forwarded to or NULL if it isn't forwarded.
+ */
+PackedNumber const *getForwarding(DNode *start, char const *num);
 
 /**
  * @brief Adds the number to the node.
- * This function will add the (reverse) number to the vector of numbers in the given node (and create the vector if
- * it doesn't exist). If there was an allocation error, the function will also delete all the nodes that were created
- * down to this node.
- * @param [in] node - pointer to the node to add the number to.
- * @param [in, out] beforeFirstAdded - pointer to the node before the first added node in the reverse tree.
- * @param [in, out] firstAdded - pointer to the first added node in the reverse tree.
- * @param [in] firstAddedDigit - digit of the first added node in the reverse tree.
- * @param [in] num - the number to add to the node.
+ * This function will add the (reverse) number to the numbers stored in the given node. They are kept in a sequence
+ * until there are a few dozen of them, then they are moved to a tree of numbers, so that a single
+ * number or all numbers with a prefix can be removed without scanning all of them. If there was an allocation error,
+ * the node is left with the same numbers.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] node - pointer to the node to add the number to.
+ * @param [in] num - the number to add to the node, it mustn't be stored in the node yet.
  * @return Value @p true if the number was added successfully.
  *         Value @p false if there was an allocation error.
  */
-bool addReverse(DNode *node, DNode *beforeFirstAdded, DNode *firstAdded, int firstAddedDigit, char const *num);
+bool addReverse(NodePool *pool, DNode *node, char const *num);
 
 /**
  * @brief Removes a number from the reverse tree.
- * This function will go to the node at the end of route represented by the number and remove the number from the vector
- * in that node. If the vector is then empty it will delete the vector structure and the route to the node (starting
- * from the point that can be safely deleted).
+ * This function will go to the node at the end of route represented by the number and remove the number from the
+ * numbers stored in that node. If there are no numbers left it will delete the route to the node (starting from the
+ * point that can be safely deleted) or merge the node with its only child. In a shared pool the route has to be
+ * copied by the earlier @ref getEndNode and @ref addReverse of the same write.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
  * @param [in] start - pointer to the node at the beginning of the route.
  * @param [in] num1 - the number representing the route to the node.
- * @param [in] num2 - the number we want to remove from the vector.
+ * @param [in] num2 - the number we want to remove from the node.
  */
-void removeReverse(DNode *start, char const *num1, char const *num2);
+void removeReverse(NodePool *pool, DNode *start, char const *num1, char const *num2);
 
 /**
  * @brief Finds the longest prefix of the number that is forwarded to another number.
  * This function is used to find the longest prefix of the number @p num that still has a number in the phone forward
  * tree starting from the node @p start. This prefix will be then used to change the number to the forwarded number
- * using @ref copyParts or@ref copyNumber.
+ * using @ref copyPackedParts or @ref copyNumber.
  * @param [in] start - pointer to the node that we want to start searching from.
  * @param [in] num - the number we are finding prefix of.
- * @param [in, out] maxForwardedPrefix - number the longest prefix is forwarded to.
+ * @param [in, out] maxForwardedPrefix - packed number the longest prefix is forwarded to.
  * @param [in, out] lenOfMaxOriginalPrefix - length of the longest prefix.
+ * @return Number of the digits of @p num followed down the tree.
  */
-void findPrefix(DNode *start, char const *num, char const **maxForwardedPrefix, size_t *lenOfMaxOriginalPrefix);
+size_t findPrefix(DNode *start, char const *num, PackedNumber const **maxForwardedPrefix,
+                  size_t *lenOfMaxOriginalPrefix);
+
+/**
+ * @brief Finds the longest forwarded prefixes of many numbers.
+ * This function works like @ref findPrefix for each of the given numbers, but it follows the routes of several numbers
+ * in lock-step, prefetching the next node of each route, so that the memory accesses of different routes overlap.
+ * @param [in] start - pointer to the node that we want to start searching from.
+ * @param [in] nums - array of the numbers we are finding prefixes of, NULL elements are skipped.
+ * @param [in] count - number of the numbers.
+ * @param [in, out] maxForwardedPrefix - array for the packed numbers the longest prefixes are forwarded to, NULL if
+ *                  there is no such prefix.
+ * @param [in, out] lenOfMaxOriginalPrefix - array for the lengths of the longest prefixes.
+ * @return Number of the digits of all the numbers followed down the tree.
+ */
+size_t findPrefixBatch(DNode *start, char const *const *nums, size_t count, PackedNumber const **maxForwardedPrefix,
+                       size_t *lenOfMaxOriginalPrefix);
 
 /**
  * @brief Adds all numbers after the operation of reversing.
@@ -159,4 +436,76 @@ void findPrefix(DNode *start, char const *num, char const **maxForwardedPrefix,
  */
 bool addAllFromReverseTree(DNode *start, char const *num, PhoneNumbers *pnum);
 
+/**
+ * @brief Adds all numbers that are forwarded to the given number.
+ * This function will go down the reverse tree like @ref addAllFromReverseTree, but before creating a number with
+ * a changed prefix it will check in the forward tree whether that number is really forwarded to @p num, so only the
+ * numbers of the inverse image of the forwarding are created and added to the given vector.
+ * @param [in] start - pointer to the root of the reverse tree.
+ * @param [in] forwardStart - pointer to the root of the forward tree.
+ * @param [in] num - the number we are finding the inverse image of.
+ * @param [in, out] pnum - the vector to add the numbers to.
+ * @return Value @p true if the numbers were added successfully.
+ *         Value @p false if there was an allocation error.
+ */
+bool addAllInverseFromReverseTree(DNode *start, DNode *forwardStart, char const *num, PhoneNumbers *pnum);
+
+/**
+ * @brief Finds the next node of the reverse tree storing the numbers forwarded to a prefix of the number.
+ * @param [in] node - pointer to the node to start from, the root of the reverse tree for the first call.
+ * @param [in] num - the number to follow the route of.
+ * @param [in, out] index - pointer to the number of the digits of @p num on the route to @p node, it will be set to
+ *                          the number of the digits on the route to the found node.
+ * @return Pointer to the found node or NULL if there is no such node further on the route.
+ */
+DNode *nodeNextReverse(DNode *node, char const *num, size_t *index);
+
+/**
+ * @brief Obtains the next number stored in the node of the reverse tree.
+ * The numbers are obtained in their sorted order, like in @ref comparePackedParts, without allocating memory.
+ * @param [in] node - pointer to the node found by @ref nodeNextReverse.
+ * @param [in] current - pointer to the current number of the node or NULL to obtain the first one.
+ * @return Pointer to the number following @p current or NULL if there is none.
+ */
+PackedNumber const *nodeNextSource(DNode *node, PackedNumber const *current);
+
+/**
+ * @brief Checks if the beginning of the packed number is stored in the node of the reverse tree.
+ * @param [in] node - pointer to the node found by @ref nodeNextReverse.
+ * @param [in] number - pointer to the packed number.
+ * @param [in] len - number of the first digits of @p number to look for, at most its length.
+ * @return Value @p true if the node stores the number made of the first @p len digits of @p number.
+ *         Value @p false otherwise.
+ */
+bool nodeHasSource(DNode *node, PackedNumber const *number, size_t len);
+
+/**
+ * @brief Builds the forward tree from forwardings sorted by the forwarded numbers.
+ * Nodes are created in the order of the numbers, following the previously added number instead of searching for the
+ * place of each number from the root. If a number is forwarded more than once, the last forwarding is kept.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] root - pointer to the root of the empty forward tree.
+ * @param [in] nums1 - array of the forwarded numbers, sorted according to @ref compareNumbers.
+ * @param [in] nums2 - array of the numbers the corresponding numbers of @p nums1 are forwarded to.
+ * @param [in] count - number of the forwardings.
+ * @return Value @p true if the tree was built successfully.
+ *         Value @p false if there was an allocation error, the tree has to be deleted then.
+ */
+bool buildForwardTree(NodePool *pool, DNode *root, char const *const *nums1, char const *const *nums2, size_t count);
+
+/**
+ * @brief Builds the reverse tree from forwardings sorted by the numbers they are forwarded to.
+ * Works like @ref buildForwardTree, but all numbers forwarded to the same number are stored in its node at once, in
+ * a sequence of the right size or, if there are many of them, in a tree of numbers built the same way.
+ * @param [in, out] pool - pointer to the pool the nodes are allocated from.
+ * @param [in, out] root - pointer to the root of the empty reverse tree.
+ * @param [in] targets - array of the numbers the forwardings lead to, sorted according to @ref compareNumbers.
+ * @param [in] sources - array of the forwarded numbers, different and sorted for each number of @p targets.
+ * @param [in] count - number of the forwardings.
+ * @return Value @p true if the tree was built successfully.
+ *         Value @p false if there was an allocation error, the tree has to be deleted then.
+ */
+bool buildReverseTree(NodePool *pool, DNode *root, char const *const *targets, char const *const *sources,
+                      size_t count);
+
 #endif /* __NODE_UTILS_H__ */
@@ -0,0 +1,213 @@
+/** @file
+ * Implementations of functions sharing the copies of equal numbers.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "number_table.h"
+#include "packed_number.h"
+#include "string_utils.h"
+
+#define FIRST_TABLE_CAPACITY 64 /**< Number of the slots of the table allocated for the first number. */
+
+/**
+ * @struct SharedNumber
+ * @brief Packed copy of a number stored in the table.
+ * @var SharedNumber::references
+ *      Number of the users of the copy.
+ * @var SharedNumber::hash
+ *      Hash of the digits of the number.
+ * @var SharedNumber::bytes
+ *      The packed number.
+ */
+struct SharedNumber {
+    size_t references;
+    uint64_t hash;
+    PackedNumber bytes[];
+};
+
+/**
+ * @struct NumberTable number_table.h
+ * @brief Hash table of the shared numbers.
+ * The collisions are resolved with linear probing, so a number is stored in the first free slot following the one
+ * chosen by its hash.
+ * @var NumberTable::slots
+ *      Array of the pointers to the numbers, NULL for the free slots.
+ * @var NumberTable::capacity
+ *      Number of the slots, 0 or a power of two.
+ * @var NumberTable::count
+ *      Number of the stored numbers, at most three quarters of @p capacity.
+ * @var NumberTable::memory
+ *      Number of the bytes allocated for the slots and the numbers, read without the writer.
+ */
+struct NumberTable {
+    struct SharedNumber **slots;
+    size_t capacity;
+    size_t count;
+    atomic_size_t memory;
+};
+
+/**
+ * @brief Obtains the stored number from the pointer to its packed copy.
+ * @param [in] number - pointer to the packed copy.
+ * @return Pointer to the stored number.
+ */
+static struct SharedNumber *sharedNumber(PackedNumber *number) {
+    return (struct SharedNumber *) (number - offsetof(struct SharedNumber, bytes));
+}
+
+/**
+ * @brief Changes the number of the bytes the table takes.
+ * @param [in, out] table - pointer to the table.
+ * @param [in] bytes - number of the allocated bytes.
+ * @param [in] allocated - value @p true if the bytes were allocated, @p false if they were freed.
+ */
+static void accountMemory(NumberTable *table, size_t bytes, bool allocated) {
+    if (allocated) {
+        atomic_fetch_add_explicit(&table->memory, bytes, memory_order_relaxed);
+    } else {
+        atomic_fetch_sub_explicit(&table->memory, bytes, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Moves the numbers to a new array of slots, twice as big as the current one.
+ * @param [in, out] table - pointer to the table.
+ * @return Value @p true if the table was enlarged successfully.
+ *         Value @p false if there was an allocation error, the table is then left unchanged.
+ */
+static bool growTable(NumberTable *table) {
+    size_t capacity = table->capacity == 0 ? FIRST_TABLE_CAPACITY : 2 * table->capacity;
+    struct SharedNumber **slots = calloc(capacity, sizeof(struct SharedNumber *));
+    if (slots == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i] != NULL) {
+            size_t slot = table->slots[i]->hash & (capacity - 1);
+            while (slots[slot] != NULL) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            slots[slot] = table->slots[i];
+        }
+    }
+    free(table->slots);
+    accountMemory(table, (capacity - table->capacity) * sizeof(struct SharedNumber *), true);
+    table->slots = slots;
+    table->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Frees the slot of the table.
+ * The numbers following the slot in the same run of occupied slots are moved back to fill the gap, unless that would
+ * put them before the slots chosen by their hashes, so every number can still be found by probing from its slot.
+ * @param [in, out] table - pointer to the table.
+ * @param [in] hole - index of the slot to free.
+ */
+static void removeSlot(NumberTable *table, size_t hole) {
+    size_t mask = table->capacity - 1;
+    for (size_t slot = (hole + 1) & mask; table->slots[slot] != NULL; slot = (slot + 1) & mask) {
+        size_t home = table->slots[slot]->hash & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            table->slots[hole] = table->slots[slot];
+            hole = slot;
+        }
+    }
+    table->slots[hole] = NULL;
+}
+
+NumberTable *numberTableNew(void) {
+    NumberTable *table = malloc(sizeof(NumberTable));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    atomic_init(&table->memory, 0);
+    return table;
+}
+
+void numberTableDelete(NumberTable *table) {
+    if (table == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->slots[i]);
+    }
+    free(table->slots);
+    free(table);
+}
+
+PackedNumber *numberTableAcquire(NumberTable *table, char const *num) {
+    size_t len;
+    uint64_t hash = hashNumber(num, &len);
+    size_t slot = table->capacity == 0 ? 0 : hash & (table->capacity - 1);
+    while (table->capacity > 0 && table->slots[slot] != NULL) {
+        struct SharedNumber *shared = table->slots[slot];
+        if (shared->hash == hash && packedEquals(shared->bytes, num)) {
+            shared->references++;
+            return shared->bytes;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    if (4 * (table->count + 1) > 3 * table->capacity) {
+        if (!growTable(table)) {
+            return NULL;
+        }
+        slot = hash & (table->capacity - 1);
+        while (table->slots[slot] != NULL) {
+            slot = (slot + 1) & (table->capacity - 1);
+        }
+    }
+
+    size_t size = sizeof(struct SharedNumber) + packedSize(len);
+    struct SharedNumber *shared = malloc(size);
+    if (shared == NULL) {
+        return NULL;
+    }
+    shared->references = 1;
+    shared->hash = hash;
+    packNumber(num, len, shared->bytes);
+    table->slots[slot] = shared;
+    table->count++;
+    accountMemory(table, size, true);
+    return shared->bytes;
+}
+
+void numberTableRetain(NumberTable *table, PackedNumber *number) {
+    (void) table;
+    sharedNumber(number)->references++;
+}
+
+void numberTableRelease(NumberTable *table, PackedNumber *number) {
+    struct SharedNumber *shared = sharedNumber(number);
+    if (--shared->references > 0) {
+        return;
+    }
+
+    size_t slot = shared->hash & (table->capacity - 1);
+    while (table->slots[slot] != shared) {
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    removeSlot(table, slot);
+    table->count--;
+    accountMemory(table, sizeof(struct SharedNumber) + packedBytes(shared->bytes), false);
+    free(shared);
+}
+
+size_t numberTableGetMemory(NumberTable const *table) {
+    return atomic_load_explicit(&table->memory, memory_order_relaxed);
+}
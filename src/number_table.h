@@ -0,0 +1,70 @@
+/** @file
+ * Interface of the class sharing the copies of equal numbers.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __NUMBER_TABLE_H__
+#define __NUMBER_TABLE_H__
+
+#include <stddef.h>
+#include "packed_number.h"
+
+/**
+ * This is a structure storing a single packed copy of each number it was given, together with the number of its
+ * users. The copies never change, so they can be read without the table, while the table itself may only be used by
+ * one writer at a time.
+ */
+struct NumberTable;
+typedef struct NumberTable NumberTable; /**< Table of the shared numbers. */
+
+/**
+ * @brief Creates a new empty table.
+ * @return Pointer to the new table or NULL if there was an allocation error.
+ */
+NumberTable *numberTableNew(void);
+
+/**
+ * @brief Deletes the table and all the numbers stored in it.
+ * Does nothing if the pointer is NULL.
+ * @param [in] table - pointer to the table.
+ */
+void numberTableDelete(NumberTable *table);
+
+/**
+ * @brief Obtains the shared copy of the number.
+ * If the table already stores the number, its copy gets one more user, otherwise the number is packed and added.
+ * @param [in, out] table - pointer to the table.
+ * @param [in] num - the number, it has to be valid.
+ * @return Pointer to the packed copy, to be passed to @ref numberTableRelease, or NULL if there was an allocation
+ *         error.
+ */
+PackedNumber *numberTableAcquire(NumberTable *table, char const *num);
+
+/**
+ * @brief Gives the shared copy of the number one more user.
+ * Every call has to be matched by a call of @ref numberTableRelease.
+ * @param [in, out] table - pointer to the table.
+ * @param [in, out] number - pointer to the copy returned by @ref numberTableAcquire.
+ */
+void numberTableRetain(NumberTable *table, PackedNumber *number);
+
+/**
+ * @brief Gives up the shared copy of the number.
+ * The copy is deleted once it has no users left.
+ * @param [in, out] table - pointer to the table.
+ * @param [in, out] number - pointer to the copy returned by @ref numberTableAcquire.
+ */
+void numberTableRelease(NumberTable *table, PackedNumber *number);
+
+/**
+ * @brief Obtains the amount of memory taken by the table.
+ * Can be called while the table is being changed, the result then may or may not include the change.
+ * @param [in] table - pointer to the table.
+ * @return Number of the bytes allocated for the table and its numbers.
+ */
+size_t numberTableGetMemory(NumberTable const *table);
+
+#endif /* __NUMBER_TABLE_H__ */
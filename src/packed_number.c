@@ -0,0 +1,503 @@
+/** @file
+ * Implementations of the functions declared in packed_number.h.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_utils.h"
+#include "packed_number.h"
+
+#define LENGTH_GROUP_BITS 7 /**< Number of the bits of the length stored in a single byte. */
+#define LENGTH_CONTINUES 0x80u /**< Bit set in every byte of the length but the last one. */
+#define FIRST_PACKED_CAPACITY 64 /**< Initial number of bytes of the numbers a sequence has memory for. */
+
+/**
+ * @struct PackedNumbers packed_number.h
+ * @brief Packed numbers stored one after another in their sorted order.
+ * @var PackedNumbers::count
+ *      Number of the numbers.
+ * @var PackedNumbers::size
+ *      Number of the used bytes of @p bytes.
+ * @var PackedNumbers::capacity
+ *      Number of the bytes of @p bytes.
+ * @var PackedNumbers::bytes
+ *      The packed numbers.
+ */
+struct PackedNumbers {
+    size_t count;
+    size_t size;
+    size_t capacity;
+    PackedNumber bytes[];
+};
+
+/**
+ * @brief Computes the number of the bytes of the length.
+ * @param [in] len - the length.
+ * @return Number of the bytes the length is written in.
+ */
+static size_t lengthBytes(size_t len) {
+    size_t bytes = 1;
+    while (len >= LENGTH_CONTINUES) {
+        len >>= LENGTH_GROUP_BITS;
+        bytes++;
+    }
+    return bytes;
+}
+
+PackedNumber const *packedDigits(PackedNumber const *packed, size_t *len) {
+    size_t result = 0;
+    unsigned int shift = 0;
+    while (*packed & LENGTH_CONTINUES) {
+        result |= (size_t) (*packed & (LENGTH_CONTINUES - 1)) << shift;
+        shift += LENGTH_GROUP_BITS;
+        packed++;
+    }
+    *len = result | (size_t) *packed << shift;
+    return packed + 1;
+}
+
+size_t packedSize(size_t len) {
+    return lengthBytes(len) + (len + 1) / 2;
+}
+
+void packNumber(char const *num, size_t len, PackedNumber *packed) {
+    size_t rest = len;
+    while (rest >= LENGTH_CONTINUES) {
+        *packed++ = (PackedNumber) ((rest & (LENGTH_CONTINUES - 1)) | LENGTH_CONTINUES);
+        rest >>= LENGTH_GROUP_BITS;
+    }
+    *packed++ = (PackedNumber) rest;
+
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        *packed++ = (PackedNumber) (toDecimalRepresentation(num[i]) | toDecimalRepresentation(num[i + 1]) << 4);
+    }
+    if (len % 2 == 1) {
+        *packed = (PackedNumber) toDecimalRepresentation(num[len - 1]);
+    }
+}
+
+bool copyPacked(char const *num, PackedNumber **packedPtr) {
+    size_t len = length(num);
+    PackedNumber *packed = malloc(packedSize(len));
+    if (packed == NULL) {
+        return false;
+    }
+
+    packNumber(num, len, packed);
+    *packedPtr = packed;
+    return true;
+}
+
+size_t packedLength(PackedNumber const *packed) {
+    size_t len;
+    packedDigits(packed, &len);
+    return len;
+}
+
+size_t packedBytes(PackedNumber const *packed) {
+    size_t len;
+    PackedNumber const *digits = packedDigits(packed, &len);
+    return (size_t) (digits - packed) + (len + 1) / 2;
+}
+
+size_t packedCheck(PackedNumber const *packed, size_t available) {
+    size_t len = 0;
+    size_t i = 0;
+    unsigned int shift = 0;
+    while (true) {
+        if (i == available || shift >= sizeof(size_t) * 8) {
+            return 0;
+        }
+        len |= (size_t) (packed[i] & (LENGTH_CONTINUES - 1)) << shift;
+        shift += LENGTH_GROUP_BITS;
+        if ((packed[i++] & LENGTH_CONTINUES) == 0) {
+            break;
+        }
+    }
+
+    if (len / 2 + len % 2 > available - i) {
+        return 0;
+    }
+    PackedNumber const *digits = packed + i;
+    for (size_t j = 0; j < len; j++) {
+        if (packedDigit(digits, j) >= NUMBER_OF_DIGITS) {
+            return 0;
+        }
+    }
+    if (len % 2 == 1 && (digits[len / 2] >> 4) != 0) {
+        return 0;
+    }
+    return i + len / 2 + len % 2;
+}
+
+void unpackNumber(PackedNumber const *packed, char *buffer) {
+    size_t len;
+    PackedNumber const *digits = packedDigits(packed, &len);
+    for (size_t i = 0; i < len; i++) {
+        buffer[i] = DIGIT_CHARS[packedDigit(digits, i)];
+    }
+    buffer[len] = '\0';
+}
+
+/**
+ * @brief Checks if the first digits of the number are the first digits of the packed number.
+ * The digits are compared in pairs with the bytes of the packed number.
+ * @param [in] digits - pointer to the first byte of the digits of the packed number.
+ * @param [in] count - number of the digits to compare.
+ * @param [in] num - the number.
+ * @return Value @p true if the digits are equal.
+ *         Value @p false otherwise.
+ */
+static bool matchDigits(PackedNumber const *digits, size_t count, char const *num) {
+    for (size_t i = 0; i + 1 < count; i += 2) {
+        int low = toDecimalRepresentation(num[i]);
+        if (low < 0) {
+            return false;
+        }
+        int high = toDecimalRepresentation(num[i + 1]);
+        if (high < 0 || digits[i / 2] != (PackedNumber) (low | high << 4)) {
+            return false;
+        }
+    }
+    return count % 2 == 0 || toDecimalRepresentation(num[count - 1]) == packedDigit(digits, count - 1);
+}
+
+bool packedEquals(PackedNumber const *packed, char const *num) {
+    size_t len;
+    PackedNumber const *digits = packedDigits(packed, &len);
+    return matchDigits(digits, len, num) && !isValidDigit(num[len]);
+}
+
+bool packedHasPrefix(PackedNumber const *packed, char const *prefix) {
+    size_t len;
+    PackedNumber const *digits = packedDigits(packed, &len);
+    size_t prefixLength = 0;
+    while (prefixLength <= len && isValidDigit(prefix[prefixLength])) {
+        prefixLength++;
+    }
+    return prefixLength <= len && matchDigits(digits, prefixLength, prefix);
+}
+
+/**
+ * @struct PartsReader
+ * @brief Position in a number built from a packed part followed by a suffix.
+ * @var PartsReader::digits
+ *      Pointer to the first byte of the digits of the packed part.
+ * @var PartsReader::length
+ *      Number of the digits of the packed part.
+ * @var PartsReader::index
+ *      Index of the next digit of the packed part.
+ * @var PartsReader::suffix
+ *      Pointer to the next digit of the suffix.
+ */
+struct PartsReader {
+    PackedNumber const *digits;
+    size_t length;
+    size_t index;
+    char const *suffix;
+};
+
+/**
+ * @brief Starts reading the number built from the parts.
+ * @param [in, out] reader - pointer to the position to set.
+ * @param [in] packed - pointer to the packed first part or NULL if it is empty.
+ * @param [in] suffix - the second part or NULL if it is empty.
+ */
+static void startReading(struct PartsReader *reader, PackedNumber const *packed, char const *suffix) {
+    reader->length = 0;
+    reader->digits = packed == NULL ? NULL : packedDigits(packed, &reader->length);
+    reader->index = 0;
+    reader->suffix = suffix == NULL ? "" : suffix;
+}
+
+/**
+ * @brief Reads the next digit of the number built from the parts.
+ * @param [in, out] reader - pointer to the position in the number.
+ * @return Decimal representation of the digit or -1 if the whole number was read.
+ */
+static int readDigit(struct PartsReader *reader) {
+    if (reader->index < reader->length) {
+        return packedDigit(reader->digits, reader->index++);
+    }
+    int digit = toDecimalRepresentation(*reader->suffix);
+    if (digit >= 0) {
+        reader->suffix++;
+    }
+    return digit;
+}
+
+int comparePackedParts(PackedNumber const *packed, char const *suffix, PackedNumber const *otherPacked,
+                       char const *otherSuffix) {
+    struct PartsReader reader;
+    struct PartsReader otherReader;
+    startReading(&reader, packed, suffix);
+    startReading(&otherReader, otherPacked, otherSuffix);
+    while (true) {
+        int digit = readDigit(&reader);
+        int otherDigit = readDigit(&otherReader);
+        if (digit != otherDigit) {
+            return digit < otherDigit ? -1 : 1;
+        }
+        if (digit < 0) {
+            return 0;
+        }
+    }
+}
+
+int comparePackedPrefix(PackedNumber const *packed, PackedNumber const *other, size_t len) {
+    size_t packedLen;
+    size_t otherLen;
+    PackedNumber const *digits = packedDigits(packed, &packedLen);
+    PackedNumber const *otherDigits = packedDigits(other, &otherLen);
+    for (size_t i = 0; i < packedLen && i < len; i++) {
+        int digit = packedDigit(digits, i);
+        int otherDigit = packedDigit(otherDigits, i);
+        if (digit != otherDigit) {
+            return digit < otherDigit ? -1 : 1;
+        }
+    }
+    return packedLen < len ? -1 : (packedLen > len ? 1 : 0);
+}
+
+bool packedEndsWith(PackedNumber const *packed, char const *num, size_t len) {
+    size_t packedLen;
+    PackedNumber const *digits = packedDigits(packed, &packedLen);
+    if (len > packedLen) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (packedDigit(digits, packedLen - len + i) != toDecimalRepresentation(num[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool copyPackedParts(char const *num, PackedNumber const *newPrefix, size_t lenOfOriginalPrefix, char **numberPtr) {
+    size_t prefixLength = packedLength(newPrefix);
+    char *result = malloc(sizeof(char) * (prefixLength - lenOfOriginalPrefix + length(num) + 1));
+    if (result == NULL) {
+        return false;
+    }
+
+    unpackNumber(newPrefix, result);
+    size_t i = prefixLength;
+    size_t j = lenOfOriginalPrefix;
+    while (isValidDigit(num[j])) {
+        result[i] = num[j];
+        i++;
+        j++;
+    }
+    result[i] = '\0';
+
+    *numberPtr = result;
+    return true;
+}
+
+size_t writePackedParts(char const *num, PackedNumber const *newPrefix, size_t lenOfOriginalPrefix, char *buffer,
+                        size_t bufferSize) {
+    size_t i = 0;
+
+    if (newPrefix != NULL) {
+        size_t prefixLength;
+        PackedNumber const *digits = packedDigits(newPrefix, &prefixLength);
+        for (; i < prefixLength; i++) {
+            if (i + 1 < bufferSize) {
+                buffer[i] = DIGIT_CHARS[packedDigit(digits, i)];
+            }
+        }
+    } else {
+        lenOfOriginalPrefix = 0;
+    }
+
+    size_t j = lenOfOriginalPrefix;
+    while (isValidDigit(num[j])) {
+        if (i + 1 < bufferSize) {
+            buffer[i] = num[j];
+        }
+        i++;
+        j++;
+    }
+
+    if (bufferSize > 0) {
+        buffer[i < bufferSize ? i : bufferSize - 1] = '\0';
+    }
+    return i;
+}
+
+/**
+ * @brief Checks if the beginning of the number matches the part.
+ * @param [in] part - the part to match.
+ * @param [in] num - the number.
+ * @param [in, out] index - index in the number to start matching at, it will be moved after the part.
+ * @return Value @p true if the digits of the number starting at the given index are the digits of the part.
+ *         Value @p false otherwise.
+ */
+static bool matchPart(char const *part, char const *num, size_t *index) {
+    for (size_t i = 0; isValidDigit(part[i]); i++) {
+        if (part[i] != num[*index]) {
+            return false;
+        }
+        (*index)++;
+    }
+    return true;
+}
+
+bool arePackedPartsEqual(char const *source, char const *suffix, PackedNumber const *newPrefix,
+                         size_t lenOfOriginalPrefix, char const *num) {
+    size_t sourceLength = length(source);
+    size_t k = 0;
+    if (newPrefix == NULL) {
+        lenOfOriginalPrefix = 0;
+    } else {
+        PackedNumber const *digits = packedDigits(newPrefix, &k);
+        if (!matchDigits(digits, k, num)) {
+            return false;
+        }
+    }
+
+    if (lenOfOriginalPrefix < sourceLength) {
+        if (!matchPart(source + lenOfOriginalPrefix, num, &k) || !matchPart(suffix, num, &k)) {
+            return false;
+        }
+    } else if (!matchPart(suffix + lenOfOriginalPrefix - sourceLength, num, &k)) {
+        return false;
+    }
+
+    return num[k] == '\0';
+}
+
+void packedNumbersDelete(PackedNumbers *numbers) {
+    free(numbers);
+}
+
+PackedNumbers *packedNumbersCopy(PackedNumbers const *numbers) {
+    PackedNumbers *copy = malloc(sizeof(PackedNumbers) + numbers->size);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    copy->count = numbers->count;
+    copy->size = numbers->size;
+    copy->capacity = numbers->size;
+    memcpy(copy->bytes, numbers->bytes, numbers->size);
+    return copy;
+}
+
+size_t packedNumbersGetSize(PackedNumbers const *numbers) {
+    return numbers->count;
+}
+
+size_t packedNumbersGetMemory(PackedNumbers const *numbers) {
+    return sizeof(PackedNumbers) + numbers->capacity;
+}
+
+bool packedNumbersReserve(PackedNumbers **numbersPtr, size_t bytes) {
+    PackedNumbers *numbers = *numbersPtr;
+    size_t size = numbers == NULL ? 0 : numbers->size;
+    size_t capacity = numbers == NULL ? 0 : numbers->capacity;
+    if (bytes > SIZE_MAX / 2 - sizeof(PackedNumbers) - size) {
+        return false;
+    }
+    if (size + bytes <= capacity && numbers != NULL) {
+        return true;
+    }
+
+    size_t newCapacity = capacity == 0 ? FIRST_PACKED_CAPACITY : 2 * capacity;
+    if (newCapacity < size + bytes) {
+        newCapacity = size + bytes;
+    }
+    PackedNumbers *grown = realloc(numbers, sizeof(PackedNumbers) + newCapacity);
+    if (grown == NULL) {
+        return false;
+    }
+    if (numbers == NULL) {
+        grown->count = 0;
+        grown->size = 0;
+    }
+    grown->capacity = newCapacity;
+    *numbersPtr = grown;
+    return true;
+}
+
+bool packedNumbersAdd(PackedNumbers **numbersPtr, char const *num) {
+    size_t len = length(num);
+    size_t bytes = packedSize(len);
+    if (!packedNumbersReserve(numbersPtr, bytes)) {
+        return false;
+    }
+
+    PackedNumbers *numbers = *numbersPtr;
+    size_t offset = 0;
+    while (offset < numbers->size && comparePackedParts(numbers->bytes + offset, NULL, NULL, num) < 0) {
+        offset += packedBytes(numbers->bytes + offset);
+    }
+    memmove(numbers->bytes + offset + bytes, numbers->bytes + offset, numbers->size - offset);
+    packNumber(num, len, numbers->bytes + offset);
+    numbers->size += bytes;
+    numbers->count++;
+    return true;
+}
+
+/**
+ * @brief Deletes the sequence if there are no numbers left in it.
+ * @param [in, out] numbersPtr - pointer to the pointer to the sequence.
+ */
+static void deleteIfEmpty(PackedNumbers **numbersPtr) {
+    if ((*numbersPtr)->count == 0) {
+        free(*numbersPtr);
+        *numbersPtr = NULL;
+    }
+}
+
+void packedNumbersRemove(PackedNumbers **numbersPtr, char const *num) {
+    PackedNumbers *numbers = *numbersPtr;
+    if (numbers == NULL) {
+        return;
+    }
+
+    for (size_t offset = 0; offset < numbers->size;) {
+        size_t bytes = packedBytes(numbers->bytes + offset);
+        if (packedEquals(numbers->bytes + offset, num)) {
+            memmove(numbers->bytes + offset, numbers->bytes + offset + bytes, numbers->size - offset - bytes);
+            numbers->size -= bytes;
+            numbers->count--;
+            break;
+        }
+        offset += bytes;
+    }
+    deleteIfEmpty(numbersPtr);
+}
+
+void packedNumbersRemoveWithPrefix(PackedNumbers **numbersPtr, char const *prefix) {
+    PackedNumbers *numbers = *numbersPtr;
+    if (numbers == NULL) {
+        return;
+    }
+
+    size_t kept = 0;
+    for (size_t offset = 0; offset < numbers->size;) {
+        size_t bytes = packedBytes(numbers->bytes + offset);
+        if (packedHasPrefix(numbers->bytes + offset, prefix)) {
+            numbers->count--;
+        } else {
+            memmove(numbers->bytes + kept, numbers->bytes + offset, bytes);
+            kept += bytes;
+        }
+        offset += bytes;
+    }
+    numbers->size = kept;
+    deleteIfEmpty(numbersPtr);
+}
+
+PackedNumber const *packedNumbersNext(PackedNumbers const *numbers, PackedNumber const *current) {
+    PackedNumber const *next = current == NULL ? numbers->bytes : current + packedBytes(current);
+    return next < numbers->bytes + numbers->size ? next : NULL;
+}
@@ -0,0 +1,275 @@
+/** @file
+ * Interface of the class containing operations on packed numbers.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __PACKED_NUMBER_H__
+#define __PACKED_NUMBER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Byte of a number stored in the trees. A packed number starts with the number of its digits, written in 7-bit groups
+ * with the least significant group first and the highest bit set in every byte but the last one, so numbers shorter
+ * than 128 digits take a single length byte. It is followed by the digits, two in each byte, the first one in the
+ * least significant bits, and the unused bits of the last byte are 0. Equal numbers have equal bytes, so they can be
+ * compared without decoding the digits.
+ */
+typedef unsigned char PackedNumber;
+
+/**
+ * This is a structure storing a sorted sequence of packed numbers in a single block of memory.
+ */
+struct PackedNumbers;
+typedef struct PackedNumbers PackedNumbers; /**< Sequence of packed numbers. */
+
+/**
+ * @brief Computes the size of the packed number.
+ * @param [in] len - number of the digits of the number.
+ * @return Number of the bytes the packed number takes.
+ */
+size_t packedSize(size_t len);
+
+/**
+ * @brief Packs the number.
+ * @param [in] num - the number.
+ * @param [in] len - length of the number.
+ * @param [in, out] packed - pointer to the memory for at least @ref packedSize(len) bytes.
+ */
+void packNumber(char const *num, size_t len, PackedNumber *packed);
+
+/**
+ * @brief Packs the number into a newly allocated memory.
+ * @param [in] num - the number.
+ * @param [in, out] packedPtr - pointer to the packed number, it has to be freed.
+ * @return Value @p true if the number was packed successfully.
+ *         Value @p false if there was an allocation error.
+ */
+bool copyPacked(char const *num, PackedNumber **packedPtr);
+
+/**
+ * @brief Obtains the length of the packed number.
+ * @param [in] packed - pointer to the packed number.
+ * @return Number of the digits of the number.
+ */
+size_t packedLength(PackedNumber const *packed);
+
+/**
+ * @brief Obtains the size of the packed number.
+ * @param [in] packed - pointer to the packed number.
+ * @return Number of the bytes the packed number takes.
+ */
+size_t packedBytes(PackedNumber const *packed);
+
+/**
+ * @brief Checks if the bytes are a valid packed number.
+ * @param [in] packed - pointer to the bytes.
+ * @param [in] available - number of the bytes that can be read.
+ * @return Number of the bytes of the packed number or 0 if it doesn't fit in @p available bytes or some of its
+ *         digits are invalid.
+ */
+size_t packedCheck(PackedNumber const *packed, size_t available);
+
+/**
+ * @brief Reads the length of the packed number.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in, out] len - pointer to the number of the digits.
+ * @return Pointer to the first byte of the digits, to be passed to @ref packedDigit.
+ */
+PackedNumber const *packedDigits(PackedNumber const *packed, size_t *len);
+
+/**
+ * @brief Obtains a digit of the packed number.
+ * The digits are read on every step of the walks down the trees along the stored numbers, so the function is
+ * defined here to be inlined.
+ * @param [in] digits - pointer to the first byte of the digits returned by @ref packedDigits.
+ * @param [in] index - index of the digit, smaller than the length of the number.
+ * @return Decimal representation of the digit.
+ */
+static inline int packedDigit(PackedNumber const *digits, size_t index) {
+    return (digits[index / 2] >> (4 * (index % 2))) & 0xF;
+}
+
+/**
+ * @brief Writes the digits of the packed number to the buffer.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in, out] buffer - the buffer for at least @ref packedLength + 1 characters, the number is terminated with
+ *                           '\0'.
+ */
+void unpackNumber(PackedNumber const *packed, char *buffer);
+
+/**
+ * @brief Checks if the packed number is equal to the number.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in] num - the number.
+ * @return Value @p true if the numbers are equal.
+ *         Value @p false otherwise.
+ */
+bool packedEquals(PackedNumber const *packed, char const *num);
+
+/**
+ * @brief Checks if the packed number starts with the prefix.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in] prefix - the prefix.
+ * @return Value @p true if @p prefix is a prefix of the packed number.
+ *         Value @p false otherwise.
+ */
+bool packedHasPrefix(PackedNumber const *packed, char const *prefix);
+
+/**
+ * @brief Compares two numbers, each built from a packed part followed by a suffix.
+ * The digits are ordered 0 to 9, '*', '#', like in the results of @ref phfwdReverse, and a number is smaller than
+ * every number it is a prefix of.
+ * @param [in] packed - pointer to the packed first part of the first number or NULL if it is empty.
+ * @param [in] suffix - the second part of the first number or NULL if it is empty.
+ * @param [in] otherPacked - pointer to the packed first part of the second number or NULL if it is empty.
+ * @param [in] otherSuffix - the second part of the second number or NULL if it is empty.
+ * @return Negative value if the first number is smaller, 0 if the numbers are equal and positive value otherwise.
+ */
+int comparePackedParts(PackedNumber const *packed, char const *suffix, PackedNumber const *otherPacked,
+                       char const *otherSuffix);
+
+/**
+ * @brief Compares the packed number with the beginning of another packed number.
+ * The numbers are ordered like in @ref comparePackedParts.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in] other - pointer to the other packed number.
+ * @param [in] len - number of the first digits of @p other to compare with, at most its length.
+ * @return Negative value if @p packed is smaller than the first @p len digits of @p other, 0 if it is equal to them
+ *         and positive value otherwise.
+ */
+int comparePackedPrefix(PackedNumber const *packed, PackedNumber const *other, size_t len);
+
+/**
+ * @brief Checks if the packed number ends with the digits of the number.
+ * @param [in] packed - pointer to the packed number.
+ * @param [in] num - the number.
+ * @param [in] len - number of the first digits of @p num to check, at most its length.
+ * @return Value @p true if the last @p len digits of the packed number are the first @p len digits of @p num.
+ *         Value @p false otherwise.
+ */
+bool packedEndsWith(PackedNumber const *packed, char const *num, size_t len);
+
+/**
+ * @brief Copies the forwarded number to the given buffer.
+ * This function first copies the digits of @p newPrefix and then appends the rest of the given number @p num without
+ * the first @p lenOfOriginalPrefix digits.
+ * @param [in] num - number to be forwarded.
+ * @param [in] newPrefix - pointer to the packed new prefix of the number.
+ * @param [in] lenOfOriginalPrefix - length of the original prefix.
+ * @param [in, out] numberPtr - pointer to the created number.
+ * @return Value @p true if the number was created successfully.
+ *         Value @p false if there was allocation error.
+ */
+bool copyPackedParts(char const *num, PackedNumber const *newPrefix, size_t lenOfOriginalPrefix, char **numberPtr);
+
+/**
+ * @brief Writes the forwarded number to the given buffer.
+ * This function works like @ref copyPackedParts, but instead of allocating the result it writes it to the buffer
+ * provided by the caller. If the buffer is too small, the result gets truncated. The result is always terminated with
+ * '\0', unless @p bufferSize is 0. If @p newPrefix is NULL, the number is copied without changes.
+ * @param [in] num - number to be forwarded.
+ * @param [in] newPrefix - pointer to the packed new prefix of the number or NULL.
+ * @param [in] lenOfOriginalPrefix - length of the original prefix.
+ * @param [in, out] buffer - the buffer to write the number to.
+ * @param [in] bufferSize - size of the buffer.
+ * @return Length of the whole number, not including the terminating '\0'.
+ */
+size_t writePackedParts(char const *num, PackedNumber const *newPrefix, size_t lenOfOriginalPrefix, char *buffer,
+                        size_t bufferSize);
+
+/**
+ * @brief Checks if the forwarded number built from two parts is equal to the given number.
+ * The forwarded number is the concatenation of @p source and @p suffix, in which the first @p lenOfOriginalPrefix
+ * digits are replaced with the digits of @p newPrefix, like in @ref copyPackedParts. The numbers are compared without
+ * building the forwarded number.
+ * @param [in] source - the first part of the number.
+ * @param [in] suffix - the second part of the number.
+ * @param [in] newPrefix - pointer to the packed new prefix of the number or NULL if the number isn't changed.
+ * @param [in] lenOfOriginalPrefix - length of the original prefix.
+ * @param [in] num - the number to compare with.
+ * @return Value @p true if the numbers are equal.
+ *         Value @p false otherwise.
+ */
+bool arePackedPartsEqual(char const *source, char const *suffix, PackedNumber const *newPrefix,
+                         size_t lenOfOriginalPrefix, char const *num);
+
+/**
+ * @brief Deletes the sequence of packed numbers.
+ * Does nothing if the pointer is NULL.
+ * @param [in] numbers - pointer to the sequence.
+ */
+void packedNumbersDelete(PackedNumbers *numbers);
+
+/**
+ * @brief Copies the sequence of packed numbers.
+ * @param [in] numbers - pointer to the sequence.
+ * @return Pointer to the copy or NULL if there was an allocation error.
+ */
+PackedNumbers *packedNumbersCopy(PackedNumbers const *numbers);
+
+/**
+ * @brief Obtains the number of the numbers in the sequence.
+ * @param [in] numbers - pointer to the sequence.
+ * @return Number of the numbers.
+ */
+size_t packedNumbersGetSize(PackedNumbers const *numbers);
+
+/**
+ * @brief Obtains the amount of memory taken by the sequence.
+ * @param [in] numbers - pointer to the sequence.
+ * @return Number of the bytes allocated for the sequence and its numbers.
+ */
+size_t packedNumbersGetMemory(PackedNumbers const *numbers);
+
+/**
+ * @brief Makes sure the numbers can be added to the sequence without allocating memory.
+ * Creates the sequence if it doesn't exist yet.
+ * @param [in, out] numbersPtr - pointer to the pointer to the sequence or to NULL.
+ * @param [in] bytes - number of the bytes of the packed numbers that will be added.
+ * @return Value @p true if the space was reserved successfully.
+ *         Value @p false if there was an allocation error, the sequence is then left unchanged.
+ */
+bool packedNumbersReserve(PackedNumbers **numbersPtr, size_t bytes);
+
+/**
+ * @brief Packs the number and inserts it into the sequence.
+ * The numbers of the sequence are kept sorted like in @ref comparePackedParts. Creates the sequence if it doesn't
+ * exist yet. The sequence may be moved in memory.
+ * @param [in, out] numbersPtr - pointer to the pointer to the sequence or to NULL.
+ * @param [in] num - the number.
+ * @return Value @p true if the number was added successfully.
+ *         Value @p false if there was an allocation error, the sequence is then left unchanged.
+ */
+bool packedNumbersAdd(PackedNumbers **numbersPtr, char const *num);
+
+/**
+ * @brief Removes the number from the sequence.
+ * If the sequence is then empty it is deleted.
+ * @param [in, out] numbersPtr - pointer to the pointer to the sequence.
+ * @param [in] num - the number to remove.
+ */
+void packedNumbersRemove(PackedNumbers **numbersPtr, char const *num);
+
+/**
+ * @brief Removes all the numbers starting with the prefix from the sequence.
+ * If there are no numbers left in the sequence, it is deleted.
+ * @param [in, out] numbersPtr - pointer to the pointer to the sequence.
+ * @param [in] prefix - the prefix of numbers we want to remove.
+ */
+void packedNumbersRemoveWithPrefix(PackedNumbers **numbersPtr, char const *prefix);
+
+/**
+ * @brief Obtains the next number of the sequence.
+ * The numbers are obtained in their sorted order.
+ * @param [in] numbers - pointer to the sequence.
+ * @param [in] current - pointer to the current number of the sequence or NULL to obtain the first one.
+ * @return Pointer to the number following @p current or NULL if there is none.
+ */
+PackedNumber const *packedNumbersNext(PackedNumbers const *numbers, PackedNumber const *current);
+
+#endif /* __PACKED_NUMBER_H__ */
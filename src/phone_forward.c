@@ -6,157 +6,675 @@
  * @date 2022
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "counters.h"
+#include "epoch.h"
+#include "packed_number.h"
 #include "phone_forward.h"
 #include "string_utils.h"
 #include "phone_numbers.h"
 #include "node_utils.h"
+#include "flat_index.h"
+#include "forward_log.h"
+#include "result_cache.h"
+#include "reverse_cursor.h"
+
+#define GET_BATCH_SIZE 64 /**< Number of numbers passed at once to @ref findPrefixBatch by @ref phfwdGetBatch. */
+#define NUMBER_BUFFER_SIZE 64 /**< Size of the buffers for the numbers given with their lengths. */
+#define FIRST_COLLECTED_CAPACITY 1024 /**< Initial number of the elements of the arrays of collected forwardings. */
+
+/**
+ * @struct Roots
+ * @brief Roots of the trees published to the concurrent readers.
+ * @var Roots::root
+ *      Pointer to the root of the tree of phone forwarding.
+ * @var Roots::reverseRoot
+ *      Pointer to the root of the tree of reverse phone forwarding.
+ */
+struct Roots {
+    DNode *root;
+    DNode *reverseRoot;
+};
+
+/**
+ * @struct PhoneReverseCursor phone_forward.h
+ * @brief Cursor over the results of the reverse forwarding and the trees it reads.
+ * @var PhoneReverseCursor::pf
+ *      Pointer to the structure the results are read from.
+ * @var PhoneReverseCursor::cursor
+ *      Pointer to the position in the results or NULL if the searched string isn't a number.
+ * @var PhoneReverseCursor::token
+ *      The token of the reading of the trees, passed to @ref endRead when the cursor is deleted.
+ */
+struct PhoneReverseCursor {
+    PhoneForward const *pf;
+    ReverseCursor *cursor;
+    unsigned token;
+};
 
 /**
  * @struct PhoneForward phone_forward.h
  * @brief Structure containing the root of the tree of phone forwarding and reverse tree.
  * @var PhoneForward::root
- *      Pointer to the root of the tree.
+ *      Pointer to the root of the tree. In the concurrent mode it is the root seen by the writer.
  * @var PhoneForward::reverseRoot
- *      Pointer to the root of the tree of reverse phone forwarding.
+ *      Pointer to the root of the tree of reverse phone forwarding. In the concurrent mode it is the root seen by the
+ *      writer.
+ * @var PhoneForward::pool
+ *      Pointer to the pool the nodes of both trees are allocated from.
+ * @var PhoneForward::index
+ *      Pointer to the read-only flat index used instead of the trees or NULL if the structure can be modified.
+ * @var PhoneForward::concurrent
+ *      Whether the structure was created with @ref phfwdNewConcurrent.
+ * @var PhoneForward::published
+ *      Pointer to the roots seen by the readers in the concurrent mode.
+ * @var PhoneForward::nextRoots
+ *      Memory for the roots published by the current write in the concurrent mode.
+ * @var PhoneForward::counters
+ *      Pointer to the counters of the operations run on the structure.
+ * @var PhoneForward::cache
+ *      Pointer to the cache of the results of the lookups or NULL if it is disabled.
+ * @var PhoneForward::log
+ *      Pointer to the log the changes are appended to or NULL if they aren't logged.
+ * @var PhoneForward::snapshotPath
+ *      Copy of the path of the snapshot the log is folded into or NULL if the changes aren't logged.
+ * @var PhoneForward::compactor
+ *      The thread folding the log in the background.
+ * @var PhoneForward::compacting
+ *      Whether @p compactor was started and wasn't joined yet.
+ * @var PhoneForward::compacted
+ *      Whether the last folding of the log succeeded.
+ * @var PhoneForward::compactEnd
+ *      Position in the log after the last record contained in the snapshot written in the background.
  */
 struct PhoneForward {
     DNode *root;
     DNode *reverseRoot;
+    NodePool *pool;
+    FlatIndex *index;
+    bool concurrent;
+    _Atomic(struct Roots *) published;
+    struct Roots *nextRoots;
+    OperationCounters *counters;
+    ResultCache *cache;
+    ForwardLog *log;
+    char *snapshotPath;
+    pthread_t compactor;
+    bool compacting;
+    bool compacted;
+    uint64_t compactEnd;
 };
 
-PhoneForward *phfwdNew(void) {
+/**
+ * @brief Creates a new structure.
+ * @param [in] options - bitwise alternative of @ref PHFWD_CONCURRENT and @ref PHFWD_FORWARD_ONLY.
+ * @return Pointer to the new structure or NULL if there was an allocation error.
+ */
+static PhoneForward *newStructure(unsigned options) {
+    bool concurrent = (options & PHFWD_CONCURRENT) != 0;
     PhoneForward *pf = malloc(sizeof(PhoneForward));
     if (pf == NULL) {
         return NULL;
     }
 
-    pf->root = nodeNew();
-    if (pf->root == NULL) {
+    pf->counters = countersNew();
+    pf->pool = nodePoolNew(concurrent);
+    if (pf->counters == NULL || pf->pool == NULL) {
+        countersDelete(pf->counters);
+        nodePoolDelete(pf->pool);
         free(pf);
         return NULL;
     }
+    nodePoolSetCounters(pf->pool, pf->counters);
 
-    pf->reverseRoot = nodeNew();
-    if (pf->reverseRoot == NULL) {
-        free(pf->root);
+    pf->index = NULL;
+    pf->cache = NULL;
+    pf->log = NULL;
+    pf->snapshotPath = NULL;
+    pf->compacting = false;
+    pf->compacted = true;
+    pf->concurrent = concurrent;
+    pf->nextRoots = NULL;
+    atomic_init(&pf->published, NULL);
+    pf->root = nodeNew(pf->pool);
+    pf->reverseRoot = (options & PHFWD_FORWARD_ONLY) != 0 ? NULL : nodeNew(pf->pool);
+    if (pf->root == NULL || (pf->reverseRoot == NULL && (options & PHFWD_FORWARD_ONLY) == 0)) {
+        nodePoolDelete(pf->pool);
+        countersDelete(pf->counters);
         free(pf);
         return NULL;
     }
 
+    if (concurrent) {
+        struct Roots *roots = malloc(sizeof(struct Roots));
+        if (roots == NULL) {
+            nodePoolDelete(pf->pool);
+            countersDelete(pf->counters);
+            free(pf);
+            return NULL;
+        }
+        roots->root = pf->root;
+        roots->reverseRoot = pf->reverseRoot;
+        atomic_init(&pf->published, roots);
+        nodePoolPublish(pf->pool);
+    }
+
     return pf;
 }
 
+PhoneForward *phfwdNew(void) {
+    return newStructure(0);
+}
+
+PhoneForward *phfwdNewConcurrent(void) {
+    return newStructure(PHFWD_CONCURRENT);
+}
+
+PhoneForward *phfwdNewWithOptions(unsigned options) {
+    if ((options & ~(unsigned) (PHFWD_CONCURRENT | PHFWD_FORWARD_ONLY)) != 0) {
+        return NULL;
+    }
+
+    return newStructure(options);
+}
+
+PhoneForward *phfwdClone(PhoneForward const *pf) {
+    if (pf == NULL || pf->index != NULL) {
+        return NULL;
+    }
+
+    PhoneForward *clone = malloc(sizeof(PhoneForward));
+    if (clone == NULL) {
+        return NULL;
+    }
+    clone->counters = countersNew();
+    struct Roots *roots = pf->concurrent ? malloc(sizeof(struct Roots)) : NULL;
+    if (clone->counters == NULL || (pf->concurrent && roots == NULL)) {
+        countersDelete(clone->counters);
+        free(roots);
+        free(clone);
+        return NULL;
+    }
+
+    nodePoolLock(pf->pool);
+    if (!nodePoolShare(pf->pool)) {
+        nodePoolUnlock(pf->pool);
+        countersDelete(clone->counters);
+        free(roots);
+        free(clone);
+        return NULL;
+    }
+    clone->root = pf->root;
+    clone->reverseRoot = pf->reverseRoot;
+    nodeRetain(clone->root);
+    if (clone->reverseRoot != NULL) {
+        nodeRetain(clone->reverseRoot);
+    }
+    nodePoolUnlock(pf->pool);
+
+    clone->pool = pf->pool;
+    clone->index = NULL;
+    clone->cache = NULL;
+    clone->log = NULL;
+    clone->snapshotPath = NULL;
+    clone->compacting = false;
+    clone->compacted = true;
+    clone->concurrent = pf->concurrent;
+    clone->nextRoots = NULL;
+    if (roots != NULL) {
+        roots->root = clone->root;
+        roots->reverseRoot = clone->reverseRoot;
+    }
+    atomic_init(&clone->published, roots);
+    return clone;
+}
+
 void phfwdDelete(PhoneForward *pf) {
     if (pf == NULL) {
         return;
     }
 
-    deleteIterative(pf->root);
-    deleteIterative(pf->reverseRoot);
+    phfwdCompactWait(pf);
+    forwardLogClose(pf->log);
+    free(pf->snapshotPath);
+    if (pf->concurrent) {
+        free(atomic_load(&pf->published));
+    }
+    if (pf->pool != NULL) {
+        nodePoolLeave(pf->pool, pf->root, pf->reverseRoot);
+    }
+    flatIndexDelete(pf->index);
+    countersDelete(pf->counters);
+    resultCacheDelete(pf->cache);
 
     free(pf);
 }
 
-bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2) {
-    if (pf == NULL || !checkNumbers(num1, num2)) {
+/**
+ * @brief Starts reading the trees of the structure.
+ * In the concurrent mode enters the epoch domain of the pool and obtains the roots published by the last write, so
+ * that none of the nodes reachable from them is freed until @ref endRead.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [out] roots - pointer to the roots to read the trees from.
+ * @return The token to pass to @ref endRead.
+ */
+static unsigned beginRead(PhoneForward const *pf, struct Roots *roots) {
+    if (!pf->concurrent) {
+        roots->root = pf->root;
+        roots->reverseRoot = pf->reverseRoot;
+        return 0;
+    }
+
+    unsigned token = epochEnter(nodePoolGetEpoch(pf->pool));
+    *roots = *atomic_load(&pf->published);
+    return token;
+}
+
+/**
+ * @brief Stops reading the trees of the structure.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] token - the token returned by @ref beginRead.
+ */
+static void endRead(PhoneForward const *pf, unsigned token) {
+    if (pf->concurrent) {
+        epochExit(nodePoolGetEpoch(pf->pool), token);
+    }
+}
+
+/**
+ * @brief Frees the roots that were replaced by a write.
+ * @param [in, out] context - unused.
+ * @param [in, out] object - pointer to the @ref Roots.
+ */
+static void reclaimRoots(void *context, void *object) {
+    (void) context;
+    free(object);
+}
+
+/**
+ * @brief Starts modifying the trees of the structure.
+ * If the pool is shared, in the concurrent mode or with clones, locks the mutex of the writers and replaces both
+ * roots with their unpublished copies, so that the write can change the copies of the routes below them. In the
+ * concurrent mode the retirement of the published roots by @ref endWrite is reserved too.
+ * @ref endWrite has to be called afterwards even if this function fails.
+ * @param [in, out] pf - pointer to the structure containing phone forwarding information.
+ * @return Value @p true if the trees can be modified.
+ *         Value @p false if there was an allocation error.
+ */
+static bool beginWrite(PhoneForward *pf) {
+    if (nodePoolGetEpoch(pf->pool) == NULL) {
+        return true;
+    }
+
+    nodePoolLock(pf->pool);
+    nodePoolSetCounters(pf->pool, pf->counters);
+    if (pf->concurrent) {
+        pf->nextRoots = malloc(sizeof(struct Roots));
+        if (pf->nextRoots == NULL || !epochReserve(nodePoolGetEpoch(pf->pool), 1)) {
+            return false;
+        }
+    }
+
+    DNode *root = nodeWritable(pf->pool, pf->root);
+    if (root == NULL) {
         return false;
     }
+    pf->root = root;
+    if (pf->reverseRoot == NULL) {
+        return true;
+    }
 
-    DNode *beforeFirstAdded = NULL;
-    DNode *firstAdded = NULL;
-    int firstAddedDigit;
-    char *overWrittenNumber = NULL;
-    DNode *node = getEndNode(pf->root, &beforeFirstAdded, &firstAdded, &firstAddedDigit, num1);
-    if (node == NULL || !overWriteForwarding(node, beforeFirstAdded, firstAdded, firstAddedDigit, num2,
-                                             &overWrittenNumber)) {
+    DNode *reverseRoot = nodeWritable(pf->pool, pf->reverseRoot);
+    if (reverseRoot == NULL) {
         return false;
     }
+    pf->reverseRoot = reverseRoot;
+    return true;
+}
+
+/**
+ * @brief Ends modifying the trees of the structure.
+ * In the concurrent mode publishes the roots changed by the write and retires the previous ones, then unlocks the
+ * mutex of the writers if the pool is shared.
+ * @param [in, out] pf - pointer to the structure containing phone forwarding information.
+ */
+static void endWrite(PhoneForward *pf) {
+    if (nodePoolGetEpoch(pf->pool) == NULL) {
+        return;
+    }
+
+    if (pf->nextRoots != NULL) {
+        pf->nextRoots->root = pf->root;
+        pf->nextRoots->reverseRoot = pf->reverseRoot;
+        struct Roots *previous = atomic_exchange(&pf->published, pf->nextRoots);
+        epochRetire(nodePoolGetEpoch(pf->pool), previous, reclaimRoots, NULL);
+        pf->nextRoots = NULL;
+    }
+    nodePoolPublish(pf->pool);
+    nodePoolUnlock(pf->pool);
+}
 
-    if (overWrittenNumber != NULL) {
-        removeReverse(pf->reverseRoot, overWrittenNumber, num1);
+/**
+ * @brief Adds a phone forwarding to the trees.
+ * The reverse tree is left alone if the structure doesn't keep it.
+ * @param [in, out] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] num1 - pointer to the prefix of the phone numbers to be forwarded.
+ * @param [in] num2 - pointer to the prefix of the phone numbers to be forwarded to.
+ * @return Value @p true if the phone forwarding was added.
+ *         Value @p false if there was an allocation error.
+ */
+static bool addForwarding(PhoneForward *pf, char const *num1, char const *num2) {
+    PackedNumber const *current = getForwarding(pf->root, num1);
+    if (current != NULL && packedEquals(current, num2)) {
+        return true;
+    }
+    if (pf->reverseRoot == NULL) {
+        DNode *node = getEndNode(pf->pool, pf->root, num1);
+        if (node == NULL || !overWriteForwarding(pf->pool, NULL, node, num1, num2)) {
+            if (node != NULL) {
+                removeEmptyRoute(pf->pool, pf->root, num1);
+            }
+            return false;
+        }
+        return true;
     }
-    free(overWrittenNumber);
 
-    DNode *beforeFirstReverseAdded = NULL;
-    DNode *firstReverseAdded = NULL;
-    int firstReverseAddedDigit;
-    DNode *nodeReverse = getEndNode(pf->reverseRoot, &beforeFirstReverseAdded, &firstReverseAdded,
-                                    &firstReverseAddedDigit, num2);
+    DNode *nodeReverse = getEndNode(pf->pool, pf->reverseRoot, num2);
+    if (nodeReverse == NULL) {
+        return false;
+    }
+    if (!addReverse(pf->pool, nodeReverse, num1)) {
+        removeEmptyRoute(pf->pool, pf->reverseRoot, num2);
+        return false;
+    }
 
-    if (nodeReverse == NULL || !addReverse(nodeReverse, beforeFirstReverseAdded, firstReverseAdded,
-                                           firstReverseAddedDigit, num1)) {
-        if (beforeFirstAdded != NULL) {
-            nodeSetNext(beforeFirstAdded, firstAddedDigit, NULL);
+    DNode *node = getEndNode(pf->pool, pf->root, num1);
+    if (node == NULL || !overWriteForwarding(pf->pool, pf->reverseRoot, node, num1, num2)) {
+        if (node != NULL) {
+            removeEmptyRoute(pf->pool, pf->root, num1);
         }
-        deleteIterative(firstAdded);
+        removeReverse(pf->pool, pf->reverseRoot, num2, num1);
         return false;
     }
 
     return true;
 }
 
-void phfwdRemove(PhoneForward *pf, char const *num) {
-    if (pf == NULL || !isNumber(num)) {
-        return;
+/**
+ * @brief Copies the number given with its length to a terminated string.
+ * @param [in] num - pointer to the number, it has to be valid.
+ * @param [in] len - length of the number.
+ * @param [in, out] buffer - buffer of @ref NUMBER_BUFFER_SIZE characters used if the number fits in it.
+ * @return Pointer to the terminated number, it has to be freed if it isn't @p buffer, or NULL if there was an
+ *         allocation error.
+ */
+static char *terminateNumber(char const *num, size_t len, char *buffer) {
+    char *terminated = len < NUMBER_BUFFER_SIZE ? buffer : malloc(len + 1);
+    if (terminated == NULL) {
+        return NULL;
     }
 
-    DNode *node = pf->root;
-    DNode *beforePointToRemove = pf->root;
-    DNode *lastPointToRemove = NULL;
-    int pointToRemoveDigit = 0;
-    size_t i = 0;
-    while (isValidDigit(num[i])) {
-        int digit = toDecimalRepresentation(num[i]);
-        if (nodeGetNext(node, digit) == NULL) {
-            return;
-        }
-        if (nodeGetNumbers(node) != NULL || numberOfChildren(node) > 1 || lastPointToRemove == NULL) {
-            beforePointToRemove = node;
-            pointToRemoveDigit = digit;
-            lastPointToRemove = nodeGetNext(node, digit);
+    memcpy(terminated, num, len);
+    terminated[len] = '\0';
+    return terminated;
+}
+
+/**
+ * @brief Frees the number returned by @ref terminateNumber.
+ * @param [in] terminated - pointer to the terminated number or NULL.
+ * @param [in] buffer - the buffer passed to @ref terminateNumber.
+ */
+static void releaseNumber(char *terminated, char const *buffer) {
+    if (terminated != buffer) {
+        free(terminated);
+    }
+}
+
+/**
+ * @brief Adds a phone forwarding of numbers that were already checked.
+ * @param [in, out] pf - pointer to the modifiable structure containing phone forwarding information.
+ * @param [in] num1 - pointer to the prefix of the phone numbers to be forwarded.
+ * @param [in] num2 - pointer to the different prefix of the phone numbers to be forwarded to.
+ * @return Value @p true if the phone forwarding was added.
+ *         Value @p false if there was an allocation error.
+ */
+static bool addChecked(PhoneForward *pf, char const *num1, char const *num2) {
+    bool result = beginWrite(pf) && (pf->log == NULL || forwardLogPrepare(pf->log, FORWARD_LOG_ADD, num1, num2)) &&
+                  addForwarding(pf, num1, num2);
+    if (result && pf->log != NULL) {
+        forwardLogCommit(pf->log);
+    }
+    endWrite(pf);
+    if (result && pf->cache != NULL) {
+        resultCacheInvalidate(pf->cache, num1, num2);
+    }
+    return result;
+}
+
+bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2) {
+    if (pf == NULL || pf->index != NULL || !checkNumbers(num1, num2)) {
+        return false;
+    }
+
+    return addChecked(pf, num1, num2);
+}
+
+bool phfwdAddN(PhoneForward *pf, char const *num1, size_t len1, char const *num2, size_t len2) {
+    if (pf == NULL || pf->index != NULL || !isNumberOfLength(num1, len1) || !isNumberOfLength(num2, len2) ||
+        (len1 == len2 && memcmp(num1, num2, len1) == 0)) {
+        return false;
+    }
+
+    char buffer1[NUMBER_BUFFER_SIZE], buffer2[NUMBER_BUFFER_SIZE];
+    char *terminated1 = terminateNumber(num1, len1, buffer1);
+    char *terminated2 = terminateNumber(num2, len2, buffer2);
+    bool result = terminated1 != NULL && terminated2 != NULL && addChecked(pf, terminated1, terminated2);
+    releaseNumber(terminated1, buffer1);
+    releaseNumber(terminated2, buffer2);
+    return result;
+}
+
+/**
+ * @struct ReverseForwarding
+ * @brief Phone forwarding used for building the reverse tree by @ref phfwdBuildFromSorted.
+ * @var ReverseForwarding::target
+ *      The number the forwarding leads to.
+ * @var ReverseForwarding::source
+ *      The forwarded number.
+ */
+struct ReverseForwarding {
+    char const *target;
+    char const *source;
+};
+
+/**
+ * @brief Compares two phone forwardings by the numbers they lead to and then by the forwarded numbers.
+ * @param [in] a - pointer to the first @ref ReverseForwarding.
+ * @param [in] b - pointer to the second @ref ReverseForwarding.
+ * @return Negative value if the first forwarding is smaller, positive value if it is greater and 0 if they are
+ *         equal.
+ */
+static int compareReverseForwardings(void const *a, void const *b) {
+    struct ReverseForwarding const *f1 = a;
+    struct ReverseForwarding const *f2 = b;
+
+    int result = compareNumbers(f1->target, f2->target);
+    return result != 0 ? result : compareNumbers(f1->source, f2->source);
+}
+
+/**
+ * @brief Builds the reverse tree of the structure from phone forwardings sorted by the forwarded numbers.
+ * The forwardings that are overwritten by the following ones are skipped, the rest is sorted by the numbers they
+ * lead to and passed to @ref buildReverseTree.
+ * @param [in, out] pf - pointer to the structure with the empty reverse tree.
+ * @param [in] nums1 - array of the forwarded numbers.
+ * @param [in] nums2 - array of the numbers the corresponding numbers of @p nums1 are forwarded to.
+ * @param [in] count - number of the forwardings, greater than 0.
+ * @return Value @p true if the tree was built successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool buildReverseFromSorted(PhoneForward *pf, char const *const *nums1, char const *const *nums2,
+                                   size_t count) {
+    struct ReverseForwarding *forwardings = malloc(count * sizeof(struct ReverseForwarding));
+    if (forwardings == NULL) {
+        return false;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i + 1 == count || !areEqual(nums1[i], nums1[i + 1])) {
+            forwardings[size++] = (struct ReverseForwarding) {nums2[i], nums1[i]};
         }
-        node = nodeGetNext(node, digit);
-        i++;
     }
+    qsort(forwardings, size, sizeof(struct ReverseForwarding), compareReverseForwardings);
 
-    if (beforePointToRemove != NULL) {
-        nodeSetNext(beforePointToRemove, pointToRemoveDigit, NULL);
+    char const **targets = malloc(2 * size * sizeof(char const *));
+    if (targets == NULL) {
+        free(forwardings);
+        return false;
+    }
+    char const **sources = targets + size;
+    for (size_t i = 0; i < size; i++) {
+        targets[i] = forwardings[i].target;
+        sources[i] = forwardings[i].source;
     }
-    deleteIterativeWithReverse(pf->reverseRoot, lastPointToRemove, num);
+    free(forwardings);
+
+    bool result = buildReverseTree(pf->pool, pf->reverseRoot, targets, sources, size);
+    free(targets);
+    return result;
 }
 
-PhoneNumbers *phfwdGet(PhoneForward const *pf, char const *num) {
-    if (pf == NULL) {
+/**
+ * @brief Builds both trees of the empty structure from phone forwardings sorted by the forwarded numbers.
+ * Has to be called while the trees are being modified, in the concurrent mode all the nodes are then created
+ * unpublished.
+ * @param [in, out] pf - pointer to the structure with the empty trees.
+ * @param [in] nums1 - array of the checked forwarded numbers, sorted according to @ref compareNumbers.
+ * @param [in] nums2 - array of the numbers the corresponding numbers of @p nums1 are forwarded to.
+ * @param [in] count - number of the forwardings.
+ * @return Value @p true if the trees were built successfully.
+ *         Value @p false if there was an allocation error, the structure has to be deleted then.
+ */
+static bool buildSorted(PhoneForward *pf, char const *const *nums1, char const *const *nums2, size_t count) {
+    return count == 0 || (buildForwardTree(pf->pool, pf->root, nums1, nums2, count) &&
+                          buildReverseFromSorted(pf, nums1, nums2, count));
+}
+
+PhoneForward *phfwdBuildFromSorted(char const *const *nums1, char const *const *nums2, size_t count) {
+    if (count > 0 && (nums1 == NULL || nums2 == NULL)) {
         return NULL;
     }
 
-    PhoneNumbers *pn = phnumNew();
-    if (pn == NULL) {
+    for (size_t i = 0; i < count; i++) {
+        if (!checkNumbers(nums1[i], nums2[i]) || (i > 0 && compareNumbers(nums1[i - 1], nums1[i]) > 0)) {
+            return NULL;
+        }
+    }
+
+    PhoneForward *pf = phfwdNew();
+    if (pf == NULL) {
         return NULL;
     }
 
-    if (!isNumber(num)) {
-        return pn;
+    if (!buildSorted(pf, nums1, nums2, count)) {
+        phfwdDelete(pf);
+        return NULL;
     }
 
-    char const *maxForwardedPrefix = NULL;
+    return pf;
+}
+
+/**
+ * @brief Drops the cached results the removal of the forwardings of the prefix may have made out of date.
+ * The numbers starting with the removed prefix are now forwarded like the prefix itself, so the results of
+ * @ref phfwdGetReverse starting with its new forwarding are dropped. If there is no memory to determine it, all
+ * results of @ref phfwdGetReverse are dropped.
+ * @param [in, out] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] num - pointer to the removed prefix.
+ */
+static void invalidateRemoved(PhoneForward *pf, char const *num) {
+    PackedNumber const *maxForwardedPrefix = NULL;
     size_t lenOfMaxOriginalPrefix = 0;
     findPrefix(pf->root, num, &maxForwardedPrefix, &lenOfMaxOriginalPrefix);
 
+    char *target = NULL;
+    bool copied = maxForwardedPrefix == NULL
+                      ? copyNumber(num, &target)
+                      : copyPackedParts(num, maxForwardedPrefix, lenOfMaxOriginalPrefix, &target);
+    resultCacheInvalidate(pf->cache, num, copied ? target : "");
+    free(target);
+}
+
+void phfwdRemove(PhoneForward *pf, char const *num) {
+    if (pf == NULL || pf->index != NULL || !isNumber(num)) {
+        return;
+    }
+
+    if (beginWrite(pf) && (pf->log == NULL || forwardLogPrepare(pf->log, FORWARD_LOG_REMOVE, num, NULL)) &&
+        removeForwardWithPrefix(pf->pool, pf->root, pf->reverseRoot, num) && pf->log != NULL) {
+        forwardLogCommit(pf->log);
+    }
+    endWrite(pf);
+    if (pf->cache != NULL) {
+        invalidateRemoved(pf, num);
+    }
+}
+
+/**
+ * @brief Finds the longest prefix of the number that is forwarded to another number.
+ * Uses the flat index if the structure has one and the forward tree otherwise, and counts the lookup.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] root - pointer to the root of the forward tree obtained by @ref beginRead.
+ * @param [in] num - the number.
+ * @param [in, out] maxForwardedPrefix - pointer to the packed number the longest prefix is forwarded to.
+ * @param [in, out] lenOfMaxOriginalPrefix - pointer to the length of the longest forwarded prefix.
+ */
+static void forwardedPrefix(PhoneForward const *pf, DNode *root, char const *num,
+                            PackedNumber const **maxForwardedPrefix, size_t *lenOfMaxOriginalPrefix) {
+    size_t walked = pf->index != NULL ? flatFindPrefix(pf->index, num, maxForwardedPrefix, lenOfMaxOriginalPrefix)
+                                      : findPrefix(root, num, maxForwardedPrefix, lenOfMaxOriginalPrefix);
+    countersAdd(pf->counters, COUNTER_GET_CALLS, 1);
+    countersAdd(pf->counters, COUNTER_DIGITS_WALKED, walked);
+}
+
+/**
+ * @brief Obtains the number after forwarding of a number that was already checked.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] num - pointer to the valid number.
+ * @return Pointer to the sequence containing the number after forwarding or NULL if there was an allocation error.
+ */
+static PhoneNumbers *getChecked(PhoneForward const *pf, char const *num) {
+    PhoneNumbers *pn = phnumNew();
+    if (pn == NULL) {
+        return NULL;
+    }
+
+    PackedNumber const *maxForwardedPrefix = NULL;
+    size_t lenOfMaxOriginalPrefix = 0;
+    struct Roots roots;
+    unsigned token = beginRead(pf, &roots);
+    forwardedPrefix(pf, roots.root, num, &maxForwardedPrefix, &lenOfMaxOriginalPrefix);
+
     char *number = NULL;
-    if (maxForwardedPrefix == NULL) {
-        if (!copyNumber(num, &number)) {
-            phnumDelete(pn);
-            return NULL;
-        }
-    } else {
-        if (!copyParts(num, maxForwardedPrefix, lenOfMaxOriginalPrefix, &number)) {
-            phnumDelete(pn);
-            return NULL;
-        }
+    bool copied = maxForwardedPrefix == NULL
+                      ? copyNumber(num, &number)
+                      : copyPackedParts(num, maxForwardedPrefix, lenOfMaxOriginalPrefix, &number);
+    endRead(pf, token);
+    if (!copied) {
+        phnumDelete(pn);
+        return NULL;
     }
 
     if (!phnumAdd(pn, &number)) {
@@ -167,69 +685,1027 @@ PhoneNumbers *phfwdGet(PhoneForward const *pf, char const *num) {
     return pn;
 }
 
-PhoneNumbers *phfwdReverse(PhoneForward const *pf, char const *num) {
+PhoneNumbers *phfwdGet(PhoneForward const *pf, char const *num) {
     if (pf == NULL) {
         return NULL;
     }
 
-    PhoneNumbers *pn = phnumNew();
-    if (pn == NULL) {
+    return isNumber(num) ? getChecked(pf, num) : phnumNew();
+}
+
+PhoneNumbers *phfwdGetN(PhoneForward const *pf, char const *num, size_t len) {
+    if (pf == NULL) {
         return NULL;
     }
-
-    if (!isNumber(num)) {
-        return pn;
+    if (!isNumberOfLength(num, len)) {
+        return phnumNew();
     }
 
-    if (!addAllFromReverseTree(pf->reverseRoot, num, pn)) {
-        phnumDelete(pn);
-        return NULL;
+    char buffer[NUMBER_BUFFER_SIZE];
+    char *terminated = terminateNumber(num, len, buffer);
+    PhoneNumbers *pn = terminated != NULL ? getChecked(pf, terminated) : NULL;
+    releaseNumber(terminated, buffer);
+    return pn;
+}
+
+size_t phfwdGetInto(PhoneForward const *pf, char const *num, char *buf, size_t bufLen) {
+    if (pf == NULL || !isNumber(num)) {
+        if (bufLen > 0) {
+            buf[0] = '\0';
+        }
+        return 0;
     }
 
-    sortPhoneNumbers(pn);
-    removeDuplicates(pn);
+    PackedNumber const *maxForwardedPrefix = NULL;
+    size_t lenOfMaxOriginalPrefix = 0;
+    struct Roots roots;
+    unsigned token = beginRead(pf, &roots);
+    forwardedPrefix(pf, roots.root, num, &maxForwardedPrefix, &lenOfMaxOriginalPrefix);
 
-    return pn;
+    size_t result = writePackedParts(num, maxForwardedPrefix, lenOfMaxOriginalPrefix, buf, bufLen);
+    endRead(pf, token);
+    return result;
 }
 
-PhoneNumbers *phfwdGetReverse(PhoneForward const *pf, char const *num) {
-    if (pf == NULL) {
-        return NULL;
+size_t phfwdGetBatch(PhoneForward const *pf, char const *const *nums, size_t count, size_t *offsets, char *buf,
+                     size_t bufLen) {
+    if (pf == NULL || nums == NULL || offsets == NULL) {
+        return 0;
     }
 
-    if (!isNumber(num)) {
-        PhoneNumbers *empty = phnumNew();
-        if (empty == NULL) {
-            return NULL;
+    size_t total = 0;
+    size_t looked = 0;
+    size_t walked = 0;
+    struct Roots roots;
+    unsigned token = beginRead(pf, &roots);
+    for (size_t first = 0; first < count; first += GET_BATCH_SIZE) {
+        size_t size = count - first < GET_BATCH_SIZE ? count - first : GET_BATCH_SIZE;
+        char const *valid[GET_BATCH_SIZE];
+        PackedNumber const *maxForwardedPrefix[GET_BATCH_SIZE];
+        size_t lenOfMaxOriginalPrefix[GET_BATCH_SIZE];
+
+        for (size_t i = 0; i < size; i++) {
+            valid[i] = isNumber(nums[first + i]) ? nums[first + i] : NULL;
+            looked += valid[i] != NULL;
+        }
+        if (pf->index != NULL) {
+            walked += flatFindPrefixBatch(pf->index, valid, size, maxForwardedPrefix, lenOfMaxOriginalPrefix);
+        } else {
+            walked += findPrefixBatch(roots.root, valid, size, maxForwardedPrefix, lenOfMaxOriginalPrefix);
         }
 
-        return empty;
+        for (size_t i = 0; i < size; i++) {
+            offsets[first + i] = total;
+            char *result = total < bufLen ? buf + total : NULL;
+            size_t available = total < bufLen ? bufLen - total : 0;
+            size_t len = 0;
+
+            if (valid[i] == NULL) {
+                if (available > 0) {
+                    result[0] = '\0';
+                }
+            } else {
+                len = writePackedParts(valid[i], maxForwardedPrefix[i], lenOfMaxOriginalPrefix[i], result, available);
+            }
+            total += len + 1;
+        }
     }
+    endRead(pf, token);
+    countersAdd(pf->counters, COUNTER_GET_CALLS, looked);
+    countersAdd(pf->counters, COUNTER_DIGITS_WALKED, walked);
 
-    PhoneNumbers *pn = phfwdReverse(pf, num);
-    if (pn == NULL) {
-        return NULL;
+    return total;
+}
+
+/**
+ * @struct ChainBuffer
+ * @brief Memory for a number on the chain of forwardings, kept on the stack until the number gets too long.
+ * @var ChainBuffer::chars
+ *      Pointer to the number, either to @p local or to the allocated memory.
+ * @var ChainBuffer::capacity
+ *      Number of the characters @p chars has memory for.
+ * @var ChainBuffer::local
+ *      Memory for a short number.
+ */
+struct ChainBuffer {
+    char *chars;
+    size_t capacity;
+    char local[NUMBER_BUFFER_SIZE];
+};
+
+/**
+ * @brief Prepares the buffer to store short numbers without allocating.
+ * @param [out] buffer - pointer to the buffer.
+ */
+static void chainBufferInit(struct ChainBuffer *buffer) {
+    buffer->chars = buffer->local;
+    buffer->capacity = NUMBER_BUFFER_SIZE;
+}
+
+/**
+ * @brief Makes sure the buffer can store a number of the given length.
+ * The number kept in the buffer is lost if the buffer is enlarged.
+ * @param [in, out] buffer - pointer to the buffer.
+ * @param [in] length - length of the number.
+ * @return Value @p true if the buffer is big enough.
+ *         Value @p false if there was an allocation error.
+ */
+static bool chainBufferReserve(struct ChainBuffer *buffer, size_t length) {
+    if (length < buffer->capacity) {
+        return true;
     }
 
-    size_t i = 0;
-    while (i < phnumGetSize(pn)) {
-        char const *currentNumber = phnumGet(pn, i);
-        PhoneNumbers *inverse = phfwdGet(pf, currentNumber);
-        if (inverse == NULL) {
-            phnumDelete(pn);
-            return NULL;
-        }
+    size_t capacity = 2 * buffer->capacity > length ? 2 * buffer->capacity : length + 1;
+    char *chars = malloc(capacity);
+    if (chars == NULL) {
+        return false;
+    }
+    if (buffer->chars != buffer->local) {
+        free(buffer->chars);
+    }
+    buffer->chars = chars;
+    buffer->capacity = capacity;
+    return true;
+}
 
-        char const *inverseNumber = phnumGet(inverse, 0);
+/**
+ * @brief Frees the memory allocated by the buffer.
+ * @param [in, out] buffer - pointer to the buffer.
+ */
+static void chainBufferFree(struct ChainBuffer *buffer) {
+    if (buffer->chars != buffer->local) {
+        free(buffer->chars);
+    }
+}
 
-        if (areEqual(inverseNumber, num)) {
-            i++;
-        } else {
-            phnumRemoveAtIndex(pn, i);
-        }
+/**
+ * @brief Applies a single forwarding to the number on the chain.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] root - pointer to the root of the forward tree obtained by @ref beginRead.
+ * @param [in] num - pointer to the valid number.
+ * @param [in, out] next - pointer to the buffer for the number after forwarding.
+ * @param [out] forwarded - pointer to the flag set if a prefix of the number is forwarded.
+ * @return Value @p true if the number after forwarding was written to @p next.
+ *         Value @p false if there was an allocation error.
+ */
+static bool forwardOnChain(PhoneForward const *pf, DNode *root, char const *num, struct ChainBuffer *next,
+                           bool *forwarded) {
+    PackedNumber const *maxForwardedPrefix = NULL;
+    size_t lenOfMaxOriginalPrefix = 0;
+    forwardedPrefix(pf, root, num, &maxForwardedPrefix, &lenOfMaxOriginalPrefix);
 
-        phnumDelete(inverse);
+    size_t length = writePackedParts(num, maxForwardedPrefix, lenOfMaxOriginalPrefix, next->chars, next->capacity);
+    if (length >= next->capacity) {
+        if (!chainBufferReserve(next, length)) {
+            return false;
+        }
+        writePackedParts(num, maxForwardedPrefix, lenOfMaxOriginalPrefix, next->chars, next->capacity);
     }
+    *forwarded = maxForwardedPrefix != NULL;
+    return true;
+}
 
-    return pn;
-}
\ No newline at end of file
+/**
+ * @brief Follows the chain of forwardings of a number that was already checked.
+ * The chain is compared with the number saved at the last power of two of the steps, so a cycle is found within twice
+ * its length after the chain enters it, without remembering the whole chain.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [in] num - pointer to the valid number.
+ * @param [in] maxHops - maximal number of the forwardings applied.
+ * @param [in, out] buffers - pointers to the three buffers used for the chain.
+ * @param [out] result - pointer to the last number of the chain or to NULL if the chain has a cycle.
+ * @return Value @p true if the chain was followed successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool followChain(PhoneForward const *pf, char const *num, size_t maxHops, struct ChainBuffer *buffers,
+                        char const **result) {
+    struct ChainBuffer *current = &buffers[0];
+    struct ChainBuffer *next = &buffers[1];
+    struct ChainBuffer *saved = &buffers[2];
+    size_t length = strlen(num);
+    if (!chainBufferReserve(current, length) || !chainBufferReserve(saved, length)) {
+        return false;
+    }
+    memcpy(current->chars, num, length + 1);
+    memcpy(saved->chars, num, length + 1);
+
+    struct Roots roots;
+    unsigned token = beginRead(pf, &roots);
+    bool success = true;
+    size_t power = 1;
+    size_t sinceSaved = 0;
+    for (size_t hops = 0; hops < maxHops; hops++) {
+        bool forwarded;
+        success = forwardOnChain(pf, roots.root, current->chars, next, &forwarded);
+        if (!success || !forwarded) {
+            break;
+        }
+
+        struct ChainBuffer *swapped = current;
+        current = next;
+        next = swapped;
+        if (areEqual(current->chars, saved->chars)) {
+            endRead(pf, token);
+            *result = NULL;
+            return true;
+        }
+        if (++sinceSaved == power) {
+            length = strlen(current->chars);
+            success = chainBufferReserve(saved, length);
+            if (!success) {
+                break;
+            }
+            memcpy(saved->chars, current->chars, length + 1);
+            power *= 2;
+            sinceSaved = 0;
+        }
+    }
+    endRead(pf, token);
+    *result = current->chars;
+    return success;
+}
+
+PhoneNumbers *phfwdResolve(PhoneForward const *pf, char const *num, size_t maxHops) {
+    if (pf == NULL) {
+        return NULL;
+    }
+
+    PhoneNumbers *pn = phnumNew();
+    if (pn == NULL || !isNumber(num)) {
+        return pn;
+    }
+
+    struct ChainBuffer buffers[3];
+    for (int i = 0; i < 3; i++) {
+        chainBufferInit(&buffers[i]);
+    }
+    char const *last = NULL;
+    char *number = NULL;
+    bool success = followChain(pf, num, maxHops, buffers, &last) &&
+                   (last == NULL || (copyNumber(last, &number) && phnumAdd(pn, &number)));
+    for (int i = 0; i < 3; i++) {
+        chainBufferFree(&buffers[i]);
+    }
+    if (!success) {
+        free(number);
+        phnumDelete(pn);
+        return NULL;
+    }
+    return pn;
+}
+
+/**
+ * @struct CollectedForwardings
+ * @brief Phone forwardings collected in the order of the forwarded numbers.
+ * @var CollectedForwardings::chars
+ *      Buffer with the numbers, each of them terminated with '\0'.
+ * @var CollectedForwardings::size
+ *      Number of the characters of the numbers.
+ * @var CollectedForwardings::capacity
+ *      Number of the characters @p chars has memory for.
+ * @var CollectedForwardings::offsets
+ *      Array of the offsets of the forwarded numbers in @p chars, each of them followed by the number it is forwarded
+ *      to.
+ * @var CollectedForwardings::count
+ *      Number of the forwardings.
+ * @var CollectedForwardings::offsetsCapacity
+ *      Number of the offsets @p offsets has memory for.
+ */
+struct CollectedForwardings {
+    char *chars;
+    size_t size;
+    size_t capacity;
+    size_t *offsets;
+    size_t count;
+    size_t offsetsCapacity;
+};
+
+/**
+ * @brief Adds the visited phone forwarding to the collected ones.
+ * @param [in] num1 - the forwarded number.
+ * @param [in] num2 - the number @p num1 is forwarded to.
+ * @param [in, out] context - pointer to the @ref CollectedForwardings.
+ * @return Value @p true if the forwarding was added.
+ *         Value @p false if there was an allocation error or the numbers are equal.
+ */
+static bool collectForwarding(char const *num1, char const *num2, void *context) {
+    struct CollectedForwardings *forwardings = context;
+    size_t len1 = strlen(num1);
+    size_t len2 = strlen(num2);
+    if (areEqual(num1, num2)) {
+        return false;
+    }
+
+    if (forwardings->capacity - forwardings->size < len1 + len2 + 2) {
+        size_t capacity = forwardings->capacity == 0 ? FIRST_COLLECTED_CAPACITY : 2 * forwardings->capacity;
+        while (capacity - forwardings->size < len1 + len2 + 2) {
+            capacity *= 2;
+        }
+        char *chars = realloc(forwardings->chars, capacity);
+        if (chars == NULL) {
+            return false;
+        }
+        forwardings->chars = chars;
+        forwardings->capacity = capacity;
+    }
+    if (forwardings->count == forwardings->offsetsCapacity) {
+        size_t capacity = forwardings->offsetsCapacity == 0 ? FIRST_COLLECTED_CAPACITY
+                                                             : 2 * forwardings->offsetsCapacity;
+        size_t *offsets = realloc(forwardings->offsets, capacity * sizeof(size_t));
+        if (offsets == NULL) {
+            return false;
+        }
+        forwardings->offsets = offsets;
+        forwardings->offsetsCapacity = capacity;
+    }
+
+    forwardings->offsets[forwardings->count++] = forwardings->size;
+    memcpy(forwardings->chars + forwardings->size, num1, len1 + 1);
+    memcpy(forwardings->chars + forwardings->size + len1 + 1, num2, len2 + 1);
+    forwardings->size += len1 + len2 + 2;
+    return true;
+}
+
+/**
+ * @brief Points to the collected phone forwardings.
+ * @param [in] forwardings - pointer to the collected forwardings.
+ * @return Array of the forwarded numbers followed by the array of the numbers they are forwarded to, which has to be
+ *         freed, or NULL if there was an allocation error.
+ */
+static char const **collectedNumbers(struct CollectedForwardings const *forwardings) {
+    char const **nums = malloc((2 * forwardings->count + 1) * sizeof(char const *));
+    if (nums == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < forwardings->count; i++) {
+        nums[i] = forwardings->chars + forwardings->offsets[i];
+        nums[forwardings->count + i] = nums[i] + strlen(nums[i]) + 1;
+    }
+    return nums;
+}
+
+/**
+ * @brief Builds the reverse tree of the forward-only structure from its forward tree.
+ * The forwardings are collected in the order of the forwarded numbers and passed to @ref buildReverseFromSorted in
+ * a single write, which creates the tree for the readers at once. Does nothing if another thread built it first.
+ * @param [in, out] pf - pointer to the modifiable structure containing phone forwarding information.
+ * @return Value @p true if the reverse tree was built.
+ *         Value @p false if there was an allocation error, the structure stays forward-only then.
+ */
+static bool buildReverseLazily(PhoneForward *pf) {
+    bool result = beginWrite(pf);
+    if (!result || pf->reverseRoot != NULL) {
+        endWrite(pf);
+        return result;
+    }
+
+    struct CollectedForwardings forwardings = {NULL, 0, 0, NULL, 0, 0};
+    result = nodeVisitForwardings(pf->root, "", collectForwarding, &forwardings);
+    char const **nums = result ? collectedNumbers(&forwardings) : NULL;
+    pf->reverseRoot = nums != NULL ? nodeNew(pf->pool) : NULL;
+    result = pf->reverseRoot != NULL &&
+             (forwardings.count == 0 || buildReverseFromSorted(pf, nums, nums + forwardings.count, forwardings.count));
+    if (!result) {
+        deleteIterative(pf->pool, pf->reverseRoot);
+        pf->reverseRoot = NULL;
+    }
+    endWrite(pf);
+    free(nums);
+    free(forwardings.chars);
+    free(forwardings.offsets);
+    return result;
+}
+
+/**
+ * @brief Starts reading the trees of the structure, including the reverse one.
+ * Works like @ref beginRead, but builds the reverse tree first if the structure is forward-only.
+ * @param [in] pf - pointer to the structure containing phone forwarding information.
+ * @param [out] roots - pointer to the roots to read the trees from.
+ * @param [out] token - pointer to the token to pass to @ref endRead.
+ * @return Value @p true if the trees can be read, @ref endRead has to be called then.
+ *         Value @p false if there was an allocation error.
+ */
+static bool beginReverseRead(PhoneForward const *pf, struct Roots *roots, unsigned *token) {
+    *token = beginRead(pf, roots);
+    if (pf->index != NULL || roots->reverseRoot != NULL) {
+        return true;
+    }
+
+    endRead(pf, *token);
+    if (!buildReverseLazily((PhoneForward *) pf)) {
+        return false;
+    }
+    *token = beginRead(pf, roots);
+    return true;
+}
+
+PhoneNumbers *phfwdReverse(PhoneForward const *pf, char const *num) {
+    if (pf == NULL) {
+        return NULL;
+    }
+
+    PhoneNumbers *pn = phnumNew();
+    if (pn == NULL) {
+        return NULL;
+    }
+
+    if (!isNumber(num)) {
+        return pn;
+    }
+
+    struct Roots roots;
+    unsigned token;
+    if (!beginReverseRead(pf, &roots, &token)) {
+        phnumDelete(pn);
+        return NULL;
+    }
+    bool added = pf->index != NULL ? flatAddAllReverse(pf->index, num, false, pn)
+                                   : addAllFromReverseTree(roots.reverseRoot, num, pn);
+    endRead(pf, token);
+    countersAdd(pf->counters, COUNTER_REVERSE_CALLS, 1);
+    if (!added) {
+        phnumDelete(pn);
+        return NULL;
+    }
+
+    if (!sortUniquePhoneNumbers(pn)) {
+        phnumDelete(pn);
+        return NULL;
+    }
+
+    return pn;
+}
+
+PhoneNumbers *phfwdGetReverse(PhoneForward const *pf, char const *num) {
+    if (pf == NULL) {
+        return NULL;
+    }
+    if (!isNumber(num)) {
+        return phnumNew();
+    }
+
+    PhoneNumbers const *cached = pf->cache != NULL ? resultCacheFind(pf->cache, num) : NULL;
+    if (cached != NULL) {
+        countersAdd(pf->counters, COUNTER_GET_REVERSE_CALLS, 1);
+        countersAdd(pf->counters, COUNTER_CACHE_HITS, 1);
+        return phnumCopy(cached);
+    }
+
+    PhoneNumbers *pn = phnumNew();
+    if (pn == NULL) {
+        return NULL;
+    }
+
+    struct Roots roots;
+    unsigned token;
+    if (!beginReverseRead(pf, &roots, &token)) {
+        phnumDelete(pn);
+        return NULL;
+    }
+    bool added = pf->index != NULL ? flatAddAllReverse(pf->index, num, true, pn)
+                                   : addAllInverseFromReverseTree(roots.reverseRoot, roots.root, num, pn);
+    endRead(pf, token);
+    countersAdd(pf->counters, COUNTER_GET_REVERSE_CALLS, 1);
+    if (!added) {
+        phnumDelete(pn);
+        return NULL;
+    }
+
+    if (!sortUniquePhoneNumbers(pn)) {
+        phnumDelete(pn);
+        return NULL;
+    }
+    if (pf->cache != NULL) {
+        resultCacheStore(pf->cache, num, pn);
+    }
+
+    return pn;
+}
+
+PhoneReverseCursor *phfwdReverseCursorNew(PhoneForward const *pf, char const *num) {
+    if (pf == NULL) {
+        return NULL;
+    }
+
+    PhoneReverseCursor *cursor = malloc(sizeof(PhoneReverseCursor));
+    if (cursor == NULL) {
+        return NULL;
+    }
+    cursor->pf = pf;
+    cursor->cursor = NULL;
+    cursor->token = 0;
+    if (!isNumber(num)) {
+        return cursor;
+    }
+
+    struct Roots roots;
+    if (!beginReverseRead(pf, &roots, &cursor->token)) {
+        free(cursor);
+        return NULL;
+    }
+    cursor->cursor = reverseCursorNew(roots.reverseRoot, pf->index, num);
+    countersAdd(pf->counters, COUNTER_REVERSE_CALLS, 1);
+    if (cursor->cursor == NULL) {
+        endRead(pf, cursor->token);
+        free(cursor);
+        return NULL;
+    }
+    return cursor;
+}
+
+bool phfwdReverseCursorNext(PhoneReverseCursor *cursor, char const **num) {
+    if (cursor == NULL || num == NULL) {
+        return false;
+    }
+    if (cursor->cursor == NULL) {
+        *num = NULL;
+        return true;
+    }
+    return reverseCursorNext(cursor->cursor, num);
+}
+
+void phfwdReverseCursorDelete(PhoneReverseCursor *cursor) {
+    if (cursor == NULL) {
+        return;
+    }
+    if (cursor->cursor != NULL) {
+        reverseCursorDelete(cursor->cursor);
+        endRead(cursor->pf, cursor->token);
+    }
+    free(cursor);
+}
+
+bool phfwdReverseVisit(PhoneForward const *pf, char const *num, PhoneNumberVisitor visit, void *context) {
+    if (visit == NULL) {
+        return false;
+    }
+
+    PhoneReverseCursor *cursor = phfwdReverseCursorNew(pf, num);
+    if (cursor == NULL) {
+        return false;
+    }
+
+    char const *number;
+    bool result;
+    do {
+        result = phfwdReverseCursorNext(cursor, &number);
+    } while (result && number != NULL && visit(number, context));
+    phfwdReverseCursorDelete(cursor);
+    return result;
+}
+
+size_t phfwdReverseCount(PhoneForward const *pf, char const *num) {
+    if (pf == NULL || !isNumber(num)) {
+        return 0;
+    }
+
+    struct Roots roots;
+    unsigned token;
+    if (!beginReverseRead(pf, &roots, &token)) {
+        return 0;
+    }
+    size_t count = reverseCount(roots.reverseRoot, pf->index, num);
+    endRead(pf, token);
+    countersAdd(pf->counters, COUNTER_REVERSE_CALLS, 1);
+    return count;
+}
+
+/**
+ * @struct ListedForwardings
+ * @brief The visitor of the listed phone forwardings.
+ * @var ListedForwardings::visit
+ *      The function called for every forwarding.
+ * @var ListedForwardings::context
+ *      Pointer passed to @p visit.
+ * @var ListedForwardings::stopped
+ *      Whether @p visit stopped the visiting.
+ */
+struct ListedForwardings {
+    PhoneForwardingVisitor visit;
+    void *context;
+    bool stopped;
+};
+
+/**
+ * @brief Passes the listed phone forwarding to the visitor of @ref phfwdList.
+ * @param [in] num1 - the forwarded number.
+ * @param [in] num2 - the number @p num1 is forwarded to.
+ * @param [in, out] context - pointer to the @ref ListedForwardings.
+ * @return Value @p true if the visiting should continue.
+ *         Value @p false if the visitor stopped it.
+ */
+static bool listForwarding(char const *num1, char const *num2, void *context) {
+    struct ListedForwardings *listed = context;
+    listed->stopped = !listed->visit(num1, num2, listed->context);
+    return !listed->stopped;
+}
+
+bool phfwdList(PhoneForward const *pf, char const *prefix, PhoneForwardingVisitor visit, void *context) {
+    if (pf == NULL || prefix == NULL || visit == NULL) {
+        return false;
+    }
+    if (prefix[0] != '\0' && !isNumber(prefix)) {
+        return true;
+    }
+
+    struct ListedForwardings listed = {visit, context, false};
+    struct Roots roots;
+    unsigned token = beginRead(pf, &roots);
+    bool result = pf->index != NULL ? flatVisitForwardings(pf->index, prefix, listForwarding, &listed)
+                                    : nodeVisitForwardings(roots.root, prefix, listForwarding, &listed);
+    endRead(pf, token);
+    return result || listed.stopped;
+}
+
+/**
+ * @struct DiffedForwardings
+ * @brief The visitor of the differences between two structures.
+ * @var DiffedForwardings::visit
+ *      The function called for every difference.
+ * @var DiffedForwardings::context
+ *      Pointer passed to @p visit.
+ * @var DiffedForwardings::stopped
+ *      Whether @p visit stopped the visiting.
+ */
+struct DiffedForwardings {
+    PhoneForwardDiffVisitor visit;
+    void *context;
+    bool stopped;
+};
+
+/**
+ * @brief Passes the difference to the visitor of the differences.
+ * @param [in] num1 - the forwarded number.
+ * @param [in] before - the number @p num1 is forwarded to in the first structure or NULL.
+ * @param [in] after - the number @p num1 is forwarded to in the second structure or NULL.
+ * @param [in, out] context - pointer to the @ref DiffedForwardings.
+ * @return Value @p true if the visiting should continue.
+ *         Value @p false if it should stop.
+ */
+static bool diffForwarding(char const *num1, char const *before, char const *after, void *context) {
+    struct DiffedForwardings *diffed = context;
+    diffed->stopped = !diffed->visit(num1, before, after, diffed->context);
+    return !diffed->stopped;
+}
+
+bool phfwdDiff(PhoneForward const *pf1, PhoneForward const *pf2, PhoneForwardDiffVisitor visit, void *context) {
+    if (pf1 == NULL || pf2 == NULL || visit == NULL || pf1->index != NULL || pf2->index != NULL) {
+        return false;
+    }
+
+    struct DiffedForwardings diffed = {visit, context, false};
+    struct Roots roots1, roots2;
+    unsigned token1 = beginRead(pf1, &roots1);
+    unsigned token2 = beginRead(pf2, &roots2);
+    bool result = nodeDiffForwardings(roots1.root, roots2.root, diffForwarding, &diffed);
+    endRead(pf2, token2);
+    endRead(pf1, token1);
+    return result || diffed.stopped;
+}
+
+/**
+ * @brief Applies a single change of a difference to the structure that is being modified.
+ * @param [in, out] pf - pointer to the modifiable structure containing phone forwarding information.
+ * @param [in] num1 - pointer to the checked forwarded number.
+ * @param [in] num2 - pointer to the checked number @p num1 is forwarded to or NULL if its forwarding is removed.
+ * @return Value @p true if the change was applied.
+ *         Value @p false if there was an allocation error.
+ */
+static bool applyChange(PhoneForward *pf, char const *num1, char const *num2) {
+    bool result = num2 == NULL ? (pf->log == NULL || forwardLogPrepare(pf->log, FORWARD_LOG_CLEAR, num1, NULL)) &&
+                                     removeForwarding(pf->pool, pf->root, pf->reverseRoot, num1)
+                               : (pf->log == NULL || forwardLogPrepare(pf->log, FORWARD_LOG_ADD, num1, num2)) &&
+                                     addForwarding(pf, num1, num2);
+    if (result && pf->log != NULL) {
+        forwardLogCommit(pf->log);
+    }
+    return result;
+}
+
+bool phfwdApplyDiff(PhoneForward *pf, char const *const *nums1, char const *const *nums2, size_t count) {
+    if (pf == NULL || pf->index != NULL || (count > 0 && (nums1 == NULL || nums2 == NULL))) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (nums2[i] == NULL ? !isNumber(nums1[i]) : !checkNumbers(nums1[i], nums2[i])) {
+            return false;
+        }
+    }
+
+    size_t applied = 0;
+    if (beginWrite(pf)) {
+        while (applied < count && applyChange(pf, nums1[applied], nums2[applied])) {
+            applied++;
+        }
+    }
+    endWrite(pf);
+
+    if (pf->cache != NULL) {
+        for (size_t i = 0; i < applied; i++) {
+            if (nums2[i] == NULL) {
+                invalidateRemoved(pf, nums1[i]);
+            } else {
+                resultCacheInvalidate(pf->cache, nums1[i], nums2[i]);
+            }
+        }
+    }
+    return applied == count;
+}
+
+bool phfwdFreeze(PhoneForward *pf) {
+    if (pf == NULL || pf->concurrent || pf->log != NULL) {
+        return false;
+    }
+    if (pf->index != NULL) {
+        return true;
+    }
+    if (pf->reverseRoot == NULL && !buildReverseLazily(pf)) {
+        return false;
+    }
+
+    pf->index = flatIndexBuild(pf->root, pf->reverseRoot);
+    if (pf->index == NULL) {
+        return false;
+    }
+
+    nodePoolLeave(pf->pool, pf->root, pf->reverseRoot);
+    pf->pool = NULL;
+    pf->root = NULL;
+    pf->reverseRoot = NULL;
+    return true;
+}
+
+bool phfwdSave(PhoneForward const *pf, char const *path) {
+    if (pf == NULL || path == NULL) {
+        return false;
+    }
+
+    if (pf->index != NULL) {
+        return flatIndexSave(pf->index, path);
+    }
+
+    struct Roots roots;
+    unsigned token;
+    if (!beginReverseRead(pf, &roots, &token)) {
+        return false;
+    }
+    FlatIndex *index = flatIndexBuild(roots.root, roots.reverseRoot);
+    endRead(pf, token);
+    if (index == NULL) {
+        return false;
+    }
+    bool result = flatIndexSave(index, path);
+    flatIndexDelete(index);
+    return result;
+}
+
+PhoneForward *phfwdLoadMapped(char const *path) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    PhoneForward *pf = malloc(sizeof(PhoneForward));
+    if (pf == NULL) {
+        return NULL;
+    }
+
+    pf->counters = countersNew();
+    pf->index = flatIndexMap(path);
+    if (pf->counters == NULL || pf->index == NULL) {
+        countersDelete(pf->counters);
+        flatIndexDelete(pf->index);
+        free(pf);
+        return NULL;
+    }
+    pf->root = NULL;
+    pf->reverseRoot = NULL;
+    pf->pool = NULL;
+    pf->cache = NULL;
+    pf->log = NULL;
+    pf->snapshotPath = NULL;
+    pf->compacting = false;
+    pf->compacted = true;
+    pf->concurrent = false;
+    pf->nextRoots = NULL;
+    atomic_init(&pf->published, NULL);
+    return pf;
+}
+
+/**
+ * @brief Builds the trees of the empty structure from the snapshot, if it exists.
+ * Has to be called while the trees are being modified.
+ * @param [in, out] pf - pointer to the structure with the empty trees.
+ * @param [in] path - path of the snapshot.
+ * @return Value @p true if the trees were built or the snapshot doesn't exist.
+ *         Value @p false if there was an allocation error or the snapshot isn't a valid image.
+ */
+static bool loadSnapshot(PhoneForward *pf, char const *path) {
+    FlatIndex *index = flatIndexMap(path);
+    if (index == NULL) {
+        struct stat fileStat;
+        return stat(path, &fileStat) != 0 && errno == ENOENT;
+    }
+
+    struct CollectedForwardings forwardings = {NULL, 0, 0, NULL, 0, 0};
+    bool result = flatVisitForwardings(index, "", collectForwarding, &forwardings);
+    flatIndexDelete(index);
+
+    char const **nums = result ? collectedNumbers(&forwardings) : NULL;
+    if (nums != NULL) {
+        result = buildSorted(pf, nums, nums + forwardings.count, forwardings.count);
+    }
+    free(nums);
+    free(forwardings.chars);
+    free(forwardings.offsets);
+    return nums != NULL && result;
+}
+
+/**
+ * @brief Replays the record of the log.
+ * Has to be called while the trees are being modified.
+ * @param [in] type - the type of the record.
+ * @param [in] num1 - the forwarded number or the removed prefix.
+ * @param [in] num2 - the number @p num1 is forwarded to or NULL.
+ * @param [in, out] context - pointer to the structure.
+ * @return Value @p true if the record was replayed.
+ *         Value @p false if there was an allocation error or the record adds a forwarding of a number to itself.
+ */
+static bool replayRecord(int type, char const *num1, char const *num2, void *context) {
+    PhoneForward *pf = context;
+    if (type == FORWARD_LOG_ADD) {
+        return !areEqual(num1, num2) && addForwarding(pf, num1, num2);
+    }
+    if (type == FORWARD_LOG_CLEAR) {
+        return removeForwarding(pf->pool, pf->root, pf->reverseRoot, num1);
+    }
+    return removeForwardWithPrefix(pf->pool, pf->root, pf->reverseRoot, num1);
+}
+
+/**
+ * @brief Creates a structure from the snapshot and the log and starts logging its changes.
+ * The snapshot is loaded and the log replayed in a single write, so in the concurrent mode the nodes are published
+ * only once.
+ * @param [in] concurrent - whether the structure can be read by many threads at once.
+ * @param [in] snapshotPath - path of the snapshot.
+ * @param [in] logPath - path of the log.
+ * @param [in] syncEvery - number of the changes flushed to the disk together.
+ * @return Pointer to the new structure or NULL if there was an error.
+ */
+static PhoneForward *recoverStructure(bool concurrent, char const *snapshotPath, char const *logPath,
+                                      size_t syncEvery) {
+    if (snapshotPath == NULL || logPath == NULL) {
+        return NULL;
+    }
+
+    PhoneForward *pf = newStructure(concurrent ? PHFWD_CONCURRENT : 0);
+    if (pf == NULL) {
+        return NULL;
+    }
+
+    pf->snapshotPath = malloc(strlen(snapshotPath) + 1);
+    if (pf->snapshotPath != NULL) {
+        strcpy(pf->snapshotPath, snapshotPath);
+    }
+    if (pf->snapshotPath != NULL && beginWrite(pf) && loadSnapshot(pf, snapshotPath)) {
+        pf->log = forwardLogOpen(logPath, syncEvery, replayRecord, pf);
+    }
+    endWrite(pf);
+    if (pf->log == NULL) {
+        phfwdDelete(pf);
+        return NULL;
+    }
+    return pf;
+}
+
+PhoneForward *phfwdRecover(char const *snapshotPath, char const *logPath, size_t syncEvery) {
+    return recoverStructure(false, snapshotPath, logPath, syncEvery);
+}
+
+PhoneForward *phfwdRecoverConcurrent(char const *snapshotPath, char const *logPath, size_t syncEvery) {
+    return recoverStructure(true, snapshotPath, logPath, syncEvery);
+}
+
+bool phfwdSyncLog(PhoneForward *pf) {
+    if (pf == NULL || pf->log == NULL) {
+        return false;
+    }
+
+    if (pf->concurrent) {
+        nodePoolLock(pf->pool);
+    }
+    bool result = forwardLogSync(pf->log);
+    if (pf->concurrent) {
+        nodePoolUnlock(pf->pool);
+    }
+    return result;
+}
+
+/**
+ * @brief Saves the structure to a new snapshot, which then replaces the old one.
+ * @param [in] pf - pointer to the structure with a log.
+ * @return Value @p true if the snapshot was replaced.
+ *         Value @p false if there was an allocation error or the snapshot couldn't be written.
+ */
+static bool writeSnapshot(PhoneForward const *pf) {
+    char *temporary = malloc(strlen(pf->snapshotPath) + sizeof(".tmp"));
+    if (temporary == NULL) {
+        return false;
+    }
+    sprintf(temporary, "%s.tmp", pf->snapshotPath);
+
+    bool result = phfwdSave(pf, temporary) && forwardLogReplaceFile(temporary, pf->snapshotPath);
+    if (!result) {
+        remove(temporary);
+    }
+    free(temporary);
+    return result;
+}
+
+/**
+ * @brief Folds the log into a new snapshot, the function run by the thread started by @ref phfwdCompact.
+ * The snapshot is written while the writers go on, only the records before the position saved when the folding
+ * started are then removed from the log.
+ * @param [in, out] context - pointer to the structure.
+ * @return NULL.
+ */
+static void *compactInBackground(void *context) {
+    PhoneForward *pf = context;
+    bool result = writeSnapshot(pf);
+    nodePoolLock(pf->pool);
+    pf->compacted = result && forwardLogDropBefore(pf->log, pf->compactEnd);
+    nodePoolUnlock(pf->pool);
+    return NULL;
+}
+
+bool phfwdCompact(PhoneForward *pf) {
+    if (pf == NULL || pf->log == NULL || pf->compacting) {
+        return false;
+    }
+
+    if (!pf->concurrent) {
+        uint64_t end = forwardLogEnd(pf->log);
+        pf->compacted = writeSnapshot(pf) && forwardLogDropBefore(pf->log, end);
+        return pf->compacted;
+    }
+
+    nodePoolLock(pf->pool);
+    pf->compactEnd = forwardLogEnd(pf->log);
+    nodePoolUnlock(pf->pool);
+    pf->compacting = pthread_create(&pf->compactor, NULL, compactInBackground, pf) == 0;
+    return pf->compacting;
+}
+
+bool phfwdCompactWait(PhoneForward *pf) {
+    if (pf == NULL) {
+        return false;
+    }
+
+    if (pf->compacting) {
+        pthread_join(pf->compactor, NULL);
+        pf->compacting = false;
+    }
+    return pf->compacted;
+}
+
+bool phfwdStats(PhoneForward const *pf, PhoneForwardStats *stats) {
+    if (pf == NULL || stats == NULL) {
+        return false;
+    }
+
+    *stats = (PhoneForwardStats) {0};
+    bool result = true;
+    if (pf->index != NULL) {
+        flatIndexStats(pf->index, stats);
+    } else {
+        struct Roots roots;
+        unsigned token = beginRead(pf, &roots);
+        result = nodeTreeStats(roots.root, &stats->forward, stats) &&
+                 (roots.reverseRoot == NULL || nodeTreeStats(roots.reverseRoot, &stats->reverse, stats));
+        nodePoolStats(pf->pool, stats);
+        endRead(pf, token);
+    }
+
+    stats->getCalls = countersGet(pf->counters, COUNTER_GET_CALLS);
+    stats->reverseCalls = countersGet(pf->counters, COUNTER_REVERSE_CALLS);
+    stats->getReverseCalls = countersGet(pf->counters, COUNTER_GET_REVERSE_CALLS);
+    stats->digitsWalked = countersGet(pf->counters, COUNTER_DIGITS_WALKED);
+    stats->nodeAllocations = countersGet(pf->counters, COUNTER_NODE_ALLOCATIONS);
+    stats->nodeFrees = countersGet(pf->counters, COUNTER_NODE_FREES);
+    stats->cacheHits = countersGet(pf->counters, COUNTER_CACHE_HITS);
+    return result;
+}
+
+bool phfwdEnableCache(PhoneForward *pf, size_t capacity) {
+    if (pf == NULL || pf->concurrent) {
+        return false;
+    }
+
+    ResultCache *cache = NULL;
+    if (capacity > 0 && (cache = resultCacheNew(capacity)) == NULL) {
+        return false;
+    }
+    resultCacheDelete(pf->cache);
+    pf->cache = cache;
+    return true;
+}
@@ -11,6 +11,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * This is a structure containing phone forwarding information.
@@ -24,12 +25,167 @@ typedef struct PhoneForward PhoneForward; /**< Type of structure containing phon
 struct PhoneNumbers;
 typedef struct PhoneNumbers PhoneNumbers; /**< Type of structure containing a sequence of phone numbers. */
 
+/**
+ * This is a structure containing the position in the results of @ref phfwdReverse.
+ */
+struct PhoneReverseCursor;
+typedef struct PhoneReverseCursor PhoneReverseCursor; /**< Type of structure containing the position in results. */
+
+/**
+ * @brief Function called for every visited phone number.
+ * @param[in] num     – pointer to the string containing the phone number, valid only during the call.
+ * @param[in] context – pointer passed to the function visiting the numbers.
+ * @return Value @p true if the visiting should continue, value @p false if it should stop.
+ */
+typedef bool (*PhoneNumberVisitor)(char const *num, void *context);
+
+/**
+ * @brief Function called for every visited phone forwarding.
+ * @param[in] num1    – pointer to the string containing the forwarded prefix, valid only during
+ *                      the call.
+ * @param[in] num2    – pointer to the string containing the prefix @p num1 is forwarded to,
+ *                      valid only during the call.
+ * @param[in] context – pointer passed to the function visiting the forwardings.
+ * @return Value @p true if the visiting should continue, value @p false if it should stop.
+ */
+typedef bool (*PhoneForwardingVisitor)(char const *num1, char const *num2, void *context);
+
+/**
+ * @brief Function called for every phone forwarding that differs between two structures.
+ * @param[in] num1    – pointer to the string containing the forwarded prefix, valid only during
+ *                      the call.
+ * @param[in] before  – pointer to the string containing the prefix @p num1 is forwarded to in
+ *                      the first structure or NULL if it isn't forwarded there, valid only during
+ *                      the call.
+ * @param[in] after   – pointer to the string containing the prefix @p num1 is forwarded to in
+ *                      the second structure or NULL if it isn't forwarded there, valid only
+ *                      during the call.
+ * @param[in] context – pointer passed to the function comparing the structures.
+ * @return Value @p true if the visiting should continue, value @p false if it should stop.
+ */
+typedef bool (*PhoneForwardDiffVisitor)(char const *num1, char const *before, char const *after, void *context);
+
+#define PHFWD_STATS_DEPTHS 32 /**< Number of depths in the histograms, the last one counts all deeper nodes. */
+#define PHFWD_STATS_FAN_OUTS 13 /**< Number of different numbers of children of a node. */
+
+/**
+ * @struct PhoneForwardTreeStats
+ * @brief Shape of a single forwarding tree.
+ * @var PhoneForwardTreeStats::nodes
+ *      Number of the nodes of the tree.
+ * @var PhoneForwardTreeStats::depths
+ *      Number of the nodes at each depth, the root is at depth 0.
+ * @var PhoneForwardTreeStats::fanOuts
+ *      Number of the nodes with each number of children.
+ */
+typedef struct PhoneForwardTreeStats {
+    size_t nodes;
+    size_t depths[PHFWD_STATS_DEPTHS];
+    size_t fanOuts[PHFWD_STATS_FAN_OUTS];
+} PhoneForwardTreeStats;
+
+/**
+ * @struct PhoneForwardStats
+ * @brief Memory used by the structure and the operations run on it.
+ * @var PhoneForwardStats::forward
+ *      Shape of the tree of phone forwarding.
+ * @var PhoneForwardStats::reverse
+ *      Shape of the tree of reverse phone forwarding.
+ * @var PhoneForwardStats::sourceTreeNodes
+ *      Number of the nodes of the trees storing the biggest sets of numbers of the reverse tree.
+ * @var PhoneForwardStats::nodeBytes
+ *      Number of the bytes taken by all the nodes and their arrays of children.
+ * @var PhoneForwardStats::numbersBytes
+ *      Number of the bytes taken by the sequences of numbers of the reverse tree.
+ * @var PhoneForwardStats::stringBytes
+ *      Number of the bytes taken by the numbers stored outside of the nodes, each distinct number is counted once.
+ * @var PhoneForwardStats::largestReverseBucket
+ *      Number of the numbers forwarded to the number with the most of them.
+ * @var PhoneForwardStats::getCalls
+ *      Number of the numbers whose forwarding was determined, by any of the functions getting it.
+ * @var PhoneForwardStats::reverseCalls
+ *      Number of the calls of @ref phfwdReverse, @ref phfwdReverseCursorNew and @ref phfwdReverseCount.
+ * @var PhoneForwardStats::getReverseCalls
+ *      Number of the calls of @ref phfwdGetReverse.
+ * @var PhoneForwardStats::digitsWalked
+ *      Number of the digits of the queried numbers followed down the trees by these functions.
+ * @var PhoneForwardStats::nodeAllocations
+ *      Number of the nodes allocated for the trees.
+ * @var PhoneForwardStats::nodeFrees
+ *      Number of the nodes of the trees freed before the structure was deleted.
+ * @var PhoneForwardStats::cacheHits
+ *      Number of the calls answered from the cache enabled by @ref phfwdEnableCache.
+ */
+typedef struct PhoneForwardStats {
+    PhoneForwardTreeStats forward;
+    PhoneForwardTreeStats reverse;
+    size_t sourceTreeNodes;
+    size_t nodeBytes;
+    size_t numbersBytes;
+    size_t stringBytes;
+    size_t largestReverseBucket;
+    uint64_t getCalls;
+    uint64_t reverseCalls;
+    uint64_t getReverseCalls;
+    uint64_t digitsWalked;
+    uint64_t nodeAllocations;
+    uint64_t nodeFrees;
+    uint64_t cacheHits;
+} PhoneForwardStats;
+
 /** @brief Creates new structure.
  * Creates new structure without any phone forwarding information.
  * @return Pointer to the new structure or NULL if there was an allocation error.
  */
 PhoneForward * phfwdNew(void);
 
+/** @brief Creates new structure that can be read by many threads at once.
+ * Works like @ref phfwdNew, but @ref phfwdGet, @ref phfwdGetInto, @ref phfwdGetBatch,
+ * @ref phfwdResolve, @ref phfwdReverse, @ref phfwdGetReverse, @ref phfwdList and @ref phfwdSave
+ * may be called by any number of threads without locks, also while @ref phfwdAdd or
+ * @ref phfwdRemove is running. Writers are serialized with a mutex, they copy the nodes on the changed routes
+ * instead of changing them in place and publish the new roots atomically, so every reader sees
+ * the state from before or after each write. The replaced memory is freed once no reader can
+ * see it. In exchange a write takes more time and memory, and if the copies can't be
+ * allocated, @ref phfwdRemove leaves the forwardings in place. The structure can't be frozen.
+ * @return Pointer to the new structure or NULL if there was an allocation error.
+ */
+PhoneForward * phfwdNewConcurrent(void);
+
+#define PHFWD_CONCURRENT 1 /**< The structure is created like by @ref phfwdNewConcurrent. */
+#define PHFWD_FORWARD_ONLY 2 /**< The tree of reverse phone forwarding isn't kept until it's needed. */
+
+/** @brief Creates new structure with the given options.
+ * Works like @ref phfwdNew, or like @ref phfwdNewConcurrent with @ref PHFWD_CONCURRENT. With
+ * @ref PHFWD_FORWARD_ONLY the reverse tree isn't built, so @ref phfwdAdd and @ref phfwdRemove
+ * only change the forward tree, they are faster and the forwardings take less memory. The first
+ * call of @ref phfwdReverse, @ref phfwdGetReverse, @ref phfwdReverseCursorNew,
+ * @ref phfwdReverseVisit, @ref phfwdReverseCount, @ref phfwdSave or @ref phfwdFreeze builds the
+ * whole reverse tree at once from the forward tree, and from then on it is kept like in a
+ * structure created without the option. In the concurrent mode that call takes the writer
+ * mutex, otherwise it changes the structure, so it mustn't run at the same time as any other
+ * call for it.
+ * @param[in] options – bitwise alternative of @ref PHFWD_CONCURRENT and @ref PHFWD_FORWARD_ONLY.
+ * @return Pointer to the new structure or NULL if there was an allocation error or @p options
+ *         contains an unknown option.
+ */
+PhoneForward * phfwdNewWithOptions(unsigned options);
+
+/** @brief Creates a copy of the structure sharing its trees.
+ * The copy holds the same forwardings as @p pf and is created in constant time, as both
+ * structures use the same nodes. From then on each of them is changed independently: a write
+ * copies only the nodes on the routes it changes and the nodes no longer used by any of the
+ * structures are freed. The writes of all the copies are serialized with a single mutex, so the
+ * copy can be changed while @p pf is read or changed by another thread. The copy is concurrent
+ * if @p pf is, it is forward-only while @p pf is, and it has no cache and no log. A structure
+ * that wasn't concurrent copies the nodes like a concurrent one once it's cloned, so if the
+ * copies can't be allocated, @ref phfwdRemove leaves the forwardings in place.
+ * @param[in] pf – pointer to the structure to be copied.
+ * @return Pointer to the copy or NULL if there was an allocation error, the pointer is NULL or
+ *         the structure was frozen or loaded with @ref phfwdLoadMapped.
+ */
+PhoneForward * phfwdClone(PhoneForward const *pf);
+
 /** @brief Deletes the structure.
  * Deletes the structure pointed by @p pf. Does nothing when the pointer is NULL.
  * @param[in] pf – pointer to the structure to be deleted.
@@ -50,6 +206,35 @@ void phfwdDelete(PhoneForward *pf);
  */
 bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2);
 
+/** @brief Adds a phone forwarding of numbers given with their lengths.
+ * Works like @ref phfwdAdd, but the numbers are the first @p len1 characters of @p num1
+ * and the first @p len2 characters of @p num2, which don't have to be terminated, and no
+ * character after them is read. Each number is checked in a single pass.
+ * @param[in,out] pf – pointer to the structure containing phone forwarding information.
+ * @param[in] num1   – pointer to the prefix of the phone numbers to be forwarded.
+ * @param[in] len1   – length of @p num1.
+ * @param[in] num2   – pointer to the prefix of the phone numbers to be forwarded to.
+ * @param[in] len2   – length of @p num2.
+ * @return Value @p true, if the phone forwarding was added.
+ *         Value @p false, if an error occurred, like in @ref phfwdAdd.
+ */
+bool phfwdAddN(PhoneForward *pf, char const *num1, size_t len1, char const *num2, size_t len2);
+
+/** @brief Creates a new structure from many phone forwardings at once.
+ * Works like @ref phfwdNew followed by @ref phfwdAdd for each pair of @p nums1[i] and
+ * @p nums2[i], in order, but the numbers @p nums1 have to be sorted lexicographically, with the
+ * digits ordered 0, 1, ..., 9, *, #. Both trees of forwardings are built in a single pass over
+ * the sorted numbers and the numbers forwarded to the same number are grouped together.
+ * If a number is forwarded more than once, the last forwarding is kept.
+ * @param[in] nums1 – array of pointers to the prefixes of the phone numbers to be forwarded.
+ * @param[in] nums2 – array of pointers to the prefixes of the phone numbers to be forwarded to.
+ * @param[in] count – number of the phone forwardings.
+ * @return Pointer to the new structure or NULL if there was an allocation error, one of the
+ *         pairs of numbers couldn't be added by @ref phfwdAdd or the numbers @p nums1 aren't
+ *         sorted.
+ */
+PhoneForward * phfwdBuildFromSorted(char const *const *nums1, char const *const *nums2, size_t count);
+
 /** @brief Deletes a phone forwarding.
  * Deletes all phone forwards, in which parameter @p num is a prefix
  * of parameter @p num1 used while adding. If no such phone forwarding was added, the
@@ -72,6 +257,72 @@ void phfwdRemove(PhoneForward *pf, char const *num);
  */
 PhoneNumbers * phfwdGet(PhoneForward const *pf, char const *num);
 
+/** @brief Obtains the number after forwarding of a number given with its length.
+ * Works like @ref phfwdGet, but the number is the first @p len characters of @p num, which
+ * don't have to be terminated, and no character after them is read.
+ * @param[in] pf  – pointer to the structure containing phone forwarding information.
+ * @param[in] num – pointer to the string containing the phone number to be forwarded.
+ * @param[in] len – length of the number.
+ * @return Pointer to the structure containing the sequence of phone numbers or NULL if
+ *         there was an allocation error or the given structure is NULL.
+ */
+PhoneNumbers * phfwdGetN(PhoneForward const *pf, char const *num, size_t len);
+
+/** @brief Obtains the number after forwarding without allocating memory.
+ * Works like @ref phfwdGet, but writes the result to the buffer @p buf provided by the caller
+ * instead of allocating a structure. If the buffer is too small, the result is truncated to
+ * @p bufLen - 1 characters. The result is always terminated with '\0', unless @p bufLen is 0.
+ * If the given string doesn't represent a number or @p pf is NULL, the result is an empty string.
+ * @param[in] pf      – pointer to the structure containing phone forwarding information.
+ * @param[in] num     – pointer to the string containing the phone number to be forwarded.
+ * @param[out] buf    – pointer to the buffer for the result.
+ * @param[in] bufLen  – size of the buffer.
+ * @return Length of the number after forwarding, not including the terminating '\0'. If it
+ *         isn't smaller than @p bufLen, the result was truncated and a buffer of at least the
+ *         returned length plus one is required. Value 0 if the result is empty.
+ */
+size_t phfwdGetInto(PhoneForward const *pf, char const *num, char *buf, size_t bufLen);
+
+/** @brief Obtains the numbers after forwarding for many numbers at once.
+ * Works like @ref phfwdGet for each of the @p count numbers from the array @p nums, walking the
+ * forwarding tree for several numbers at the same time. The results are written to the buffer
+ * @p buf one after another, each terminated with '\0', and the offset of the i-th result in the
+ * buffer is stored in @p offsets[i]. If the i-th string doesn't represent a number, its result is
+ * an empty string. If the buffer is too small, the results that don't fit in it are truncated or
+ * not written at all, but all the offsets are still set, so the caller can retry with a buffer of
+ * the returned size. Doesn't allocate memory.
+ * @param[in] pf       – pointer to the structure containing phone forwarding information.
+ * @param[in] nums     – array of pointers to the strings containing the phone numbers.
+ * @param[in] count    – number of the phone numbers.
+ * @param[out] offsets – array of @p count offsets of the results.
+ * @param[out] buf     – pointer to the buffer for the results.
+ * @param[in] bufLen   – size of the buffer.
+ * @return Total size of all results, including the terminating '\0' characters. Value 0 if
+ *         @p pf, @p nums or @p offsets is NULL.
+ */
+size_t phfwdGetBatch(PhoneForward const *pf, char const *const *nums, size_t count, size_t *offsets, char *buf,
+                     size_t bufLen);
+
+/** @brief Obtains the number at the end of the chain of forwardings.
+ * Applies @ref phfwdGet to the given number, then to its result and so on, until the number
+ * isn't forwarded anymore or @p maxHops forwardings were applied. The whole chain is followed
+ * in a single call, on the same state of the structure, and apart from the result the memory
+ * is only allocated for very long numbers. If the chain comes
+ * back to a number it has already passed, it would never end, and the result is an empty
+ * sequence, unless @p maxHops forwardings are applied before the cycle is noticed, which
+ * happens at most twice the length of the cycle after the chain enters it. A chain that grows
+ * without repeating a number, like the one of the forwarding of 1 to 12, is only stopped by
+ * @p maxHops.
+ * Allocates structure @p PhoneNumbers, which must be then freed using @ref phnumDelete.
+ * @param[in] pf      – pointer to the structure containing phone forwarding information.
+ * @param[in] num     – pointer to the string containing the phone number to be forwarded.
+ * @param[in] maxHops – maximal number of the forwardings applied.
+ * @return Pointer to the structure containing the sequence with the last number of the chain,
+ *         an empty sequence if the chain has a cycle or the given string doesn't represent a
+ *         number, or NULL if there was an allocation error or the given structure is NULL.
+ */
+PhoneNumbers * phfwdResolve(PhoneForward const *pf, char const *num, size_t maxHops);
+
 /** @brief Obtains all forwards to the prefixes of the given number.
  * For each phone number, which is a prefix of the given number @p num, finds all
  * phone numbers that are forwarded to this prefix. The function also concatenates
@@ -102,6 +353,120 @@ PhoneNumbers * phfwdReverse(PhoneForward const *pf, char const *num);
  */
 PhoneNumbers * phfwdGetReverse(PhoneForward const *pf, char const *num);
 
+/** @brief Creates a cursor over the results of phfwdReverse().
+ * The cursor obtains the same numbers as @ref phfwdReverse, in the same order, one at a
+ * time. They are read straight from the reverse tree, so only the current number is kept in
+ * memory, however many numbers are forwarded to the prefixes of @p num. If the given string
+ * doesn't represent a number, the cursor obtains no numbers. In the concurrent mode the
+ * cursor sees the state from before or after every write, like a single lookup, and the
+ * memory freed by the writes isn't reused until the cursor is deleted, otherwise the
+ * structure mustn't be modified while the cursor exists. It has to be deleted with
+ * @ref phfwdReverseCursorDelete before the structure is deleted.
+ * @param[in] pf  – pointer to the structure containing phone forwarding information.
+ * @param[in] num – pointer to the string containing the phone number to be reversed.
+ * @return Pointer to the new cursor or NULL if there was an allocation error or the given
+ *         structure is NULL.
+ */
+PhoneReverseCursor * phfwdReverseCursorNew(PhoneForward const *pf, char const *num);
+
+/** @brief Obtains the next number of the cursor.
+ * The number is written to a buffer of the cursor, which is reused for the next numbers.
+ * @param[in, out] cursor – pointer to the cursor.
+ * @param[out] num        – pointer to the number, valid until the next call or until the
+ *                          cursor is deleted, set to NULL if there are no more numbers.
+ * @return Value @p true if the number was obtained successfully. Value @p false if there was
+ *         an allocation error, the cursor can then only be deleted, or a pointer is NULL.
+ */
+bool phfwdReverseCursorNext(PhoneReverseCursor *cursor, char const **num);
+
+/** @brief Deletes the cursor.
+ * Does nothing when the pointer is NULL.
+ * @param[in] cursor – pointer to the cursor to be deleted.
+ */
+void phfwdReverseCursorDelete(PhoneReverseCursor *cursor);
+
+/** @brief Visits the results of phfwdReverse().
+ * Calls @p visit for the numbers @ref phfwdReverse would return, in the same order, until
+ * it returns @p false. The numbers are obtained like with @ref phfwdReverseCursorNew.
+ * @param[in] pf      – pointer to the structure containing phone forwarding information.
+ * @param[in] num     – pointer to the string containing the phone number to be reversed.
+ * @param[in] visit   – the function called for every number.
+ * @param[in] context – pointer passed to @p visit.
+ * @return Value @p true if the numbers were visited, also if @p visit stopped the visiting.
+ *         Value @p false if there was an allocation error or @p pf or @p visit is NULL.
+ */
+bool phfwdReverseVisit(PhoneForward const *pf, char const *num, PhoneNumberVisitor visit, void *context);
+
+/** @brief Counts the results of phfwdReverse().
+ * Counts the numbers @ref phfwdReverse would return without building them and without
+ * allocating memory, unless the reverse tree of a structure created with
+ * @ref PHFWD_FORWARD_ONLY has to be built first.
+ * @param[in] pf  – pointer to the structure containing phone forwarding information.
+ * @param[in] num – pointer to the string containing the phone number to be reversed.
+ * @return Number of the numbers. Value 0 if the given string doesn't represent a number,
+ *         there was an allocation error or the given structure is NULL.
+ */
+size_t phfwdReverseCount(PhoneForward const *pf, char const *num);
+
+/** @brief Lists the phone forwardings of the prefixes starting with the given prefix.
+ * Calls @p visit for every phone forwarding added with @ref phfwdAdd whose parameter @p num1
+ * starts with @p prefix, including @p prefix itself, in the lexicographic order of @p num1, with
+ * the digits ordered 0, 1, ..., 9, *, #. The empty prefix lists all the forwardings. The tree is
+ * walked from the node of the prefix with an explicit stack, so listing the whole structure is
+ * a single pass over it, and both numbers are passed in buffers reused for all the forwardings.
+ * @p visit mustn't change the structure. In the concurrent mode it sees the state from before or
+ * after each write that runs at the same time.
+ * @param[in] pf      – pointer to the structure containing phone forwarding information.
+ * @param[in] prefix  – pointer to the string containing the prefix or the empty string.
+ * @param[in] visit   – the function called for every forwarding.
+ * @param[in] context – pointer passed to @p visit.
+ * @return Value @p true if the forwardings were visited, also if @p visit stopped the visiting
+ *         or @p prefix doesn't represent a number, then no forwarding is visited.
+ *         Value @p false if there was an allocation error or @p pf, @p prefix or @p visit is
+ *         NULL.
+ */
+bool phfwdList(PhoneForward const *pf, char const *prefix, PhoneForwardingVisitor visit, void *context);
+
+/** @brief Lists the phone forwardings that differ between two structures.
+ * Calls @p visit for every prefix forwarded with @ref phfwdAdd in only one of the structures or
+ * forwarded to different numbers in each of them, in the order of @ref phfwdList. Both forward
+ * trees are walked in lock-step and the parts that @p pf2 shares with @p pf1, because one of
+ * them was cloned from the other with @ref phfwdClone, are skipped without being walked, so
+ * comparing a structure with its clone takes time proportional to the changes made since the
+ * cloning. The changes passed to @p visit can be applied with @ref phfwdApplyDiff to turn a
+ * copy of @p pf1 into a copy of @p pf2. @p visit mustn't change the structures.
+ * @param[in] pf1     – pointer to the first structure containing phone forwarding information.
+ * @param[in] pf2     – pointer to the second structure containing phone forwarding information.
+ * @param[in] visit   – the function called for every difference.
+ * @param[in] context – pointer passed to @p visit.
+ * @return Value @p true if the differences were visited, also if @p visit stopped the visiting.
+ *         Value @p false if there was an allocation error, any of the pointers @p pf1, @p pf2
+ *         and @p visit is NULL or any of the structures was frozen or loaded with
+ *         @ref phfwdLoadMapped.
+ */
+bool phfwdDiff(PhoneForward const *pf1, PhoneForward const *pf2, PhoneForwardDiffVisitor visit, void *context);
+
+/** @brief Applies the phone forwardings listed by phfwdDiff().
+ * For every @p i sets the forwarding of @p nums1[i] to @p nums2[i] like @ref phfwdAdd or, if
+ * @p nums2[i] is NULL, removes the forwarding of exactly the prefix @p nums1[i], leaving the
+ * forwardings of the longer prefixes starting with it intact. The changes are applied in order
+ * in a single write, so the routes of a shared or concurrent structure are copied once for the
+ * whole batch and the readers of a concurrent structure see the changes only once the write
+ * ends: all of them or, if there was an allocation error, the ones before the failed one. All
+ * the numbers are checked before anything is changed.
+ * @param[in,out] pf – pointer to the structure containing phone forwarding information.
+ * @param[in] nums1  – array of the forwarded prefixes.
+ * @param[in] nums2  – array of the prefixes the corresponding prefixes of @p nums1 are
+ *                     forwarded to, NULL elements remove the forwardings.
+ * @param[in] count  – number of the changes.
+ * @return Value @p true if all the changes were applied.
+ *         Value @p false if any of the numbers is invalid or any prefix would be forwarded to
+ *         itself, nothing is changed then, or if there was an allocation error, then the changes
+ *         before the failed one are kept, or @p pf is NULL, frozen or loaded with
+ *         @ref phfwdLoadMapped.
+ */
+bool phfwdApplyDiff(PhoneForward *pf, char const *const *nums1, char const *const *nums2, size_t count);
+
 /** @brief Deletes the structure.
  * Deletes the structure pointed by @p pnum. Does nothing when the pointer is NULL.
  * @param[in] pnum – pointer to the structure to be deleted.
@@ -118,4 +483,141 @@ void phnumDelete(PhoneNumbers *pnum);
  */
 char const * phnumGet(PhoneNumbers const *pnum, size_t idx);
 
+/** @brief Makes the structure read-only.
+ * Compiles the forwarding trees of the structure pointed by @p pf into a flat index, which
+ * is then used to answer @ref phfwdGet, @ref phfwdReverse, @ref phfwdGetReverse and the
+ * functions based on them, and deletes the trees. The index stores the nodes in arrays in
+ * breadth-first order with 32-bit offsets instead of pointers and all the numbers in a single
+ * block of memory, so it takes much less memory and lookups touch fewer cache lines. Once
+ * frozen, the structure can't be modified: @ref phfwdAdd always fails and @ref phfwdRemove
+ * does nothing. Freezing a structure that is already read-only does nothing.
+ * @param[in,out] pf – pointer to the structure containing phone forwarding information.
+ * @return Value @p true if the structure is read-only.
+ *         Value @p false if there was an allocation error, the structure is too big for the
+ *         index, it was created with @ref phfwdNewConcurrent, @ref phfwdRecover or
+ *         @ref phfwdRecoverConcurrent or @p pf is NULL, the structure is left unchanged then.
+ */
+bool phfwdFreeze(PhoneForward *pf);
+
+/** @brief Saves the phone forwarding information to a file.
+ * Writes a binary image of the structure pointed by @p pf to the file @p path, which can be
+ * used by @ref phfwdLoadMapped. The image doesn't contain any pointers, the numbers are
+ * stored in the native byte order.
+ * @param[in] pf   – pointer to the structure containing phone forwarding information.
+ * @param[in] path – pointer to the path of the file.
+ * @return Value @p true if the image was saved.
+ *         Value @p false if there was an allocation error, an error while writing the file,
+ *         the structure is too big for the format or @p pf or @p path is NULL.
+ */
+bool phfwdSave(PhoneForward const *pf, char const *path);
+
+/** @brief Creates a read-only structure from a file.
+ * Maps the image saved by @ref phfwdSave to memory and uses it to answer @ref phfwdGet,
+ * @ref phfwdReverse, @ref phfwdGetReverse and the functions based on them directly, without
+ * rebuilding the forwarding trees. The mapped pages are shared by all processes using the same
+ * file, which mustn't be changed while it is mapped. The structure mustn't be modified:
+ * @ref phfwdAdd always fails and @ref phfwdRemove does nothing. It has to be deleted with
+ * @ref phfwdDelete.
+ * @param[in] path – pointer to the path of the file.
+ * @return Pointer to the new structure or NULL if there was an allocation error, the file
+ *         couldn't be mapped or it doesn't contain a valid image.
+ */
+PhoneForward * phfwdLoadMapped(char const *path);
+
+/** @brief Creates a structure from a snapshot and a log of the later changes.
+ * Builds a structure that can be modified from the image saved in the file @p snapshotPath,
+ * if it exists, and then replays the changes recorded in the log file @p logPath. A change
+ * cut off by a crash is dropped together with anything after it. Then each successful
+ * @ref phfwdAdd, @ref phfwdAddN and @ref phfwdRemove, and each change made by
+ * @ref phfwdApplyDiff, appends a compact binary record to the log, the log is created if it
+ * doesn't exist. The records are buffered and written together,
+ * they are flushed to the disk once @p syncEvery of them were added, or by @ref phfwdSyncLog.
+ * Once writing the log fails, changes are refused. @ref phfwdCompact folds the log into a
+ * new snapshot. The structure can't be frozen.
+ * @param[in] snapshotPath – pointer to the path of the snapshot.
+ * @param[in] logPath      – pointer to the path of the log.
+ * @param[in] syncEvery    – number of the changes flushed to the disk together, 1 makes every
+ *                           change durable before it returns, 0 leaves it to @ref phfwdSyncLog.
+ * @return Pointer to the new structure or NULL if there was an allocation error, the snapshot
+ *         exists but isn't a valid image, the log couldn't be read or written, or a path is NULL.
+ */
+PhoneForward * phfwdRecover(char const *snapshotPath, char const *logPath, size_t syncEvery);
+
+/** @brief Creates a structure from a snapshot and a log that can be read by many threads at once.
+ * Works like @ref phfwdRecover, but the structure works like one created with
+ * @ref phfwdNewConcurrent, and @ref phfwdCompact writes the snapshot in the background.
+ * @param[in] snapshotPath – pointer to the path of the snapshot.
+ * @param[in] logPath      – pointer to the path of the log.
+ * @param[in] syncEvery    – number of the changes flushed to the disk together.
+ * @return Pointer to the new structure or NULL if there was an error, like in @ref phfwdRecover.
+ */
+PhoneForward * phfwdRecoverConcurrent(char const *snapshotPath, char const *logPath, size_t syncEvery);
+
+/** @brief Flushes the logged changes to the disk.
+ * Writes the buffered records of the log of a structure created with @ref phfwdRecover and
+ * waits until they are on the disk, so all the changes made before survive a crash.
+ * @param[in,out] pf – pointer to the structure containing phone forwarding information.
+ * @return Value @p true if all the changes are on the disk.
+ *         Value @p false if writing the log failed, the structure has no log or @p pf is NULL.
+ */
+bool phfwdSyncLog(PhoneForward *pf);
+
+/** @brief Folds the log into a new snapshot.
+ * Saves the structure created with @ref phfwdRecover to a new snapshot, which then atomically
+ * replaces the old one, and removes from the log the records the snapshot contains. The
+ * changes made meanwhile stay in the log, as replaying a change the snapshot already contains
+ * doesn't alter the result, so a crash at any point leaves a snapshot and a log that recover
+ * the latest state. In the concurrent mode the snapshot is written by a background thread and
+ * changes can be made meanwhile, its result is obtained by @ref phfwdCompactWait, otherwise the
+ * snapshot is written before the function returns. This function and @ref phfwdCompactWait
+ * mustn't be called by many threads at once.
+ * @param[in,out] pf – pointer to the structure containing phone forwarding information.
+ * @return Value @p true if the log was folded or, in the concurrent mode, the folding started.
+ *         Value @p false if there was an allocation error, the snapshot or the log couldn't be
+ *         written, a folding is already running, the structure has no log or @p pf is NULL.
+ */
+bool phfwdCompact(PhoneForward *pf);
+
+/** @brief Waits for the folding of the log started by @ref phfwdCompact.
+ * @param[in,out] pf – pointer to the structure containing phone forwarding information.
+ * @return Value @p true if the last folding succeeded or none was started.
+ *         Value @p false if it failed or @p pf is NULL.
+ */
+bool phfwdCompactWait(PhoneForward *pf);
+
+/** @brief Describes the memory used by the structure and the operations run on it.
+ * Walks both forwarding trees, or the flat index of a read-only structure, and fills @p stats.
+ * The counters of the operations are kept all the time, in 16 copies on separate cache lines.
+ * Each thread is given one of the copies the first time it counts an operation, in turn, so
+ * with more than 16 threads some of them share a copy. A call costs a single atomic addition,
+ * which stays uncontended unless threads sharing a copy run at once. It may be called at the
+ * same time as the readers of the structure, in the concurrent mode also at the same time as
+ * the writers, the counters of the operations running meanwhile may then be missed.
+ * @param[in] pf     – pointer to the structure containing phone forwarding information.
+ * @param[out] stats – pointer to the statistics.
+ * @return Value @p true if the statistics were filled.
+ *         Value @p false if there was an allocation error or @p pf or @p stats is NULL.
+ */
+bool phfwdStats(PhoneForward const *pf, PhoneForwardStats *stats);
+
+/** @brief Keeps the recent results of phfwdGetReverse() to answer the repeated ones faster.
+ * Makes @ref phfwdGetReverse keep copies of up to @p capacity of its recent results. A
+ * repeated lookup then costs a hash probe, a check of the result against the later changes,
+ * which takes time proportional to the length of the number and the total length of the
+ * numbers of the result, and copying the result, instead of walking both trees and sorting.
+ * The results of @ref phfwdGet aren't kept, because a lookup walks a single route of the tree
+ * and wouldn't be any faster. @ref phfwdAdd, @ref phfwdRemove and @ref phfwdApplyDiff don't
+ * look at the kept results: each change only records a new generation for two numbers, in time
+ * proportional to their lengths, and the results it may have made out of date are dropped when
+ * they are found. With the cache enabled, even the lookups change the structure, so they
+ * mustn't be run by many threads at once. Enabling the cache again replaces the kept results,
+ * @p capacity 0 disables it.
+ * @param[in,out] pf   – pointer to the structure containing phone forwarding information.
+ * @param[in] capacity – number of the results kept, rounded up to a power of two.
+ * @return Value @p true if the cache was enabled or disabled.
+ *         Value @p false if there was an allocation error, the structure was created with
+ *         @ref phfwdNewConcurrent or @p pf is NULL, the previous cache is kept then.
+ */
+bool phfwdEnableCache(PhoneForward *pf, size_t capacity);
+
 #endif /* __PHONE_FORWARD_H__ */
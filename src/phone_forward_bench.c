@@ -0,0 +1,542 @@
+/** @file
+ * Benchmarks of the phone forwarding operations on repeatable synthetic workloads.
+ * Every line of the report gives the workload, the operation, the number of the operations, the mean time of an
+ * operation, the nodes of the trees allocated and freed per operation, which don't include the other allocations, like
+ * the stored numbers or the results, and the peak memory used by the process so far.
+ * The optional argument scales the sizes of all workloads, e.g. @p 0.1 runs a quick check.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "phone_forward.h"
+#include "phone_numbers.h"
+
+#define SEED 20220517 /**< Seed of the generator, the same seed gives the same workloads. */
+#define BULK_FORWARDINGS 200000 /**< Number of the forwardings added by the bulk workload. */
+#define LOOKUPS 1000000 /**< Number of the numbers looked up by the lookup workloads. */
+#define REVERSE_LOOKUPS 100000 /**< Number of the numbers looked up by the reverse lookup workloads. */
+#define CHAIN_LENGTH 2000 /**< Length of the number whose every prefix is forwarded. */
+#define CHAIN_LOOKUPS 10000 /**< Number of the lookups of the numbers at the end of the chain. */
+#define FAN_IN_SOURCES 1000000 /**< Number of the numbers forwarded to the same target. */
+#define FAN_IN_LOOKUPS 10 /**< Number of the reverse lookups of the target of all numbers. */
+#define MIN_LENGTH 3 /**< Minimal length of the generated prefixes. */
+#define MAX_LENGTH 10 /**< Maximal length of the generated prefixes. */
+#define QUERY_LENGTH 12 /**< Length of the numbers looked up. */
+#define CACHE_CAPACITY 4096 /**< Number of the results kept by the cache of the cached workloads. */
+#define SHORT_PREFIX_LENGTH 2 /**< Length of the prefixes removed by the mass removal workload. */
+
+/**
+ * @struct Numbers
+ * @brief Generated numbers, kept in a single buffer so generating them doesn't take part in the measurements.
+ * @var Numbers::chars
+ *      Buffer with the characters of all numbers.
+ * @var Numbers::nums
+ *      Array of pointers to the numbers inside of @p chars.
+ * @var Numbers::count
+ *      Number of the numbers.
+ */
+struct Numbers {
+    char *chars;
+    char **nums;
+    size_t count;
+};
+
+/**
+ * @struct Measurement
+ * @brief State of the structure when the measured operations started.
+ * @var Measurement::start
+ *      Time of the start.
+ * @var Measurement::allocations
+ *      Number of the nodes allocated by the structure before the start.
+ * @var Measurement::frees
+ *      Number of the nodes freed by the structure before the start.
+ */
+struct Measurement {
+    struct timespec start;
+    uint64_t allocations;
+    uint64_t frees;
+};
+
+static uint64_t randomState = SEED; /**< State of the generator of the pseudorandom numbers. */
+static size_t sink; /**< Sum of the sizes of the results, it keeps the measured calls from being optimized away. */
+
+/**
+ * @brief Gives the next pseudorandom number.
+ * Uses the SplitMix64 generator, so the workloads are the same on every platform.
+ * @return The pseudorandom number.
+ */
+static uint64_t nextRandom(void) {
+    uint64_t z = (randomState += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Gives a pseudorandom number from the range.
+ * @param [in] bound - the end of the range.
+ * @return The pseudorandom number not smaller than 0 and smaller than @p bound.
+ */
+static size_t randomBelow(size_t bound) {
+    return (size_t) (nextRandom() % bound);
+}
+
+/**
+ * @brief Frees the space of the numbers.
+ * @param [in, out] numbers - pointer to the numbers.
+ */
+static void numbersDelete(struct Numbers *numbers) {
+    free(numbers->chars);
+    free(numbers->nums);
+    numbers->chars = NULL;
+    numbers->nums = NULL;
+    numbers->count = 0;
+}
+
+/**
+ * @brief Allocates the space for the numbers.
+ * On failure the numbers are left empty, so they can be deleted anyway.
+ * @param [out] numbers - pointer to the numbers.
+ * @param [in] count - number of the numbers.
+ * @param [in] maxLength - maximal length of a number.
+ * @return Value @p true if the space was allocated.
+ *         Value @p false if there was an allocation error.
+ */
+static bool numbersNew(struct Numbers *numbers, size_t count, size_t maxLength) {
+    numbers->chars = malloc(count * (maxLength + 1));
+    numbers->nums = malloc(count * sizeof(char *));
+    numbers->count = count;
+    if (numbers->chars == NULL || numbers->nums == NULL) {
+        numbersDelete(numbers);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        numbers->nums[i] = numbers->chars + i * (maxLength + 1);
+        numbers->nums[i][0] = '\0';
+    }
+    return true;
+}
+
+/**
+ * @brief Appends pseudorandom digits to the number.
+ * @param [in, out] num - pointer to the number, there has to be space for @p length more digits.
+ * @param [in] length - number of the appended digits.
+ */
+static void appendDigits(char *num, size_t length) {
+    size_t end = strlen(num);
+    for (size_t i = 0; i < length; i++) {
+        num[end + i] = (char) ('0' + randomBelow(10));
+    }
+    num[end + length] = '\0';
+}
+
+/**
+ * @brief Generates numbers of pseudorandom digits.
+ * @param [out] numbers - pointer to the numbers.
+ * @param [in] count - number of the numbers.
+ * @param [in] minLength - minimal length of a number.
+ * @param [in] maxLength - maximal length of a number.
+ * @return Value @p true if the numbers were generated.
+ *         Value @p false if there was an allocation error.
+ */
+static bool generateNumbers(struct Numbers *numbers, size_t count, size_t minLength, size_t maxLength) {
+    if (!numbersNew(numbers, count, maxLength)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        appendDigits(numbers->nums[i], minLength + randomBelow(maxLength - minLength + 1));
+    }
+    return true;
+}
+
+/**
+ * @brief Generates numbers drawn from the Zipf distribution.
+ * Each prefix is extended to a single number, the number at the index @p k is drawn with the probability
+ * proportional to @p 1 / (k + 1), so the same few numbers are looked up most of the time.
+ * @param [out] numbers - pointer to the numbers.
+ * @param [in] count - number of the numbers.
+ * @param [in] prefixes - pointer to the prefixes.
+ * @return Value @p true if the numbers were generated.
+ *         Value @p false if there was an allocation error.
+ */
+static bool generateZipfNumbers(struct Numbers *numbers, size_t count, struct Numbers const *prefixes) {
+    struct Numbers popular = {0};
+    double *cumulative = malloc(prefixes->count * sizeof(double));
+    if (cumulative == NULL || !numbersNew(&popular, prefixes->count, QUERY_LENGTH) ||
+        !numbersNew(numbers, count, QUERY_LENGTH)) {
+        free(cumulative);
+        numbersDelete(&popular);
+        return false;
+    }
+
+    double total = 0;
+    for (size_t k = 0; k < prefixes->count; k++) {
+        total += 1 / (double) (k + 1);
+        cumulative[k] = total;
+        strcpy(popular.nums[k], prefixes->nums[k]);
+        appendDigits(popular.nums[k], QUERY_LENGTH - strlen(prefixes->nums[k]));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        double drawn = (double) (nextRandom() >> 11) / (double) (UINT64_C(1) << 53) * total;
+        size_t low = 0, high = prefixes->count - 1;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (cumulative[middle] < drawn) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        strcpy(numbers->nums[i], popular.nums[low]);
+    }
+
+    free(cumulative);
+    numbersDelete(&popular);
+    return true;
+}
+
+/**
+ * @brief Gives the number of the nodes allocated and freed by the structure.
+ * @param [in] pf - pointer to the structure.
+ * @param [out] allocations - number of the allocated nodes.
+ * @param [out] frees - number of the freed nodes.
+ */
+static void nodeCounters(PhoneForward const *pf, uint64_t *allocations, uint64_t *frees) {
+    PhoneForwardStats stats;
+    if (pf != NULL && phfwdStats(pf, &stats)) {
+        *allocations = stats.nodeAllocations;
+        *frees = stats.nodeFrees;
+    } else {
+        *allocations = 0;
+        *frees = 0;
+    }
+}
+
+/**
+ * @brief Starts measuring the operations on the structure.
+ * @param [in] pf - pointer to the structure or NULL if only the time is measured.
+ * @param [out] measurement - pointer to the measurement.
+ */
+static void beginMeasurement(PhoneForward const *pf, struct Measurement *measurement) {
+    nodeCounters(pf, &measurement->allocations, &measurement->frees);
+    clock_gettime(CLOCK_MONOTONIC, &measurement->start);
+}
+
+/**
+ * @brief Finishes measuring the operations and prints a line of the report.
+ * @param [in] pf - pointer to the structure or NULL if only the time is measured.
+ * @param [in] measurement - pointer to the measurement.
+ * @param [in] workload - name of the workload.
+ * @param [in] operation - name of the measured operation.
+ * @param [in] count - number of the operations.
+ */
+static void endMeasurement(PhoneForward const *pf, struct Measurement const *measurement, char const *workload,
+                           char const *operation, size_t count) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double nanoseconds = (double) (end.tv_sec - measurement->start.tv_sec) * 1e9 +
+                         (double) (end.tv_nsec - measurement->start.tv_nsec);
+
+    uint64_t allocations, frees;
+    nodeCounters(pf, &allocations, &frees);
+    if (pf == NULL) {
+        allocations = measurement->allocations;
+        frees = measurement->frees;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double operations = (double) count;
+    printf("%-12s %-16s %10zu %12.1f %10.3f %10.3f %10ld\n", workload, operation, count, nanoseconds / operations,
+           (double) (allocations - measurement->allocations) / operations,
+           (double) (frees - measurement->frees) / operations, usage.ru_maxrss);
+}
+
+/**
+ * @brief Adds the forwardings and measures it.
+ * The forwardings of a prefix to itself, which can be drawn by chance, are rejected by @ref phfwdAdd like any other
+ * invalid ones, so the result of a single call isn't checked.
+ * @param [in, out] pf - pointer to the structure.
+ * @param [in] sources - pointer to the forwarded prefixes.
+ * @param [in] targets - pointer to the targets, the number of those is a divisor of the number of the sources.
+ * @param [in] workload - name of the workload.
+ */
+static void measureAdd(PhoneForward *pf, struct Numbers const *sources, struct Numbers const *targets,
+                       char const *workload) {
+    struct Measurement measurement;
+    beginMeasurement(pf, &measurement);
+    for (size_t i = 0; i < sources->count; i++) {
+        sink += phfwdAdd(pf, sources->nums[i], targets->nums[i % targets->count]);
+    }
+    endMeasurement(pf, &measurement, workload, "phfwdAdd", sources->count);
+}
+
+/**
+ * @brief Looks up the numbers with the function and measures it.
+ * @param [in] pf - pointer to the structure.
+ * @param [in] queries - pointer to the looked up numbers.
+ * @param [in] query - the measured function.
+ * @param [in] workload - name of the workload.
+ * @param [in] operation - name of the measured function.
+ * @return Value @p true if all numbers were looked up.
+ *         Value @p false if there was an allocation error.
+ */
+static bool measureQuery(PhoneForward const *pf, struct Numbers const *queries,
+                         PhoneNumbers *(*query)(PhoneForward const *, char const *), char const *workload,
+                         char const *operation) {
+    struct Measurement measurement;
+    bool success = true;
+    beginMeasurement(pf, &measurement);
+    for (size_t i = 0; i < queries->count; i++) {
+        PhoneNumbers *result = query(pf, queries->nums[i]);
+        if (result == NULL) {
+            success = false;
+        }
+        sink += phnumGetSize(result);
+        phnumDelete(result);
+    }
+    endMeasurement(pf, &measurement, workload, operation, queries->count);
+    return success;
+}
+
+/**
+ * @brief Removes the prefixes and measures it.
+ * @param [in, out] pf - pointer to the structure.
+ * @param [in] prefixes - pointer to the removed prefixes.
+ * @param [in] workload - name of the workload.
+ */
+static void measureRemove(PhoneForward *pf, struct Numbers const *prefixes, char const *workload) {
+    struct Measurement measurement;
+    beginMeasurement(pf, &measurement);
+    for (size_t i = 0; i < prefixes->count; i++) {
+        phfwdRemove(pf, prefixes->nums[i]);
+    }
+    endMeasurement(pf, &measurement, workload, "phfwdRemove", prefixes->count);
+}
+
+/**
+ * @brief Deletes the structure and measures it as a single operation.
+ * @param [in] pf - pointer to the structure.
+ * @param [in] workload - name of the workload.
+ */
+static void measureDelete(PhoneForward *pf, char const *workload) {
+    struct Measurement measurement;
+    beginMeasurement(NULL, &measurement);
+    phfwdDelete(pf);
+    endMeasurement(NULL, &measurement, workload, "phfwdDelete", 1);
+}
+
+/**
+ * @brief Scales the size of a workload.
+ * @param [in] size - the size when the scale is 1.
+ * @param [in] scale - the scale.
+ * @return The scaled size, at least 1.
+ */
+static size_t scaled(size_t size, double scale) {
+    size_t result = (size_t) ((double) size * scale);
+    return result > 0 ? result : 1;
+}
+
+/**
+ * @brief Bulk load of random forwardings, uniform and Zipf lookups with and without the cache, reverse lookups, writes
+ * with the cache enabled and teardown.
+ * @param [in] scale - scale of the sizes.
+ * @return Value @p true if the workload was run.
+ *         Value @p false if there was an allocation error.
+ */
+static bool benchBulk(double scale) {
+    struct Numbers sources = {0}, targets = {0}, uniform = {0}, zipf = {0}, reverse = {0};
+    size_t count = scaled(BULK_FORWARDINGS, scale);
+    bool success = generateNumbers(&sources, count, MIN_LENGTH, MAX_LENGTH);
+    success = generateNumbers(&targets, count, MIN_LENGTH, MAX_LENGTH) && success;
+    success = generateNumbers(&uniform, scaled(LOOKUPS, scale), QUERY_LENGTH, QUERY_LENGTH) && success;
+    success = success && generateZipfNumbers(&zipf, scaled(LOOKUPS, scale), &sources);
+    success = success && numbersNew(&reverse, scaled(REVERSE_LOOKUPS, scale), MAX_LENGTH + QUERY_LENGTH);
+    for (size_t i = 0; success && i < reverse.count; i++) {
+        strcpy(reverse.nums[i], targets.nums[randomBelow(count)]);
+        appendDigits(reverse.nums[i], randomBelow(QUERY_LENGTH / 2));
+    }
+
+    PhoneForward *pf = success ? phfwdNew() : NULL;
+    success = pf != NULL;
+    if (success) {
+        measureAdd(pf, &sources, &targets, "bulk");
+    }
+    success = success && measureQuery(pf, &uniform, phfwdGet, "uniform", "phfwdGet");
+    success = success && measureQuery(pf, &zipf, phfwdGet, "zipf", "phfwdGet");
+    success = success && measureQuery(pf, &reverse, phfwdReverse, "bulk", "phfwdReverse");
+    success = success && measureQuery(pf, &reverse, phfwdGetReverse, "bulk", "phfwdGetReverse");
+    success = success && phfwdEnableCache(pf, CACHE_CAPACITY);
+    success = success && measureQuery(pf, &zipf, phfwdGetReverse, "zipf-cached", "phfwdGetReverse");
+    if (success) {
+        measureAdd(pf, &uniform, &targets, "bulk-cached");
+    }
+    if (pf != NULL) {
+        measureDelete(pf, "bulk");
+    }
+
+    numbersDelete(&sources);
+    numbersDelete(&targets);
+    numbersDelete(&uniform);
+    numbersDelete(&zipf);
+    numbersDelete(&reverse);
+    return success;
+}
+
+/**
+ * @brief Forwards every prefix of a long number and looks up the numbers walking the whole chain.
+ * @param [in] scale - scale of the sizes.
+ * @return Value @p true if the workload was run.
+ *         Value @p false if there was an allocation error.
+ */
+static bool benchChain(double scale) {
+    struct Numbers chain = {0}, sources = {0}, targets = {0}, queries = {0};
+    size_t length = scaled(CHAIN_LENGTH, scale);
+    bool success = generateNumbers(&chain, 1, length, length);
+    success = success && numbersNew(&sources, length, length);
+    success = success && generateNumbers(&targets, length, MIN_LENGTH, MAX_LENGTH);
+    success = success && numbersNew(&queries, scaled(CHAIN_LOOKUPS, scale), length + QUERY_LENGTH);
+    for (size_t i = 0; success && i < length; i++) {
+        memcpy(sources.nums[i], chain.nums[0], i + 1);
+        sources.nums[i][i + 1] = '\0';
+    }
+    for (size_t i = 0; success && i < queries.count; i++) {
+        strcpy(queries.nums[i], chain.nums[0]);
+        appendDigits(queries.nums[i], randomBelow(QUERY_LENGTH));
+    }
+
+    PhoneForward *pf = success ? phfwdNew() : NULL;
+    success = pf != NULL;
+    if (success) {
+        measureAdd(pf, &sources, &targets, "chain");
+    }
+    success = success && measureQuery(pf, &queries, phfwdGet, "chain", "phfwdGet");
+    success = success && measureQuery(pf, &targets, phfwdReverse, "chain", "phfwdReverse");
+    success = success && measureQuery(pf, &targets, phfwdGetReverse, "chain", "phfwdGetReverse");
+    if (pf != NULL) {
+        measureDelete(pf, "chain");
+    }
+
+    numbersDelete(&chain);
+    numbersDelete(&sources);
+    numbersDelete(&targets);
+    numbersDelete(&queries);
+    return success;
+}
+
+/**
+ * @brief Forwards many numbers to the same target, looks it up in reverse and removes the numbers one by one.
+ * @param [in] scale - scale of the sizes.
+ * @return Value @p true if the workload was run.
+ *         Value @p false if there was an allocation error.
+ */
+static bool benchFanIn(double scale) {
+    struct Numbers sources = {0}, target = {0}, queries = {0};
+    bool success = generateNumbers(&sources, scaled(FAN_IN_SOURCES, scale), QUERY_LENGTH, QUERY_LENGTH);
+    success = success && generateNumbers(&target, 1, MIN_LENGTH, MIN_LENGTH);
+    success = success && numbersNew(&queries, FAN_IN_LOOKUPS, MIN_LENGTH);
+    for (size_t i = 0; success && i < queries.count; i++) {
+        strcpy(queries.nums[i], target.nums[0]);
+    }
+
+    PhoneForward *pf = success ? phfwdNew() : NULL;
+    success = pf != NULL;
+    if (success) {
+        measureAdd(pf, &sources, &target, "fan-in");
+    }
+    success = success && measureQuery(pf, &queries, phfwdReverse, "fan-in", "phfwdReverse");
+    success = success && measureQuery(pf, &queries, phfwdGetReverse, "fan-in", "phfwdGetReverse");
+    if (success) {
+        measureRemove(pf, &sources, "fan-in");
+    }
+    if (pf != NULL) {
+        measureDelete(pf, "fan-in");
+    }
+
+    numbersDelete(&sources);
+    numbersDelete(&target);
+    numbersDelete(&queries);
+    return success;
+}
+
+/**
+ * @brief Adds random forwardings and removes all of them with a few short prefixes.
+ * @param [in] scale - scale of the sizes.
+ * @return Value @p true if the workload was run.
+ *         Value @p false if there was an allocation error.
+ */
+static bool benchMassRemove(double scale) {
+    struct Numbers sources = {0}, targets = {0}, prefixes = {0};
+    size_t count = 1;
+    for (size_t i = 0; i < SHORT_PREFIX_LENGTH; i++) {
+        count *= 10;
+    }
+    bool success = generateNumbers(&sources, scaled(BULK_FORWARDINGS, scale), MIN_LENGTH, MAX_LENGTH);
+    success = success && generateNumbers(&targets, sources.count, MIN_LENGTH, MAX_LENGTH);
+    success = success && numbersNew(&prefixes, count, SHORT_PREFIX_LENGTH);
+    for (size_t i = 0; success && i < count; i++) {
+        for (size_t digit = 0, rest = i; digit < SHORT_PREFIX_LENGTH; digit++, rest /= 10) {
+            prefixes.nums[i][SHORT_PREFIX_LENGTH - 1 - digit] = (char) ('0' + rest % 10);
+        }
+        prefixes.nums[i][SHORT_PREFIX_LENGTH] = '\0';
+    }
+
+    PhoneForward *pf = success ? phfwdNew() : NULL;
+    success = pf != NULL;
+    if (success) {
+        measureAdd(pf, &sources, &targets, "mass-remove");
+    }
+    if (success) {
+        measureRemove(pf, &prefixes, "mass-remove");
+    }
+    if (pf != NULL) {
+        measureDelete(pf, "mass-remove");
+    }
+
+    numbersDelete(&sources);
+    numbersDelete(&targets);
+    numbersDelete(&prefixes);
+    return success;
+}
+
+/**
+ * @brief Runs all workloads and prints the report.
+ * @param [in] argc - number of the arguments.
+ * @param [in] argv - the arguments, the optional first one is the scale of the sizes of the workloads.
+ * @return Value @p 0 if all workloads were run, @p 1 otherwise.
+ */
+int main(int argc, char *argv[]) {
+    double scale = 1;
+    if (argc > 2 || (argc == 2 && ((scale = strtod(argv[1], NULL)) <= 0 || scale > 100))) {
+        fprintf(stderr, "Usage: %s [scale]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-12s %-16s %10s %12s %10s %10s %10s\n", "workload", "operation", "ops", "ns/op", "nodes/op",
+           "freed/op", "rss[KiB]");
+    bool success = benchBulk(scale);
+    success = benchChain(scale) && success;
+    success = benchFanIn(scale) && success;
+    success = benchMassRemove(scale) && success;
+    if (!success) {
+        fprintf(stderr, "Allocation error, the results are incomplete.\n");
+        return 1;
+    }
+    return sink > 0 ? 0 : 1;
+}
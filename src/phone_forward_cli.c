@@ -0,0 +1,684 @@
+/** @file
+ * Command processor driving the phone forwarding structure from a stream of commands.
+ * Reads the commands from the file given as the only argument or from the standard input, one command per line:
+ * @p ADD @p num1 @p num2, @p DEL @p num, @p GET @p num, @p REVERSE @p num and @p GETREVERSE @p num, the words are
+ * separated with spaces or tabs and empty lines are skipped. Writes one line to the standard output for every command:
+ * @p OK or @p ERROR for @p ADD, @p OK for @p DEL, the number after forwarding for @p GET and the numbers separated
+ * with spaces for @p REVERSE and @p GETREVERSE. A line which isn't a valid command gives @p ERROR.
+ * The input is read in big chunks, or mapped if it is a regular file, and parsed by a separate thread into batches of
+ * commands, which are run while the next batch is parsed. The results are written through a single buffer, which is
+ * flushed whenever no parsed command is waiting, so the answers reach a client waiting for them.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "phone_forward.h"
+
+#define INPUT_CHUNK_SIZE (1 << 20) /**< Initial number of the bytes of the buffer the input is read into. */
+#define BATCH_CAPACITY 4096 /**< Number of the commands a batch has memory for. */
+#define FIRST_ARENA_CAPACITY (1 << 16) /**< Initial number of the bytes of the arguments a batch has memory for. */
+#define OUTPUT_BUFFER_SIZE (1 << 20) /**< Initial number of the bytes of the buffer the results are written to. */
+#define BATCH_COUNT 2 /**< Number of the batches, one is parsed while the other one is run. */
+
+#define INVALID_COMMAND 0 /**< The line isn't a valid command. */
+#define ADD_COMMAND 1 /**< The command adds a forwarding. */
+#define DEL_COMMAND 2 /**< The command removes the forwardings of a prefix. */
+#define GET_COMMAND 3 /**< The command obtains the forwarding of a number. */
+#define REVERSE_COMMAND 4 /**< The command obtains the reverse forwardings of a number. */
+#define GETREVERSE_COMMAND 5 /**< The command obtains the numbers forwarded to a number. */
+
+/**
+ * @struct CommandName
+ * @brief Word of a command and the number of its arguments.
+ * @var CommandName::name
+ *      The word starting the line of the command.
+ * @var CommandName::kind
+ *      The command, one of the constants of the commands.
+ * @var CommandName::arguments
+ *      Number of the arguments of the command.
+ */
+struct CommandName {
+    char const *name;
+    int kind;
+    size_t arguments;
+};
+
+/** The commands understood by the processor. */
+static struct CommandName const COMMAND_NAMES[] = {
+    {"ADD", ADD_COMMAND, 2},
+    {"DEL", DEL_COMMAND, 1},
+    {"GET", GET_COMMAND, 1},
+    {"REVERSE", REVERSE_COMMAND, 1},
+    {"GETREVERSE", GETREVERSE_COMMAND, 1},
+};
+
+/**
+ * @struct Command
+ * @brief Parsed command.
+ * @var Command::kind
+ *      The command, one of the constants of the commands.
+ * @var Command::arguments
+ *      Offsets of the arguments in the arena of the batch, each of them is terminated with '\0'.
+ */
+struct Command {
+    int kind;
+    size_t arguments[2];
+};
+
+/**
+ * @struct Batch
+ * @brief Commands passed from the parser to the thread running them.
+ * @var Batch::commands
+ *      Array of the commands.
+ * @var Batch::count
+ *      Number of the commands.
+ * @var Batch::arena
+ *      Buffer with the arguments of the commands.
+ * @var Batch::arenaSize
+ *      Number of the bytes of @p arena taken by the arguments.
+ * @var Batch::arenaCapacity
+ *      Number of the bytes @p arena has memory for.
+ * @var Batch::full
+ *      Whether the batch was parsed and waits to be run.
+ */
+struct Batch {
+    struct Command *commands;
+    size_t count;
+    char *arena;
+    size_t arenaSize;
+    size_t arenaCapacity;
+    bool full;
+};
+
+/**
+ * @struct Pipeline
+ * @brief State shared by the parser and the thread running the commands.
+ * @var Pipeline::mutex
+ *      Mutex guarding the flags of the pipeline and of the batches.
+ * @var Pipeline::changed
+ *      Condition signalled when a flag changes.
+ * @var Pipeline::batches
+ *      The batches of the commands.
+ * @var Pipeline::finished
+ *      Whether the parser parsed the whole input or stopped because of an error.
+ * @var Pipeline::failed
+ *      Whether the parser couldn't read the input or allocate memory.
+ * @var Pipeline::stopped
+ *      Whether the commands stopped being run because of an error, so the parser should stop too.
+ * @var Pipeline::fd
+ *      Descriptor of the input.
+ * @var Pipeline::mapped
+ *      Pointer to the mapped input or NULL if it is read.
+ * @var Pipeline::mappedSize
+ *      Number of the bytes of the mapped input.
+ */
+struct Pipeline {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    struct Batch batches[BATCH_COUNT];
+    bool finished;
+    bool failed;
+    bool stopped;
+    int fd;
+    char const *mapped;
+    size_t mappedSize;
+};
+
+/**
+ * @struct Parser
+ * @brief State of the parser.
+ * @var Parser::pipeline
+ *      Pointer to the pipeline.
+ * @var Parser::batch
+ *      Index of the batch being parsed.
+ */
+struct Parser {
+    struct Pipeline *pipeline;
+    size_t batch;
+};
+
+/**
+ * @struct Output
+ * @brief Buffer of the results.
+ * @var Output::buffer
+ *      The results that weren't written yet.
+ * @var Output::size
+ *      Number of the bytes of the results.
+ * @var Output::capacity
+ *      Number of the bytes @p buffer has memory for.
+ * @var Output::failed
+ *      Whether writing the results failed.
+ */
+struct Output {
+    char *buffer;
+    size_t size;
+    size_t capacity;
+    bool failed;
+};
+
+/**
+ * @brief Checks if the character separates the words of a command.
+ * @param [in] c - the character.
+ * @return Value @p true if the character is a space, a tab or a carriage return.
+ *         Value @p false otherwise.
+ */
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * @brief Copies the argument to the arena of the batch.
+ * @param [in, out] batch - pointer to the batch.
+ * @param [in] word - pointer to the argument, not terminated.
+ * @param [in] len - length of the argument.
+ * @param [out] offset - pointer to the offset of the copy.
+ * @return Value @p true if the argument was copied successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool addArgument(struct Batch *batch, char const *word, size_t len, size_t *offset) {
+    if (batch->arenaCapacity - batch->arenaSize <= len) {
+        size_t capacity = batch->arenaCapacity;
+        while (capacity - batch->arenaSize <= len) {
+            capacity *= 2;
+        }
+        char *arena = realloc(batch->arena, capacity);
+        if (arena == NULL) {
+            return false;
+        }
+        batch->arena = arena;
+        batch->arenaCapacity = capacity;
+    }
+
+    *offset = batch->arenaSize;
+    memcpy(batch->arena + batch->arenaSize, word, len);
+    batch->arena[batch->arenaSize + len] = '\0';
+    batch->arenaSize += len + 1;
+    return true;
+}
+
+/**
+ * @brief Parses the line into the next command of the batch.
+ * The batch has to have memory for one more command. Doesn't add anything if the line is empty.
+ * @param [in, out] batch - pointer to the batch.
+ * @param [in] line - pointer to the line, not terminated.
+ * @param [in] len - length of the line, without the end of line.
+ * @return Value @p true if the line was parsed successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool parseLine(struct Batch *batch, char const *line, size_t len) {
+    char const *words[4];
+    size_t lengths[4];
+    size_t count = 0;
+    for (size_t i = 0; i < len && count < 4;) {
+        if (isBlank(line[i])) {
+            i++;
+            continue;
+        }
+        words[count] = line + i;
+        while (i < len && !isBlank(line[i])) {
+            i++;
+        }
+        lengths[count] = line + i - words[count];
+        count++;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    struct Command *command = &batch->commands[batch->count++];
+    command->kind = INVALID_COMMAND;
+    command->arguments[0] = 0;
+    command->arguments[1] = 0;
+    for (size_t i = 0; i < sizeof(COMMAND_NAMES) / sizeof(COMMAND_NAMES[0]); i++) {
+        struct CommandName const *name = &COMMAND_NAMES[i];
+        if (count == name->arguments + 1 && lengths[0] == strlen(name->name) &&
+            memcmp(words[0], name->name, lengths[0]) == 0) {
+            command->kind = name->kind;
+            for (size_t j = 0; j < name->arguments; j++) {
+                if (!addArgument(batch, words[j + 1], lengths[j + 1], &command->arguments[j])) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Passes the parsed batch to the thread running the commands and waits for the next free batch.
+ * Does nothing if the batch is empty.
+ * @param [in, out] parser - pointer to the parser.
+ * @return Value @p true if the next batch can be parsed.
+ *         Value @p false if the commands stopped being run.
+ */
+static bool handOff(struct Parser *parser) {
+    struct Pipeline *pipeline = parser->pipeline;
+    if (pipeline->batches[parser->batch].count == 0) {
+        return true;
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->batches[parser->batch].full = true;
+    pthread_cond_broadcast(&pipeline->changed);
+    parser->batch = (parser->batch + 1) % BATCH_COUNT;
+    struct Batch *batch = &pipeline->batches[parser->batch];
+    while (batch->full && !pipeline->stopped) {
+        pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+    }
+    bool stopped = pipeline->stopped;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    batch->count = 0;
+    batch->arenaSize = 0;
+    return !stopped;
+}
+
+/**
+ * @brief Parses the complete lines of the text, passing on the batches as they fill up.
+ * @param [in, out] parser - pointer to the parser.
+ * @param [in] text - pointer to the text.
+ * @param [in] size - number of the bytes of the text.
+ * @param [in] final - whether the text ends the input, so its last line is complete even without the end of line.
+ * @param [out] parsed - pointer to the number of the bytes of the parsed lines.
+ * @return Value @p true if the lines were parsed successfully.
+ *         Value @p false if there was an allocation error or the commands stopped being run.
+ */
+static bool parseLines(struct Parser *parser, char const *text, size_t size, bool final, size_t *parsed) {
+    size_t start = 0;
+    while (start < size) {
+        char const *end = memchr(text + start, '\n', size - start);
+        if (end == NULL && !final) {
+            break;
+        }
+        size_t len = end == NULL ? size - start : (size_t) (end - text) - start;
+
+        if (parser->pipeline->batches[parser->batch].count == BATCH_CAPACITY && !handOff(parser)) {
+            return false;
+        }
+        if (!parseLine(&parser->pipeline->batches[parser->batch], text + start, len)) {
+            parser->pipeline->failed = true;
+            return false;
+        }
+        start += len + 1;
+    }
+    *parsed = start < size ? start : size;
+    return true;
+}
+
+/**
+ * @brief Parses the input read in chunks.
+ * A line not ending in the read chunk is moved to the start of the buffer and completed with the next chunk, the
+ * buffer is enlarged only for the lines longer than it.
+ * @param [in, out] parser - pointer to the parser.
+ */
+static void parseRead(struct Parser *parser) {
+    struct Pipeline *pipeline = parser->pipeline;
+    size_t capacity = INPUT_CHUNK_SIZE;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL) {
+        pipeline->failed = true;
+        return;
+    }
+
+    size_t size = 0;
+    while (true) {
+        if (size == capacity) {
+            char *bigger = realloc(buffer, 2 * capacity);
+            if (bigger == NULL) {
+                pipeline->failed = true;
+                break;
+            }
+            buffer = bigger;
+            capacity *= 2;
+        }
+
+        ssize_t count = read(pipeline->fd, buffer + size, capacity - size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0) {
+            pipeline->failed = true;
+            break;
+        }
+
+        size_t parsed;
+        if (!parseLines(parser, buffer, size + count, count == 0, &parsed) || !handOff(parser) || count == 0) {
+            break;
+        }
+        size += count - parsed;
+        memmove(buffer, buffer + parsed, size);
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Parses the whole input, the function run by the thread of the parser.
+ * @param [in, out] context - pointer to the pipeline.
+ * @return NULL.
+ */
+static void *parseInput(void *context) {
+    struct Parser parser = {context, 0};
+    struct Pipeline *pipeline = parser.pipeline;
+    size_t parsed;
+    if (pipeline->mapped == NULL) {
+        parseRead(&parser);
+    } else if (parseLines(&parser, pipeline->mapped, pipeline->mappedSize, true, &parsed)) {
+        handOff(&parser);
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->finished = true;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Writes the results from the buffer to the standard output.
+ * @param [in, out] output - pointer to the buffer.
+ */
+static void flushOutput(struct Output *output) {
+    if (output->size > 0 && !output->failed &&
+        (fwrite(output->buffer, 1, output->size, stdout) != output->size || fflush(stdout) != 0)) {
+        output->failed = true;
+    }
+    output->size = 0;
+}
+
+/**
+ * @brief Makes room in the buffer for the given number of bytes.
+ * Writes the buffered results if they don't leave enough room and enlarges the buffer if it is too small anyway.
+ * @param [in, out] output - pointer to the buffer.
+ * @param [in] len - number of the bytes.
+ * @return Value @p true if the buffer has room for @p len more bytes.
+ *         Value @p false if there was an allocation error.
+ */
+static bool reserveOutput(struct Output *output, size_t len) {
+    if (output->capacity - output->size >= len) {
+        return true;
+    }
+
+    flushOutput(output);
+    if (output->capacity >= len) {
+        return true;
+    }
+    char *buffer = realloc(output->buffer, len);
+    if (buffer == NULL) {
+        return false;
+    }
+    output->buffer = buffer;
+    output->capacity = len;
+    return true;
+}
+
+/**
+ * @brief Appends the text to the buffer.
+ * @param [in, out] output - pointer to the buffer.
+ * @param [in] text - the text.
+ * @param [in] len - length of the text.
+ * @return Value @p true if the text was appended successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool writeOutput(struct Output *output, char const *text, size_t len) {
+    if (!reserveOutput(output, len)) {
+        return false;
+    }
+    memcpy(output->buffer + output->size, text, len);
+    output->size += len;
+    return true;
+}
+
+/**
+ * @brief Appends the number to the current line of the results, after a space unless it is the first one.
+ * @param [in, out] output - pointer to the buffer.
+ * @param [in] num - the number.
+ * @param [in] first - whether it is the first number of the line.
+ * @return Value @p true if the number was appended successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool writeNumber(struct Output *output, char const *num, bool first) {
+    return (first || writeOutput(output, " ", 1)) && writeOutput(output, num, strlen(num));
+}
+
+/**
+ * @struct ReverseLine
+ * @brief Line of the results of a reverse lookup.
+ * @var ReverseLine::output
+ *      Pointer to the buffer of the results.
+ * @var ReverseLine::first
+ *      Whether no number was written to the line yet.
+ * @var ReverseLine::failed
+ *      Whether there was an allocation error.
+ */
+struct ReverseLine {
+    struct Output *output;
+    bool first;
+    bool failed;
+};
+
+/**
+ * @brief Appends the number to the line of the results of a reverse lookup.
+ * @param [in] num - the number.
+ * @param [in, out] context - pointer to the line.
+ * @return Value @p true if the number was appended successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool visitReverse(char const *num, void *context) {
+    struct ReverseLine *line = context;
+    line->failed = !writeNumber(line->output, num, line->first);
+    line->first = false;
+    return !line->failed;
+}
+
+/**
+ * @brief Runs the command and appends its line of the results.
+ * @param [in, out] pf - pointer to the structure.
+ * @param [in] batch - pointer to the batch of the command.
+ * @param [in] command - pointer to the command.
+ * @param [in, out] output - pointer to the buffer of the results.
+ * @return Value @p true if the command was run successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool runCommand(PhoneForward *pf, struct Batch const *batch, struct Command const *command,
+                       struct Output *output) {
+    char const *num1 = batch->arena + command->arguments[0];
+    char const *num2 = batch->arena + command->arguments[1];
+    switch (command->kind) {
+        case ADD_COMMAND:
+            return phfwdAdd(pf, num1, num2) ? writeOutput(output, "OK\n", 3) : writeOutput(output, "ERROR\n", 6);
+        case DEL_COMMAND:
+            phfwdRemove(pf, num1);
+            return writeOutput(output, "OK\n", 3);
+        case GET_COMMAND: {
+            size_t len = phfwdGetInto(pf, num1, output->buffer + output->size, output->capacity - output->size);
+            if (len >= output->capacity - output->size) {
+                if (!reserveOutput(output, len + 1)) {
+                    return false;
+                }
+                phfwdGetInto(pf, num1, output->buffer + output->size, output->capacity - output->size);
+            }
+            output->size += len;
+            return writeOutput(output, "\n", 1);
+        }
+        case REVERSE_COMMAND: {
+            struct ReverseLine line = {output, true, false};
+            return phfwdReverseVisit(pf, num1, visitReverse, &line) && !line.failed && writeOutput(output, "\n", 1);
+        }
+        case GETREVERSE_COMMAND: {
+            PhoneNumbers *pnum = phfwdGetReverse(pf, num1);
+            bool written = pnum != NULL;
+            for (size_t i = 0; written && phnumGet(pnum, i) != NULL; i++) {
+                written = writeNumber(output, phnumGet(pnum, i), i == 0);
+            }
+            phnumDelete(pnum);
+            return written && writeOutput(output, "\n", 1);
+        }
+        default:
+            return writeOutput(output, "ERROR\n", 6);
+    }
+}
+
+/**
+ * @brief Runs the batches of the commands as the parser passes them on.
+ * The results are written out before waiting for a batch, so the answers to all the parsed commands are sent.
+ * @param [in, out] pipeline - pointer to the pipeline.
+ * @param [in, out] pf - pointer to the structure.
+ * @param [in, out] output - pointer to the buffer of the results.
+ * @return Value @p true if all the commands were run successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool runCommands(struct Pipeline *pipeline, PhoneForward *pf, struct Output *output) {
+    bool success = true;
+    for (size_t index = 0; success; index = (index + 1) % BATCH_COUNT) {
+        struct Batch *batch = &pipeline->batches[index];
+        pthread_mutex_lock(&pipeline->mutex);
+        while (!batch->full && !pipeline->finished) {
+            if (output->size > 0) {
+                pthread_mutex_unlock(&pipeline->mutex);
+                flushOutput(output);
+                pthread_mutex_lock(&pipeline->mutex);
+            } else {
+                pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+            }
+        }
+        bool full = batch->full;
+        pthread_mutex_unlock(&pipeline->mutex);
+        if (!full) {
+            break;
+        }
+
+        for (size_t i = 0; success && i < batch->count; i++) {
+            success = runCommand(pf, batch, &batch->commands[i], output);
+        }
+
+        pthread_mutex_lock(&pipeline->mutex);
+        batch->full = false;
+        pipeline->stopped = !success;
+        pthread_cond_broadcast(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+    flushOutput(output);
+    return success;
+}
+
+/**
+ * @brief Prepares the input, mapping it if it is a regular file.
+ * @param [in, out] pipeline - pointer to the pipeline, its input is set.
+ * @param [in] path - path of the input file or NULL for the standard input.
+ * @return Value @p true if the input was prepared successfully.
+ *         Value @p false if the file couldn't be opened.
+ */
+static bool openInput(struct Pipeline *pipeline, char const *path) {
+    pipeline->fd = path == NULL ? STDIN_FILENO : open(path, O_RDONLY);
+    pipeline->mapped = NULL;
+    pipeline->mappedSize = 0;
+    if (pipeline->fd < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(pipeline->fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        void *mapped = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, pipeline->fd, 0);
+        if (mapped != MAP_FAILED) {
+            posix_madvise(mapped, status.st_size, POSIX_MADV_SEQUENTIAL);
+            pipeline->mapped = mapped;
+            pipeline->mappedSize = status.st_size;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Allocates the batches of the pipeline.
+ * @param [in, out] pipeline - pointer to the pipeline.
+ * @return Value @p true if the batches were allocated successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool newBatches(struct Pipeline *pipeline) {
+    bool success = true;
+    for (size_t i = 0; i < BATCH_COUNT; i++) {
+        struct Batch *batch = &pipeline->batches[i];
+        batch->commands = malloc(BATCH_CAPACITY * sizeof(struct Command));
+        batch->count = 0;
+        batch->arena = malloc(FIRST_ARENA_CAPACITY);
+        batch->arenaSize = 0;
+        batch->arenaCapacity = FIRST_ARENA_CAPACITY;
+        batch->full = false;
+        success = success && batch->commands != NULL && batch->arena != NULL;
+    }
+    return success;
+}
+
+/**
+ * @brief Frees the batches and the input of the pipeline.
+ * @param [in, out] pipeline - pointer to the pipeline.
+ */
+static void deletePipeline(struct Pipeline *pipeline) {
+    for (size_t i = 0; i < BATCH_COUNT; i++) {
+        free(pipeline->batches[i].commands);
+        free(pipeline->batches[i].arena);
+    }
+    if (pipeline->mapped != NULL) {
+        munmap((void *) pipeline->mapped, pipeline->mappedSize);
+    }
+    if (pipeline->fd != STDIN_FILENO) {
+        close(pipeline->fd);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [file]\n", argv[0]);
+        return 1;
+    }
+
+    struct Pipeline pipeline;
+    if (!openInput(&pipeline, argc == 2 ? argv[1] : NULL)) {
+        fprintf(stderr, "Cannot open %s.\n", argv[1]);
+        return 1;
+    }
+    pthread_mutex_init(&pipeline.mutex, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+    pipeline.finished = false;
+    pipeline.failed = false;
+    pipeline.stopped = false;
+
+    struct Output output = {malloc(OUTPUT_BUFFER_SIZE), 0, OUTPUT_BUFFER_SIZE, false};
+    PhoneForward *pf = phfwdNew();
+    pthread_t parser;
+    bool success = newBatches(&pipeline) && pf != NULL && output.buffer != NULL &&
+                   pthread_create(&parser, NULL, parseInput, &pipeline) == 0;
+    if (success) {
+        success = runCommands(&pipeline, pf, &output);
+        pthread_join(parser, NULL);
+        success = success && !pipeline.failed;
+    }
+
+    phfwdDelete(pf);
+    free(output.buffer);
+    deletePipeline(&pipeline);
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.mutex);
+    if (output.failed) {
+        fprintf(stderr, "Cannot write the results.\n");
+        return 1;
+    } else if (!success) {
+        fprintf(stderr, "Allocation error or the input couldn't be read.\n");
+        return 1;
+    }
+    return 0;
+}
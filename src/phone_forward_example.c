@@ -3,11 +3,79 @@
 #endif
 
 #include "phone_forward.h"
+#include "phone_forward_shards.h"
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
 #define MAX_LEN 23
 
+static bool countTwo(char const *num, void *context) {
+  size_t *visited = context;
+  (void) num;
+  return ++*visited < 2;
+}
+
+static bool appendForwarding(char const *num1, char const *num2, void *context) {
+  char *listed = context;
+  strcat(listed, num1);
+  strcat(listed, ">");
+  strcat(listed, num2);
+  strcat(listed, ";");
+  return strlen(listed) < MAX_LEN;
+}
+
+static bool appendDiff(char const *num1, char const *before, char const *after, void *context) {
+  char *diffed = context;
+  strcat(diffed, num1);
+  strcat(diffed, ":");
+  strcat(diffed, before == NULL ? "" : before);
+  strcat(diffed, ">");
+  strcat(diffed, after == NULL ? "" : after);
+  strcat(diffed, ";");
+  return true;
+}
+
+static void checkBatch(PhoneForward const *pf) {
+  char const *nums[] = {"1234", "A", "125", "", "5"};
+  size_t offsets[5];
+  char buf[16];
+  assert(phfwdGetBatch(pf, nums, 5, offsets, buf, sizeof buf) == 11);
+  assert(strcmp(buf + offsets[0], "454") == 0);
+  assert(strcmp(buf + offsets[1], "") == 0);
+  assert(strcmp(buf + offsets[2], "95") == 0);
+  assert(strcmp(buf + offsets[3], "") == 0);
+  assert(strcmp(buf + offsets[4], "9") == 0);
+  memset(buf, 'X', sizeof buf);
+  assert(phfwdGetBatch(pf, nums, 5, offsets, buf, 6) == 11);
+  assert(offsets[0] == 0 && offsets[1] == 4 && offsets[2] == 5 && offsets[3] == 8 && offsets[4] == 9);
+  assert(strcmp(buf, "454") == 0 && buf[6] == 'X');
+  assert(phfwdGetBatch(pf, nums, 5, NULL, buf, sizeof buf) == 0);
+}
+
+static void checkIndex(PhoneForward const *pf) {
+  PhoneReverseCursor *cursor = phfwdReverseCursorNew(pf, "94");
+  char const *next;
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(strcmp(next, "124") == 0);
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(strcmp(next, "54") == 0);
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(strcmp(next, "94") == 0);
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(next == NULL);
+  phfwdReverseCursorDelete(cursor);
+  assert(phfwdReverseCount(pf, "9") == 3);
+  assert(phfwdReverseCount(pf, "454") == 2);
+  assert(phfwdReverseCount(pf, "A") == 0);
+  char listed[MAX_LEN + 1] = "";
+  assert(phfwdList(pf, "", appendForwarding, listed) == true);
+  assert(strcmp(listed, "12>9;123>45;5>9;") == 0);
+  listed[0] = '\0';
+  assert(phfwdList(pf, "123", appendForwarding, listed) == true);
+  assert(strcmp(listed, "123>45;") == 0);
+}
+
 int main() {
   char num1[MAX_LEN + 1], num2[MAX_LEN + 1];
   PhoneForward *pf;
@@ -30,6 +98,20 @@ int main() {
   assert(strcmp(phnumGet(pnum, 0), "12") == 0);
   phnumDelete(pnum);
 
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "94") == 0);
+  assert(phfwdGetInto(pf, "1234", num1, 2) == 2);
+  assert(strcmp(num1, "9") == 0);
+  assert(phfwdGetInto(pf, "A", num1, sizeof num1) == 0);
+  assert(strcmp(num1, "") == 0);
+
+  char const *batch[] = {"1234", "A", "12"};
+  size_t offsets[3];
+  assert(phfwdGetBatch(pf, batch, 3, offsets, num1, sizeof num1) == 7);
+  assert(strcmp(num1 + offsets[0], "94") == 0);
+  assert(strcmp(num1 + offsets[1], "") == 0);
+  assert(strcmp(num1 + offsets[2], "12") == 0);
+
   strcpy(num1, "123456");
   strcpy(num2, "777777");
   assert(phfwdAdd(pf, num1, num2) == true);
@@ -54,6 +136,18 @@ int main() {
   pnum = phfwdGet(pf, "432");
   assert(strcmp(phnumGet(pnum, 0), "433") == 0);
   phnumDelete(pnum);
+  pnum = phfwdResolve(pf, "4315", 10);
+  assert(strcmp(phnumGet(pnum, 0), "4335") == 0);
+  assert(phnumGet(pnum, 1) == NULL);
+  phnumDelete(pnum);
+  pnum = phfwdResolve(pf, "431", 1);
+  assert(strcmp(phnumGet(pnum, 0), "432") == 0);
+  phnumDelete(pnum);
+  assert(phfwdAdd(pf, "433", "431") == true);
+  pnum = phfwdResolve(pf, "431", SIZE_MAX);
+  assert(phnumGet(pnum, 0) == NULL);
+  phnumDelete(pnum);
+  phfwdRemove(pf, "433");
 
   pnum = phfwdReverse(pf, "432");
   assert(strcmp(phnumGet(pnum, 0), "431") == 0);
@@ -121,12 +215,247 @@ int main() {
   assert(phnumGet(pnum, 3) == NULL);
   phnumDelete(pnum);
 
+  PhoneReverseCursor *cursor = phfwdReverseCursorNew(pf, "434");
+  char const *next;
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(strcmp(next, "2334") == 0);
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(strcmp(next, "234") == 0);
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(strcmp(next, "434") == 0);
+  assert(phfwdReverseCursorNext(cursor, &next) == true);
+  assert(next == NULL);
+  phfwdReverseCursorDelete(cursor);
+
+  size_t visited = 0;
+  assert(phfwdReverseVisit(pf, "434", countTwo, &visited) == true);
+  assert(visited == 2);
+  assert(phfwdReverseCount(pf, "434") == 3);
+  assert(phfwdReverseCount(pf, "A") == 0);
+
   phfwdDelete(pf);
   pnum = NULL;
   phnumDelete(pnum);
   pf = NULL;
   phfwdDelete(pf);
 
+  char expected[24];
+  pf = phfwdNew();
+  for (int i = 0; i < 40; i++) {
+    snprintf(expected, sizeof expected, "3%02d", i);
+    assert(phfwdAdd(pf, expected, "8") == true);
+  }
+  for (int round = 0; round < 2; round++) {
+    size_t count = round == 0 ? 40 : 10;
+    PhoneNumbers *got = phfwdGetReverse(pf, "85");
+    pnum = phfwdReverse(pf, "85");
+    cursor = phfwdReverseCursorNew(pf, "85");
+    for (size_t i = 0; i < count; i++) {
+      snprintf(expected, sizeof expected, "3%02zu5", i);
+      assert(strcmp(phnumGet(pnum, i), expected) == 0);
+      assert(strcmp(phnumGet(got, i), expected) == 0);
+      assert(phfwdReverseCursorNext(cursor, &next) == true);
+      assert(strcmp(next, expected) == 0);
+    }
+    assert(strcmp(phnumGet(pnum, count), "85") == 0);
+    assert(phnumGet(pnum, count + 1) == NULL);
+    assert(strcmp(phnumGet(got, count), "85") == 0);
+    assert(phnumGet(got, count + 1) == NULL);
+    assert(phfwdReverseCursorNext(cursor, &next) == true);
+    assert(strcmp(next, "85") == 0);
+    assert(phfwdReverseCursorNext(cursor, &next) == true);
+    assert(next == NULL);
+    assert(phfwdReverseCount(pf, "85") == count + 1);
+    phfwdReverseCursorDelete(cursor);
+    phnumDelete(got);
+    phnumDelete(pnum);
+    phfwdRemove(pf, "31");
+    phfwdRemove(pf, "32");
+    phfwdRemove(pf, "33");
+  }
+  phfwdDelete(pf);
+
+  pf = phfwdNew();
+  for (int i = 0; i < 150; i++) {
+    snprintf(num1, sizeof num1, "4%03d", i);
+    snprintf(num2, sizeof num2, "6%03d", i);
+    assert(phfwdAdd(pf, num1, num2) == true);
+  }
+  assert(phfwdAdd(pf, "5", "6000") == true);
+  phfwdRemove(pf, "4");
+  for (int i = 0; i < 150; i++) {
+    snprintf(num2, sizeof num2, "6%03d", i);
+    pnum = phfwdReverse(pf, num2);
+    assert(strcmp(phnumGet(pnum, i == 0 ? 1 : 0), num2) == 0);
+    assert(phnumGet(pnum, i == 0 ? 2 : 1) == NULL);
+    phnumDelete(pnum);
+  }
+  pnum = phfwdReverse(pf, "6000");
+  assert(strcmp(phnumGet(pnum, 0), "5") == 0);
+  phnumDelete(pnum);
+  phfwdDelete(pf);
+
+  pf = phfwdNew();
+  assert(phfwdAdd(pf, "1234567890123456789012345", "9") == true);
+  assert(phfwdAdd(pf, "12345678901234567890123456789", "8") == true);
+  assert(phfwdAdd(pf, "1234567890123456789012347", "4") == true);
+  assert(phfwdAdd(pf, "1234567890129", "7") == true);
+  assert(phfwdAdd(pf, "555555555555553", "6") == true);
+  assert(phfwdAdd(pf, "55555555555555122222222", "6") == true);
+  assert(phfwdAdd(pf, "8812", "6") == true);
+  assert(phfwdAdd(pf, "88129", "7") == true);
+  assert(phfwdAdd(pf, "883", "6") == true);
+  assert(phfwdGetInto(pf, "12345678901234567890123451", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "91") == 0);
+  assert(phfwdGetInto(pf, "123456789012345678901234567890", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "80") == 0);
+  assert(phfwdGetInto(pf, "12345678901234567890123471", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "41") == 0);
+  PhoneForward *copy = phfwdClone(pf);
+  phfwdRemove(pf, "1234567890123456789012347");
+  phfwdRemove(pf, "1234567890129");
+  phfwdRemove(pf, "12345678901234567890123456");
+  phfwdRemove(pf, "555555555555553");
+  phfwdRemove(pf, "883");
+  assert(phfwdGetInto(pf, "12345678901234567890123451", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "91") == 0);
+  assert(phfwdGetInto(pf, "12345678901234567890123471", num1, sizeof num1) == 26);
+  assert(phfwdGetInto(pf, "12345678901299", num1, sizeof num1) == 14);
+  assert(strcmp(num1, "12345678901299") == 0);
+  assert(phfwdGetInto(pf, "123456789012345678901234567890", num1, sizeof num1) == 6);
+  assert(strcmp(num1, "967890") == 0);
+  assert(phfwdGetInto(pf, "555555555555551222222229", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "69") == 0);
+  assert(phfwdGetInto(pf, "881295", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "75") == 0);
+  assert(phfwdGetInto(pf, "88125", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "65") == 0);
+  assert(phfwdGetInto(pf, "8835", num1, sizeof num1) == 4);
+  assert(strcmp(num1, "8835") == 0);
+  pnum = phfwdReverse(pf, "91");
+  assert(strcmp(phnumGet(pnum, 0), "12345678901234567890123451") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "91") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdAdd(pf, "12345678901234567890123456789", "5") == true);
+  assert(phfwdGetInto(pf, "123456789012345678901234567890", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "50") == 0);
+  assert(phfwdGetInto(copy, "123456789012345678901234567890", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "80") == 0);
+  assert(phfwdGetInto(copy, "12345678901234567890123471", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "41") == 0);
+  assert(phfwdGetInto(copy, "12345678901299", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "79") == 0);
+  assert(phfwdGetInto(copy, "8835", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "65") == 0);
+  phfwdDelete(copy);
+  phfwdDelete(pf);
+
+  pf = phfwdNewConcurrent();
+  assert(phfwdAdd(pf, "8812", "6") == true);
+  assert(phfwdAdd(pf, "88129", "7") == true);
+  assert(phfwdAdd(pf, "88127", "5") == true);
+  assert(phfwdAdd(pf, "883", "6") == true);
+  phfwdRemove(pf, "883");
+  assert(phfwdGetInto(pf, "881295", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "75") == 0);
+  assert(phfwdGetInto(pf, "881275", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "55") == 0);
+  assert(phfwdGetInto(pf, "8835", num1, sizeof num1) == 4);
+  assert(strcmp(num1, "8835") == 0);
+  phfwdDelete(pf);
+
+  char const *sorted1[] = {"12", "123", "123", "5"};
+  char const *sorted2[] = {"9", "44", "45", "9"};
+  pf = phfwdBuildFromSorted(sorted1, sorted2, 4);
+  assert(pf != NULL);
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "454") == 0);
+  pnum = phfwdReverse(pf, "9");
+  assert(strcmp(phnumGet(pnum, 0), "12") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "5") == 0);
+  assert(strcmp(phnumGet(pnum, 2), "9") == 0);
+  assert(phnumGet(pnum, 3) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdFreeze(pf) == true);
+  assert(phfwdAdd(pf, "1", "2") == false);
+  checkBatch(pf);
+  checkIndex(pf);
+  pnum = phfwdReverse(pf, "44");
+  assert(strcmp(phnumGet(pnum, 0), "44") == 0);
+  assert(phnumGet(pnum, 1) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdSave(pf, "phone_forward_example.img") == true);
+  phfwdDelete(pf);
+  assert(phfwdBuildFromSorted(sorted2, sorted1, 4) == NULL);
+
+  pf = phfwdLoadMapped("phone_forward_example.img");
+  assert(pf != NULL);
+  remove("phone_forward_example.img");
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "454") == 0);
+  checkBatch(pf);
+  checkIndex(pf);
+  pnum = phfwdGetReverse(pf, "9");
+  assert(strcmp(phnumGet(pnum, 0), "12") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "5") == 0);
+  assert(strcmp(phnumGet(pnum, 2), "9") == 0);
+  assert(phnumGet(pnum, 3) == NULL);
+  phnumDelete(pnum);
+  pnum = phfwdGetReverse(pf, "454");
+  assert(strcmp(phnumGet(pnum, 0), "1234") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "454") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdAdd(pf, "1", "2") == false);
+  phfwdDelete(pf);
+
+  pf = phfwdRecover("phone_forward_example.img", "phone_forward_example.log", 1);
+  assert(pf != NULL);
+  assert(phfwdAdd(pf, "12", "34") == true);
+  assert(phfwdFreeze(pf) == false);
+  phfwdDelete(pf);
+  pf = phfwdRecover("phone_forward_example.img", "phone_forward_example.log", 1);
+  assert(phfwdGetInto(pf, "125", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "345") == 0);
+  assert(phfwdCompact(pf) == true);
+  phfwdRemove(pf, "1");
+  phfwdDelete(pf);
+  pf = phfwdRecover("phone_forward_example.img", "phone_forward_example.log", 0);
+  assert(phfwdGetInto(pf, "125", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "125") == 0);
+  phfwdDelete(pf);
+  remove("phone_forward_example.img");
+  remove("phone_forward_example.log");
+
+  pf = phfwdRecoverConcurrent("phone_forward_example.img", "phone_forward_example.log", 0);
+  assert(pf != NULL);
+  assert(phfwdAdd(pf, "12", "34") == true);
+  assert(phfwdAdd(pf, "5", "6") == true);
+  assert(phfwdCompact(pf) == true);
+  assert(phfwdAdd(pf, "123", "7") == true);
+  phfwdRemove(pf, "5");
+  char const *applied[] = {"8", "12"};
+  char const *appliedTo[] = {"9", "35"};
+  assert(phfwdApplyDiff(pf, applied, appliedTo, 2) == true);
+  assert(phfwdCompactWait(pf) == true);
+  assert(phfwdSyncLog(pf) == true);
+  phfwdDelete(pf);
+  pf = phfwdLoadMapped("phone_forward_example.img");
+  assert(pf != NULL);
+  assert(phfwdGetInto(pf, "125", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "345") == 0 || strcmp(num1, "355") == 0);
+  phfwdDelete(pf);
+  pf = phfwdRecoverConcurrent("phone_forward_example.img", "phone_forward_example.log", 0);
+  assert(pf != NULL);
+  num1[0] = '\0';
+  assert(phfwdList(pf, "", appendForwarding, num1) == true);
+  assert(strcmp(num1, "12>35;123>7;8>9;") == 0);
+  assert(phfwdReverseCount(pf, "6") == 1);
+  phfwdDelete(pf);
+  remove("phone_forward_example.img");
+  remove("phone_forward_example.log");
+
   pf = phfwdNew();
   phfwdAdd(pf, "1234", "76");
   pnum = phfwdGet(pf, "1234581");
@@ -139,5 +468,252 @@ int main() {
   assert(strcmp(phnumGet(pnum, 0), "7581") == 0);
   assert(phnumGet(pnum, 1) == NULL);
   phnumDelete(pnum);
+  PhoneForwardStats stats;
+  assert(phfwdStats(pf, &stats) == true);
+  assert(stats.forward.nodes == 2 && stats.reverse.nodes == 2);
+  assert(stats.forward.depths[1] == 1 && stats.forward.fanOuts[0] == 1);
+  assert(stats.largestReverseBucket == 1);
+  assert(stats.getCalls == 2 && stats.reverseCalls == 1 && stats.digitsWalked == 4);
+  assert(phfwdFreeze(pf) == true);
+  assert(phfwdStats(pf, &stats) == true);
+  assert(stats.forward.nodes == 2 && stats.reverse.nodes == 2 && stats.getCalls == 2);
+  assert(phfwdStats(NULL, &stats) == false);
+  phfwdDelete(pf);
+
+  pf = phfwdNew();
+  assert(phfwdEnableCache(pf, 16) == true);
+  assert(phfwdAdd(pf, "12", "3") == true);
+  assert(phfwdAdd(pf, "4", "3") == true);
+  for (int i = 0; i < 2; i++) {
+    pnum = phfwdGet(pf, "125");
+    assert(strcmp(phnumGet(pnum, 0), "35") == 0);
+    phnumDelete(pnum);
+    pnum = phfwdGetReverse(pf, "35");
+    assert(strcmp(phnumGet(pnum, 0), "125") == 0);
+    assert(strcmp(phnumGet(pnum, 1), "35") == 0);
+    assert(strcmp(phnumGet(pnum, 2), "45") == 0);
+    phnumDelete(pnum);
+  }
+  assert(phfwdGetInto(pf, "125", num1, sizeof num1) == 2);
+  assert(phfwdStats(pf, &stats) == true && stats.cacheHits == 1);
+  assert(phfwdAdd(pf, "125", "6") == true);
+  assert(phfwdGetInto(pf, "125", num1, sizeof num1) == 1);
+  assert(strcmp(num1, "6") == 0);
+  phfwdRemove(pf, "4");
+  pnum = phfwdGetReverse(pf, "35");
+  assert(strcmp(phnumGet(pnum, 0), "35") == 0);
+  assert(phnumGet(pnum, 1) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdEnableCache(pf, 0) == true);
+  phfwdDelete(pf);
+
+  pf = phfwdNew();
+  assert(phfwdEnableCache(pf, 16) == true);
+  assert(phfwdAdd(pf, "1", "5") == true);
+  assert(phfwdAdd(pf, "12", "7") == true);
+  pnum = phfwdGetReverse(pf, "523");
+  assert(strcmp(phnumGet(pnum, 0), "523") == 0);
+  assert(phnumGet(pnum, 1) == NULL);
+  phnumDelete(pnum);
+  phfwdRemove(pf, "12");
+  pnum = phfwdGetReverse(pf, "523");
+  assert(strcmp(phnumGet(pnum, 0), "123") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "523") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdStats(pf, &stats) == true && stats.cacheHits == 0);
   phfwdDelete(pf);
+
+  pf = phfwdNew();
+  assert(phfwdAddN(pf, "12345", 2, "9876", 1) == true);
+  assert(phfwdAddN(pf, "12", 2, "1299", 2) == false);
+  assert(phfwdAddN(pf, "1A", 2, "3", 1) == false);
+  assert(phfwdAddN(pf, "1", 0, "3", 1) == false);
+  pnum = phfwdGetN(pf, "1234", 3);
+  assert(strcmp(phnumGet(pnum, 0), "93") == 0);
+  phnumDelete(pnum);
+  pnum = phfwdGetN(pf, "12", 0);
+  assert(phnumGet(pnum, 0) == NULL);
+  phnumDelete(pnum);
+  phfwdDelete(pf);
+
+  pf = phfwdNewConcurrent();
+  assert(phfwdAdd(pf, "12", "9") == true);
+  assert(phfwdAdd(pf, "123", "45") == true);
+  assert(phfwdAdd(pf, "5", "9") == true);
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "454") == 0);
+  phfwdRemove(pf, "12");
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 4);
+  pnum = phfwdReverse(pf, "9");
+  assert(strcmp(phnumGet(pnum, 0), "5") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "9") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdFreeze(pf) == false);
+  phfwdDelete(pf);
+
+  assert(phfwdNewWithOptions(4) == NULL);
+  pf = phfwdNewWithOptions(PHFWD_FORWARD_ONLY);
+  assert(phfwdAdd(pf, "12", "9") == true);
+  assert(phfwdAdd(pf, "123", "45") == true);
+  assert(phfwdAdd(pf, "5", "9") == true);
+  assert(phfwdAdd(pf, "12", "7") == true);
+  phfwdRemove(pf, "123");
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "734") == 0);
+  assert(phfwdReverseCount(pf, "9") == 2);
+  assert(phfwdAdd(pf, "6", "9") == true);
+  pnum = phfwdReverse(pf, "9");
+  assert(strcmp(phnumGet(pnum, 0), "5") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "6") == 0);
+  assert(strcmp(phnumGet(pnum, 2), "9") == 0);
+  assert(phnumGet(pnum, 3) == NULL);
+  phnumDelete(pnum);
+  num1[0] = '\0';
+  assert(phfwdList(pf, "", appendForwarding, num1) == true);
+  assert(strcmp(num1, "12>7;5>9;6>9;") == 0);
+  num1[0] = '\0';
+  assert(phfwdList(pf, "1", appendForwarding, num1) == true);
+  assert(strcmp(num1, "12>7;") == 0);
+  num1[0] = '\0';
+  assert(phfwdList(pf, "13", appendForwarding, num1) == true);
+  assert(phfwdList(pf, "A", appendForwarding, num1) == true);
+  assert(strcmp(num1, "") == 0);
+  phfwdDelete(pf);
+
+  pf = phfwdNewWithOptions(PHFWD_CONCURRENT | PHFWD_FORWARD_ONLY);
+  assert(phfwdAdd(pf, "12", "9") == true);
+  pnum = phfwdGetReverse(pf, "934");
+  assert(strcmp(phnumGet(pnum, 0), "1234") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "934") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  phfwdDelete(pf);
+
+  pf = phfwdNew();
+  assert(phfwdAdd(pf, "12", "9") == true);
+  assert(phfwdAdd(pf, "123", "45") == true);
+  PhoneForward *clone = phfwdClone(pf);
+  assert(clone != NULL);
+  assert(phfwdAdd(clone, "123", "7") == true);
+  phfwdRemove(pf, "12");
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 4);
+  assert(strcmp(num1, "1234") == 0);
+  assert(phfwdGetInto(clone, "1234", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "74") == 0);
+  assert(phfwdReverseCount(clone, "9") == 2);
+  assert(phfwdReverseCount(pf, "9") == 1);
+  PhoneForward *second = phfwdClone(clone);
+  phfwdDelete(clone);
+  assert(phfwdGetInto(second, "125", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "95") == 0);
+  assert(phfwdFreeze(second) == true);
+  assert(phfwdClone(second) == NULL);
+  phfwdDelete(second);
+  phfwdDelete(pf);
+
+  char diffed[64] = "";
+  pf = phfwdNew();
+  assert(phfwdAdd(pf, "12", "9") == true);
+  assert(phfwdAdd(pf, "123", "45") == true);
+  assert(phfwdAdd(pf, "5", "6") == true);
+  clone = phfwdClone(pf);
+  assert(phfwdDiff(pf, clone, appendDiff, diffed) == true);
+  assert(strcmp(diffed, "") == 0);
+  assert(phfwdAdd(clone, "123", "7") == true);
+  assert(phfwdAdd(clone, "8", "1") == true);
+  phfwdRemove(clone, "5");
+  assert(phfwdDiff(pf, clone, appendDiff, diffed) == true);
+  assert(strcmp(diffed, "123:45>7;5:6>;8:>1;") == 0);
+  char const *changed[] = {"123", "5", "8", "12"};
+  char const *changedTo[] = {"7", NULL, "1", NULL};
+  assert(phfwdApplyDiff(pf, changed, changedTo, 3) == true);
+  diffed[0] = '\0';
+  assert(phfwdDiff(pf, clone, appendDiff, diffed) == true);
+  assert(strcmp(diffed, "") == 0);
+  assert(phfwdApplyDiff(pf, changed + 3, changedTo + 3, 1) == true);
+  assert(phfwdGetInto(pf, "1234", num1, sizeof num1) == 2);
+  assert(strcmp(num1, "74") == 0);
+  assert(phfwdGetInto(pf, "125", num1, sizeof num1) == 3);
+  assert(strcmp(num1, "125") == 0);
+  assert(phfwdReverseCount(pf, "9") == 1);
+  assert(phfwdApplyDiff(pf, changed + 3, changed + 3, 1) == false);
+  phfwdDelete(clone);
+  phfwdDelete(pf);
+
+  char longNum[48], longTarget[48];
+  pf = phfwdNew();
+  for (int i = 0; i < 100; i++) {
+    snprintf(longNum, sizeof longNum, "1%02d", i);
+    snprintf(longTarget, sizeof longTarget, "%040d", i);
+    assert(phfwdAdd(pf, longNum, longTarget) == true);
+  }
+  for (int i = 0; i < 10; i++) {
+    snprintf(longNum, sizeof longNum, "2%d", i);
+    assert(phfwdAdd(pf, longNum, "7777777777777777777777777777777777777777") == true);
+  }
+  for (int i = 0; i < 50; i++) {
+    snprintf(longNum, sizeof longNum, "1%02d", i);
+    snprintf(longTarget, sizeof longTarget, "%040d", i + 100);
+    assert(phfwdAdd(pf, longNum, longTarget) == true);
+  }
+  assert(phfwdGetInto(pf, "1071", longNum, sizeof longNum) == 41);
+  assert(strcmp(longNum, "00000000000000000000000000000000000001071") == 0);
+  assert(phfwdGetInto(pf, "1991", longNum, sizeof longNum) == 41);
+  assert(strcmp(longNum, "00000000000000000000000000000000000000991") == 0);
+  assert(phfwdReverseCount(pf, "0000000000000000000000000000000000000007") == 1);
+  assert(phfwdReverseCount(pf, "7777777777777777777777777777777777777777") == 11);
+  phfwdRemove(pf, "1");
+  assert(phfwdGetInto(pf, "199", longNum, sizeof longNum) == 3);
+  assert(strcmp(longNum, "199") == 0);
+  assert(phfwdReverseCount(pf, "0000000000000000000000000000000000000107") == 1);
+  phfwdRemove(pf, "25");
+  pnum = phfwdReverse(pf, "7777777777777777777777777777777777777777");
+  assert(strcmp(phnumGet(pnum, 0), "20") == 0);
+  assert(strcmp(phnumGet(pnum, 4), "24") == 0);
+  assert(strcmp(phnumGet(pnum, 5), "26") == 0);
+  assert(strcmp(phnumGet(pnum, 9), "7777777777777777777777777777777777777777") == 0);
+  assert(phnumGet(pnum, 10) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdGetInto(pf, "299", longNum, sizeof longNum) == 41);
+  assert(strcmp(longNum, "77777777777777777777777777777777777777779") == 0);
+  phfwdDelete(pf);
+
+  PhoneForwardShards *shards = phfwdShardsNew(2);
+  assert(shards != NULL);
+  char const *from[] = {"12", "123", "5", "A", "#1"};
+  char const *to[] = {"9", "45", "9", "1", "9"};
+#ifdef PHFWD_DECIMAL_ONLY
+  assert(phfwdShardsAdd(shards, from, to, 5) == 3);
+#else
+  assert(phfwdShardsAdd(shards, from, to, 5) == 4);
+#endif
+  pnum = phfwdShardsGet(shards, "1234");
+  assert(strcmp(phnumGet(pnum, 0), "454") == 0);
+  phnumDelete(pnum);
+  pnum = phfwdShardsReverse(shards, "9");
+  assert(strcmp(phnumGet(pnum, 0), "12") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "5") == 0);
+  assert(strcmp(phnumGet(pnum, 2), "9") == 0);
+#ifdef PHFWD_DECIMAL_ONLY
+  assert(phnumGet(pnum, 3) == NULL);
+#else
+  assert(strcmp(phnumGet(pnum, 3), "#1") == 0);
+  assert(phnumGet(pnum, 4) == NULL);
+#endif
+  phnumDelete(pnum);
+  char const *removed[] = {"12", "4"};
+  phfwdShardsRemove(shards, removed, 2);
+  pnum = phfwdShardsGetReverse(shards, "94");
+  assert(strcmp(phnumGet(pnum, 0), "54") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "94") == 0);
+#ifdef PHFWD_DECIMAL_ONLY
+  assert(phnumGet(pnum, 2) == NULL);
+#else
+  assert(strcmp(phnumGet(pnum, 2), "#14") == 0);
+  assert(phnumGet(pnum, 3) == NULL);
+#endif
+  phnumDelete(pnum);
+  phfwdShardsDelete(shards);
 }
@@ -0,0 +1,292 @@
+/** @file
+ * Implementations of functions of phone forwarding split into shards.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "phone_forward.h"
+#include "phone_forward_shards.h"
+#include "phone_numbers.h"
+#include "string_utils.h"
+#include "thread_pool.h"
+
+#define SHARD_COUNT NUMBER_OF_DIGITS /**< Number of the shards, one for each digit. */
+#define NO_SHARD SHARD_COUNT /**< The string doesn't start with a digit, so it belongs to no shard. */
+
+/**
+ * @struct PhoneForwardShards phone_forward_shards.h
+ * @brief Structure containing the shards and the threads changing them.
+ * @var PhoneForwardShards::shards
+ *      Array of the shards, the shard of each digit is at the index of its decimal representation.
+ * @var PhoneForwardShards::pool
+ *      Pointer to the pool of the threads applying the batches of changes.
+ */
+struct PhoneForwardShards {
+    PhoneForward *shards[SHARD_COUNT];
+    ThreadPool *pool;
+};
+
+/**
+ * @struct Batch
+ * @brief Changes split between the shards.
+ * @var Batch::shards
+ *      Pointer to the changed structure.
+ * @var Batch::nums1
+ *      Array of the forwarded prefixes or the removed prefixes.
+ * @var Batch::nums2
+ *      Array of the prefixes the numbers are forwarded to, unused for removals.
+ * @var Batch::remove
+ *      Whether the prefixes are removed instead of added.
+ * @var Batch::order
+ *      Indexes of the changes grouped by the shards, in the given order within each shard.
+ * @var Batch::starts
+ *      Position in @p order of the first change of each shard, the last element is the number of the changes.
+ * @var Batch::tasks
+ *      Shards that have any changes, one for each task of the pool.
+ * @var Batch::added
+ *      Number of the forwardings added to each shard.
+ */
+struct Batch {
+    PhoneForwardShards *shards;
+    char const *const *nums1;
+    char const *const *nums2;
+    bool remove;
+    size_t *order;
+    size_t starts[SHARD_COUNT + 1];
+    size_t tasks[SHARD_COUNT];
+    size_t added[SHARD_COUNT];
+};
+
+/**
+ * @brief Gives the shard keeping the forwardings of the number.
+ * @param [in] num - pointer to the number.
+ * @return Index of the shard or @ref NO_SHARD if the string doesn't start with a digit.
+ */
+static size_t shardOf(char const *num) {
+    if (num == NULL || !isValidDigit(num[0])) {
+        return NO_SHARD;
+    }
+    return (size_t) toDecimalRepresentation(num[0]);
+}
+
+/**
+ * @brief Applies a single change of the batch to the shard.
+ * @param [in, out] pf - pointer to the shard.
+ * @param [in] batch - pointer to the batch.
+ * @param [in] i - index of the change.
+ * @return Value @p true if a forwarding was added.
+ *         Value @p false if the prefix was removed or the forwarding couldn't be added.
+ */
+static bool applyChange(PhoneForward *pf, struct Batch const *batch, size_t i) {
+    if (batch->remove) {
+        phfwdRemove(pf, batch->nums1[i]);
+        return false;
+    }
+    return phfwdAdd(pf, batch->nums1[i], batch->nums2[i]);
+}
+
+/**
+ * @brief Applies the changes of a single shard, it is run as a task of the pool.
+ * @param [in, out] context - pointer to the batch.
+ * @param [in] index - index of the task.
+ */
+static void applyShard(void *context, size_t index) {
+    struct Batch *batch = context;
+    size_t shard = batch->tasks[index];
+    PhoneForward *pf = batch->shards->shards[shard];
+
+    size_t added = 0;
+    for (size_t i = batch->starts[shard]; i < batch->starts[shard + 1]; i++) {
+        if (applyChange(pf, batch, batch->order[i])) {
+            added++;
+        }
+    }
+    batch->added[shard] = added;
+}
+
+/**
+ * @brief Splits the changes between the shards and applies them in parallel.
+ * If there is no memory to split the changes, they are applied one by one by the calling thread.
+ * @param [in, out] batch - pointer to the batch, all fields but @p order, @p starts, @p tasks and @p added have to be
+ *                          set.
+ * @param [in] count - number of the changes.
+ * @return Number of the forwardings that were added.
+ */
+static size_t applyBatch(struct Batch *batch, size_t count) {
+    size_t added = 0;
+    batch->order = malloc(count * sizeof(size_t));
+    if (batch->order == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            size_t shard = shardOf(batch->nums1[i]);
+            if (shard != NO_SHARD && applyChange(batch->shards->shards[shard], batch, i)) {
+                added++;
+            }
+        }
+        return added;
+    }
+
+    size_t positions[SHARD_COUNT] = {0};
+    for (size_t i = 0; i < count; i++) {
+        size_t shard = shardOf(batch->nums1[i]);
+        if (shard != NO_SHARD) {
+            positions[shard]++;
+        }
+    }
+
+    size_t taskCount = 0;
+    batch->starts[0] = 0;
+    for (size_t shard = 0; shard < SHARD_COUNT; shard++) {
+        batch->starts[shard + 1] = batch->starts[shard] + positions[shard];
+        if (positions[shard] > 0) {
+            batch->tasks[taskCount++] = shard;
+        }
+        positions[shard] = batch->starts[shard];
+        batch->added[shard] = 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t shard = shardOf(batch->nums1[i]);
+        if (shard != NO_SHARD) {
+            batch->order[positions[shard]++] = i;
+        }
+    }
+
+    threadPoolRun(batch->shards->pool, applyShard, batch, taskCount);
+    free(batch->order);
+
+    for (size_t shard = 0; shard < SHARD_COUNT; shard++) {
+        added += batch->added[shard];
+    }
+    return added;
+}
+
+/**
+ * @brief Asks every shard and joins the results.
+ * Keeps only the numbers starting with the digit of the shard that gave them, the forwardings from other numbers
+ * aren't known to that shard. The shards are visited in the order of the digits, so the joined numbers stay sorted.
+ * @param [in] shards - pointer to the structure.
+ * @param [in] num - pointer to the number.
+ * @param [in] query - the function asking a single shard.
+ * @return Pointer to the joined numbers or NULL if there was an allocation error.
+ */
+static PhoneNumbers *joinShards(PhoneForwardShards const *shards, char const *num,
+                                PhoneNumbers *(*query)(PhoneForward const *, char const *)) {
+    if (shards == NULL) {
+        return NULL;
+    }
+
+    PhoneNumbers *joined = phnumNew();
+    if (joined == NULL || !isNumber(num)) {
+        return joined;
+    }
+
+    PhoneNumbers *results[SHARD_COUNT];
+    bool success = true;
+    size_t total = 0;
+    for (size_t shard = 0; shard < SHARD_COUNT; shard++) {
+        results[shard] = success ? query(shards->shards[shard], num) : NULL;
+        if (results[shard] == NULL) {
+            success = false;
+        } else {
+            total += phnumGetSize(results[shard]);
+        }
+    }
+    success = success && phnumReserve(joined, total);
+
+    for (size_t shard = 0; shard < SHARD_COUNT && success; shard++) {
+        char const *number;
+        for (size_t i = 0; success && (number = phnumGet(results[shard], i)) != NULL; i++) {
+            char *copy = NULL;
+            if (shardOf(number) != shard) {
+                continue;
+            }
+            if (!copyNumber(number, &copy)) {
+                success = false;
+            } else if (!phnumAdd(joined, &copy)) {
+                free(copy);
+                success = false;
+            }
+        }
+    }
+
+    for (size_t shard = 0; shard < SHARD_COUNT; shard++) {
+        phnumDelete(results[shard]);
+    }
+    if (!success) {
+        phnumDelete(joined);
+        return NULL;
+    }
+    return joined;
+}
+
+PhoneForwardShards *phfwdShardsNew(size_t threadCount) {
+    PhoneForwardShards *shards = malloc(sizeof(PhoneForwardShards));
+    if (shards == NULL) {
+        return NULL;
+    }
+
+    shards->pool = threadPoolNew(threadCount);
+    bool success = shards->pool != NULL;
+    for (size_t shard = 0; shard < SHARD_COUNT; shard++) {
+        shards->shards[shard] = success ? phfwdNewConcurrent() : NULL;
+        success = shards->shards[shard] != NULL;
+    }
+
+    if (!success) {
+        phfwdShardsDelete(shards);
+        return NULL;
+    }
+    return shards;
+}
+
+void phfwdShardsDelete(PhoneForwardShards *shards) {
+    if (shards == NULL) {
+        return;
+    }
+
+    threadPoolDelete(shards->pool);
+    for (size_t shard = 0; shard < SHARD_COUNT; shard++) {
+        phfwdDelete(shards->shards[shard]);
+    }
+    free(shards);
+}
+
+size_t phfwdShardsAdd(PhoneForwardShards *shards, char const *const *nums1, char const *const *nums2, size_t count) {
+    if (shards == NULL || nums1 == NULL || nums2 == NULL || count == 0) {
+        return 0;
+    }
+
+    struct Batch batch = {.shards = shards, .nums1 = nums1, .nums2 = nums2, .remove = false};
+    return applyBatch(&batch, count);
+}
+
+void phfwdShardsRemove(PhoneForwardShards *shards, char const *const *nums, size_t count) {
+    if (shards == NULL || nums == NULL || count == 0) {
+        return;
+    }
+
+    struct Batch batch = {.shards = shards, .nums1 = nums, .nums2 = NULL, .remove = true};
+    applyBatch(&batch, count);
+}
+
+PhoneNumbers *phfwdShardsGet(PhoneForwardShards const *shards, char const *num) {
+    if (shards == NULL) {
+        return NULL;
+    }
+
+    size_t shard = shardOf(num);
+    return phfwdGet(shards->shards[shard == NO_SHARD ? 0 : shard], num);
+}
+
+PhoneNumbers *phfwdShardsReverse(PhoneForwardShards const *shards, char const *num) {
+    return joinShards(shards, num, phfwdReverse);
+}
+
+PhoneNumbers *phfwdShardsGetReverse(PhoneForwardShards const *shards, char const *num) {
+    return joinShards(shards, num, phfwdGetReverse);
+}
@@ -0,0 +1,88 @@
+/** @file
+ * Interface of the class storing phone forwarding split into shards.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __PHONE_FORWARD_SHARDS_H__
+#define __PHONE_FORWARD_SHARDS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "phone_forward.h"
+
+/**
+ * This is a structure containing phone forwarding information split by the first digit of the forwarded numbers.
+ * Each shard is a separate structure created with @ref phfwdNewConcurrent, with its own trees and its own writer lock.
+ * All forwardings that can apply to a number are kept in the shard of its first digit.
+ */
+struct PhoneForwardShards;
+typedef struct PhoneForwardShards PhoneForwardShards; /**< Type of structure containing the shards. */
+
+/** @brief Creates new structure.
+ * Creates new structure without any phone forwarding information.
+ * @param[in] threadCount – number of the threads which change the shards besides the calling one.
+ * @return Pointer to the new structure or NULL if there was an allocation error or a thread
+ *         couldn't be started.
+ */
+PhoneForwardShards * phfwdShardsNew(size_t threadCount);
+
+/** @brief Deletes the structure.
+ * Deletes the structure pointed by @p shards. Does nothing when the pointer is NULL.
+ * @param[in] shards – pointer to the structure to be deleted.
+ */
+void phfwdShardsDelete(PhoneForwardShards *shards);
+
+/** @brief Adds many phone forwardings at once.
+ * Works like @ref phfwdAdd for each pair of @p nums1[i] and @p nums2[i]. The pairs of each
+ * shard are added in the given order, the shards are changed in parallel by the threads of the
+ * structure. Readers may query the structure at the same time.
+ * @param[in,out] shards – pointer to the structure containing phone forwarding information.
+ * @param[in] nums1      – array of pointers to the prefixes of the phone numbers to be forwarded.
+ * @param[in] nums2      – array of pointers to the prefixes of the phone numbers to be forwarded to.
+ * @param[in] count      – number of the phone forwardings.
+ * @return Number of the phone forwardings that were added.
+ */
+size_t phfwdShardsAdd(PhoneForwardShards *shards, char const *const *nums1, char const *const *nums2, size_t count);
+
+/** @brief Removes many phone forwardings at once.
+ * Works like @ref phfwdRemove for each of @p nums[i]. The prefixes of each shard are removed
+ * in the given order, the shards are changed in parallel by the threads of the structure.
+ * @param[in,out] shards – pointer to the structure containing phone forwarding information.
+ * @param[in] nums       – array of pointers to the prefixes of the removed phone forwardings.
+ * @param[in] count      – number of the prefixes.
+ */
+void phfwdShardsRemove(PhoneForwardShards *shards, char const *const *nums, size_t count);
+
+/** @brief Determines phone forwarding of the number.
+ * Works like @ref phfwdGet, only the shard of the first digit of @p num is read.
+ * @param[in] shards – pointer to the structure containing phone forwarding information.
+ * @param[in] num    – pointer to the number.
+ * @return Pointer to the structure containing a sequence of numbers or NULL if there was an
+ *         allocation error.
+ */
+PhoneNumbers * phfwdShardsGet(PhoneForwardShards const *shards, char const *num);
+
+/** @brief Determines phone forwarding to the number.
+ * Works like @ref phfwdReverse. Every shard is asked, each one gives the numbers starting with
+ * its own digit, so the results are joined in the order of the shards without comparing them.
+ * @param[in] shards – pointer to the structure containing phone forwarding information.
+ * @param[in] num    – pointer to the number.
+ * @return Pointer to the structure containing a sequence of numbers or NULL if there was an
+ *         allocation error.
+ */
+PhoneNumbers * phfwdShardsReverse(PhoneForwardShards const *shards, char const *num);
+
+/** @brief Determines the numbers, which are forwarded to the given number.
+ * Works like @ref phfwdGetReverse, the results of the shards are joined like in
+ * @ref phfwdShardsReverse.
+ * @param[in] shards – pointer to the structure containing phone forwarding information.
+ * @param[in] num    – pointer to the number.
+ * @return Pointer to the structure containing a sequence of numbers or NULL if there was an
+ *         allocation error.
+ */
+PhoneNumbers * phfwdShardsGetReverse(PhoneForwardShards const *shards, char const *num);
+
+#endif /* __PHONE_FORWARD_SHARDS_H__ */
@@ -12,6 +12,9 @@
 #include "phone_numbers.h"
 #include "string_utils.h"
 
+#define SORT_SYMBOLS (NUMBER_OF_DIGITS + 1) /**< Number of different digits increased by one for the end of the number. */
+#define INSERTION_SORT_THRESHOLD 16 /**< Size of the part of the array that is sorted with insertion sort. */
+
 /**
  * @struct PhoneNumber
  * @brief Structure containing a single phone number.
@@ -55,150 +58,197 @@ size_t phnumGetSize(PhoneNumbers const *pNumbers) {
     return pNumbers->size;
 }
 
+size_t phnumGetMemory(PhoneNumbers const *pNumbers) {
+    return sizeof(PhoneNumbers) + (pNumbers->array != NULL ? pNumbers->capacity * sizeof(PNumber) : 0);
+}
+
 bool phnumAdd(PhoneNumbers *pNumbers, char **number) {
     pNumbers->size++;
 
     if (pNumbers->size == pNumbers->capacity) {
-        pNumbers->capacity *= 2;
-        PNumber *tmp = realloc(pNumbers->array, pNumbers->capacity * sizeof(PNumber));
+        PNumber *tmp = realloc(pNumbers->array, pNumbers->capacity * 2 * sizeof(PNumber));
         if (tmp == NULL) {
             pNumbers->size--;
             return false;
         }
         pNumbers->array = tmp;
+        pNumbers->capacity *= 2;
     }
 
     pNumbers->array[pNumbers->size - 1].number = *number;
     return true;
 }
 
-bool phnumAddAllCopiedParts(PhoneNumbers *from, PhoneNumbers *to, char const *originalNumber, size_t prefixLength) {
-    for (size_t i = 0; i < from->size; i++) {
-        char *result = NULL;
-        if (!copyParts(originalNumber, from->array[i].number, prefixLength, &result)) {
-            return false;
-        }
-        if (!phnumAdd(to, &result)) {
-            free(result);
-            return false;
-        }
-    }
-
-    return true;
-}
-
-void phnumRemove(PhoneNumbers **pNumbersPtr, char const *num) {
-    PhoneNumbers *pNumbers = *pNumbersPtr;
-    if (pNumbers == NULL) {
-        return;
-    }
-
-    size_t i;
-    for (i = 0; i < pNumbers->size; i++) {
-        if (areEqual(pNumbers->array[i].number, num)) {
-            free(pNumbers->array[i].number);
-            pNumbers->size--;
-            break;
-        }
-    }
-
-    if (pNumbers->size == 0) {
-        free(pNumbers->array);
-        free(pNumbers);
-        pNumbers = NULL;
-        *pNumbersPtr = NULL;
-        return;
-    }
-
-    for (size_t j = i; j < pNumbers->size; j++) {
-        pNumbers->array[j] = pNumbers->array[j + 1];
-    }
-}
-
-void phnumRemoveWithPrefix(PhoneNumbers **pNumbersPtr, char const *prefix) {
-    PhoneNumbers *pNumbers = *pNumbersPtr;
-    if (pNumbers == NULL) {
-        return;
+bool phnumReserve(PhoneNumbers *pNumbers, size_t count) {
+    size_t capacity = pNumbers->size + count + 1;
+    if (capacity <= pNumbers->capacity) {
+        return true;
     }
 
-    size_t i = 0;
-    while (i < pNumbers->size) {
-        if (isPrefix(pNumbers->array[i].number, prefix)) {
-            free(pNumbers->array[i].number);
-            pNumbers->array[i] = pNumbers->array[pNumbers->size - 1];
-            pNumbers->size--;
-        } else {
-            i++;
-        }
-    }
-
-    if (pNumbers->size == 0) {
-        free(pNumbers->array);
-        free(pNumbers);
-        pNumbers = NULL;
-        *pNumbersPtr = NULL;
-        return;
+    PNumber *tmp = realloc(pNumbers->array, capacity * sizeof(PNumber));
+    if (tmp == NULL) {
+        return false;
     }
+    pNumbers->array = tmp;
+    pNumbers->capacity = capacity;
+    return true;
 }
 
-void phnumRemoveAtIndex(PhoneNumbers *pNumbers, size_t index) {
-    free(pNumbers->array[index].number);
-    pNumbers->size--;
-
-    for (size_t i = index; i < pNumbers->size; i++) {
-        pNumbers->array[i] = pNumbers->array[i + 1];
-    }
+/**
+ * @brief Obtains the symbol of the number used for sorting.
+ * @param [in] number - the phone number.
+ * @param [in] depth - index of the character of the number.
+ * @return Value @p 0 if the number ends before the given index, otherwise the decimal representation of the digit
+ *         increased by one.
+ */
+static int sortSymbol(char const *number, size_t depth) {
+    return isValidDigit(number[depth]) ? toDecimalRepresentation(number[depth]) + 1 : 0;
 }
 
 /**
  * @brief Compares two phone numbers according to their lexicographical order.
  * @param [in] a - first phone number.
  * @param [in] b - second phone number.
+ * @param [in] depth - number of the first characters known to be equal in both numbers.
  * @return Value @p 1 if a is greater than b.
  *         Value @p -1 if a is less than b.
  *         Value @p 0 if a is equal to b.
  */
-static int comparePhoneNumbers(void const *a, void const *b) {
-    PNumber const *p1 = a;
-    PNumber const *p2 = b;
-
-    size_t i = 0;
-    while (isValidDigit(p1->number[i]) && isValidDigit(p2->number[i])) {
-        int const n1 = toDecimalRepresentation(p1->number[i]);
-        int const n2 = toDecimalRepresentation(p2->number[i]);
+static int comparePhoneNumbers(char const *a, char const *b, size_t depth) {
+    size_t i = depth;
+    while (true) {
+        int const n1 = sortSymbol(a, i);
+        int const n2 = sortSymbol(b, i);
 
         if (n1 > n2) {
             return 1;
         } else if (n1 < n2) {
             return -1;
+        } else if (n1 == 0) {
+            return 0;
         }
         i++;
     }
+}
 
-    if (isValidDigit(p1->number[i])) {
-        return 1;
-    } else if (isValidDigit(p2->number[i])) {
-        return -1;
+/**
+ * @brief Sorts a short part of the array with insertion sort and deletes the duplicates in it.
+ * The deleted numbers are set to NULL.
+ * @param [in, out] array - pointer to the first number of the part.
+ * @param [in] size - number of numbers in the part.
+ * @param [in] depth - number of the first characters known to be equal in all numbers of the part.
+ */
+static void insertionSortUnique(PNumber *array, size_t size, size_t depth) {
+    for (size_t i = 1; i < size; i++) {
+        PNumber current = array[i];
+        size_t j = i;
+        while (j > 0 && comparePhoneNumbers(array[j - 1].number, current.number, depth) > 0) {
+            array[j] = array[j - 1];
+            j--;
+        }
+        array[j] = current;
     }
 
-    return 0;
+    for (size_t i = size; i-- > 1;) {
+        if (comparePhoneNumbers(array[i - 1].number, array[i].number, depth) == 0) {
+            free(array[i].number);
+            array[i].number = NULL;
+        }
+    }
 }
 
+/**
+ * @struct SortSegment
+ * @brief Part of the array that is left to be sorted.
+ * @var SortSegment::begin
+ *      Index of the first number of the part.
+ * @var SortSegment::size
+ *      Number of numbers in the part.
+ * @var SortSegment::depth
+ *      Number of the first characters that are equal in all numbers of the part.
+ */
+struct SortSegment {
+    size_t begin;
+    size_t size;
+    size_t depth;
+};
 
-void sortPhoneNumbers(PhoneNumbers *pNumbers) {
-    qsort(pNumbers->array, pNumbers->size, sizeof(PNumber), comparePhoneNumbers);
-}
+bool sortUniquePhoneNumbers(PhoneNumbers *pNumbers) {
+    if (pNumbers->size < 2) {
+        return true;
+    }
+
+    PNumber *buffer = malloc(pNumbers->size * sizeof(PNumber));
+    size_t stackCapacity = SORT_SYMBOLS * 4;
+    struct SortSegment *stack = malloc(stackCapacity * sizeof(struct SortSegment));
+    if (buffer == NULL || stack == NULL) {
+        free(buffer);
+        free(stack);
+        return false;
+    }
+
+    PNumber *array = pNumbers->array;
+    bool result = true;
+    size_t stackSize = 0;
+    stack[stackSize++] = (struct SortSegment) {0, pNumbers->size, 0};
+
+    while (stackSize > 0) {
+        struct SortSegment segment = stack[--stackSize];
+        PNumber *part = array + segment.begin;
+        if (segment.size < INSERTION_SORT_THRESHOLD) {
+            insertionSortUnique(part, segment.size, segment.depth);
+            continue;
+        }
+
+        size_t count[SORT_SYMBOLS] = {0};
+        for (size_t i = 0; i < segment.size; i++) {
+            count[sortSymbol(part[i].number, segment.depth)]++;
+        }
 
-void removeDuplicates(PhoneNumbers *pNumbers) {
-    size_t i = 0;
+        if (stackSize + SORT_SYMBOLS > stackCapacity) {
+            struct SortSegment *newStack = realloc(stack, 2 * stackCapacity * sizeof(struct SortSegment));
+            if (newStack == NULL) {
+                result = false;
+                break;
+            }
+            stack = newStack;
+            stackCapacity *= 2;
+        }
+
+        size_t position[SORT_SYMBOLS];
+        size_t sum = 0;
+        for (int symbol = 0; symbol < SORT_SYMBOLS; symbol++) {
+            position[symbol] = sum;
+            if (symbol > 0 && count[symbol] > 1) {
+                stack[stackSize++] = (struct SortSegment) {segment.begin + sum, count[symbol], segment.depth + 1};
+            }
+            sum += count[symbol];
+        }
+
+        for (size_t i = 0; i < segment.size; i++) {
+            buffer[position[sortSymbol(part[i].number, segment.depth)]++] = part[i];
+        }
+        for (size_t i = 0; i < segment.size; i++) {
+            part[i] = buffer[i];
+        }
 
-    while (i < pNumbers->size - 1) {
-        if (areEqual(pNumbers->array[i].number, pNumbers->array[i + 1].number)) {
-            phnumRemoveAtIndex(pNumbers, i + 1);
-        } else {
-            i++;
+        for (size_t i = 1; i < count[0]; i++) {
+            free(part[i].number);
+            part[i].number = NULL;
         }
     }
+
+    size_t last = 0;
+    for (size_t i = 0; i < pNumbers->size; i++) {
+        if (array[i].number != NULL) {
+            array[last++] = array[i];
+        }
+    }
+    pNumbers->size = last;
+
+    free(buffer);
+    free(stack);
+    return result;
 }
 
 void phnumDelete(PhoneNumbers *pn) {
@@ -213,6 +263,27 @@ void phnumDelete(PhoneNumbers *pn) {
     free(pn);
 }
 
+PhoneNumbers *phnumCopy(PhoneNumbers const *pNumbers) {
+    PhoneNumbers *copy = phnumNew();
+    if (copy == NULL) {
+        return NULL;
+    }
+    if (!phnumReserve(copy, pNumbers->size)) {
+        phnumDelete(copy);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < pNumbers->size; i++) {
+        char *number = NULL;
+        if (!copyNumber(pNumbers->array[i].number, &number)) {
+            phnumDelete(copy);
+            return NULL;
+        }
+        copy->array[copy->size++].number = number;
+    }
+    return copy;
+}
+
 char const *phnumGet(PhoneNumbers const *pn, size_t idx) {
     if (pn == NULL || idx >= pn->size) {
         return NULL;
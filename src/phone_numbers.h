@@ -30,6 +30,22 @@ PhoneNumbers *phnumNew(void);
  */
 size_t phnumGetSize(PhoneNumbers const *pNumbers);
 
+/**
+ * @brief Obtains the memory taken by the phone numbers vector.
+ * Counts the structure and its array, but not the numbers themselves.
+ * @param [in] pNumbers - vector of phone numbers.
+ * @return Number of the bytes.
+ */
+size_t phnumGetMemory(PhoneNumbers const *pNumbers);
+
+/**
+ * @brief Copies the vector of phone numbers.
+ * Every number is copied too, so the copy can be changed without affecting the original vector.
+ * @param [in] pNumbers - vector of phone numbers.
+ * @return Pointer to the copy or NULL if there was an allocation error.
+ */
+PhoneNumbers *phnumCopy(PhoneNumbers const *pNumbers);
+
 /** @brief Adds phone number to the vector.
  * Allocates memory (if needed) for the new number and adds it to the array.
  * @param [in, out] pNumbers - pointer to the structure of phone numbers.
@@ -40,55 +56,24 @@ size_t phnumGetSize(PhoneNumbers const *pNumbers);
 bool phnumAdd(PhoneNumbers *pNumbers, char **number);
 
 /**
- * @brief Removes number from the vector.
- * This function will remove the number from the given vector. If the vector is then empty it will delete the vector
- * structure.
- * @param [in, out] pNumbersPtr - pointer to the vector to remove the number from.
- * @param [in] num - the number to remove from the vector.
- */
-void phnumRemove(PhoneNumbers **pNumbersPtr, char const *num);
-
-/**
- * @brief Removes all the numbers containing the given prefix.
- * This function is used to delete all phone numbers that contain the given prefix from the vector. If there are no
- * numbers left in the vector, the vector is deleted.
- * @param [in, out] pNumbersPtr - pointer to the vector of phone numbers.
- * @param [in] prefix - the prefix of numbers we want to remove.
- */
-void phnumRemoveWithPrefix(PhoneNumbers **pNumbersPtr, char const *prefix);
-
-/**
- * @brief Removes phone number at the given index.
- * This function will free the memory allocated for the phone number at the given index and then shift all other
- * phone numbers in the array to the left.
- * @param [in, out] pNumbers - pointer to the phone numbers structure.
- * @param [in] index - index of the phone number to be removed.
- */
-void phnumRemoveAtIndex(PhoneNumbers *pNumbers, size_t index);
-
-/**
- * @brief Adds all numbers with changed prefix to the vector.
- * This function will create a copy of the original number, with a changed prefix, stored in one vector (using
- * @ref copyParts), and add these new numbers to the other vector.
- * @param [in] from - vector containing the prefixes.
- * @param [in, out] to - vector to add the new numbers to.
- * @param [in] originalNumber - the original number we want to change prefixes in.
- * @param [in] prefixLength - the length of the prefix we want to change in the original number.
- * @return Value @p true if the numbers were added successfully.
+ * @brief Reserves space in the vector.
+ * Makes sure the given number of numbers can be added to the vector without allocating memory.
+ * @param [in, out] pNumbers - pointer to the vector.
+ * @param [in] count - number of numbers that will be added to the vector.
+ * @return Value @p true if the space was reserved successfully.
  *         Value @p false if there was an allocation error.
  */
-bool phnumAddAllCopiedParts(PhoneNumbers *from, PhoneNumbers *to, char const *originalNumber, size_t prefixLength);
-
-/**
- * @brief Sorts the vector of phone numbers.
- * @param [in] pNumbers - pointer to the vector to sort.
- */
-void sortPhoneNumbers(PhoneNumbers *pNumbers);
+bool phnumReserve(PhoneNumbers *pNumbers, size_t count);
 
 /**
- * @brief Removes duplicates from the vector.
- * @param [in, out] pNumbers - pointer to the vector to remove duplicates from.
+ * @brief Sorts the vector of phone numbers and removes duplicates from it.
+ * The numbers are sorted with the most significant digit first radix sort over the twelve digits, in which equal
+ * numbers end up in a single bucket and all but one of them are deleted right away. Short parts of the array are
+ * sorted with insertion sort.
+ * @param [in, out] pNumbers - pointer to the vector to sort.
+ * @return Value @p true if the vector was sorted successfully.
+ *         Value @p false if there was an allocation error, the vector is then left partly sorted.
  */
-void removeDuplicates(PhoneNumbers *pNumbers);
+bool sortUniquePhoneNumbers(PhoneNumbers *pNumbers);
 
 #endif /* __PHONE_NUMBERS_H__ */
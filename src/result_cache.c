@@ -0,0 +1,182 @@
+/** @file
+ * Implementations of functions caching the results of the reverse lookups.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "phone_forward.h"
+#include "phone_numbers.h"
+#include "result_cache.h"
+#include "string_utils.h"
+
+/**
+ * @struct CacheEntry
+ * @brief Result kept for a single number.
+ * @var CacheEntry::num
+ *      Pointer to the copy of the number or NULL if the entry is empty.
+ * @var CacheEntry::result
+ *      Pointer to the copy of the result.
+ * @var CacheEntry::generation
+ *      Generation of the cache when the result was kept.
+ */
+struct CacheEntry {
+    char *num;
+    PhoneNumbers *result;
+    uint64_t generation;
+};
+
+/**
+ * @struct ResultCache result_cache.h
+ * @brief Table of the kept results.
+ * @var ResultCache::entries
+ *      Array of the entries.
+ * @var ResultCache::mask
+ *      Number of the entries decreased by 1, the entry of a number is its hash masked with it.
+ * @var ResultCache::changed
+ *      Generations of the last changes of the forwardings of the numbers starting with a prefix, indexed like the
+ *      entries with the masked hash of the prefix.
+ * @var ResultCache::redirected
+ *      Generations of the last changes that forwarded some numbers to the numbers starting with a prefix, indexed
+ *      the same way.
+ * @var ResultCache::generation
+ *      Number of the changes so far.
+ */
+struct ResultCache {
+    struct CacheEntry *entries;
+    size_t mask;
+    uint64_t *changed;
+    uint64_t *redirected;
+    uint64_t generation;
+};
+
+/**
+ * @brief Checks if a prefix of the number was stamped after the given generation.
+ * The hashes of all the prefixes of the number, from the empty one, are computed in a single pass. Prefixes with the
+ * same masked hash share their generation, which can only make a result look out of date when it isn't.
+ * @param [in] cache - pointer to the cache.
+ * @param [in] generations - the generations of the prefixes, @p changed or @p redirected of the cache.
+ * @param [in] num - pointer to the number.
+ * @param [in] generation - the generation of the result.
+ * @return Value @p true if any prefix of the number has a later generation.
+ *         Value @p false otherwise.
+ */
+static bool stampedSince(ResultCache const *cache, uint64_t const *generations, char const *num,
+                         uint64_t generation) {
+    uint64_t hash = NUMBER_HASH_BASIS;
+    for (size_t i = 0;; i++) {
+        if (generations[hash & cache->mask] > generation) {
+            return true;
+        }
+        if (!isValidDigit(num[i])) {
+            return false;
+        }
+        hash = hashNextDigit(hash, num[i]);
+    }
+}
+
+/**
+ * @brief Checks if the result kept in the entry could have been made out of date by a later change.
+ * It is out of date if some numbers were forwarded to a number its number starts with or if the forwardings of a
+ * prefix of any of its numbers were changed.
+ * @param [in] cache - pointer to the cache.
+ * @param [in] entry - pointer to the entry.
+ * @return Value @p true if the result can't be used.
+ *         Value @p false otherwise.
+ */
+static bool isOutOfDate(ResultCache const *cache, struct CacheEntry const *entry) {
+    if (stampedSince(cache, cache->redirected, entry->num, entry->generation)) {
+        return true;
+    }
+    for (size_t i = 0; i < phnumGetSize(entry->result); i++) {
+        if (stampedSince(cache, cache->changed, phnumGet(entry->result, i), entry->generation)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Empties the entry.
+ * @param [in, out] entry - pointer to the entry.
+ */
+static void clearEntry(struct CacheEntry *entry) {
+    free(entry->num);
+    phnumDelete(entry->result);
+    entry->num = NULL;
+    entry->result = NULL;
+}
+
+ResultCache *resultCacheNew(size_t capacity) {
+    if (capacity == 0 || capacity > SIZE_MAX / 2 / sizeof(struct CacheEntry)) {
+        return NULL;
+    }
+
+    ResultCache *cache = malloc(sizeof(ResultCache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    cache->mask = size - 1;
+    cache->generation = 0;
+    cache->changed = calloc(size, sizeof(uint64_t));
+    cache->redirected = calloc(size, sizeof(uint64_t));
+    cache->entries = calloc(size, sizeof(struct CacheEntry));
+    if (cache->changed == NULL || cache->redirected == NULL || cache->entries == NULL) {
+        resultCacheDelete(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void resultCacheDelete(ResultCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; cache->entries != NULL && i <= cache->mask; i++) {
+        clearEntry(&cache->entries[i]);
+    }
+    free(cache->entries);
+    free(cache->changed);
+    free(cache->redirected);
+    free(cache);
+}
+
+PhoneNumbers const *resultCacheFind(ResultCache const *cache, char const *num) {
+    struct CacheEntry const *entry = &cache->entries[hashNumber(num, NULL) & cache->mask];
+    if (entry->num == NULL || !areEqual(entry->num, num) || isOutOfDate(cache, entry)) {
+        return NULL;
+    }
+    return entry->result;
+}
+
+void resultCacheStore(ResultCache *cache, char const *num, PhoneNumbers const *result) {
+    struct CacheEntry *entry = &cache->entries[hashNumber(num, NULL) & cache->mask];
+    clearEntry(entry);
+
+    char *copy = NULL;
+    PhoneNumbers *resultCopy = phnumCopy(result);
+    if (resultCopy == NULL || !copyNumber(num, &copy)) {
+        phnumDelete(resultCopy);
+        return;
+    }
+    entry->num = copy;
+    entry->result = resultCopy;
+    entry->generation = cache->generation;
+}
+
+void resultCacheInvalidate(ResultCache *cache, char const *prefix, char const *target) {
+    cache->generation++;
+    cache->changed[hashNumber(prefix, NULL) & cache->mask] = cache->generation;
+    cache->redirected[hashNumber(target, NULL) & cache->mask] = cache->generation;
+}
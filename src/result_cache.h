@@ -0,0 +1,71 @@
+/** @file
+ * Interface of the class caching the results of the reverse lookups.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __RESULT_CACHE_H__
+#define __RESULT_CACHE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "phone_numbers.h"
+
+/**
+ * This is a structure storing copies of the recently computed results of @ref phfwdGetReverse.
+ * The table is direct mapped: a number can be kept only in the entry chosen by its hash, so finding it takes a single
+ * probe and storing a new result replaces the previous one in that entry. A change of the forwardings only stamps the
+ * prefixes it affects with a new generation, and a result found later is used only if none of the prefixes of its
+ * numbers was stamped after the result was kept.
+ */
+struct ResultCache;
+typedef struct ResultCache ResultCache; /**< Cache of the results. */
+
+/**
+ * @brief Creates a new empty cache.
+ * @param [in] capacity - number of the results kept, it is rounded up to a power of two.
+ * @return Pointer to the new cache or NULL if there was an allocation error or @p capacity is 0.
+ */
+ResultCache *resultCacheNew(size_t capacity);
+
+/**
+ * @brief Deletes the cache and the results kept in it.
+ * Does nothing if the pointer is NULL.
+ * @param [in] cache - pointer to the cache.
+ */
+void resultCacheDelete(ResultCache *cache);
+
+/**
+ * @brief Finds the result kept for the number.
+ * The result is checked against the changes made after it was kept, which takes time proportional to the length of
+ * the number and the total length of the numbers of the result.
+ * @param [in] cache - pointer to the cache.
+ * @param [in] num - pointer to the number, it has to be valid.
+ * @return Pointer to the kept result, valid until the cache is changed, or NULL if there is none.
+ */
+PhoneNumbers const *resultCacheFind(ResultCache const *cache, char const *num);
+
+/**
+ * @brief Keeps a copy of the result computed for the number.
+ * If there is no memory for the copy, the result is not kept.
+ * @param [in, out] cache - pointer to the cache.
+ * @param [in] num - pointer to the number, it has to be valid.
+ * @param [in] result - pointer to the result.
+ */
+void resultCacheStore(ResultCache *cache, char const *num, PhoneNumbers const *result);
+
+/**
+ * @brief Drops the results that a change of the forwardings of the prefix may have made out of date.
+ * Changing the forwardings of the numbers starting with @p prefix changes a result only if it contains such a number
+ * or if the numbers starting with @p prefix are now forwarded to their number, which means it starts with @p target. The results aren't
+ * looked at: @p prefix and @p target are stamped with a new generation, in time proportional to their lengths, and
+ * the results are checked when they are found.
+ * @param [in, out] cache - pointer to the cache.
+ * @param [in] prefix - pointer to the prefix whose forwardings were changed.
+ * @param [in] target - pointer to the number @p prefix is now forwarded to.
+ */
+void resultCacheInvalidate(ResultCache *cache, char const *prefix, char const *target);
+
+#endif /* __RESULT_CACHE_H__ */
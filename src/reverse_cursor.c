@@ -0,0 +1,441 @@
+/** @file
+ * Implementations of functions walking the results of the reverse forwarding in their sorted order.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "flat_index.h"
+#include "node_utils.h"
+#include "packed_number.h"
+#include "string_utils.h"
+#include "reverse_cursor.h"
+
+#define TREE_LEVEL 0 /**< The numbers of the level are stored in a node of the reverse tree. */
+#define FLAT_LEVEL 1 /**< The numbers of the level are stored in a list of the flat index. */
+#define SELF_LEVEL 2 /**< The level holds only the searched number itself. */
+#define FIRST_PENDING_CAPACITY 4 /**< Initial number of the numbers the pending stack of a level has memory for. */
+#define FIRST_RESULT_CAPACITY 64 /**< Initial number of the characters of the buffer for the results. */
+
+/** The empty packed number, the source of the searched number itself. */
+static PackedNumber const EMPTY_NUMBER[1] = {0};
+
+/**
+ * @struct ReverseLevel
+ * @brief Numbers forwarded to a single prefix of the searched number.
+ * The results of a level are its numbers followed by the rest of the searched number. Such results aren't sorted
+ * like the numbers themselves when one number is a prefix of another, so a number is read into the pending numbers
+ * and left there until every result of the numbers following it in the sorted order is known to be bigger. The pending
+ * numbers are then always prefixes of the next number, so there are few of them.
+ * @var ReverseLevel::kind
+ *      Where the numbers are stored, one of @ref TREE_LEVEL, @ref FLAT_LEVEL and @ref SELF_LEVEL.
+ * @var ReverseLevel::prefixLength
+ *      Length of the prefix of the searched number the numbers are forwarded to.
+ * @var ReverseLevel::node
+ *      Pointer to the node of the reverse tree storing the numbers.
+ * @var ReverseLevel::list
+ *      The list of the flat index storing the numbers.
+ * @var ReverseLevel::position
+ *      Index of @p next in the list of the flat index.
+ * @var ReverseLevel::next
+ *      Pointer to the first number of the level that wasn't read yet or NULL if all of them were.
+ * @var ReverseLevel::head
+ *      Pointer to the number of the smallest result of the level that wasn't obtained yet or NULL if there is none.
+ * @var ReverseLevel::pending
+ *      Array of the numbers that were read, but whose results weren't obtained yet.
+ * @var ReverseLevel::pendingCount
+ *      Number of the pending numbers.
+ * @var ReverseLevel::pendingCapacity
+ *      Number of the numbers @p pending has memory for.
+ */
+struct ReverseLevel {
+    int kind;
+    size_t prefixLength;
+    DNode *node;
+    uint32_t list;
+    uint32_t position;
+    PackedNumber const *next;
+    PackedNumber const *head;
+    PackedNumber const **pending;
+    size_t pendingCount;
+    size_t pendingCapacity;
+};
+
+/**
+ * @struct LevelWalk
+ * @brief Position on the route of the searched number in the reverse tree.
+ * @var LevelWalk::node
+ *      Pointer to the current node of the reverse tree.
+ * @var LevelWalk::flatNode
+ *      Index of the current node of the reverse tree of the flat index.
+ * @var LevelWalk::prefixLength
+ *      Number of the digits of the searched number on the route to the current node.
+ * @var LevelWalk::finished
+ *      Whether the end of the route was reached and the level of the searched number itself was found.
+ */
+struct LevelWalk {
+    DNode *node;
+    uint32_t flatNode;
+    size_t prefixLength;
+    bool finished;
+};
+
+/**
+ * @struct ReverseCursor reverse_cursor.h
+ * @brief Levels of the results and the current result.
+ * @var ReverseCursor::index
+ *      Pointer to the flat index storing the trees or NULL.
+ * @var ReverseCursor::num
+ *      Copy of the searched number.
+ * @var ReverseCursor::levels
+ *      Array of the levels.
+ * @var ReverseCursor::count
+ *      Number of the levels.
+ * @var ReverseCursor::result
+ *      Buffer for the current result.
+ * @var ReverseCursor::capacity
+ *      Number of the characters @p result has memory for.
+ */
+struct ReverseCursor {
+    FlatIndex const *index;
+    char *num;
+    struct ReverseLevel *levels;
+    size_t count;
+    char *result;
+    size_t capacity;
+};
+
+/**
+ * @brief Starts walking the route of the searched number.
+ * @param [in, out] walk - pointer to the position to set.
+ * @param [in] reverseStart - pointer to the root of the reverse tree.
+ */
+static void startWalk(struct LevelWalk *walk, DNode *reverseStart) {
+    walk->node = reverseStart;
+    walk->flatNode = 0;
+    walk->prefixLength = 0;
+    walk->finished = false;
+}
+
+/**
+ * @brief Finds the next level of the results.
+ * The levels are found in the order of the lengths of their prefixes, the level of the searched number itself is the
+ * last one.
+ * @param [in, out] walk - pointer to the position on the route.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in] num - the searched number.
+ * @param [in, out] level - pointer to the level to set, only its numbers and prefix are set.
+ * @return Value @p true if the level was found.
+ *         Value @p false if there are no more levels.
+ */
+static bool nextLevel(struct LevelWalk *walk, FlatIndex const *index, char const *num, struct ReverseLevel *level) {
+    if (walk->finished) {
+        return false;
+    }
+
+    if (index != NULL) {
+        if (flatNextReverse(index, &walk->flatNode, num, &walk->prefixLength, &level->list)) {
+            level->kind = FLAT_LEVEL;
+            level->prefixLength = walk->prefixLength;
+            return true;
+        }
+    } else {
+        walk->node = nodeNextReverse(walk->node, num, &walk->prefixLength);
+        if (walk->node != NULL) {
+            level->kind = TREE_LEVEL;
+            level->node = walk->node;
+            level->prefixLength = walk->prefixLength;
+            return true;
+        }
+    }
+
+    walk->finished = true;
+    level->kind = SELF_LEVEL;
+    level->prefixLength = 0;
+    return true;
+}
+
+/**
+ * @brief Obtains the first number of the level.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in, out] level - pointer to the level.
+ * @return Pointer to the first number or NULL if the level has no numbers.
+ */
+static PackedNumber const *firstSource(FlatIndex const *index, struct ReverseLevel *level) {
+    level->position = 0;
+    if (level->kind == TREE_LEVEL) {
+        return nodeNextSource(level->node, NULL);
+    } else if (level->kind == FLAT_LEVEL) {
+        return flatListSize(index, level->list) > 0 ? flatListNumber(index, level->list, 0) : NULL;
+    }
+    return EMPTY_NUMBER;
+}
+
+/**
+ * @brief Obtains the number of the level following the given one.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in, out] level - pointer to the level.
+ * @param [in] current - pointer to the current number of the level, at @p position in a list of the flat index.
+ * @return Pointer to the next number or NULL if there is none.
+ */
+static PackedNumber const *nextSource(FlatIndex const *index, struct ReverseLevel *level,
+                                      PackedNumber const *current) {
+    if (level->kind == TREE_LEVEL) {
+        return nodeNextSource(level->node, current);
+    } else if (level->kind == FLAT_LEVEL && level->position + 1 < flatListSize(index, level->list)) {
+        return flatListNumber(index, level->list, ++level->position);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Checks if the level stores the beginning of the packed number.
+ * The lists of the flat index are sorted, so they are searched with binary search.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in] level - pointer to the level.
+ * @param [in] number - pointer to the packed number.
+ * @param [in] len - number of the first digits of @p number to look for.
+ * @return Value @p true if the level stores the number made of the first @p len digits of @p number.
+ *         Value @p false otherwise.
+ */
+static bool hasSource(FlatIndex const *index, struct ReverseLevel const *level, PackedNumber const *number,
+                      size_t len) {
+    if (level->kind == TREE_LEVEL) {
+        return nodeHasSource(level->node, number, len);
+    } else if (level->kind != FLAT_LEVEL) {
+        return false;
+    }
+
+    uint32_t low = 0;
+    uint32_t high = flatListSize(index, level->list);
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int comparison = comparePackedPrefix(flatListNumber(index, level->list, middle), number, len);
+        if (comparison == 0) {
+            return true;
+        } else if (comparison < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Adds the number to the pending numbers of the level.
+ * @param [in, out] level - pointer to the level.
+ * @param [in] number - pointer to the number.
+ * @return Value @p true if the number was added successfully.
+ *         Value @p false if there was an allocation error.
+ */
+static bool pushPending(struct ReverseLevel *level, PackedNumber const *number) {
+    if (level->pendingCount == level->pendingCapacity) {
+        size_t capacity = level->pendingCapacity == 0 ? FIRST_PENDING_CAPACITY : 2 * level->pendingCapacity;
+        PackedNumber const **pending = realloc(level->pending, capacity * sizeof(PackedNumber const *));
+        if (pending == NULL) {
+            return false;
+        }
+        level->pending = pending;
+        level->pendingCapacity = capacity;
+    }
+    level->pending[level->pendingCount++] = number;
+    return true;
+}
+
+/**
+ * @brief Finds the next smallest result of the level.
+ * The smallest pending result can be obtained once it is smaller than the next number of the level, as then it is
+ * smaller than the results of all the numbers that weren't read yet. Otherwise the next number becomes pending.
+ * @param [in] cursor - pointer to the cursor.
+ * @param [in, out] level - pointer to the level.
+ * @return Value @p true if the result was found successfully or there are no more results.
+ *         Value @p false if there was an allocation error.
+ */
+static bool advanceLevel(ReverseCursor *cursor, struct ReverseLevel *level) {
+    char const *suffix = cursor->num + level->prefixLength;
+    while (true) {
+        size_t smallest = level->pendingCount;
+        for (size_t i = 0; i < level->pendingCount; i++) {
+            if (smallest == level->pendingCount ||
+                comparePackedParts(level->pending[i], suffix, level->pending[smallest], suffix) < 0) {
+                smallest = i;
+            }
+        }
+
+        if (smallest < level->pendingCount &&
+            (level->next == NULL || comparePackedParts(level->pending[smallest], suffix, level->next, NULL) < 0)) {
+            level->head = level->pending[smallest];
+            level->pending[smallest] = level->pending[--level->pendingCount];
+            return true;
+        }
+        if (level->next == NULL) {
+            level->head = NULL;
+            return true;
+        }
+
+        if (!pushPending(level, level->next)) {
+            return false;
+        }
+        level->next = nextSource(cursor->index, level, level->next);
+    }
+}
+
+ReverseCursor *reverseCursorNew(DNode *reverseStart, FlatIndex const *index, char const *num) {
+    ReverseCursor *cursor = malloc(sizeof(ReverseCursor));
+    if (cursor == NULL) {
+        return NULL;
+    }
+
+    size_t len = length(num);
+    cursor->index = index;
+    cursor->count = 0;
+    cursor->num = NULL;
+    cursor->result = NULL;
+    cursor->capacity = 0;
+    cursor->levels = malloc((len + 1) * sizeof(struct ReverseLevel));
+    if (cursor->levels == NULL || !copyNumber(num, &cursor->num)) {
+        reverseCursorDelete(cursor);
+        return NULL;
+    }
+
+    struct LevelWalk walk;
+    startWalk(&walk, reverseStart);
+    struct ReverseLevel level;
+    while (nextLevel(&walk, index, num, &level)) {
+        level.pending = NULL;
+        level.pendingCount = 0;
+        level.pendingCapacity = 0;
+        level.next = firstSource(index, &level);
+        cursor->levels[cursor->count++] = level;
+        if (!advanceLevel(cursor, &cursor->levels[cursor->count - 1])) {
+            reverseCursorDelete(cursor);
+            return NULL;
+        }
+    }
+    return cursor;
+}
+
+void reverseCursorDelete(ReverseCursor *cursor) {
+    if (cursor == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cursor->count; i++) {
+        free(cursor->levels[i].pending);
+    }
+    free(cursor->levels);
+    free(cursor->num);
+    free(cursor->result);
+    free(cursor);
+}
+
+/**
+ * @brief Compares the smallest results of two levels.
+ * @param [in] cursor - pointer to the cursor.
+ * @param [in] level - pointer to the first level.
+ * @param [in] other - pointer to the second level.
+ * @return Negative value if the result of @p level is smaller, 0 if the results are equal and positive value
+ *         otherwise.
+ */
+static int compareHeads(ReverseCursor const *cursor, struct ReverseLevel const *level,
+                        struct ReverseLevel const *other) {
+    return comparePackedParts(level->head, cursor->num + level->prefixLength, other->head,
+                              cursor->num + other->prefixLength);
+}
+
+bool reverseCursorNext(ReverseCursor *cursor, char const **num) {
+    struct ReverseLevel *smallest = NULL;
+    for (size_t i = 0; i < cursor->count; i++) {
+        struct ReverseLevel *level = &cursor->levels[i];
+        if (level->head != NULL && (smallest == NULL || compareHeads(cursor, level, smallest) < 0)) {
+            smallest = level;
+        }
+    }
+    if (smallest == NULL) {
+        *num = NULL;
+        return true;
+    }
+
+    size_t size = packedLength(smallest->head) + length(cursor->num + smallest->prefixLength) + 1;
+    if (size > cursor->capacity) {
+        size_t capacity = cursor->capacity == 0 ? FIRST_RESULT_CAPACITY : 2 * cursor->capacity;
+        if (capacity < size) {
+            capacity = size;
+        }
+        char *result = realloc(cursor->result, capacity * sizeof(char));
+        if (result == NULL) {
+            return false;
+        }
+        cursor->result = result;
+        cursor->capacity = capacity;
+    }
+    size_t sourceLength = packedLength(smallest->head);
+    unpackNumber(smallest->head, cursor->result);
+    writePackedParts(cursor->num + smallest->prefixLength, NULL, 0, cursor->result + sourceLength,
+                     size - sourceLength);
+
+    for (size_t i = 0; i < cursor->count; i++) {
+        struct ReverseLevel *level = &cursor->levels[i];
+        if (level->head != NULL && comparePackedParts(level->head, cursor->num + level->prefixLength, NULL,
+                                                      cursor->result) == 0 && !advanceLevel(cursor, level)) {
+            return false;
+        }
+    }
+    *num = cursor->result;
+    return true;
+}
+
+/**
+ * @brief Checks if the result of the number of the level is also a result of a level with a shorter prefix.
+ * A number @p source forwarded to the prefix of length @p p gives the same result as a number forwarded to the
+ * prefix of length @p q < @p p only if that number is @p source without its last @p p - @p q digits, which have to be
+ * the digits of the searched number between its positions @p q and @p p.
+ * @param [in] reverseStart - pointer to the root of the reverse tree, used if @p index is NULL.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in] num - the searched number.
+ * @param [in] prefixLength - length of the prefix the number is forwarded to.
+ * @param [in] source - pointer to the number.
+ * @return Value @p true if the result was already counted for a shorter prefix.
+ *         Value @p false otherwise.
+ */
+static bool isCountedBefore(DNode *reverseStart, FlatIndex const *index, char const *num, size_t prefixLength,
+                            PackedNumber const *source) {
+    size_t sourceLength = packedLength(source);
+    struct LevelWalk walk;
+    startWalk(&walk, reverseStart);
+    struct ReverseLevel level;
+    while (nextLevel(&walk, index, num, &level) && level.kind != SELF_LEVEL && level.prefixLength < prefixLength) {
+        size_t cut = prefixLength - level.prefixLength;
+        if (cut < sourceLength && packedEndsWith(source, num + level.prefixLength, cut) &&
+            hasSource(index, &level, source, sourceLength - cut)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t reverseCount(DNode *reverseStart, FlatIndex const *index, char const *num) {
+    size_t count = 0;
+    struct LevelWalk walk;
+    startWalk(&walk, reverseStart);
+    struct ReverseLevel level;
+    while (nextLevel(&walk, index, num, &level)) {
+        if (level.kind == SELF_LEVEL) {
+            count++;
+            continue;
+        }
+        for (PackedNumber const *source = firstSource(index, &level); source != NULL;
+             source = nextSource(index, &level, source)) {
+            if (!isCountedBefore(reverseStart, index, num, level.prefixLength, source)) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,64 @@
+/** @file
+ * Interface of the class walking the results of the reverse forwarding in their sorted order.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __REVERSE_CURSOR_H__
+#define __REVERSE_CURSOR_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "flat_index.h"
+#include "node_utils.h"
+
+/**
+ * This is a structure storing the position in the results of @ref phfwdReverse.
+ * The numbers forwarded to each prefix of the searched number are read in their sorted order straight from the
+ * reverse tree and merged, so the results are obtained one by one, in their sorted order and without duplicates,
+ * and only the current one is kept in memory.
+ */
+struct ReverseCursor;
+typedef struct ReverseCursor ReverseCursor; /**< Position in the results of the reverse forwarding. */
+
+/**
+ * @brief Creates a new cursor placed before the first result.
+ * The trees mustn't be changed or freed until the cursor is deleted.
+ * @param [in] reverseStart - pointer to the root of the reverse tree, used if @p index is NULL.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in] num - the number we are finding reverse forwards of, it has to be valid.
+ * @return Pointer to the new cursor or NULL if there was an allocation error.
+ */
+ReverseCursor *reverseCursorNew(DNode *reverseStart, FlatIndex const *index, char const *num);
+
+/**
+ * @brief Deletes the cursor.
+ * Does nothing if the pointer is NULL.
+ * @param [in] cursor - pointer to the cursor.
+ */
+void reverseCursorDelete(ReverseCursor *cursor);
+
+/**
+ * @brief Moves the cursor to the next result.
+ * @param [in, out] cursor - pointer to the cursor.
+ * @param [in, out] num - pointer to the result, valid until the cursor is moved again or deleted, or to NULL if there
+ *                        are no more results.
+ * @return Value @p true if the cursor was moved successfully.
+ *         Value @p false if there was an allocation error, the cursor can then only be deleted.
+ */
+bool reverseCursorNext(ReverseCursor *cursor, char const **num);
+
+/**
+ * @brief Counts the results of the reverse forwarding.
+ * The numbers forwarded to each prefix of the searched number are counted without building the results. A result
+ * obtained from more than one prefix is counted only for the shortest of them. No memory is allocated.
+ * @param [in] reverseStart - pointer to the root of the reverse tree, used if @p index is NULL.
+ * @param [in] index - pointer to the flat index storing the trees or NULL.
+ * @param [in] num - the number we are finding reverse forwards of, it has to be valid.
+ * @return Number of the results, including @p num itself.
+ */
+size_t reverseCount(DNode *reverseStart, FlatIndex const *index, char const *num);
+
+#endif /* __REVERSE_CURSOR_H__ */
@@ -6,18 +6,30 @@
  * @date 2022
  */
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
-#include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "string_utils.h"
 
+#ifndef PHFWD_DECIMAL_ONLY
 #define DECIMAL_STAR_REPRESENTATION 10 /**< The digit which '*' represents. */
 #define DECIMAL_HASH_REPRESENTATION 11 /**< The digit which '#' represents. */
+#endif
 
-bool isValidDigit(char const c) {
-    return isdigit(c) || c == '*' || c == '#';
-}
+#ifdef PHFWD_DECIMAL_ONLY
+char const DIGIT_CHARS[NUMBER_OF_DIGITS] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
+#else
+char const DIGIT_CHARS[NUMBER_OF_DIGITS] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '*', '#'};
+#endif
+
+unsigned char const DIGIT_CLASSES[UCHAR_MAX + 1] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+#ifndef PHFWD_DECIMAL_ONLY
+    ['*'] = DECIMAL_STAR_REPRESENTATION + 1, ['#'] = DECIMAL_HASH_REPRESENTATION + 1,
+#endif
+};
 
 bool isNumber(char const *number) {
     if (number == NULL) {
@@ -35,6 +47,18 @@ bool isNumber(char const *number) {
     return true;
 }
 
+bool isNumberOfLength(char const *number, size_t len) {
+    if (number == NULL || len == 0) {
+        return false;
+    }
+
+    unsigned char invalid = 0;
+    for (size_t i = 0; i < len; i++) {
+        invalid |= DIGIT_CLASSES[(unsigned char) number[i]] == 0;
+    }
+    return invalid == 0;
+}
+
 bool areEqual(char const *num1, char const *num2) {
     size_t i = 0;
 
@@ -48,6 +72,18 @@ bool areEqual(char const *num1, char const *num2) {
     return num1[i] == '\0' && num2[i] == '\0';
 }
 
+int compareNumbers(char const *num1, char const *num2) {
+    size_t i = 0;
+
+    while (isValidDigit(num1[i]) && num1[i] == num2[i]) {
+        i++;
+    }
+
+    int const n1 = isValidDigit(num1[i]) ? toDecimalRepresentation(num1[i]) + 1 : 0;
+    int const n2 = isValidDigit(num2[i]) ? toDecimalRepresentation(num2[i]) + 1 : 0;
+    return n1 - n2;
+}
+
 bool isPrefix(char const *num, char const *prefix) {
     size_t i = 0;
 
@@ -111,13 +147,16 @@ size_t length(const char *num) {
     return len;
 }
 
-int toDecimalRepresentation(char const c) {
-    if (c == '*') {
-        return DECIMAL_STAR_REPRESENTATION;
-    } else if (c == '#') {
-        return DECIMAL_HASH_REPRESENTATION;
+uint64_t hashNumber(char const *num, size_t *len) {
+    uint64_t hash = NUMBER_HASH_BASIS;
+    size_t i = 0;
+    for (; isValidDigit(num[i]); i++) {
+        hash = hashNextDigit(hash, num[i]);
+    }
+    if (len != NULL) {
+        *len = i;
     }
-    return c - '0';
+    return hash;
 }
 
 bool copyNumber(char const *num, char **numberPtr) {
@@ -9,16 +9,45 @@
 #ifndef __STRING_UTILS_H__
 #define __STRING_UTILS_H__
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#define NUMBER_HASH_BASIS UINT64_C(14695981039346656037) /**< FNV-1a hash of the empty number. */
+#define NUMBER_HASH_PRIME UINT64_C(1099511628211) /**< Multiplier of the FNV-1a hash of the numbers. */
+
+#ifdef PHFWD_DECIMAL_ONLY
+#define NUMBER_OF_DIGITS 10 /**< Number of different digits, the decimal-only build doesn't accept '*' and '#'. */
+#else
+#define NUMBER_OF_DIGITS 12 /**< Number of different digits. */
+#endif
+
+/**
+ * Characters of the digits, indexed with their decimal representations.
+ * All the loops over the digits are bounded by @ref NUMBER_OF_DIGITS, so in the decimal-only build, selected with the
+ * @p PHFWD_DECIMAL_ONLY macro, the same code walks nodes with at most 10 children and the compiler can unroll it for
+ * that alphabet.
+ */
+extern char const DIGIT_CHARS[NUMBER_OF_DIGITS];
+
+/**
+ * Class of each char: the decimal representation of the digit it represents increased by 1, or 0 if it isn't a digit.
+ * The digits are checked and converted on every step of every walk down the trees, so the table replaces comparisons
+ * and the locale-aware @p isdigit, and the functions using it are defined here to be inlined.
+ */
+extern unsigned char const DIGIT_CLASSES[UCHAR_MAX + 1];
 
 /**
  * @brief Checks if the given char is a digit.
- * Checks whether the given char is a representation of a digit (0-9, '*' or '#').
+ * Checks whether the given char is a representation of a digit (0-9 and, unless the build is decimal-only, '*' or
+ * '#').
  * @param [in] c - char to check.
  * @return Value @p true if the given char is a digit, @p false otherwise.
  */
-bool isValidDigit(char c);
+static inline bool isValidDigit(char c) {
+    return DIGIT_CLASSES[(unsigned char) c] != 0;
+}
 
 /**
  * @brief Checks if the given string is a valid phone number.
@@ -28,6 +57,16 @@ bool isValidDigit(char c);
  */
 bool isNumber(char const *number);
 
+/**
+ * @brief Checks if the first characters of the string are a valid phone number.
+ * Reads exactly @p len characters, the string doesn't have to be terminated.
+ * @param [in] number - string to check.
+ * @param [in] len - number of the characters to check.
+ * @return Value @p true if the characters are a valid phone number.
+ *         Value @p false otherwise.
+ */
+bool isNumberOfLength(char const *number, size_t len);
+
 /**
  * @brief Checks if two numbers are equal.
  * @param [in] num1 - first number to compare.
@@ -37,6 +76,16 @@ bool isNumber(char const *number);
  */
 bool areEqual(char const *num1, char const *num2);
 
+/**
+ * @brief Compares two numbers according to their lexicographical order.
+ * The digits are ordered by their decimal representations, so '*' and '#' come after '9'.
+ * @param [in] num1 - first number to compare.
+ * @param [in] num2 - second number to compare.
+ * @return Negative value if the first number is smaller, positive value if it is greater and 0 if the numbers are
+ *         equal.
+ */
+int compareNumbers(char const *num1, char const *num2);
+
 /**
  * @brief Checks if one number is a prefix of another.
  * @param [in] num - number to check.
@@ -64,13 +113,34 @@ bool checkNumbers(char const *num1, char const *num2);
  */
 size_t length(char const *num);
 
+/**
+ * @brief Extends the hash of a number with the next digit.
+ * Starting from @ref NUMBER_HASH_BASIS, it gives the hashes of all the prefixes of a number in a single pass.
+ * @param [in] hash - FNV-1a hash of the number without the digit.
+ * @param [in] c - the next digit.
+ * @return FNV-1a hash of the number with the digit.
+ */
+static inline uint64_t hashNextDigit(uint64_t hash, char c) {
+    return (hash ^ (unsigned char) c) * NUMBER_HASH_PRIME;
+}
+
+/**
+ * @brief Computes the FNV-1a hash of the number.
+ * @param [in] num - pointer to the number.
+ * @param [in, out] len - pointer to the length of the number, set unless it is NULL.
+ * @return The hash.
+ */
+uint64_t hashNumber(char const *num, size_t *len);
+
 /**
  * @brief Obtains the decimal representation.
  * Obtains the decimal representation of the given char.
  * @param [in] c - digit to convert.
- * @return Decimal representation of the digit.
+ * @return Decimal representation of the digit or -1 if the char isn't a digit.
  */
-int toDecimalRepresentation(char c);
+static inline int toDecimalRepresentation(char c) {
+    return DIGIT_CLASSES[(unsigned char) c] - 1;
+}
 
 /**
  * @brief Copies the number to the given buffer.
@@ -0,0 +1,193 @@
+/** @file
+ * Implementations of functions running tasks on many threads.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "thread_pool.h"
+
+/**
+ * @struct ThreadPool thread_pool.h
+ * @brief Threads of the pool and the tasks they are running.
+ * @var ThreadPool::mutex
+ *      Mutex guarding the tasks and @p stopping.
+ * @var ThreadPool::work
+ *      Condition signalled when new tasks are given or the pool is stopping.
+ * @var ThreadPool::done
+ *      Condition signalled when the last task is finished.
+ * @var ThreadPool::run
+ *      Mutex serializing the calls of @ref threadPoolRun.
+ * @var ThreadPool::threads
+ *      Array of the threads.
+ * @var ThreadPool::threadCount
+ *      Number of the threads.
+ * @var ThreadPool::task
+ *      The function running the current tasks.
+ * @var ThreadPool::context
+ *      Pointer passed to @p task.
+ * @var ThreadPool::count
+ *      Number of the current tasks.
+ * @var ThreadPool::next
+ *      Index of the next task that isn't taken by any thread yet.
+ * @var ThreadPool::unfinished
+ *      Number of the current tasks that aren't finished yet.
+ * @var ThreadPool::stopping
+ *      Whether the threads should stop.
+ */
+struct ThreadPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    pthread_mutex_t run;
+    pthread_t *threads;
+    size_t threadCount;
+    ParallelTask task;
+    void *context;
+    size_t count;
+    size_t next;
+    size_t unfinished;
+    bool stopping;
+};
+
+/**
+ * @brief Runs the tasks that aren't taken yet.
+ * The mutex of the pool has to be locked, it is unlocked for the time of running each task.
+ * @param [in, out] pool - pointer to the pool.
+ */
+static void runTasks(ThreadPool *pool) {
+    while (pool->next < pool->count) {
+        size_t index = pool->next++;
+        pthread_mutex_unlock(&pool->mutex);
+        pool->task(pool->context, index);
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->unfinished == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+}
+
+/**
+ * @brief Runs the tasks given to the pool until it is stopped.
+ * @param [in, out] argument - pointer to the pool.
+ * @return Value NULL.
+ */
+static void *workerMain(void *argument) {
+    ThreadPool *pool = argument;
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->stopping) {
+        if (pool->next < pool->count) {
+            runTasks(pool);
+        } else {
+            pthread_cond_wait(&pool->work, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Stops the threads that were started and waits for them.
+ * @param [in, out] pool - pointer to the pool.
+ * @param [in] started - number of the threads that were started.
+ */
+static void stopThreads(ThreadPool *pool, size_t started) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+}
+
+/**
+ * @brief Frees the pool and its synchronization objects.
+ * @param [in] pool - pointer to the pool.
+ */
+static void freePool(ThreadPool *pool) {
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->run);
+    free(pool->threads);
+    free(pool);
+}
+
+ThreadPool *threadPoolNew(size_t threadCount) {
+    ThreadPool *pool = malloc(sizeof(ThreadPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->threads = malloc((threadCount > 0 ? threadCount : 1) * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pthread_mutex_init(&pool->run, NULL);
+    pool->threadCount = threadCount;
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->count = 0;
+    pool->next = 0;
+    pool->unfinished = 0;
+    pool->stopping = false;
+
+    for (size_t i = 0; i < threadCount; i++) {
+        if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) {
+            stopThreads(pool, i);
+            freePool(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void threadPoolDelete(ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    stopThreads(pool, pool->threadCount);
+    freePool(pool);
+}
+
+void threadPoolRun(ThreadPool *pool, ParallelTask task, void *context, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run);
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->context = context;
+    pool->count = count;
+    pool->next = 0;
+    pool->unfinished = count;
+    if (count > 1) {
+        pthread_cond_broadcast(&pool->work);
+    }
+
+    runTasks(pool);
+    while (pool->unfinished > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pool->count = 0;
+    pool->next = 0;
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_mutex_unlock(&pool->run);
+}
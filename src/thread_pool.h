@@ -0,0 +1,54 @@
+/** @file
+ * Interface of the class running tasks on many threads.
+ *
+ * @author Szymon Dziuda <sd438422@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * This is a structure storing the threads that run the tasks passed to @ref threadPoolRun.
+ */
+struct ThreadPool;
+typedef struct ThreadPool ThreadPool; /**< Pool of threads. */
+
+/**
+ * @brief Function running a single task.
+ * @param [in, out] context - pointer passed to @ref threadPoolRun.
+ * @param [in] index - index of the task.
+ */
+typedef void (*ParallelTask)(void *context, size_t index);
+
+/**
+ * @brief Creates a new pool of threads.
+ * @param [in] threadCount - number of the threads started besides the one calling @ref threadPoolRun, 0 means that
+ *                           all tasks are run by the caller.
+ * @return Pointer to the new pool or NULL if there was an allocation error or a thread couldn't be started.
+ */
+ThreadPool *threadPoolNew(size_t threadCount);
+
+/**
+ * @brief Stops the threads and deletes the pool.
+ * Does nothing if the pointer is NULL.
+ * @param [in] pool - pointer to the pool.
+ */
+void threadPoolDelete(ThreadPool *pool);
+
+/**
+ * @brief Runs the tasks on the threads of the pool.
+ * Calls @p task for every index from 0 to @p count - 1, each index is taken by the first free thread, including the
+ * calling one. Returns once all the tasks are finished. Calls from different threads are run one after another.
+ * @param [in, out] pool - pointer to the pool.
+ * @param [in] task - the function running a task.
+ * @param [in, out] context - pointer passed to @p task.
+ * @param [in] count - number of the tasks.
+ */
+void threadPoolRun(ThreadPool *pool, ParallelTask task, void *context, size_t count);
+
+#endif /* __THREAD_POOL_H__ */